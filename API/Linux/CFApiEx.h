@@ -0,0 +1,1779 @@
+#ifndef _CFAPIEX_H_
+#define _CFAPIEX_H_
+
+#include "CFApi.h"
+
+//======================== Host-side extensions to libCFApi =========================
+// Built from API/Linux/src on top of the libCFApi interface and linked together with
+// libCFApi.a / libCFApi.so, see README.md "Host-side extensions".
+
+#define	BATCH_DRAIN_TIMEOUT					2		// ms allowed to finish a label that is already arriving while draining a batch
+
+#ifndef TAGCOMPACT_CODE_LEN
+#define TAGCOMPACT_CODE_LEN					12		// inline code slot of TagInfoCompact: 12, 16 or 32
+#endif
+#define TAGCOMPACT_NO_ARENA					0xFFFF	// TagInfoCompact.arenaOff when the code is inline (or was truncated)
+
+// TagInfo without the inline code[255]: 24 bytes with the default 12 byte slot.
+// Codes longer than the slot are stored in a TagCodeArena and referenced by arenaOff.
+typedef struct
+{
+	short rssi;
+	unsigned short arenaOff;
+	unsigned char antenna;
+	unsigned char channel;
+	unsigned char codeLen;
+	unsigned char pc[2];
+	unsigned char crc[2];
+	unsigned char code[TAGCOMPACT_CODE_LEN];
+}TagInfoCompact;
+
+// Caller-owned overflow storage for codes longer than TAGCOMPACT_CODE_LEN. Reset used to 0
+// before reusing it for the next batch; codes that no longer fit are truncated to the slot.
+typedef struct
+{
+	unsigned char* base;
+	unsigned short size;
+	unsigned short used;
+}TagCodeArena;
+
+#define STREAM_BATCH_MAX					32		// labels per InventoryStartStreaming callback
+#define STREAM_POLL_TIMEOUT					DEF_READ_TIMEOUT	// ms the reader thread waits before checking for stop
+#define STREAM_PER_TAG						0x01	// flags: one callback per label instead of per burst
+#define STREAM_NO_INVENTORY					0x02	// flags: do not send InventoryContinue (reader already reports on its own, e.g. WORKMODE auto/trigger)
+
+// Called from the reader thread of InventoryStartStreaming. status is STAT_OK with count >= 1
+// labels, or the status that ended the stream (STAT_CMD_INVENTORY_STOP, STAT_DLL_DISCONNECT ...)
+// with count 0. tags and arena are only valid during the call.
+typedef void (*TagStreamCallback)(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx);
+
+#define RING_DEFAULT_SIZE					1024	// labels held by InventoryStartRing / TagAggregatorCreate when size is 0, rounded up to a power of two
+
+// Counters of a tag ring. Labels are dropped (overflow) when the consumer falls behind; codes
+// longer than TAGCOMPACT_CODE_LEN are kept truncated to the inline slot (truncated).
+typedef struct
+{
+	uint64_t pushed;
+	uint64_t popped;
+	uint64_t overflow;
+	uint64_t truncated;
+	size_t capacity;
+	size_t used;
+}TagRingStats;
+
+// Label of a TagAggregator together with the connection it was read on.
+typedef struct
+{
+	int64_t hComm;
+	TagInfoCompact tag;
+}TagInfoSourced;
+
+// Multi-producer ring fed by the reader threads of several connections.
+typedef struct TagAggregator TagAggregator;
+
+#define SERIAL_OPT_LOW_LATENCY				0x01	// SerialOptions.flags: ASYNC_LOW_LATENCY on the tty (+ 1 ms FTDI latency timer)
+#define SERIAL_OPT_EXCLUSIVE				0x02	// SerialOptions.flags: TIOCEXCL, further opens of the port fail with EBUSY
+#define SERIAL_OPT_VMIN_VTIME				0x04	// SerialOptions.flags: apply vmin / vtime
+#define SERIAL_OPT_LATENCY_TIMER			0x08	// LinkStats.applied: latencyTimer written to the FTDI adapter
+
+// Options of OpenDeviceEx applied on top of the OpenDevice settings.
+typedef struct
+{
+	unsigned int flags;				// SERIAL_OPT_*
+	unsigned char vmin;				// termios VMIN
+	unsigned char vtime;			// termios VTIME, 0.1 s
+	unsigned char latencyTimer;		// FTDI latency timer in ms (1..255), 0 to keep the adapter setting
+}SerialOptions;
+
+// Link statistics of GetLinkStats. Rates are measured since the previous call.
+typedef struct
+{
+	uint64_t rxBytes;				// since OpenDeviceEx / the first GetLinkStats call
+	uint64_t txBytes;
+	unsigned int elapsedMs;
+	unsigned int rxRate;			// bytes/s
+	unsigned int txRate;
+	unsigned int baudRate;			// rate the tty is really set to, 0 for network connections
+	unsigned int applied;			// SERIAL_OPT_* OpenDeviceEx managed to apply
+}LinkStats;
+
+#define READVIEW_POOL_SIZE					8		// TagReadView a handle can lend out at the same time
+
+// Read response lent out of the receive slot of a handle, no copy is made. The offsets index
+// frame (CF FF cmd len status payload crc); valid until ReleaseTagReadView.
+typedef struct
+{
+	const unsigned char* frame;
+	unsigned short frameLen;
+	unsigned char tagStatus;
+	unsigned char antenna;
+	unsigned short crcOff;			// 2 bytes
+	unsigned short pcOff;			// 2 bytes
+	unsigned short codeOff;
+	unsigned char codeLen;
+	unsigned short dataOff;			// read data, dataLen bytes (2 * wordCount)
+	unsigned short dataLen;
+	int slot;						// receive slot, owned by the library
+}TagReadView;
+
+#define TAGOP_READ							0x01	// TagOp.type: ReadTag
+#define TAGOP_WRITE							0x02	// TagOp.type: WriteTag
+#define TAGOP_LOCK							0x03	// TagOp.type: LockTag
+#define OPQUEUE_DEFAULT_DEPTH				4		// operations CFOpQueueSubmit keeps in flight
+#define OPQUEUE_DEPTH_MAX					8
+
+// One tag operation of CFOpQueueSubmit, fields as for ReadTag / WriteTag / LockTag. With maskBits
+// set, SetSelectMask(maskPtr, maskBits, mask) is sent in front of it to target one tag (option 0x01).
+typedef struct
+{
+	unsigned char type;				// TAGOP_*
+	unsigned char option;
+	unsigned char accPwd[4];
+	unsigned char memBank;			// TAGOP_LOCK: erea
+	unsigned char action;			// TAGOP_LOCK only
+	unsigned short wordPtr;
+	unsigned char wordCount;
+	unsigned char maskBits;			// 0: no SetSelectMask
+	unsigned short maskPtr;
+	unsigned char mask[32];
+	unsigned char* data;			// TAGOP_WRITE: 2 * wordCount bytes
+	void* opCtx;					// free for the caller
+}TagOp;
+
+// Completion of one TagOp, code and data are only valid during the callback.
+typedef struct
+{
+	size_t index;					// position of the operation in the submitted array
+	int status;
+	unsigned char tagStatus;
+	unsigned char antenna;
+	unsigned char crc[2];
+	unsigned char pc[2];
+	unsigned char codeLen;
+	const unsigned char* code;
+	unsigned char wordCount;		// TAGOP_READ
+	const unsigned char* data;		// TAGOP_READ: 2 * wordCount bytes
+}TagOpResult;
+
+typedef void (*TagOpCallback)(int64_t hComm, const TagOp* op, const TagOpResult* result, void* userCtx);
+
+#define DEDUP_CODE_MAX						64		// code bytes a TagDedup entry keeps (and compares), longer codes are hashed in full
+#define DEDUP_ANY_ANTENNA					0x01	// TagDedupConfig.flags: one entry per tag across all antennas instead of per antenna
+#define DEDUP_NO_ARRIVE						0x02	// TagDedupConfig.flags: only report tags once they leave (DEPART / EVICT / FLUSH)
+
+#define DEDUP_ARRIVE						1		// TagSighting.event: first read of the tag in a window
+#define DEDUP_DEPART						2		// not read for windowMs
+#define DEDUP_EVICT							3		// dropped to make room for a new tag (maxEntries reached)
+#define DEDUP_FLUSH							4		// TagDedupFlush or end of the stream
+
+typedef struct
+{
+	unsigned int windowMs;			// a tag departs once it has not been read for windowMs
+	unsigned int maxEntries;		// tags (per antenna) tracked at once, the least recently read is evicted
+	unsigned int flags;				// DEDUP_ANY_ANTENNA, DEDUP_NO_ARRIVE
+}TagDedupConfig;
+
+// One tag (per antenna unless DEDUP_ANY_ANTENNA) summarised over its window, instead of every repeat.
+// code is only valid during the callback.
+typedef struct
+{
+	int event;						// DEDUP_*
+	TagInfoCompact tag;				// last read, arenaOff is TAGCOMPACT_NO_ARENA
+	const unsigned char* code;		// full code, up to DEDUP_CODE_MAX bytes
+	unsigned char codeLen;
+	unsigned char antenna;			// antenna of the last read
+	short peakRssi;
+	unsigned int count;				// reads since the tag arrived
+	uint64_t firstSeenMs;			// CLOCK_MONOTONIC ms
+	uint64_t lastSeenMs;
+}TagSighting;
+
+typedef void (*TagSightingCallback)(const TagSighting* sighting, void* userCtx);
+
+// Dedup cache keyed on the EPC hash, with LRU eviction. Not thread-safe: feed it from one thread.
+typedef struct TagDedup TagDedup;
+
+#define ANTSCHED_PORTS						8		// antenna ports of the reader (SetAntenna mask bits)
+
+#define ANTSCHED_ROUND_ROBIN				0		// every port of the mask gets cycleMs / ports
+#define ANTSCHED_YIELD						1		// dwell follows the new tags (and reads) each port brought in, within the bounds
+#define ANTSCHED_TRIGGER					2		// ANTSCHED_YIELD while a GPI of triggerGpi is active (GetGateStatus) and triggerHoldMs after
+#define ANTSCHED_CUSTOM						3		// dwell from the AntSchedPolicy of CFAntSchedSetPolicy
+
+// Antenna scheduler settings, 0 selects the default of a field.
+typedef struct
+{
+	unsigned char antennaMask;		// ports to schedule, bit 0 = antenna 1 (default all)
+	unsigned char ewmaPercent;		// weight of the last dwell in the learnt yields (default 30)
+	unsigned char triggerGpi;		// ANTSCHED_TRIGGER: GateParam.GPI bits that arm the scheduler (default 0x01)
+	unsigned int cycleMs;			// one pass over every port (default 1000)
+	unsigned int minDwellMs;		// fairness floor: every port is still visited this long per cycle (default 50)
+	unsigned int maxDwellMs;		// no port holds the reader longer per cycle (default cycleMs)
+	unsigned int newTagWindowMs;	// a tag counts as new again once not read for this long (default 5000)
+	unsigned int triggerHoldMs;		// ANTSCHED_TRIGGER: keep reading after the trigger went away (default 2000)
+}AntSchedConfig;
+
+// What the scheduler learnt about one port.
+typedef struct
+{
+	uint64_t reads;					// labels read on the port
+	uint64_t newTags;				// of them, tags no port had read within newTagWindowMs
+	uint64_t dwellMs;				// airtime the port got
+	unsigned int dwells;			// inventory rounds on the port
+	unsigned int lastDwellMs;
+	float readRate;					// EWMA of reads per second of dwell
+	float newRate;					// EWMA of new tags per second of dwell
+}AntPortStats;
+
+// ANTSCHED_CUSTOM: dwell in ms for antenna (0-based) in the cycle that starts, 0 skips the port.
+// Called on the scheduler thread once per port and cycle.
+typedef unsigned int (*AntSchedPolicy)(int antenna, const AntPortStats* ports, const AntSchedConfig* config, void* policyCtx);
+
+// Host-side antenna scheduler driving per-antenna inventory rounds from its own thread.
+typedef struct CFAntSched CFAntSched;
+
+#define QCTL_NO_SESSION						0x01	// QCtlConfig.flags: leave the session as found
+#define QCTL_NO_TARGET						0x02	// QCtlConfig.flags: leave the target as found
+
+#define QCTL_REASON_POPULATION				0x01	// QCtlEvent.reasons: Q follows the estimated population
+#define QCTL_REASON_COLLISION				0x02	// read rate fell while the population did not shrink
+#define QCTL_REASON_EMPTY					0x04	// round without labels
+#define QCTL_REASON_SESSION					0x08	// population crossed sessionHighTags / sessionLowTags
+#define QCTL_REASON_TARGET					0x10	// targetFlipWindows rounds without new tags
+
+// Q / session controller settings, 0 selects the default of a field (except qMin and proto).
+typedef struct
+{
+	unsigned char proto;			// protocol of QueryCfgGet / QueryCfgSet
+	unsigned char qMin;
+	unsigned char qMax;				// default 15
+	unsigned char stepPercent;		// C of the Q algorithm in 1/100, largest Q step per round (default 30)
+	unsigned char sessionHigh;		// session for large populations (default 1)
+	unsigned char targetFlipWindows;// rounds without new tags before the target flips A/B (default 3)
+	unsigned char flags;			// QCTL_NO_SESSION, QCTL_NO_TARGET
+	unsigned int windowMs;			// inventory round between two adjustments (default 500)
+	unsigned int sessionHighTags;	// estimated population from which sessionHigh is used (default 32)
+	unsigned int sessionLowTags;	// estimated population below which session 0 is used again (default 8)
+}QCtlConfig;
+
+// Statistics of one round and the settings the controller chose after it.
+typedef struct
+{
+	uint64_t timeMs;				// CLOCK_MONOTONIC ms at the end of the round
+	unsigned int windowMs;			// length of the round
+	unsigned int reads;
+	unsigned int uniqueTags;		// different tags among reads
+	float readRate;					// reads per second
+	float population;				// EWMA of uniqueTags
+	float qfp;						// floating point Q of the Q algorithm
+	unsigned char q, session, target;
+	unsigned char prevQ, prevSession, prevTarget;
+	unsigned char reasons;			// QCTL_REASON_*, 0 if nothing changed
+}QCtlEvent;
+
+// Called from the controller thread after every round that changed Q, session or target.
+typedef void (*QCtlTelemetryCallback)(int64_t hComm, const QCtlEvent* event, void* telemetryCtx);
+
+// Host-side closed-loop Q / session / target controller running inventory rounds from its own thread.
+typedef struct CFQCtl CFQCtl;
+
+#define DISCOVER_HID						0x01	// DiscoverOptions.kinds / DiscoverResult.kind: OpenHidConnection readers
+#define DISCOVER_SERIAL						0x02	// /dev/ttyUSB* and /dev/ttyACM* ports
+#define DISCOVER_NET						0x04	// hosts answering the UDP broadcast probe
+#define DISCOVER_VERIFY						0x01	// DiscoverOptions.flags: probe serial ports the cache already knows
+#define DISCOVER_ALL_PORTS					0x02	// DiscoverOptions.flags: also report serial ports that are no reader
+#define DISCOVER_CACHED						0x01	// DiscoverResult.flags: taken from the cache without a probe
+#define DISCOVER_READER						0x02	// DiscoverResult.flags: answered GetInfo (or is a cached reader)
+#define DISCOVER_TIMEOUT					0x04	// DiscoverResult.flags: probe still running at the deadline
+#define DISCOVER_DEFAULT_TIMEOUT			800		// DiscoverOptions.timeoutMs default
+#define DISCOVER_PATH_LEN					128
+#define DISCOVER_SERIAL_LEN					64
+
+// Settings of CFDiscoverAll, 0 / NULL selects the default of a field.
+typedef struct
+{
+	unsigned int kinds;				// DISCOVER_HID | DISCOVER_SERIAL | DISCOVER_NET (default HID and serial)
+	unsigned int flags;				// DISCOVER_VERIFY, DISCOVER_ALL_PORTS
+	unsigned int timeoutMs;			// the whole discovery, probes run in parallel
+	int baudRate;					// OpenDevice baud rate of the serial probes (default 115200)
+	unsigned short vendorId;		// USB vendor of serial ports to probe, 0 for any
+	unsigned short productId;		// USB product of serial ports to probe, 0 for any
+	const char* cacheFile;			// mappings kept across runs, NULL for the process cache only
+	unsigned short netUdpPort;		// UDP port the broadcast probe goes to (DISCOVER_NET)
+	unsigned short netTcpPort;		// reported as DiscoverResult.port of network readers
+	const unsigned char* netProbe;	// broadcast payload of the reader's network configuration protocol
+	unsigned short netProbeLen;
+}DiscoverOptions;
+
+// One reader (or port) found by CFDiscoverAll.
+typedef struct
+{
+	unsigned char kind;				// DISCOVER_HID, DISCOVER_SERIAL or DISCOVER_NET
+	unsigned char flags;			// DISCOVER_CACHED, DISCOVER_READER, DISCOVER_TIMEOUT
+	unsigned short vendorId;		// USB ids, 0 for network readers
+	unsigned short productId;
+	unsigned short index;			// OpenHidConnection index of HID readers
+	unsigned short port;			// netTcpPort of network readers
+	int status;						// status of the probe
+	char path[DISCOVER_PATH_LEN];	// tty device, HID path or IP address
+	char serial[DISCOVER_SERIAL_LEN];	// USB serial number, empty if the device has none
+	unsigned char sn[12];			// DeviceInfo.SN of probed readers
+}DiscoverResult;
+
+#define HANDLE_PAUSE_INVENTORY				0x01	// CFHandleLock flags: also stop an inventory started with InventoryContinueEx
+
+// Command run by CFHandleCall / CFPoolCall with the link of hComm to itself.
+typedef int (*HandleCommand)(int64_t hComm, void* ctx);
+
+#define POOL_DEFAULT_CONNECT_TIMEOUT		3000	// PoolConfig.connectTimeoutMs default
+#define POOL_DEFAULT_KEEPALIVE				10000	// PoolConfig.keepaliveMs default
+
+// Connection pool settings, 0 selects the default of a field.
+typedef struct
+{
+	unsigned int connectTimeoutMs;	// OpenNetConnection timeout
+	unsigned int keepaliveMs;		// idle sessions are probed with GetHeartbeat after this long, also the TCP keepalive idle time
+	unsigned int idleCloseMs;		// sessions unused for this long are closed, 0 keeps them open
+	unsigned int retries;			// reconnects of CFPoolCall after STAT_DLL_DISCONNECT (default 1)
+}PoolConfig;
+
+// State of one pooled session.
+typedef struct
+{
+	int64_t hComm;					// valid while connected
+	unsigned char connected;
+	unsigned char streaming;		// CFPoolStartStreaming stream running (paused while a command runs)
+	unsigned char busy;				// acquired by a caller
+	unsigned int connects;			// OpenNetConnection successes, 1 + reconnects
+	unsigned int commands;			// CFPoolAcquire / CFPoolCall
+	uint64_t lastUsedMs;			// CLOCK_MONOTONIC ms of the last release
+}PoolSessionInfo;
+
+
+// Pool of warm network sessions keyed by ip:port, one session per reader.
+typedef struct CFPool CFPool;
+
+#define CONFIG_DEVICE_PARA					0x0001	// ConfigSnapshot parts: GetDevicePara / SetDevicePara
+#define CONFIG_FREQ							0x0002	// GetFreq / SetFreq
+#define CONFIG_ANT_POWER					0x0004	// GetAntPower / SetAntPower
+#define CONFIG_GPIO							0x0008	// GetGpioPara / SetGpioPara
+#define CONFIG_QUERY						0x0010	// QueryCfgGet / QueryCfgSet
+#define CONFIG_SELECT						0x0020	// SelectOrSortGet / SelectOrSortSet
+#define CONFIG_ALL							0x003F
+
+#define CONFIG_BLOB_VERSION					1		// version written by CFConfigSerialize
+#define CONFIG_BLOB_MAX_LEN					160		// blob of a snapshot with every part
+
+#define CONFIG_APPLY_ANY_SN					0x01	// CFConfigApply flags: apply a snapshot of another reader (cloning)
+
+// Configuration of one reader as read by CFConfigRead. Only the parts in valid were read
+// and are applied.
+typedef struct
+{
+	unsigned char sn[12];			// DeviceInfo.SN of the reader
+	unsigned char proto;			// protocol of the query and select parts
+	unsigned int valid;				// CONFIG_* parts present
+	DevicePara device;
+	FreqInfo freq;
+	AntPower antPower;
+	GpioPara gpio;
+	QueryParam query;
+	SelectSortParam select;
+}ConfigSnapshot;
+
+#define WHITELIST_RECORD_LEN				32		// one CUSTOMERINFO
+#define WHITELIST_FRAME_RECORDS				7		// CUSTOMERINFO per SetWhiteList frame, FRAMENUM INFOCOUNT records fill 227 of 255 bytes
+#define WHITELIST_DEFAULT_WINDOW			4		// WhiteListOptions.window default
+#define WHITELIST_WINDOW_MAX				16
+
+// Fills count records of WHITELIST_RECORD_LEN bytes starting at record first. Anything but 0x00 ends the upload with that status.
+typedef int (*WhiteListSource)(void* ctx, size_t first, unsigned char* records, size_t count);
+// Receives count downloaded records starting at record first (valid during the call). Anything but 0x00 ends the download.
+typedef int (*WhiteListSink)(void* ctx, size_t first, const unsigned char* records, size_t count);
+// Records acknowledged (upload) or received (download) so far.
+typedef void (*WhiteListProgress)(void* ctx, size_t done, size_t total);
+
+// Settings of a whitelist transfer, 0 / NULL selects the default of a field.
+typedef struct
+{
+	unsigned int window;			// SetWhiteList frames sent ahead of their acknowledgement, 1..WHITELIST_WINDOW_MAX
+	unsigned int frameRecords;		// records per frame, 1..WHITELIST_FRAME_RECORDS (default the maximum)
+	unsigned short timeout;			// ms to wait for an acknowledgement or a download frame (default COMMON_TIMEOUT)
+	unsigned short resumeFrame;		// upload: first FRAMENUM to send, WhiteListTransfer.nextFrame of an interrupted upload
+	WhiteListProgress progress;
+	void* progressCtx;
+}WhiteListOptions;
+
+// Outcome of a whitelist transfer, filled also when it fails.
+typedef struct
+{
+	unsigned short nextFrame;		// upload: frames 0..nextFrame - 1 are acknowledged, pass as resumeFrame to continue
+	size_t records;					// records acknowledged / received
+	unsigned short infoCount;		// EndWhiteList count of the reader after an upload
+}WhiteListTransfer;
+
+#define STATS_HIST_BUCKETS					24		// latency buckets: 0 below 1 us, i from 2^(i-1) to 2^i us, the last one open ended
+#define STATS_CMD_SLOTS						16		// command codes with a round trip histogram of their own
+
+// Latency histogram of CFStats, in microseconds.
+typedef struct
+{
+	uint64_t count;
+	uint64_t sumUs;
+	uint64_t maxUs;
+	uint64_t buckets[STATS_HIST_BUCKETS];
+}LatencyHist;
+
+// Round trips of one command code on the frame paths of this layer (operation queue, whitelist).
+typedef struct
+{
+	unsigned short cmd;
+	uint64_t lost;					// sent but never answered
+	LatencyHist rtt;
+}CmdStats;
+
+// Counters of a handle since its first use. Frame counters cover the frames this layer reads and
+// writes itself, the link byte counters every byte of the connection including libCFApi's own.
+typedef struct
+{
+	uint64_t elapsedMs;
+	unsigned int linkCounted;		// 1 when rxBytes / txBytes come from the kernel (TIOCGICOUNT / TCP_INFO)
+	uint64_t rxBytes;
+	uint64_t txBytes;
+	uint64_t frameRxBytes;			// bytes the frame parser took from the link, discarded ones included
+	uint64_t frameTxBytes;
+	uint64_t frames;				// frames parsed with a good CRC
+	uint64_t crcErrors;
+	uint64_t resyncs;				// frames that had to be searched for behind stray bytes
+	uint64_t resyncBytes;			// bytes skipped to find them
+	uint64_t tags;					// labels decoded by GetTagUii for the batch, stream and ring paths
+	unsigned int tagRate;			// labels/s since the previous CFGetStats
+	uint64_t ringOverflow;			// labels dropped by the ring of InventoryStartRing
+	LatencyHist tagWait;			// time blocked waiting for the first label of a burst
+	size_t cmdCount;				// used entries of cmds
+	uint64_t cmdUntracked;			// round trips of command codes that found no free slot
+	CmdStats cmds[STATS_CMD_SLOTS];
+}CFStats;
+
+#define CAPTURE_VERSION						1
+#define CAPTURE_DIR_RX						0x00	// reader to host
+#define CAPTURE_DIR_TX						0x01	// host to reader
+#define CAPTURE_FLAG_LABELS					0x0001	// HID capture: inventory label frames rebuilt from the decoded labels, no commands
+#define REPLAY_SPEED_MAX					0.0		// OpenReplayDevice speed: as fast as the host reads
+
+// Head of a capture file of CFCaptureStart, followed by records up to the end of the file. The
+// layout is little endian and naturally aligned, a player can walk a read-only mapping of it.
+typedef struct
+{
+	char magic[4];					// "CFCP"
+	unsigned short version;			// CAPTURE_VERSION
+	unsigned short flags;			// CAPTURE_FLAG_*
+	uint64_t startUs;				// CLOCK_REALTIME of the start of the capture
+}CaptureFileHeader;
+
+// One chunk of bytes as the link delivered it, followed by len bytes and padded to 8 bytes.
+typedef struct
+{
+	unsigned int deltaUs;			// since the previous record (or the start of the capture)
+	unsigned short len;
+	unsigned char dir;				// CAPTURE_DIR_*
+	unsigned char reserved;
+}CaptureRecord;
+
+#define JOURNAL_VERSION						1
+#define JOURNAL_CODE_MAX					40		// code bytes a JournalRecord keeps (and a code query compares), longer codes are hashed in full
+#define JOURNAL_DEFAULT_RECORDS				262144	// TagJournalConfig.segmentRecords when 0: 16 MiB of records per segment
+#define JOURNAL_DEFAULT_STRIDE				256		// TagJournalConfig.indexStride when 0
+#define JOURNAL_TIME_MAX					0xFFFFFFFFFFFFFFFFULL	// toUs of a query without an upper bound
+
+typedef struct
+{
+	unsigned int segmentRecords;	// records per segment file, rounded up to a multiple of indexStride
+	unsigned int maxSegments;		// segments kept, the oldest file is deleted on rotation (0 keeps all)
+	unsigned int indexStride;		// records per entry of the sparse time index
+}TagJournalConfig;
+
+// One read event, 64 bytes. Records of a journal are in append order and their times never go back:
+// a clock stepped backwards is clamped to the previous record.
+typedef struct
+{
+	uint64_t timeUs;				// CLOCK_REALTIME of the append
+	unsigned int source;			// reader id given to InventoryStartJournal / TagJournalAppend
+	unsigned int chain;				// previous record of the same code hash bucket in the segment + 1, 0 ends the chain
+	short rssi;
+	unsigned char antenna;
+	unsigned char channel;
+	unsigned char codeLen;			// full code length, the first JOURNAL_CODE_MAX bytes are kept
+	unsigned char pc[2];
+	unsigned char reserved;
+	unsigned char code[JOURNAL_CODE_MAX];
+}JournalRecord;
+
+// Head of a segment file (seg-<sequence>.cfj) of a journal directory. The file is created at its full
+// size; the time index (uint64_t time of every indexStride-th record), the code hash buckets (uint32_t
+// newest record + 1) and the records start at the given offsets. A reader may map it while it is written:
+// count is stored after the record it covers and a bucket after count. Little endian, naturally aligned.
+typedef struct
+{
+	char magic[4];					// "CFJS"
+	unsigned short version;			// JOURNAL_VERSION
+	unsigned short recordSize;		// sizeof(JournalRecord)
+	unsigned int capacity;			// records
+	unsigned int count;				// records written
+	unsigned int indexStride;
+	unsigned int buckets;			// power of two
+	uint64_t sequence;
+	uint64_t indexOffset;
+	uint64_t bucketOffset;
+	uint64_t recordOffset;
+}JournalSegmentHeader;
+
+// Called for the records a query finds. Return STAT_OK to go on, anything else ends the query with it.
+typedef int (*JournalRecordCallback)(const JournalRecord* record, void* userCtx);
+
+typedef struct TagJournal TagJournal;
+
+#define PRESENCE_ZONES						16		// zones of a TagPresenceConfig
+#define PRESENCE_ANTENNAS					16		// antennas the engine tracks (RssiPara.AntDelta), 0 counts as antenna 1
+#define PRESENCE_CODE_MAX					64		// code bytes an entry keeps (and compares), longer codes are hashed in full
+#define PRESENCE_DEFAULT_ENTER				-650	// enterRssi when 0: -65 dBm, the BasicRSSI the readers ship with
+
+#define ZONE_ENTER							1		// ZoneEvent.event: the tag got into zone
+#define ZONE_EXIT							2		// fell below the hysteresis, was not read for exitMs, evicted or flushed
+#define ZONE_DIRECTION						3		// entered zone within directionMs of being in fromZone
+
+#define ZONE_DIR_IN							1		// ZoneEvent.direction: to a higher zone number, zones are numbered from the outside in
+#define ZONE_DIR_OUT						2		// to a lower zone number
+
+// Zones over the antennas of a reader, RSSI values in the 0.1 dBm of TagInfo.rssi. A tag is in a zone
+// while the smoothed RSSI on one of its antennas is at least enterRssi of that antenna, and leaves once
+// all of them are hysteresis below it or have not read it for exitMs. Zones may share antennas. Two
+// zones in front of and behind a gate give the in / out of GateParam.DIR for any set of antennas.
+typedef struct
+{
+	unsigned int zoneCount;			// used entries of zoneAntennas
+	unsigned short zoneAntennas[PRESENCE_ZONES];	// antennas of each zone, bit 0 = antenna 1
+	short enterRssi[PRESENCE_ANTENNAS];	// per antenna, 0 for PRESENCE_DEFAULT_ENTER (see TagPresenceConfigFromRssiPara)
+	unsigned short hysteresis;		// 0.1 dB below enterRssi a tag must fall to leave, 0 for 30
+	unsigned int smoothPercent;		// weight of a new read in the smoothed RSSI, 0 for 30
+	unsigned int exitMs;			// 0 for 1000
+	unsigned int directionMs;		// 0 for 3000
+	unsigned int maxTags;			// tags tracked at once, the least recently read is evicted, 0 for 4096
+}TagPresenceConfig;
+
+// One change of a tag. code is only valid during the callback.
+typedef struct
+{
+	int event;						// ZONE_*
+	unsigned int zone;
+	unsigned int fromZone;			// ZONE_DIRECTION: zone the tag was in before
+	int direction;					// ZONE_DIRECTION: ZONE_DIR_IN / ZONE_DIR_OUT
+	const unsigned char* code;		// full code, up to PRESENCE_CODE_MAX bytes
+	unsigned char codeLen;
+	unsigned char antenna;			// antenna of the read behind the event, 0 for a timeout, eviction or flush
+	short rssi;						// smoothed RSSI of the best antenna of zone at the event
+	uint64_t timeMs;				// CLOCK_MONOTONIC
+	uint64_t enteredMs;				// ZONE_EXIT: when the tag entered zone
+}ZoneEvent;
+
+typedef void (*ZoneEventCallback)(const ZoneEvent* event, void* userCtx);
+
+typedef struct TagPresence TagPresence;
+
+#define RESERVE_VIEWS						0x01	// CFHandleReserve: the READVIEW_POOL_SIZE receive slots of GetReadTagRespView
+#define RESERVE_RING						0x02	// CFHandleReserve: the ring of InventoryStartRing
+
+#define MERGE_CODE_MAX						64		// code bytes a TagMerge entry keeps (and compares), longer codes are hashed in full
+#define MERGE_READERS						8		// readers tracked per tag, the one not heard from longest makes room
+#define MERGE_ARRIVE						1		// TagMergeEvent.event: first read of the tag on any reader
+#define MERGE_HANDOFF						2		// another reader took the tag over
+#define MERGE_DEPART						3		// no reader read the tag for departMs
+#define MERGE_EVICT							4		// dropped to make room for a new tag (maxTags reached)
+#define MERGE_FLUSH							5		// TagMergeFlush
+
+// Cross-reader dedup. Fields left 0 select the default.
+typedef struct
+{
+	unsigned int windowMs;			// a reader's peak RSSI counts toward the ownership this long, 0 for 500
+	unsigned int departMs;			// a tag no reader read this long departs, 0 for 2000 or windowMs if longer
+	unsigned short hysteresis;		// 0.1 dB a reader must beat the owner's peak by to take a tag over, 0 for 30
+	unsigned int maxTags;			// tags tracked at once, split evenly over the shards, 0 for 8192
+	unsigned int shards;			// parts of the table with a lock each, rounded up to a power of two, 0 for 16
+	size_t ringSize;				// events queued for TagMergePop, 0 for RING_DEFAULT_SIZE
+}TagMergeConfig;
+
+// One change of the owner of a tag, copied out of the table.
+typedef struct
+{
+	int event;						// MERGE_*
+	int64_t hComm;					// owner after the event, the last owner for DEPART / EVICT / FLUSH
+	int64_t fromHComm;				// MERGE_HANDOFF: previous owner
+	short rssi;						// peak RSSI of hComm within windowMs
+	short fromRssi;					// MERGE_HANDOFF: peak RSSI of fromHComm
+	unsigned char antenna;			// antenna of the last read of hComm
+	unsigned char readers;			// readers that read the tag within windowMs
+	unsigned char codeLen;
+	unsigned char code[MERGE_CODE_MAX];
+	unsigned int count;				// reads on all readers since MERGE_ARRIVE
+	uint64_t firstMs;				// MERGE_ARRIVE, CLOCK_MONOTONIC
+	uint64_t timeMs;
+}TagMergeEvent;
+
+typedef struct
+{
+	uint64_t reads;					// labels fed
+	uint64_t events;				// queued for TagMergePop
+	uint64_t handoffs;
+	uint64_t overflow;				// events dropped by a full ring
+	uint64_t contended;				// feeds that found their shard locked by another thread
+	size_t tags;					// tracked now
+	size_t queued;					// events waiting for TagMergePop
+}TagMergeStats;
+
+// Table of the tags of several readers; the reader with the strongest recent RSSI owns a tag.
+// Fed from any number of threads, events are taken by one consumer.
+typedef struct TagMerge TagMerge;
+
+#define TRIGGER_HOST						0x00	// TriggerConfig.source: the host starts a bounded inventory on the trigger
+#define TRIGGER_GPIO						0x01	// the GPI of the reader starts its inventory (trigger work mode)
+#define TRIGGER_WORKMODE					0x02	// DevicePara.WORKMODE of the trigger work mode
+
+// Armed trigger-to-first-tag reads. Fields left 0 select the default.
+typedef struct
+{
+	unsigned char source;			// TRIGGER_HOST / TRIGGER_GPIO
+	unsigned char level;			// TRIGGER_GPIO: GpioPara.TriggleMode, 0x01 high level, 0x00 low level
+	unsigned char triggerTime;		// TRIGGER_GPIO: DevicePara.TRIGGLETIME, seconds the reader inventories per trigger, 0 for 1
+	unsigned char cycles;			// TRIGGER_HOST: inventory rounds per start (InvType 0x01), 0 for 1
+}TriggerConfig;
+
+// Timing of the label CFTriggerWaitTag returned, CFStats_NowUs clock (CLOCK_MONOTONIC).
+typedef struct
+{
+	uint64_t triggerUs;				// the inventory was started, 0 for TRIGGER_GPIO (the edge is not seen by the host)
+	uint64_t tagUs;					// the label frame was complete
+	unsigned int latencyUs;			// tagUs - triggerUs, 0 for TRIGGER_GPIO
+	unsigned int rounds;			// TRIGGER_HOST: inventories started until a label came back
+	unsigned int skipped;			// frames dropped: bad CRC, other commands, labels of the previous trigger
+}TriggerResult;
+
+#define COMMISSION_EPC_MAX					30		// bytes of a new EPC, it is also the select mask of the later steps
+#define COMMISSION_CODE_MAX					62		// bytes of the old EPC CommissionResult reports
+#define COMMISSION_LOCK_KILL_PWD			0x01	// CommissionJob.lockAreas: bit (1 << erea) of LockTag
+#define COMMISSION_LOCK_ACCESS_PWD			0x02
+#define COMMISSION_LOCK_EPC					0x04
+#define COMMISSION_LOCK_TID					0x08
+#define COMMISSION_LOCK_USER				0x10
+#define COMMISSION_STEP_SINGULATE			1		// CommissionResult.step: read the PC of the tag the selector picks
+#define COMMISSION_STEP_WRITE				2		// write the EPC (and the PC if the length changes)
+#define COMMISSION_STEP_VERIFY				3		// read PC and EPC back through the new EPC
+#define COMMISSION_STEP_LOCK				4		// LockTag of every area of lockAreas
+#define COMMISSION_STEP_DONE				5
+#define COMMISSION_FIXED_DEPTH				0x01	// CommissionConfig.flags: keep the op queue depth of the handle
+
+// One tag to commission. The selectors of the jobs CFCommissionRun works on at once must pick
+// different tags; a job without one is run on its own.
+typedef struct
+{
+	unsigned char maskBits;			// selector: leading bits of the current EPC (SetSelectMask), 0 for the tag that answers first
+	unsigned char mask[32];
+	unsigned char epcLen;			// bytes of the new EPC, even, 2..COMMISSION_EPC_MAX
+	unsigned char epc[COMMISSION_EPC_MAX];
+	unsigned char accPwd[4];
+	unsigned char lockAreas;		// COMMISSION_LOCK_*, 0 for no lock
+	unsigned char lockAction;		// LockTag action of every area in lockAreas
+	void* jobCtx;					// free for the caller
+}CommissionJob;
+
+// Fields left 0 select the default.
+typedef struct
+{
+	unsigned int window;			// jobs in progress at once, their operations share the op queue, 0 for 16
+	unsigned int retries;			// retries of a step after STAT_CMD_TAG_NO_RESP, low power, a lost answer ..., 0 for 3
+	unsigned short retryDelayMs;	// pause after a pass with a low power failure, doubled while they last, 0 for 20
+	unsigned short timeout;			// waiting time for each response, 0 for DEF_WRITE_TIMEOUT
+	unsigned int flags;				// COMMISSION_FIXED_DEPTH
+}CommissionConfig;
+
+// Outcome of one job, oldCode is only valid during the callback.
+typedef struct
+{
+	size_t index;					// position of the job in the submitted array
+	int status;						// STAT_OK once every step passed, STAT_CMD_DECODE_TAG_DATA_FAIL if the read back differs
+	unsigned char step;				// COMMISSION_STEP_DONE, or the step that failed
+	unsigned char antenna;
+	unsigned char oldPc[2];
+	unsigned char oldCodeLen;
+	const unsigned char* oldCode;	// EPC before the write, up to COMMISSION_CODE_MAX bytes
+	unsigned int attempts;			// operations sent for the tag, retries included
+	unsigned int retries;
+	unsigned int elapsedUs;			// first operation to the end of the job
+}CommissionResult;
+
+typedef void (*CommissionCallback)(int64_t hComm, const CommissionJob* job, const CommissionResult* result, void* userCtx);
+
+typedef struct
+{
+	size_t jobs;
+	size_t commissioned;
+	size_t failed;
+	uint64_t ops;					// operations sent, retries included
+	uint64_t retries;
+	uint64_t lowPower;				// STAT_GB_TAG_LOW_POWER / STAT_ISO_TAG_LOW_POWER answers
+	uint64_t noResp;				// STAT_CMD_TAG_NO_RESP answers
+	uint64_t lost;					// answers that never came (STAT_CMD_COMM_TIMEOUT)
+	unsigned int passes;			// CFOpQueueSubmit calls
+	unsigned int depth;				// op queue depth the run ended with
+	uint64_t elapsedMs;
+	unsigned int perMinute;			// tags commissioned per minute over elapsedMs
+}CommissionStats;
+
+#define ASYNC_INVENTORY						0x01	// AsyncOp.type: labels of one inventory until capacity, its end or the deadline
+#define ASYNC_TAGOP							0x02	// one TagOp, with its SetSelectMask in front when maskBits is set
+#define ASYNC_GATE							0x03	// the next gate status frame the reader sends (GetGateStatus)
+#define ASYNC_CANCELLED						STAT_CMD_INVENTORY_STOP	// AsyncResult.status of an operation ended by CFAsyncCancel / CFAsyncRemove
+
+// Event loop running the operations of several serial / TCP connections on one thread without
+// blocking: every call but CFAsyncStop is made on the thread that runs CFAsyncPoll.
+typedef struct CFAsync CFAsync;
+
+// One operation of CFAsyncSubmit. It and the buffers it points to stay valid until its callback.
+typedef struct
+{
+	unsigned char type;				// ASYNC_*
+	unsigned char cycles;			// ASYNC_INVENTORY: rounds of the inventory, 0 to read until capacity, the deadline or CFAsyncCancel
+	unsigned int timeout;			// ms from CFAsyncSubmit to STAT_CMD_COMM_TIMEOUT, 0 for none (ASYNC_TAGOP: DEF_WRITE_TIMEOUT)
+	TagInfo* tags;					// ASYNC_INVENTORY: capacity labels
+	size_t capacity;
+	const TagOp* tagOp;				// ASYNC_TAGOP
+}AsyncOp;
+
+// Completion of an AsyncOp. An inventory that ends early by capacity, deadline or cancel is
+// stopped first (InventoryStop), so the link is free for the next operation of the connection.
+typedef struct
+{
+	uint64_t id;					// as returned by CFAsyncSubmit
+	int status;						// ASYNC_INVENTORY: STAT_OK once labels came, STAT_CMD_COMM_TIMEOUT without any
+	size_t count;					// ASYNC_INVENTORY: labels stored in tags
+	unsigned int dropped;			// ASYNC_INVENTORY: labels past capacity, while the inventory was stopped
+	TagOpResult tagOp;				// ASYNC_TAGOP, code and data are only valid during the callback
+	GateParam gate;					// ASYNC_GATE
+}AsyncResult;
+
+typedef void (*AsyncCallback)(CFAsync* async, int64_t hComm, const AsyncOp* op, const AsyncResult* result, void* userCtx);
+
+// epoll dispatcher of several connections. Serial and TCP connections are drained on the
+// CFReactorRun threads themselves; HID connections keep a reader thread feeding the reactor.
+typedef struct CFReactor CFReactor;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/// <summary>
+	/// Close reader connection and release the host-side state of the handle
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <returns>0x00 Success</returns>
+	int CloseDeviceEx(int64_t hComm);
+	/// <summary>
+	/// Obtain all labels already received in one call and return them in TagInfo format.
+	/// Only blocks (up to timeout) while no label is buffered.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="out">TagInfo array of return type</param>
+	/// <param name="capacity">number of elements in out</param>
+	/// <param name="count">number of labels written to out</param>
+	/// <param name="timeout">waiting time for the first label</param>
+	/// <returns>0x00 success with count >= 1, otherwise the status GetTagUii would return (STAT_CMD_COMM_TIMEOUT, STAT_CMD_INVENTORY_STOP ...)</returns>
+	int GetTagUiiBatch(int64_t hComm, TagInfo* out, size_t capacity, size_t* count, unsigned short timeout);
+	/// <summary>
+	/// Obtain label information and return it in TagInfoCompact format
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="tag">TagInfoCompact of return type</param>
+	/// <param name="arena">overflow storage for codes longer than TAGCOMPACT_CODE_LEN, may be NULL</param>
+	/// <param name="timeout">waiting time</param>
+	/// <returns>0x00 success, STAT_CMD_BUF_OVERFLOW if the code did not fit arena and tag holds it truncated to the inline slot</returns>
+	int GetTagUiiCompact(int64_t hComm, TagInfoCompact* tag, TagCodeArena* arena, unsigned short timeout);
+	/// <summary>
+	/// GetTagUiiBatch filling a TagInfoCompact array
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="out">TagInfoCompact array of return type</param>
+	/// <param name="capacity">number of elements in out</param>
+	/// <param name="count">number of labels written to out</param>
+	/// <param name="arena">overflow storage for codes longer than TAGCOMPACT_CODE_LEN, may be NULL</param>
+	/// <param name="timeout">waiting time for the first label</param>
+	/// <returns>0x00 success with count >= 1, the batch ends before a label whose code no longer fits arena and the next call returns it;
+	/// STAT_CMD_BUF_OVERFLOW with count 1 if even the first label did not fit and it was truncated to the inline slot;
+	/// otherwise the status GetTagUii would return</returns>
+	int GetTagUiiBatchCompact(int64_t hComm, TagInfoCompact* out, size_t capacity, size_t* count, TagCodeArena* arena, unsigned short timeout);
+	/// <summary>
+	/// Convert TagInfo to TagInfoCompact
+	/// </summary>
+	/// <param name="src"></param>
+	/// <param name="dst"></param>
+	/// <param name="arena">overflow storage for codes longer than TAGCOMPACT_CODE_LEN, may be NULL</param>
+	/// <returns>0x00 success, STAT_CMD_BUF_OVERFLOW if the code did not fit and was truncated to the inline slot</returns>
+	int TagInfoToCompact(const TagInfo* src, TagInfoCompact* dst, TagCodeArena* arena);
+	/// <summary>
+	/// Get the full code of a compact label (inline slot or arena), codeLen bytes long
+	/// </summary>
+	/// <param name="tag"></param>
+	/// <param name="arena">the arena the label was filled with</param>
+	/// <returns></returns>
+	const unsigned char* TagCompactCode(const TagInfoCompact* tag, const TagCodeArena* arena);
+	/// <summary>
+	/// Start inventory and deliver labels from a library-owned reader thread as soon as they are decoded
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="callback">called for each label / burst of labels</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="flags">STREAM_PER_TAG, STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if a stream is already running on hComm</returns>
+	int InventoryStartStreaming(int64_t hComm, TagStreamCallback callback, void* userCtx, unsigned int flags);
+	/// <summary>
+	/// Stop Inventory and the reader thread of InventoryStartStreaming. Use instead of InventoryStop
+	/// while streaming; may be called from the callback, the thread then stops after it returns.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="timeout">waiting time</param>
+	/// <returns>0x00 success</returns>
+	int InventoryStopStreaming(int64_t hComm, unsigned short timeout);
+	/// <summary>
+	/// Inline code slot length libCFApiEx was built with (TAGCOMPACT_CODE_LEN), for bindings
+	/// </summary>
+	/// <returns></returns>
+	int TagCompactCodeLen(void);
+	/// <summary>
+	/// Start streaming into a lock-free single-producer/single-consumer ring of hComm, read it with TagRingPop.
+	/// Stop with InventoryStopStreaming; the ring and its counters stay readable until the next start or CloseDeviceEx.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="ringSize">number of labels, 0 for RING_DEFAULT_SIZE</param>
+	/// <param name="flags">STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if a stream is already running on hComm</returns>
+	int InventoryStartRing(int64_t hComm, size_t ringSize, unsigned int flags);
+	/// <summary>
+	/// Take the labels waiting in the ring of hComm. Call from one consumer thread only.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="out">TagInfoCompact array of return type, codes are inline only</param>
+	/// <param name="capacity">number of elements in out</param>
+	/// <param name="count">number of labels written to out</param>
+	/// <param name="timeout">waiting time while the ring is empty, 0 to poll</param>
+	/// <returns>0x00 success with count >= 1, STAT_CMD_COMM_TIMEOUT, or the status that ended the stream once the ring is empty</returns>
+	int TagRingPop(int64_t hComm, TagInfoCompact* out, size_t capacity, size_t* count, unsigned short timeout);
+	/// <summary>
+	/// Get the counters of the ring of hComm
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="stats"></param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if InventoryStartRing was not called</returns>
+	int TagRingGetStats(int64_t hComm, TagRingStats* stats);
+	/// <summary>
+	/// Create a lock-free multi-producer/single-consumer ring several connections can stream into
+	/// </summary>
+	/// <param name="ringSize">number of labels, 0 for RING_DEFAULT_SIZE</param>
+	/// <returns>NULL on allocation failure</returns>
+	TagAggregator* TagAggregatorCreate(size_t ringSize);
+	/// <summary>
+	/// Free an aggregator. Stop every connection streaming into it first.
+	/// </summary>
+	/// <param name="agg"></param>
+	void TagAggregatorDestroy(TagAggregator* agg);
+	/// <summary>
+	/// Start streaming the labels of hComm into agg. Stop with InventoryStopStreaming.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="agg"></param>
+	/// <param name="flags">STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if a stream is already running on hComm</returns>
+	int InventoryStartAggregated(int64_t hComm, TagAggregator* agg, unsigned int flags);
+	/// <summary>
+	/// Take the labels waiting in agg. Call from one consumer thread only.
+	/// </summary>
+	/// <param name="agg"></param>
+	/// <param name="out">TagInfoSourced array of return type</param>
+	/// <param name="capacity">number of elements in out</param>
+	/// <param name="count">number of labels written to out</param>
+	/// <param name="timeout">waiting time while the ring is empty, 0 to poll</param>
+	/// <returns>0x00 success with count >= 1, STAT_CMD_COMM_TIMEOUT</returns>
+	int TagAggregatorPop(TagAggregator* agg, TagInfoSourced* out, size_t capacity, size_t* count, unsigned short timeout);
+	/// <summary>
+	/// Get the counters of agg
+	/// </summary>
+	/// <param name="agg"></param>
+	/// <param name="stats"></param>
+	/// <returns>0x00 success</returns>
+	int TagAggregatorGetStats(TagAggregator* agg, TagRingStats* stats);
+	/// <summary>
+	/// Create a reactor delivering the labels of every added connection to one callback
+	/// </summary>
+	/// <param name="callback">called on a CFReactorRun / CFReactorPoll thread, as for InventoryStartStreaming</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <returns>NULL on failure</returns>
+	CFReactor* CFReactorCreate(TagStreamCallback callback, void* userCtx);
+	/// <summary>
+	/// Remove every connection (stopping its inventory) and free the reactor. CFReactorRun must have returned.
+	/// </summary>
+	/// <param name="reactor"></param>
+	void CFReactorDestroy(CFReactor* reactor);
+	/// <summary>
+	/// Start inventory on hComm and dispatch its labels from the reactor
+	/// </summary>
+	/// <param name="reactor"></param>
+	/// <param name="hComm"></param>
+	/// <param name="flags">STREAM_PER_TAG, STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if hComm is already added or streaming</returns>
+	int CFReactorAdd(CFReactor* reactor, int64_t hComm, unsigned int flags);
+	/// <summary>
+	/// Stop inventory on hComm and remove it from the reactor. May be called from the callback.
+	/// </summary>
+	/// <param name="reactor"></param>
+	/// <param name="hComm"></param>
+	/// <param name="timeout">InventoryStop waiting time</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if hComm is not added (or its inventory already ended)</returns>
+	int CFReactorRemove(CFReactor* reactor, int64_t hComm, unsigned short timeout);
+	/// <summary>
+	/// Wait for one round of events and dispatch them on the calling thread
+	/// </summary>
+	/// <param name="reactor"></param>
+	/// <param name="timeout">ms, -1 to wait without limit</param>
+	/// <returns>0x00 events dispatched, STAT_CMD_COMM_TIMEOUT none arrived</returns>
+	int CFReactorPoll(CFReactor* reactor, int timeout);
+	/// <summary>
+	/// Dispatch events on the calling thread until CFReactorStop. Several threads may run the same reactor;
+	/// a connection is only drained by one of them at a time.
+	/// </summary>
+	/// <param name="reactor"></param>
+	/// <returns>0x00 after CFReactorStop</returns>
+	int CFReactorRun(CFReactor* reactor);
+	/// <summary>
+	/// Make every CFReactorRun of the reactor return
+	/// </summary>
+	/// <param name="reactor"></param>
+	/// <returns>0x00 success</returns>
+	int CFReactorStop(CFReactor* reactor);
+	/// <summary>
+	/// Get the counters of the ring HID connections feed the reactor through
+	/// </summary>
+	/// <param name="reactor"></param>
+	/// <param name="stats"></param>
+	/// <returns>0x00 success</returns>
+	int CFReactorGetStats(CFReactor* reactor, TagRingStats* stats);
+	/// <summary>
+	/// Open serial port connection with the termios / USB adapter options of options
+	/// </summary>
+	/// <param name="hComm">Return the handle for opening the serial port</param>
+	/// <param name="pcCom">Serial port number</param>
+	/// <param name="iBaudRate">Baud rate</param>
+	/// <param name="options">NULL for plain OpenDevice</param>
+	/// <returns>0x00 success; STAT_PORT_OPEN_FAILED if the port could not be locked, the connection is closed again</returns>
+	int OpenDeviceEx(int64_t* hComm, char* pcCom, int iBaudRate, const SerialOptions* options);
+	/// <summary>
+	/// Get the byte counters and the throughput the link achieved. Serial ports need driver TIOCGICOUNT
+	/// support and network connections TCP_INFO byte counters, the counters stay 0 otherwise.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="stats"></param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR for HID connections</returns>
+	int GetLinkStats(int64_t hComm, LinkStats* stats);
+	/// <summary>
+	/// Obtain read instruction response command without copying: the response is parsed in place and lent
+	/// out as a view of the receive slot. Serial and TCP connections read the frame straight from the link.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="view">TagReadView of return type, release with ReleaseTagReadView</param>
+	/// <param name="timeout">waiting time</param>
+	/// <returns>0x00 success, STAT_CMD_BUF_OVERFLOW if all READVIEW_POOL_SIZE slots are lent out, otherwise as GetReadTagResp</returns>
+	int GetReadTagRespView(int64_t hComm, TagReadView* view, unsigned short timeout);
+	/// <summary>
+	/// Give the receive slot of a TagReadView back to the handle
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="view"></param>
+	/// <returns>0x00 success</returns>
+	int ReleaseTagReadView(int64_t hComm, TagReadView* view);
+	/// <summary>
+	/// Run tag operations pipelined: up to the queue depth are sent before the first response is awaited,
+	/// responses are matched by command code and reported through callback as they arrive (on the calling
+	/// thread, before the call returns). HID connections run them one by one.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="ops">TagOp array</param>
+	/// <param name="n">number of operations</param>
+	/// <param name="callback">called once per operation</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="timeout">waiting time for each response</param>
+	/// <returns>0x00 every operation was completed (see TagOpResult.status), otherwise the link error that ended the queue, or STAT_CMD_COMM_TIMEOUT if the link did not go quiet after a response timed out</returns>
+	int CFOpQueueSubmit(int64_t hComm, const TagOp* ops, size_t n, TagOpCallback callback, void* userCtx, unsigned short timeout);
+	/// <summary>
+	/// Set how many operations CFOpQueueSubmit keeps in flight on hComm (1 disables pipelining)
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="depth">1..OPQUEUE_DEPTH_MAX, default OPQUEUE_DEFAULT_DEPTH</param>
+	/// <returns>0x00 success</returns>
+	int CFOpQueueSetDepth(int64_t hComm, unsigned int depth);
+	/// <summary>
+	/// Create a dedup cache
+	/// </summary>
+	/// <param name="config">windowMs and maxEntries must not be 0</param>
+	/// <returns>NULL on invalid config</returns>
+	TagDedup* TagDedupCreate(const TagDedupConfig* config);
+	/// <summary>
+	/// Destroy a dedup cache without reporting the tags still in it (see TagDedupFlush)
+	/// </summary>
+	/// <param name="dedup"></param>
+	void TagDedupDestroy(TagDedup* dedup);
+	/// <summary>
+	/// Feed labels into the cache: new tags are reported as DEDUP_ARRIVE, repeats only update the entry.
+	/// Tags whose window ran out are reported as DEDUP_DEPART first.
+	/// </summary>
+	/// <param name="dedup"></param>
+	/// <param name="tags"></param>
+	/// <param name="count"></param>
+	/// <param name="arena">arena the codes of tags are stored in, may be NULL</param>
+	/// <param name="callback">called on the calling thread</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <returns>0x00 success</returns>
+	int TagDedupFeed(TagDedup* dedup, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, TagSightingCallback callback, void* userCtx);
+	/// <summary>
+	/// Report the tags whose window ran out as DEDUP_DEPART, for callers feeding the cache at irregular intervals
+	/// </summary>
+	/// <param name="dedup"></param>
+	/// <param name="callback"></param>
+	/// <param name="userCtx"></param>
+	/// <returns>0x00 success</returns>
+	int TagDedupExpire(TagDedup* dedup, TagSightingCallback callback, void* userCtx);
+	/// <summary>
+	/// Report every tag still in the cache as DEDUP_FLUSH and empty it
+	/// </summary>
+	/// <param name="dedup"></param>
+	/// <param name="callback">NULL to drop them silently</param>
+	/// <param name="userCtx"></param>
+	/// <returns>0x00 success</returns>
+	int TagDedupFlush(TagDedup* dedup, TagSightingCallback callback, void* userCtx);
+	/// <summary>
+	/// Number of tags currently tracked
+	/// </summary>
+	/// <param name="dedup"></param>
+	/// <returns></returns>
+	size_t TagDedupCount(const TagDedup* dedup);
+	/// <summary>
+	/// InventoryStartStreaming through a dedup cache: the reader thread feeds dedup and reports sightings
+	/// instead of labels, departures are checked every STREAM_POLL_TIMEOUT without labels and the remaining
+	/// tags are flushed when the inventory ends. dedup belongs to the stream until InventoryStopStreaming.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="dedup">one stream per cache</param>
+	/// <param name="callback">called from the reader thread</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="flags">STREAM_PER_TAG, STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success</returns>
+	int InventoryStartDedup(int64_t hComm, TagDedup* dedup, TagSightingCallback callback, void* userCtx, unsigned int flags);
+	/// <summary>
+	/// Format a code as upper-case hex (SSSE3 / NEON where the CPU has it), NUL-terminated
+	/// </summary>
+	/// <param name="code"></param>
+	/// <param name="len">code length in bytes</param>
+	/// <param name="out">at least 2 * len + 1 chars</param>
+	/// <param name="outSize">size of out</param>
+	/// <returns>number of hex digits written (2 * len), 0 if out is too small</returns>
+	size_t TagCodeToHex(const unsigned char* code, size_t len, char* out, size_t outSize);
+	/// <summary>
+	/// TagCodeToHex of the full code of a compact label
+	/// </summary>
+	/// <param name="tag"></param>
+	/// <param name="arena">the arena the label was filled with</param>
+	/// <param name="out">at least 2 * codeLen + 1 chars</param>
+	/// <param name="outSize">size of out</param>
+	/// <returns>number of hex digits written, 0 if out is too small</returns>
+	size_t TagCompactToHex(const TagInfoCompact* tag, const TagCodeArena* arena, char* out, size_t outSize);
+	/// <summary>
+	/// Create an antenna scheduler
+	/// </summary>
+	/// <param name="config">NULL for the defaults</param>
+	/// <returns>NULL on invalid config</returns>
+	CFAntSched* CFAntSchedCreate(const AntSchedConfig* config);
+	/// <summary>
+	/// Stop the scheduler if it is running and free it
+	/// </summary>
+	/// <param name="sched"></param>
+	void CFAntSchedDestroy(CFAntSched* sched);
+	/// <summary>
+	/// Select the policy, also while the scheduler runs (from the next cycle on)
+	/// </summary>
+	/// <param name="sched"></param>
+	/// <param name="policy">ANTSCHED_*</param>
+	/// <param name="custom">ANTSCHED_CUSTOM: dwell of each port, otherwise NULL</param>
+	/// <param name="policyCtx">passed back to custom</param>
+	/// <returns>0x00 success</returns>
+	int CFAntSchedSetPolicy(CFAntSched* sched, int policy, AntSchedPolicy custom, void* policyCtx);
+	/// <summary>
+	/// Run inventory rounds on hComm one antenna at a time (SetAntenna, InventoryContinue, InventoryStop)
+	/// from a scheduler thread, labels are reported as by InventoryStartStreaming. The scheduler is the
+	/// stream of hComm: CFHandleLock pauses its round, InventoryStopStreaming stops it
+	/// </summary>
+	/// <param name="sched"></param>
+	/// <param name="hComm"></param>
+	/// <param name="callback">called from the scheduler thread, status ends the schedule on link errors</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if the scheduler or hComm is already running</returns>
+	int CFAntSchedStart(CFAntSched* sched, int64_t hComm, TagStreamCallback callback, void* userCtx);
+	/// <summary>
+	/// Stop the scheduler after the current round and restore the antenna mask found at CFAntSchedStart.
+	/// From the callback only the request is made, the thread ends once the callback returns.
+	/// </summary>
+	/// <param name="sched"></param>
+	/// <returns>0x00 success</returns>
+	int CFAntSchedStop(CFAntSched* sched);
+	/// <summary>
+	/// Get what the scheduler learnt about each port
+	/// </summary>
+	/// <param name="sched"></param>
+	/// <param name="ports">ANTSCHED_PORTS entries, index 0 = antenna 1</param>
+	/// <returns>0x00 success</returns>
+	int CFAntSchedGetStats(CFAntSched* sched, AntPortStats* ports);
+	/// <summary>
+	/// Create a Q / session controller
+	/// </summary>
+	/// <param name="config">NULL for the defaults</param>
+	/// <returns>NULL on invalid config</returns>
+	CFQCtl* CFQCtlCreate(const QCtlConfig* config);
+	/// <summary>
+	/// Stop the controller if it is running and free it
+	/// </summary>
+	/// <param name="ctl"></param>
+	void CFQCtlDestroy(CFQCtl* ctl);
+	/// <summary>
+	/// Run inventory rounds of windowMs on hComm and adjust Q (SetCoilPRM) and session / target (QueryCfgSet)
+	/// between them, labels are reported as by InventoryStartStreaming. The controller is the stream of
+	/// hComm: CFHandleLock pauses its round, InventoryStopStreaming stops it
+	/// </summary>
+	/// <param name="ctl"></param>
+	/// <param name="hComm"></param>
+	/// <param name="callback">called from the controller thread, status ends the rounds on link errors</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="telemetry">NULL for no telemetry</param>
+	/// <param name="telemetryCtx">passed back to telemetry</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if the controller or hComm is already running</returns>
+	int CFQCtlStart(CFQCtl* ctl, int64_t hComm, TagStreamCallback callback, void* userCtx, QCtlTelemetryCallback telemetry, void* telemetryCtx);
+	/// <summary>
+	/// Stop the controller, Q and query settings stay as last chosen.
+	/// From the callbacks only the request is made, the thread ends once the callback returns.
+	/// </summary>
+	/// <param name="ctl"></param>
+	/// <returns>0x00 success</returns>
+	int CFQCtlStop(CFQCtl* ctl);
+	/// <summary>
+	/// Get the last round and the current settings
+	/// </summary>
+	/// <param name="ctl"></param>
+	/// <param name="state"></param>
+	/// <returns>0x00 success</returns>
+	int CFQCtlGetState(CFQCtl* ctl, QCtlEvent* state);
+	/// <summary>
+	/// Create a connection pool and its keepalive thread
+	/// </summary>
+	/// <param name="config">NULL for the defaults</param>
+	/// <returns>NULL on failure</returns>
+	CFPool* CFPoolCreate(const PoolConfig* config);
+	/// <summary>
+	/// Stop the pool streams and close every session. No session may be acquired any more.
+	/// </summary>
+	/// <param name="pool"></param>
+	void CFPoolDestroy(CFPool* pool);
+	/// <summary>
+	/// Get exclusive use of the session of ip:port, connecting it if needed. A stream of the session
+	/// is paused until CFPoolRelease. Other callers of the same reader wait.
+	/// </summary>
+	/// <param name="pool"></param>
+	/// <param name="ip"></param>
+	/// <param name="port"></param>
+	/// <param name="hComm">session handle, valid until CFPoolRelease</param>
+	/// <returns>0x00 success, the OpenNetConnection status otherwise</returns>
+	int CFPoolAcquire(CFPool* pool, const char* ip, unsigned short port, int64_t* hComm);
+	/// <summary>
+	/// Give an acquired session back and resume its stream
+	/// </summary>
+	/// <param name="pool"></param>
+	/// <param name="hComm"></param>
+	/// <param name="status">status of the last call on hComm, STAT_DLL_DISCONNECT has the session reconnected</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if hComm is not acquired</returns>
+	int CFPoolRelease(CFPool* pool, int64_t hComm, int status);
+	/// <summary>
+	/// Run command on the session of ip:port: acquire, call, release. After STAT_DLL_DISCONNECT the
+	/// session is reconnected and command run again, up to PoolConfig.retries times.
+	/// </summary>
+	/// <param name="pool"></param>
+	/// <param name="ip"></param>
+	/// <param name="port"></param>
+	/// <param name="command">not allowed to call the pool</param>
+	/// <param name="ctx">passed back to command</param>
+	/// <returns>status of command or of the connect</returns>
+	int CFPoolCall(CFPool* pool, const char* ip, unsigned short port, HandleCommand command, void* ctx);
+	/// <summary>
+	/// Stream the labels of ip:port on its pooled session as InventoryStartStreaming does. Commands of the
+	/// pool pause the stream while they run; after link errors the session is reconnected and the stream resumed.
+	/// </summary>
+	/// <param name="pool"></param>
+	/// <param name="ip"></param>
+	/// <param name="port"></param>
+	/// <param name="callback">called from the reader thread, not allowed to call the pool; only STAT_CMD_INVENTORY_STOP ends the stream</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="flags">STREAM_PER_TAG, STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if the session is already streaming</returns>
+	int CFPoolStartStreaming(CFPool* pool, const char* ip, unsigned short port, TagStreamCallback callback, void* userCtx, unsigned int flags);
+	/// <summary>
+	/// Stop the stream of ip:port, the session stays open
+	/// </summary>
+	/// <param name="pool"></param>
+	/// <param name="ip"></param>
+	/// <param name="port"></param>
+	/// <returns>0x00 success</returns>
+	int CFPoolStopStreaming(CFPool* pool, const char* ip, unsigned short port);
+	/// <summary>
+	/// Get the state of the session of ip:port
+	/// </summary>
+	/// <param name="pool"></param>
+	/// <param name="ip"></param>
+	/// <param name="port"></param>
+	/// <param name="info"></param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if the pool has no session of ip:port</returns>
+	int CFPoolGetInfo(CFPool* pool, const char* ip, unsigned short port, PoolSessionInfo* info);
+	/// <summary>
+	/// InventoryContinue that records its arguments on hComm, so CFHandleLock / CFHandleUnlock continue a
+	/// paused inventory exactly as it was started
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="btInvCount"></param>
+	/// <param name="dwInvParam"></param>
+	/// <returns>0x00 success</returns>
+	int InventoryContinueEx(int64_t hComm, unsigned char btInvCount, unsigned long dwInvParam);
+	/// <summary>
+	/// Take the link of hComm for a command sequence: libCFApiEx calls of other threads on hComm wait (in
+	/// arrival order, between two polls of a waiting GetTagUiiBatch) until CFHandleUnlock. The inventory of
+	/// a running stream is stopped and continued on unlock so no label comes in between the responses.
+	/// Calls nest per thread.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="flags">HANDLE_PAUSE_INVENTORY</param>
+	/// <returns>0x00 success, also when no inventory was running; the InventoryStop status otherwise (the link is not taken then)</returns>
+	int CFHandleLock(int64_t hComm, unsigned int flags);
+	/// <summary>
+	/// Give the link of hComm back, the last unlock continues a stopped inventory with the arguments of the last
+	/// InventoryContinueEx (or streaming start) on hComm, InventoryContinue(0, 0) if there was none
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if the calling thread does not hold the link</returns>
+	int CFHandleUnlock(int64_t hComm);
+	/// <summary>
+	/// Run command between CFHandleLock and CFHandleUnlock
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="command"></param>
+	/// <param name="ctx">passed back to command</param>
+	/// <param name="flags">HANDLE_PAUSE_INVENTORY</param>
+	/// <returns>status of command, else of the lock / unlock</returns>
+	int CFHandleCall(int64_t hComm, HandleCommand command, void* ctx, unsigned int flags);
+	/// <summary>
+	/// Find the readers of the host: HID readers (CFHid_GetUsbInfo matched to hid_enumerate), serial ports probed
+	/// with OpenDevice / GetInfo in parallel, and network readers answering a UDP broadcast. Serial ports whose
+	/// VID / PID / serial number and path the cache knows are reported without a probe. A probe still running at
+	/// the deadline is reported as DISCOVER_TIMEOUT, and the call returns once it has closed its port.
+	/// </summary>
+	/// <param name="options">NULL for the defaults</param>
+	/// <param name="results"></param>
+	/// <param name="n">capacity of results</param>
+	/// <param name="count">results filled</param>
+	/// <returns>0x00 success, STAT_CMD_BUF_OVERFLOW if more than n were found (the first n are filled)</returns>
+	int CFDiscoverAll(const DiscoverOptions* options, DiscoverResult* results, size_t n, size_t* count);
+	/// <summary>
+	/// Open discovered readers one after the other: OpenDevice, OpenHidConnection or OpenNetConnection by kind.
+	/// libCFApi does not lock its connection table, so the opens of the extensions take turns
+	/// </summary>
+	/// <param name="results"></param>
+	/// <param name="n"></param>
+	/// <param name="baudRate">serial baud rate, 0 for 115200</param>
+	/// <param name="timeoutMs">OpenNetConnection timeout</param>
+	/// <param name="handles">n handles, valid where statuses is 0x00</param>
+	/// <param name="statuses">n open statuses</param>
+	/// <returns>0x00 if every reader was opened, else the first failure</returns>
+	int CFDiscoverOpen(const DiscoverResult* results, size_t n, int baudRate, unsigned int timeoutMs, int64_t* handles, int* statuses);
+	/// <summary>
+	/// Read the configuration parts of hComm in one pass, the link held with CFHandleLock so no other
+	/// command or inventory label comes in between. A part the reader refuses is left out of snap->valid.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="proto">protocol of the query and select parts</param>
+	/// <param name="parts">CONFIG_* parts to read, 0 for CONFIG_ALL</param>
+	/// <param name="snap"></param>
+	/// <returns>0x00 success, the GetInfo status, or the status of a part that lost the link</returns>
+	int CFConfigRead(int64_t hComm, unsigned char proto, unsigned int parts, ConfigSnapshot* snap);
+	/// <summary>
+	/// Write snap as a versioned blob: "CFCS", version, SN, parts, the parts field by field (little endian),
+	/// CRC-16. The blob does not depend on the struct layout of the host.
+	/// </summary>
+	/// <param name="snap"></param>
+	/// <param name="blob">CONFIG_BLOB_MAX_LEN bytes are always enough</param>
+	/// <param name="size"></param>
+	/// <param name="len">bytes written</param>
+	/// <returns>0x00 success, STAT_CMD_BUF_OVERFLOW if size is too small</returns>
+	int CFConfigSerialize(const ConfigSnapshot* snap, unsigned char* blob, size_t size, size_t* len);
+	/// <summary>
+	/// Read a blob of CFConfigSerialize back, parts of a later version that are not known are skipped
+	/// </summary>
+	/// <param name="blob"></param>
+	/// <param name="len"></param>
+	/// <param name="snap"></param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if the blob is damaged or not a snapshot</returns>
+	int CFConfigDeserialize(const unsigned char* blob, size_t len, ConfigSnapshot* snap);
+	/// <summary>
+	/// Parts valid in both a and b whose values differ
+	/// </summary>
+	/// <param name="a"></param>
+	/// <param name="b"></param>
+	/// <returns>CONFIG_* mask</returns>
+	unsigned int CFConfigDiff(const ConfigSnapshot* a, const ConfigSnapshot* b);
+	/// <summary>
+	/// Bring hComm to the configuration of target, calling only the setters of parts that differ from what
+	/// the reader has. The device parameters go first and the parts they overlap are read again after them,
+	/// so nothing is written twice.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="target"></param>
+	/// <param name="current">configuration of hComm read before, NULL to read it now</param>
+	/// <param name="flags">CONFIG_APPLY_ANY_SN</param>
+	/// <param name="applied">CONFIG_* parts written, may be NULL</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if target belongs to another reader, else the first failed setter</returns>
+	int CFConfigApply(int64_t hComm, const ConfigSnapshot* target, const ConfigSnapshot* current, unsigned int flags, unsigned int* applied);
+	/// <summary>
+	/// Upload total whitelist records (BeginWhiteList, SetWhiteList frames, EndWhiteList) taking them from source a
+	/// frame at a time. On serial and TCP links up to options->window frames are on the way before the first
+	/// acknowledgement is awaited. After a failure transfer->nextFrame tells where the reader stopped: passed as
+	/// options->resumeFrame (on the reopened connection) the upload continues from there without BeginWhiteList.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="source"></param>
+	/// <param name="ctx">passed back to source</param>
+	/// <param name="total">records of the whole list</param>
+	/// <param name="options">NULL for the defaults</param>
+	/// <param name="transfer">may be NULL</param>
+	/// <returns>0x00 success, else the status of the failed frame, the source or the link</returns>
+	int UploadWhiteListStream(int64_t hComm, WhiteListSource source, void* ctx, size_t total, const WhiteListOptions* options, WhiteListTransfer* transfer);
+	/// <summary>
+	/// UploadWhiteListStream of a file of WHITELIST_RECORD_LEN byte records, mapped rather than read into memory
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="path"></param>
+	/// <param name="options">NULL for the defaults</param>
+	/// <param name="transfer">may be NULL</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if the file cannot be mapped or is not a whole number of records</returns>
+	int UploadWhiteListFile(int64_t hComm, const char* path, const WhiteListOptions* options, WhiteListTransfer* transfer);
+	/// <summary>
+	/// Download the whitelist (BeginWhiteList option 2, GetAccessInfo count) handing the records of each frame to
+	/// sink straight from the receive buffer, without a WhiteList copy per frame
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="sink"></param>
+	/// <param name="ctx">passed back to sink</param>
+	/// <param name="options">NULL for the defaults, window / frameRecords / resumeFrame are not used</param>
+	/// <param name="transfer">may be NULL</param>
+	/// <returns>0x00 success, else the status of the reader, the sink or the link</returns>
+	int DownloadWhiteListStream(int64_t hComm, WhiteListSink sink, void* ctx, const WhiteListOptions* options, WhiteListTransfer* transfer);
+	/// <summary>
+	/// Get the counters and latency histograms of hComm. The counters are updated lock-free on the hot
+	/// paths, a snapshot taken while they run may be a few events apart between fields.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="stats"></param>
+	/// <returns>0x00 success</returns>
+	int CFGetStats(int64_t hComm, CFStats* stats);
+	/// <summary>
+	/// Format the stats of n readers as OpenMetrics text (Prometheus text exposition), one sample per
+	/// reader in each family with reader="readers[i]", ended by "# EOF"
+	/// </summary>
+	/// <param name="stats">n snapshots of CFGetStats</param>
+	/// <param name="readers">n label values</param>
+	/// <param name="n"></param>
+	/// <param name="buf"></param>
+	/// <param name="size">size of buf</param>
+	/// <param name="len">length of the text without the terminating NUL, also the space needed when buf is too small</param>
+	/// <returns>0x00 success, STAT_CMD_BUF_OVERFLOW if size is not above len</returns>
+	int CFStatsFormatOpenMetrics(const CFStats* stats, const char* const* readers, size_t n, char* buf, size_t size, size_t* len);
+	/// <summary>
+	/// Record the raw byte stream of hComm to path until CFCaptureStop. Serial and TCP connections are
+	/// relayed through a pseudo terminal or socket pair that takes the place of the descriptor, so every
+	/// byte of libCFApi and of this library is recorded in both directions. HID connections record the
+	/// labels of the batch, stream and ring paths as the inventory frames they came in (CAPTURE_FLAG_LABELS).
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="path">file to create or truncate</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if a capture is already running or path cannot be created, STAT_PORT_HANDLE_ERR if the relay cannot be set up</returns>
+	int CFCaptureStart(int64_t hComm, const char* path);
+	/// <summary>
+	/// End the capture of hComm and put the connection back in place. Bytes the relay delivered and
+	/// libCFApi had not read yet are lost with the relay. CloseDeviceEx stops a running capture as well.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if no capture is running, STAT_DLL_INNER_FAILED if the file could not be written completely</returns>
+	int CFCaptureStop(int64_t hComm);
+	/// <summary>
+	/// Open a capture file as a reader: like OpenDevice on a pseudo terminal that plays the recorded reader
+	/// bytes back. Where the host wrote in the capture, playback waits until the host has written as many
+	/// bytes, so commands get their recorded responses. Close with CloseDeviceEx.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="path">file of CFCaptureStart</param>
+	/// <param name="speed">1.0 for the recorded timing, N for N times faster, REPLAY_SPEED_MAX for no pauses</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if path is no capture file, else the status of OpenDevice</returns>
+	int OpenReplayDevice(int64_t* hComm, const char* path, double speed);
+	/// <summary>
+	/// Open a tag event journal in a directory, created if missing. Appending goes on in the newest segment
+	/// when it has room. Records are copied into shared mappings of preallocated files and reach the card
+	/// by the kernel's writeback, nothing on the append path waits for the disk (see TagJournalSync).
+	/// </summary>
+	/// <param name="dir"></param>
+	/// <param name="config">NULL for the defaults</param>
+	/// <returns>NULL if dir cannot be created or the first segment cannot be set up</returns>
+	TagJournal* TagJournalOpen(const char* dir, const TagJournalConfig* config);
+	/// <summary>
+	/// Close a journal, stopping the InventoryStartJournal streams that feed it (not from their callbacks)
+	/// </summary>
+	/// <param name="journal"></param>
+	void TagJournalClose(TagJournal* journal);
+	/// <summary>
+	/// Append labels as records stamped with the current time, from any thread
+	/// </summary>
+	/// <param name="journal"></param>
+	/// <param name="source">reader id stored in the records</param>
+	/// <param name="tags"></param>
+	/// <param name="count"></param>
+	/// <param name="arena">arena the codes of tags are stored in, may be NULL</param>
+	/// <returns>0x00 success, STAT_DLL_INNER_FAILED if the next segment could not be created (the labels are lost)</returns>
+	int TagJournalAppend(TagJournal* journal, unsigned int source, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena);
+	/// <summary>
+	/// Write the records appended so far to the disk and wait for it, for a thread of its own or a
+	/// shutdown rather than the stream path
+	/// </summary>
+	/// <param name="journal"></param>
+	/// <returns>0x00 success, STAT_DLL_INNER_FAILED if the segment could not be written</returns>
+	int TagJournalSync(TagJournal* journal);
+	/// <summary>
+	/// InventoryStartStreaming into a journal: the reader thread appends every label with source as its
+	/// reader id and then passes the batch on to callback. Several handles may feed one journal.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="journal"></param>
+	/// <param name="source">reader id stored in the records</param>
+	/// <param name="callback">NULL to only journal the labels, else called from the reader thread</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="flags">STREAM_PER_TAG, STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success</returns>
+	int InventoryStartJournal(int64_t hComm, TagJournal* journal, unsigned int source, TagStreamCallback callback, void* userCtx, unsigned int flags);
+	/// <summary>
+	/// Records of a journal directory with fromUs &lt;= timeUs &lt;= toUs, oldest first. Segments outside the
+	/// range are skipped from their header, within one the time index finds the first record. Works on a
+	/// journal another thread or process is appending to.
+	/// </summary>
+	/// <param name="dir"></param>
+	/// <param name="fromUs">CLOCK_REALTIME in microseconds</param>
+	/// <param name="toUs">JOURNAL_TIME_MAX for no upper bound</param>
+	/// <param name="callback"></param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if dir cannot be read, else the status callback ended the query with</returns>
+	int TagJournalQueryRange(const char* dir, uint64_t fromUs, uint64_t toUs, JournalRecordCallback callback, void* userCtx);
+	/// <summary>
+	/// Records of one code within fromUs..toUs, newest first, found through the code hash index of each segment
+	/// </summary>
+	/// <param name="dir"></param>
+	/// <param name="code"></param>
+	/// <param name="codeLen">full code length</param>
+	/// <param name="fromUs"></param>
+	/// <param name="toUs">JOURNAL_TIME_MAX for no upper bound</param>
+	/// <param name="callback"></param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if dir cannot be read, else the status callback ended the query with</returns>
+	int TagJournalQueryCode(const char* dir, const unsigned char* code, size_t codeLen, uint64_t fromUs, uint64_t toUs, JournalRecordCallback callback, void* userCtx);
+	/// <summary>
+	/// Set config->enterRssi from the RSSI filter calibration of a reader: BasciRssi - AntDelta[i] dBm for antenna i + 1
+	/// </summary>
+	/// <param name="config"></param>
+	/// <param name="para"></param>
+	/// <returns>0x00 success</returns>
+	int TagPresenceConfigFromRssiPara(TagPresenceConfig* config, const RssiPara* para);
+	/// <summary>
+	/// Create a presence engine
+	/// </summary>
+	/// <param name="config">zoneCount 1..PRESENCE_ZONES, each zone with at least one antenna</param>
+	/// <returns>NULL on invalid config</returns>
+	TagPresence* TagPresenceCreate(const TagPresenceConfig* config);
+	/// <summary>
+	/// Destroy a presence engine without reporting the tags still in a zone (see TagPresenceFlush)
+	/// </summary>
+	/// <param name="presence"></param>
+	void TagPresenceDestroy(TagPresence* presence);
+	/// <summary>
+	/// Feed labels into the engine. Each read updates the smoothed RSSI of its tag and antenna and reports
+	/// the zones the tag leaves (first) and enters. Tags no longer read are timed out first, as by TagPresenceExpire.
+	/// </summary>
+	/// <param name="presence"></param>
+	/// <param name="tags"></param>
+	/// <param name="count"></param>
+	/// <param name="arena">arena the codes of tags are stored in, may be NULL</param>
+	/// <param name="callback">called on the calling thread</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <returns>0x00 success</returns>
+	int TagPresenceFeed(TagPresence* presence, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, ZoneEventCallback callback, void* userCtx);
+	/// <summary>
+	/// Report ZONE_EXIT for the tags not read for exitMs, for callers feeding the engine at irregular intervals
+	/// </summary>
+	/// <param name="presence"></param>
+	/// <param name="callback"></param>
+	/// <param name="userCtx"></param>
+	/// <returns>0x00 success</returns>
+	int TagPresenceExpire(TagPresence* presence, ZoneEventCallback callback, void* userCtx);
+	/// <summary>
+	/// Report ZONE_EXIT for every zone a tag is in and empty the engine
+	/// </summary>
+	/// <param name="presence"></param>
+	/// <param name="callback">NULL to drop them silently</param>
+	/// <param name="userCtx"></param>
+	/// <returns>0x00 success</returns>
+	int TagPresenceFlush(TagPresence* presence, ZoneEventCallback callback, void* userCtx);
+	/// <summary>
+	/// Zones a tag is in, on the thread feeding the engine (or from its callback)
+	/// </summary>
+	/// <param name="presence"></param>
+	/// <param name="code"></param>
+	/// <param name="codeLen">full code length</param>
+	/// <returns>bit z set for zone z, 0 for a tag not tracked</returns>
+	unsigned int TagPresenceZones(const TagPresence* presence, const unsigned char* code, size_t codeLen);
+	/// <summary>
+	/// Number of tags currently tracked
+	/// </summary>
+	/// <param name="presence"></param>
+	/// <returns></returns>
+	size_t TagPresenceCount(const TagPresence* presence);
+	/// <summary>
+	/// InventoryStartStreaming through a presence engine: the reader thread feeds presence and reports zone
+	/// events instead of labels, timeouts are checked every STREAM_POLL_TIMEOUT without labels and the tags
+	/// still in a zone are flushed when the inventory ends. presence belongs to the stream until InventoryStopStreaming.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="presence">one stream per engine</param>
+	/// <param name="callback">called from the reader thread</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="flags">STREAM_PER_TAG, STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success</returns>
+	int InventoryStartPresence(int64_t hComm, TagPresence* presence, ZoneEventCallback callback, void* userCtx, unsigned int flags);
+	/// <summary>
+	/// Allocate the per-handle buffers up front instead of on first use, so a steady inventory loop
+	/// (GetTagUii*, GetReadTagRespView, InventoryStartRing + TagRingPop) does no heap allocation.
+	/// The buffers stay with the handle until CloseDevice.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="ringSize">ring of InventoryStartRing, 0 for RING_DEFAULT_SIZE; InventoryStartRing with the same size reuses it</param>
+	/// <param name="flags">RESERVE_*</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR while a stream runs or a TagRingPop waits and RESERVE_RING is set</returns>
+	int CFHandleReserve(int64_t hComm, size_t ringSize, unsigned int flags);
+	/// <summary>
+	/// Setters of CFApi.h taking the parameter block by pointer, for bindings that keep one block
+	/// around instead of building a copy for every call. NULL is rejected with STAT_CMD_PARAM_ERR.
+	/// </summary>
+	int SetDevicePara_Ptr(int64_t hComm, const DevicePara* devInfo);
+	int SetLongPermissonPara_Ptr(int64_t hComm, const LongPermissonPara* param);
+	int SetPermissonPara_Ptr(int64_t hComm, const PermissonPara* param);
+	int SetGpioPara_Ptr(int64_t hComm, const GpioPara* param);
+	int SetNetInfo_Ptr(int64_t hComm, const NetInfo* param);
+	int SetwifiPara_Ptr(int64_t hComm, const WiFiPara* param);
+	int SetRemoteNetInfo_Ptr(int64_t hComm, const RemoteNetInfo* param);
+	int SetAntPower_Ptr(int64_t hComm, const AntPower* param);
+	int SetGPIOWorkParam_Ptr(int64_t hComm, const GPIOWorkParam* param);
+	int SetGateWorkParam_Ptr(int64_t hComm, const GateWorkParam* param);
+	int SetEASMask_Ptr(int64_t hComm, const EASMask* param);
+	int SetHeartbeat_Ptr(int64_t hComm, const Heartbeat* param);
+	int SetAccessOperateParam_Ptr(int64_t hComm, const AccessOperateParam* param);
+	/// <summary>
+	/// Create a cross-reader dedup table
+	/// </summary>
+	/// <param name="config">NULL for the defaults</param>
+	/// <returns>NULL on allocation failure, a departMs below windowMs or more shards than maxTags</returns>
+	TagMerge* TagMergeCreate(const TagMergeConfig* config);
+	/// <summary>
+	/// Free a table without reporting the tags still in it. Stop every connection streaming into it first.
+	/// </summary>
+	/// <param name="merge"></param>
+	void TagMergeDestroy(TagMerge* merge);
+	/// <summary>
+	/// Feed labels read on hComm, from any thread. A read can make hComm the owner of its tag
+	/// (MERGE_ARRIVE / MERGE_HANDOFF); repeats only update the table.
+	/// </summary>
+	/// <param name="merge"></param>
+	/// <param name="hComm">reader the labels came from</param>
+	/// <param name="tags"></param>
+	/// <param name="count"></param>
+	/// <param name="arena">codes longer than TAGCOMPACT_CODE_LEN, may be NULL</param>
+	/// <returns>0x00 success</returns>
+	int TagMergeFeed(TagMerge* merge, int64_t hComm, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena);
+	/// <summary>
+	/// TagStreamCallback feeding the TagMerge passed as userCtx, e.g. CFReactorCreate(TagMergeStreamCallback, merge)
+	/// </summary>
+	void TagMergeStreamCallback(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx);
+	/// <summary>
+	/// Queue MERGE_DEPART for the tags no reader read for departMs. The streams of InventoryStartMerged
+	/// and TagMergePop do it on their own; shards locked by a feeding thread are left for the next call.
+	/// </summary>
+	/// <param name="merge"></param>
+	/// <returns>0x00 success</returns>
+	int TagMergeExpire(TagMerge* merge);
+	/// <summary>
+	/// Queue MERGE_FLUSH for every tag and empty the table
+	/// </summary>
+	/// <param name="merge"></param>
+	/// <returns>0x00 success</returns>
+	int TagMergeFlush(TagMerge* merge);
+	/// <summary>
+	/// Start streaming the labels of hComm into merge. Stop with InventoryStopStreaming.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="merge"></param>
+	/// <param name="flags">STREAM_NO_INVENTORY</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if a stream is already running on hComm</returns>
+	int InventoryStartMerged(int64_t hComm, TagMerge* merge, unsigned int flags);
+	/// <summary>
+	/// Take the events of merge, after expiring departed tags. Call from one consumer thread only.
+	/// </summary>
+	/// <param name="merge"></param>
+	/// <param name="out">TagMergeEvent array of return type</param>
+	/// <param name="capacity">number of elements in out</param>
+	/// <param name="count">number of events written to out</param>
+	/// <param name="timeout">waiting time while no event is queued, 0 to poll</param>
+	/// <returns>0x00 success with count >= 1, STAT_CMD_COMM_TIMEOUT</returns>
+	int TagMergePop(TagMerge* merge, TagMergeEvent* out, size_t capacity, size_t* count, unsigned short timeout);
+	/// <summary>
+	/// Get the counters of merge
+	/// </summary>
+	/// <param name="merge"></param>
+	/// <param name="stats"></param>
+	/// <returns>0x00 success</returns>
+	int TagMergeGetStats(TagMerge* merge, TagMergeStats* stats);
+	/// <summary>
+	/// Prime hComm for trigger reads: stop the inventory, configure the trigger and discard what is
+	/// queued on the link. TRIGGER_GPIO switches the reader to TRIGGER_WORKMODE with SetDevicePara,
+	/// SetGpioPara (TriggleMode) and SetGPIOWorkParam (firmware without the latter keeps its GPIO work
+	/// parameters); the previous values are put back by CFTriggerDisarm. Arming again disarms first.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="config">NULL for TRIGGER_HOST with the defaults</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if a stream is running on hComm</returns>
+	int CFTriggerArm(int64_t hComm, const TriggerConfig* config);
+	/// <summary>
+	/// Wait for the trigger and return the first label that passes CRC. TRIGGER_HOST starts an
+	/// inventory of cycles rounds once triggerFd is readable (POLLIN / POLLPRI, the call does not
+	/// read it), or at once for -1; the reader ends the rounds itself, so no InventoryStop is sent,
+	/// and an empty round is started again. Labels still coming for the previous trigger are skipped.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="triggerFd">TRIGGER_HOST: descriptor of the trigger (GPIO line, socket ...), -1 for the call itself</param>
+	/// <param name="tag">TagInfo of return type</param>
+	/// <param name="result">TriggerResult of return type</param>
+	/// <param name="timeout">waiting time for the trigger and the label together</param>
+	/// <returns>0x00 success, STAT_CMD_COMM_TIMEOUT, STAT_CMD_PARAM_ERR if hComm is not armed</returns>
+	int CFTriggerWaitTag(int64_t hComm, int triggerFd, TagInfo* tag, TriggerResult* result, unsigned short timeout);
+	/// <summary>
+	/// Leave the armed state, putting back the parameters CFTriggerArm changed on the reader
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <returns>0x00 success, the status of the first parameter that could not be put back</returns>
+	int CFTriggerDisarm(int64_t hComm);
+	/// <summary>
+	/// Commission a queue of tags: singulate, write the EPC, verify it by reading it back through the new
+	/// EPC, and lock. The next step of every job in the window goes into one pipelined CFOpQueueSubmit, each
+	/// operation with the SetSelectMask of its tag. Failed steps the tag may pass
+	/// on a later try (no response, low power, lost answer, busy tag) are retried; a pass with low power
+	/// failures is followed by a pause for the tags to recharge, and lost answers halve the op queue depth,
+	/// which grows back by one per clean pass. The depth of the handle is restored at the end.
+	/// </summary>
+	/// <param name="hComm"></param>
+	/// <param name="jobs">CommissionJob array</param>
+	/// <param name="n">number of jobs</param>
+	/// <param name="config">NULL for the defaults</param>
+	/// <param name="callback">called once per job on the calling thread, may be NULL</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="stats">counters of the run, may be NULL</param>
+	/// <returns>0x00 every job was run (see CommissionResult.status), otherwise the link error that ended the run</returns>
+	int CFCommissionRun(int64_t hComm, const CommissionJob* jobs, size_t n, const CommissionConfig* config, CommissionCallback callback, void* userCtx, CommissionStats* stats);
+	/// <summary>
+	/// Create an event loop for CFAsyncSubmit
+	/// </summary>
+	/// <returns>NULL on failure</returns>
+	CFAsync* CFAsyncCreate();
+	/// <summary>
+	/// Remove every connection (cancelling its operations, their callbacks are called here) and free the loop
+	/// </summary>
+	/// <param name="async"></param>
+	void CFAsyncDestroy(CFAsync* async);
+	/// <summary>
+	/// Hand hComm over to the loop: it holds the turn on the link (as CFHandleLock does) until CFAsyncRemove
+	/// </summary>
+	/// <param name="async"></param>
+	/// <param name="hComm">serial or TCP connection without a running stream</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR for HID, streaming or already added connections</returns>
+	int CFAsyncAdd(CFAsync* async, int64_t hComm);
+	/// <summary>
+	/// Cancel the operations of hComm (a running inventory gets a stop without waiting for its answer)
+	/// and give the link back
+	/// </summary>
+	/// <param name="async"></param>
+	/// <param name="hComm"></param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if hComm is not added</returns>
+	int CFAsyncRemove(CFAsync* async, int64_t hComm);
+	/// <summary>
+	/// Queue op on hComm. Inventories and tag operations of a connection run one after the other in
+	/// submission order, gate waits next to them; callback is called from CFAsyncPoll.
+	/// </summary>
+	/// <param name="async"></param>
+	/// <param name="hComm">connection added with CFAsyncAdd</param>
+	/// <param name="op">AsyncOp</param>
+	/// <param name="callback">called once per operation</param>
+	/// <param name="userCtx">passed back to callback</param>
+	/// <param name="id">id for CFAsyncCancel, may be NULL</param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR for an invalid op, the link error of a connection that failed</returns>
+	int CFAsyncSubmit(CFAsync* async, int64_t hComm, const AsyncOp* op, AsyncCallback callback, void* userCtx, uint64_t* id);
+	/// <summary>
+	/// End operation id with ASYNC_CANCELLED: a running inventory is stopped, a sent tag operation still
+	/// holds the link until its answer (or deadline), a queued one never goes out. The callback follows
+	/// from the next CFAsyncPoll.
+	/// </summary>
+	/// <param name="async"></param>
+	/// <param name="id"></param>
+	/// <returns>0x00 success, STAT_CMD_PARAM_ERR if id has completed (or was never submitted)</returns>
+	int CFAsyncCancel(CFAsync* async, uint64_t id);
+	/// <summary>
+	/// Wait for the link events and deadlines of one round and call the callbacks of the operations they complete
+	/// </summary>
+	/// <param name="async"></param>
+	/// <param name="timeout">ms, -1 to wait without limit</param>
+	/// <returns>0x00 something happened, STAT_CMD_COMM_TIMEOUT nothing did</returns>
+	int CFAsyncPoll(CFAsync* async, int timeout);
+	/// <summary>
+	/// CFAsyncPoll until CFAsyncStop
+	/// </summary>
+	/// <param name="async"></param>
+	/// <returns>0x00 after CFAsyncStop</returns>
+	int CFAsyncRun(CFAsync* async);
+	/// <summary>
+	/// Make CFAsyncRun return, may be called from any thread
+	/// </summary>
+	/// <param name="async"></param>
+	/// <returns>0x00 success</returns>
+	int CFAsyncStop(CFAsync* async);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,640 @@
+// cfapi-bench: tags/s, latency percentiles and CPU per tag of libCFApi + libCFApiEx against one or more
+// readers, reported as JSON so runs of different libCFApi builds and releases can be compared.
+//
+//   cfapi-bench --serial /dev/ttyUSB0 [--net 192.168.1.200:2022 ...] [--duration 10]
+//               [--scenario poll,batch,stream,ops,ops-seq,reactor] [--ops 16] [--depth 4] [--write] [--output run.json]
+//               [--capture run.cap]
+//   cfapi-bench --replay run.cap [--speed 0] ...
+//
+// Every scenario runs for --duration seconds on the first reader, the reactor scenario on all of them.
+// --capture records the byte stream of the first reader, --replay plays such a recording back as a
+// reader (OpenReplayDevice), at --speed times the recorded pace or with no pauses for 0.
+//
+// With glibc the heap allocations of the process are counted as well (malloc, calloc, realloc and
+// posix_memalign are interposed below), the bookkeeping of the bench itself left out. The readers
+// are set up with CFHandleReserve first, so steady_allocs of the poll, batch and stream scenarios
+// is expected to be 0.
+
+#include "CFApiEx.h"
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define BENCH_BATCH							64		// labels per GetTagUiiBatchCompact call
+#define BENCH_POLL_TIMEOUT					200		// ms per GetTagUii / batch call
+#define BENCH_NET_TIMEOUT					3000	// OpenNetConnection timeout
+#define BENCH_MEMBANK_EPC					0x01
+#define BENCH_MEMBANK_USER					0x03
+
+#ifdef __GLIBC__
+#define BENCH_COUNT_ALLOCS					1
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+
+static std::atomic<uint64_t> g_allocs(0);
+static __thread int t_benchOwn;		// set while the bench records its own results
+
+static inline void Bench_CountAlloc()
+{
+	if (t_benchOwn == 0)
+		g_allocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void* malloc(size_t size)
+{
+	Bench_CountAlloc();
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+	Bench_CountAlloc();
+	return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+	Bench_CountAlloc();
+	return __libc_realloc(ptr, size);
+}
+
+extern "C" int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+	Bench_CountAlloc();
+	void* mem = __libc_memalign(alignment, size);
+	if (mem == NULL)
+		return ENOMEM;
+	*ptr = mem;
+	return 0;
+}
+#else
+#define BENCH_COUNT_ALLOCS					0
+
+static std::atomic<uint64_t> g_allocs(0);
+static int t_benchOwn;
+#endif
+
+struct BenchReader
+{
+	std::string name;				// as given on the command line
+	int64_t hComm;
+};
+
+struct BenchOptions
+{
+	std::vector<BenchReader> readers;
+	std::vector<std::string> scenarios;
+	double duration;
+	unsigned int ops;
+	unsigned int depth;
+	bool write;
+	const char* output;
+};
+
+// Outcome of one scenario.
+struct BenchResult
+{
+	std::string name;
+	unsigned int readers;
+	uint64_t tags;					// labels, or operations for the ops scenarios
+	uint64_t calls;
+	uint64_t errors;				// failed calls / operations other than timeouts
+	uint64_t timeouts;
+	double seconds;
+	double firstTagMs;				// -1 when none arrived
+	double cpuSeconds;				// user + system time of the process
+	uint64_t allocs;				// heap allocations of the scenario, setup and teardown included
+	uint64_t steadyAllocs;			// the ones from the first label until the scenario stopped its reader
+	std::vector<double> latencyUs;	// per call, operation or delivery, see the scenario
+};
+
+struct BenchStream
+{
+	std::mutex lock;
+	BenchResult* result;
+	uint64_t startNs;
+	uint64_t lastNs;
+};
+
+struct BenchOps
+{
+	uint64_t submitNs;
+	BenchResult* result;
+	std::vector<uint64_t>* doneNs;
+};
+
+static uint64_t Bench_NowNs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static double Bench_CpuSeconds()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void Bench_Begin(BenchResult* r, const char* name, unsigned int readers)
+{
+	r->name = name;
+	r->readers = readers;
+	r->tags = r->calls = r->errors = r->timeouts = 0;
+	r->firstTagMs = -1;
+	r->latencyUs.clear();
+	r->steadyAllocs = 0;
+	r->seconds = Bench_NowNs() / 1e9;
+	r->cpuSeconds = Bench_CpuSeconds();
+	r->allocs = g_allocs.load(std::memory_order_relaxed);
+}
+
+static void Bench_End(BenchResult* r)
+{
+	r->allocs = g_allocs.load(std::memory_order_relaxed) - r->allocs;
+	r->seconds = Bench_NowNs() / 1e9 - r->seconds;
+	r->cpuSeconds = Bench_CpuSeconds() - r->cpuSeconds;
+}
+
+// Allocations since the first label, called before the scenario stops its reader.
+static void Bench_Steady(BenchResult* r)
+{
+	if (r->firstTagMs >= 0)
+		r->steadyAllocs = g_allocs.load(std::memory_order_relaxed) - r->steadyAllocs;
+}
+
+static void Bench_Sample(BenchResult* r, double us)
+{
+	t_benchOwn++;
+	r->latencyUs.push_back(us);
+	t_benchOwn--;
+}
+
+static void Bench_Count(BenchResult* r, int status)
+{
+	if (status == (int)STAT_CMD_COMM_TIMEOUT)
+		r->timeouts++;
+	else if (status != STAT_OK && status != (int)STAT_CMD_INVENTORY_STOP && status != (int)STAT_CMD_NOMORE_DATA)
+		r->errors++;
+}
+
+static void Bench_FirstTag(BenchResult* r, uint64_t startNs)
+{
+	if (r->firstTagMs < 0)
+	{
+		r->firstTagMs = (Bench_NowNs() - startNs) / 1e6;
+		r->steadyAllocs = g_allocs.load(std::memory_order_relaxed);
+	}
+}
+
+// Labels left in flight after InventoryStop must not be counted by the next scenario.
+static void Bench_Flush(int64_t hComm)
+{
+	TagInfo tag;
+	while (GetTagUii(hComm, &tag, BENCH_POLL_TIMEOUT) == STAT_OK)
+		;
+}
+
+// InventoryContinue + GetTagUii, latency: wait of each GetTagUii that returned a label.
+static void Bench_Poll(const BenchOptions* opt, BenchResult* r)
+{
+	int64_t hComm = opt->readers[0].hComm;
+	Bench_Begin(r, "poll", 1);
+	uint64_t start = Bench_NowNs(), end = start + (uint64_t)(opt->duration * 1e9);
+	Bench_Count(r, InventoryContinue(hComm, 0, 0));
+	TagInfo tag;
+	while (Bench_NowNs() < end)
+	{
+		uint64_t t = Bench_NowNs();
+		int status = GetTagUii(hComm, &tag, BENCH_POLL_TIMEOUT);
+		r->calls++;
+		if (status == STAT_OK)
+		{
+			Bench_FirstTag(r, start);
+			Bench_Sample(r, (Bench_NowNs() - t) / 1e3);
+			r->tags++;
+		}
+		else if (status == (int)STAT_CMD_INVENTORY_STOP)
+			Bench_Count(r, InventoryContinue(hComm, 0, 0));
+		else
+			Bench_Count(r, status);
+	}
+	Bench_Steady(r);
+	InventoryStop(hComm, COMMON_TIMEOUT);
+	Bench_End(r);
+	Bench_Flush(hComm);
+}
+
+// InventoryContinue + GetTagUiiBatchCompact, latency: duration of each call that returned labels.
+static void Bench_Batch(const BenchOptions* opt, BenchResult* r)
+{
+	int64_t hComm = opt->readers[0].hComm;
+	std::vector<TagInfoCompact> tags(BENCH_BATCH);
+	std::vector<unsigned char> codes(BENCH_BATCH * 64);
+	Bench_Begin(r, "batch", 1);
+	uint64_t start = Bench_NowNs(), end = start + (uint64_t)(opt->duration * 1e9);
+	Bench_Count(r, InventoryContinue(hComm, 0, 0));
+	while (Bench_NowNs() < end)
+	{
+		TagCodeArena arena = { codes.data(), (unsigned short)codes.size(), 0 };
+		size_t count = 0;
+		uint64_t t = Bench_NowNs();
+		int status = GetTagUiiBatchCompact(hComm, tags.data(), tags.size(), &count, &arena, BENCH_POLL_TIMEOUT);
+		r->calls++;
+		if (count > 0)
+		{
+			Bench_FirstTag(r, start);
+			Bench_Sample(r, (Bench_NowNs() - t) / 1e3);
+			r->tags += count;
+		}
+		if (status == (int)STAT_CMD_INVENTORY_STOP)
+			Bench_Count(r, InventoryContinue(hComm, 0, 0));
+		else
+			Bench_Count(r, status);
+	}
+	Bench_Steady(r);
+	InventoryStop(hComm, COMMON_TIMEOUT);
+	Bench_End(r);
+	Bench_Flush(hComm);
+}
+
+// Latency: time between two deliveries of the stream or reactor callback.
+static void Bench_StreamCallback(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	BenchStream* s = (BenchStream*)userCtx;
+	uint64_t now = Bench_NowNs();
+	std::lock_guard<std::mutex> guard(s->lock);
+	BenchResult* r = s->result;
+	r->calls++;
+	if (status != STAT_OK)
+	{
+		Bench_Count(r, status);
+		return;
+	}
+	if (r->firstTagMs < 0)
+	{
+		r->firstTagMs = (now - s->startNs) / 1e6;
+		r->steadyAllocs = g_allocs.load(std::memory_order_relaxed);
+	}
+	else
+		Bench_Sample(r, (now - s->lastNs) / 1e3);
+	s->lastNs = now;
+	r->tags += count;
+}
+
+static void Bench_Sleep(double seconds)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t)seconds;
+	ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+static void Bench_Stream(const BenchOptions* opt, BenchResult* r)
+{
+	int64_t hComm = opt->readers[0].hComm;
+	BenchStream s;
+	s.result = r;
+	Bench_Begin(r, "stream", 1);
+	s.startNs = s.lastNs = Bench_NowNs();
+	int status = InventoryStartStreaming(hComm, Bench_StreamCallback, &s, 0);
+	if (status == STAT_OK)
+	{
+		Bench_Sleep(opt->duration);
+		s.lock.lock();
+		Bench_Steady(r);
+		s.lock.unlock();
+		InventoryStopStreaming(hComm, COMMON_TIMEOUT);
+	}
+	else
+		r->errors++;
+	Bench_End(r);
+}
+
+static void* Bench_ReactorThread(void* arg)
+{
+	CFReactorRun((CFReactor*)arg);
+	return NULL;
+}
+
+// Every reader on one CFReactor run by one thread.
+static void Bench_Reactor(const BenchOptions* opt, BenchResult* r)
+{
+	BenchStream s;
+	s.result = r;
+	Bench_Begin(r, "reactor", (unsigned int)opt->readers.size());
+	s.startNs = s.lastNs = Bench_NowNs();
+	CFReactor* reactor = CFReactorCreate(Bench_StreamCallback, &s);
+	if (reactor == NULL)
+	{
+		r->errors++;
+		Bench_End(r);
+		return;
+	}
+	for (size_t i = 0; i < opt->readers.size(); i++)
+		Bench_Count(r, CFReactorAdd(reactor, opt->readers[i].hComm, 0));
+	pthread_t thread;
+	bool started = pthread_create(&thread, NULL, Bench_ReactorThread, reactor) == 0;
+	if (started)
+	{
+		Bench_Sleep(opt->duration);
+		s.lock.lock();
+		Bench_Steady(r);
+		s.lock.unlock();
+		CFReactorStop(reactor);
+		pthread_join(thread, NULL);
+	}
+	for (size_t i = 0; i < opt->readers.size(); i++)
+		CFReactorRemove(reactor, opt->readers[i].hComm, COMMON_TIMEOUT);
+	Bench_End(r);
+	CFReactorDestroy(reactor);
+}
+
+static void Bench_OpCallback(int64_t hComm, const TagOp* op, const TagOpResult* result, void* userCtx)
+{
+	BenchOps* ops = (BenchOps*)userCtx;
+	(*ops->doneNs)[result->index] = Bench_NowNs();
+	ops->result->tags++;
+	Bench_Count(ops->result, result->status);
+}
+
+// CFOpQueueSubmit of --ops operations at a time, latency: submit to completion of each operation.
+// ReadTag of the EPC, with --write also WriteTag of user memory word 0.
+static void Bench_Ops(const BenchOptions* opt, BenchResult* r, const char* name, unsigned int depth)
+{
+	int64_t hComm = opt->readers[0].hComm;
+	unsigned char pattern[2] = { 0x12, 0x34 };
+	std::vector<TagOp> ops(opt->ops);
+	for (size_t i = 0; i < ops.size(); i++)
+	{
+		TagOp* op = &ops[i];
+		memset(op, 0, sizeof(*op));
+		bool write = opt->write && (i & 1);
+		op->type = write ? TAGOP_WRITE : TAGOP_READ;
+		op->memBank = write ? BENCH_MEMBANK_USER : BENCH_MEMBANK_EPC;
+		op->wordPtr = write ? 0 : 2;
+		op->wordCount = write ? 1 : 6;
+		op->data = write ? pattern : NULL;
+	}
+	std::vector<uint64_t> doneNs(ops.size());
+	BenchOps ctx;
+	ctx.result = r;
+	ctx.doneNs = &doneNs;
+
+	CFOpQueueSetDepth(hComm, depth);
+	Bench_Begin(r, name, 1);
+	uint64_t start = Bench_NowNs(), end = start + (uint64_t)(opt->duration * 1e9);
+	while (Bench_NowNs() < end)
+	{
+		ctx.submitNs = Bench_NowNs();
+		int status = CFOpQueueSubmit(hComm, ops.data(), ops.size(), Bench_OpCallback, &ctx, COMMON_TIMEOUT);
+		r->calls++;
+		if (status != STAT_OK)
+		{
+			Bench_Count(r, status);
+			if (status != (int)STAT_CMD_COMM_TIMEOUT)
+				break;
+		}
+		for (size_t i = 0; i < doneNs.size(); i++)
+			Bench_Sample(r, (doneNs[i] - ctx.submitNs) / 1e3);
+		if (r->firstTagMs < 0)
+		{
+			r->firstTagMs = (doneNs[0] - start) / 1e6;
+			r->steadyAllocs = g_allocs.load(std::memory_order_relaxed);
+		}
+	}
+	Bench_Steady(r);
+	Bench_End(r);
+	CFOpQueueSetDepth(hComm, OPQUEUE_DEFAULT_DEPTH);
+}
+
+static double Bench_Percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+	size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+	return sorted[i];
+}
+
+static std::string Bench_Escape(const char* s, size_t len)
+{
+	std::string out;
+	for (size_t i = 0; i < len && s[i] != '\0'; i++)
+	{
+		unsigned char c = (unsigned char)s[i];
+		if (c == '"' || c == '\\')
+			out += '\\';
+		out += c >= 0x20 && c < 0x7F ? (char)c : '?';
+	}
+	return out;
+}
+
+static void Bench_Json(FILE* out, const BenchOptions* opt, const std::vector<BenchResult>& results)
+{
+	struct utsname uts;
+	uname(&uts);
+	fprintf(out, "{\n  \"machine\": \"%s\",\n  \"kernel\": \"%s\",\n", Bench_Escape(uts.machine, sizeof(uts.machine)).c_str(),
+		Bench_Escape(uts.release, sizeof(uts.release)).c_str());
+	fprintf(out, "  \"tagcompact_code_len\": %d,\n  \"duration_s\": %.3f,\n  \"readers\": [", TagCompactCodeLen(), opt->duration);
+	for (size_t i = 0; i < opt->readers.size(); i++)
+	{
+		DeviceInfo info;
+		memset(&info, 0, sizeof(info));
+		GetInfo(opt->readers[i].hComm, &info);
+		fprintf(out, "%s\n    { \"name\": \"%s\", \"firmware\": \"%s\", \"hardware\": \"%s\" }", i ? "," : "",
+			Bench_Escape(opt->readers[i].name.c_str(), opt->readers[i].name.size()).c_str(),
+			Bench_Escape((const char*)info.firmVersion, sizeof(info.firmVersion)).c_str(),
+			Bench_Escape((const char*)info.hardVersion, sizeof(info.hardVersion)).c_str());
+	}
+	fprintf(out, "\n  ],\n  \"scenarios\": [");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult* r = &results[i];
+		std::vector<double> sorted = r->latencyUs;
+		std::sort(sorted.begin(), sorted.end());
+		double rate = r->seconds > 0 ? r->tags / r->seconds : 0;
+		fprintf(out, "%s\n    {\n      \"name\": \"%s\",\n      \"readers\": %u,\n", i ? "," : "", r->name.c_str(), r->readers);
+		fprintf(out, "      \"tags\": %llu,\n      \"calls\": %llu,\n      \"errors\": %llu,\n      \"timeouts\": %llu,\n",
+			(unsigned long long)r->tags, (unsigned long long)r->calls, (unsigned long long)r->errors, (unsigned long long)r->timeouts);
+		fprintf(out, "      \"seconds\": %.3f,\n      \"tags_per_s\": %.1f,\n      \"first_tag_ms\": %.3f,\n", r->seconds, rate, r->firstTagMs);
+		fprintf(out, "      \"latency_us\": { \"samples\": %zu, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f },\n",
+			sorted.size(), Bench_Percentile(sorted, 0.5), Bench_Percentile(sorted, 0.9), Bench_Percentile(sorted, 0.99),
+			Bench_Percentile(sorted, 0.999), sorted.empty() ? 0 : sorted.back());
+		fprintf(out, "      \"cpu_s\": %.3f,\n      \"cpu_pct\": %.1f,\n      \"cpu_us_per_tag\": %.2f,\n", r->cpuSeconds,
+			r->seconds > 0 ? 100 * r->cpuSeconds / r->seconds : 0, r->tags ? 1e6 * r->cpuSeconds / r->tags : 0);
+		if (BENCH_COUNT_ALLOCS)
+			fprintf(out, "      \"allocs\": %llu,\n      \"steady_allocs\": %llu,\n      \"allocs_per_tag\": %.4f\n    }",
+				(unsigned long long)r->allocs, (unsigned long long)r->steadyAllocs, r->tags ? (double)r->steadyAllocs / r->tags : 0);
+		else
+			fprintf(out, "      \"allocs\": null,\n      \"steady_allocs\": null,\n      \"allocs_per_tag\": null\n    }");
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+static int Bench_Open(const char* kind, const char* arg, int baud, double speed, BenchReader* reader)
+{
+	reader->name = std::string(kind) + ":" + arg;
+	reader->hComm = 0;
+	if (strcmp(kind, "hid") == 0)
+		return OpenHidConnection(&reader->hComm, (unsigned short)atoi(arg));
+	if (strcmp(kind, "serial") == 0)
+		return OpenDevice(&reader->hComm, (char*)arg, baud);
+	if (strcmp(kind, "replay") == 0)
+		return OpenReplayDevice(&reader->hComm, arg, speed);
+	std::string host(arg);
+	size_t colon = host.rfind(':');
+	if (colon == std::string::npos)
+		return STAT_CMD_PARAM_ERR;
+	unsigned short port = (unsigned short)atoi(host.c_str() + colon + 1);
+	host.resize(colon);
+	return OpenNetConnection(&reader->hComm, (char*)host.c_str(), port, BENCH_NET_TIMEOUT);
+}
+
+static void Bench_Usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s (--serial PATH | --net HOST:PORT | --hid INDEX | --replay FILE)... [--baud N] [--duration S]\n"
+		"       [--scenario poll,batch,stream,ops,ops-seq,reactor] [--ops N] [--depth D] [--write] [--output FILE]\n"
+		"       [--capture FILE] [--speed X]\n"
+		"  --write adds WriteTag of user memory word 0 (0x1234) to the ops scenarios: it changes the tags in the field\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longOptions[] = {
+		{ "serial", required_argument, NULL, 's' },
+		{ "net", required_argument, NULL, 'n' },
+		{ "hid", required_argument, NULL, 'H' },
+		{ "replay", required_argument, NULL, 'r' },
+		{ "speed", required_argument, NULL, 'x' },
+		{ "capture", required_argument, NULL, 'c' },
+		{ "baud", required_argument, NULL, 'b' },
+		{ "duration", required_argument, NULL, 'd' },
+		{ "scenario", required_argument, NULL, 'S' },
+		{ "ops", required_argument, NULL, 'o' },
+		{ "depth", required_argument, NULL, 'D' },
+		{ "write", no_argument, NULL, 'w' },
+		{ "output", required_argument, NULL, 'O' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	BenchOptions opt;
+	opt.duration = 10;
+	opt.ops = 16;
+	opt.depth = OPQUEUE_DEFAULT_DEPTH;
+	opt.write = false;
+	opt.output = NULL;
+	std::vector<std::pair<std::string, std::string> > targets;
+	std::string scenarios = "poll,batch,stream,ops,ops-seq,reactor";
+	int baud = 115200;
+	double speed = REPLAY_SPEED_MAX;
+	const char* capture = NULL;
+	int c;
+	while ((c = getopt_long(argc, argv, "s:n:H:r:x:c:b:d:S:o:D:wO:h", longOptions, NULL)) != -1)
+	{
+		switch (c)
+		{
+		case 's': targets.push_back(std::make_pair("serial", optarg)); break;
+		case 'n': targets.push_back(std::make_pair("net", optarg)); break;
+		case 'H': targets.push_back(std::make_pair("hid", optarg)); break;
+		case 'r': targets.push_back(std::make_pair("replay", optarg)); break;
+		case 'x': speed = atof(optarg); break;
+		case 'c': capture = optarg; break;
+		case 'b': baud = atoi(optarg); break;
+		case 'd': opt.duration = atof(optarg); break;
+		case 'S': scenarios = optarg; break;
+		case 'o': opt.ops = (unsigned int)atoi(optarg); break;
+		case 'D': opt.depth = (unsigned int)atoi(optarg); break;
+		case 'w': opt.write = true; break;
+		case 'O': opt.output = optarg; break;
+		default: Bench_Usage(argv[0]); return c == 'h' ? 0 : 2;
+		}
+	}
+	if (targets.empty() || opt.duration <= 0 || opt.ops == 0 || opt.depth == 0 || opt.depth > OPQUEUE_DEPTH_MAX)
+	{
+		Bench_Usage(argv[0]);
+		return 2;
+	}
+
+	for (size_t start = 0; start <= scenarios.size();)
+	{
+		size_t comma = scenarios.find(',', start);
+		if (comma == std::string::npos)
+			comma = scenarios.size();
+		if (comma > start)
+			opt.scenarios.push_back(scenarios.substr(start, comma - start));
+		start = comma + 1;
+	}
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		BenchReader reader;
+		int status = Bench_Open(targets[i].first.c_str(), targets[i].second.c_str(), baud, speed, &reader);
+		if (status != STAT_OK)
+		{
+			fprintf(stderr, "%s: open failed, status 0x%08X\n", reader.name.c_str(), (unsigned int)status);
+			return 1;
+		}
+		// receive slots and ring up front, the scenarios then measure the steady state only
+		CFHandleReserve(reader.hComm, 0, RESERVE_VIEWS | RESERVE_RING);
+		opt.readers.push_back(reader);
+	}
+	if (capture != NULL)
+	{
+		int status = CFCaptureStart(opt.readers[0].hComm, capture);
+		if (status != STAT_OK)
+		{
+			fprintf(stderr, "%s: capture failed, status 0x%08X\n", capture, (unsigned int)status);
+			return 1;
+		}
+	}
+
+	std::vector<BenchResult> results;
+	for (size_t i = 0; i < opt.scenarios.size(); i++)
+	{
+		const std::string& name = opt.scenarios[i];
+		BenchResult r;
+		if (name == "poll")
+			Bench_Poll(&opt, &r);
+		else if (name == "batch")
+			Bench_Batch(&opt, &r);
+		else if (name == "stream")
+			Bench_Stream(&opt, &r);
+		else if (name == "ops")
+			Bench_Ops(&opt, &r, "ops", opt.depth);
+		else if (name == "ops-seq")
+			Bench_Ops(&opt, &r, "ops-seq", 1);
+		else if (name == "reactor")
+			Bench_Reactor(&opt, &r);
+		else
+		{
+			fprintf(stderr, "unknown scenario %s\n", name.c_str());
+			continue;
+		}
+		fprintf(stderr, "%-8s %10llu tags %10.1f tags/s\n", r.name.c_str(), (unsigned long long)r.tags, r.seconds > 0 ? r.tags / r.seconds : 0);
+		results.push_back(r);
+	}
+
+	FILE* out = opt.output != NULL ? fopen(opt.output, "w") : stdout;
+	if (out == NULL)
+	{
+		fprintf(stderr, "%s: %s\n", opt.output, strerror(errno));
+		return 1;
+	}
+	Bench_Json(out, &opt, results);
+	if (out != stdout)
+		fclose(out);
+	if (capture != NULL && CFCaptureStop(opt.readers[0].hComm) != STAT_OK)
+		fprintf(stderr, "%s: capture incomplete\n", capture);
+	for (size_t i = 0; i < opt.readers.size(); i++)
+		CloseDeviceEx(opt.readers[i].hComm);
+	return 0;
+}
@@ -0,0 +1,307 @@
+#ifndef _CFAPI_HPP_
+#define _CFAPI_HPP_
+
+#include "CFApiEx.h"
+#include <string.h>
+#include <type_traits>
+
+//======================== Protocol-typed C++ layer over libCFApi ========================
+// Header only, C++11. Reader<Iso6C> / Reader<GB> fix the protocol byte of SelectOrSortSet,
+// QueryCfgSet and SetRFIDType at compile time, and the Select / Query / Mask parameter blocks
+// are checked by static_assert and laid out as constexpr objects, so what libCFApi would answer
+// with STAT_CMD_PARAM_ERR does not compile. The calls themselves go to libCFApi / libCFApiEx
+// unchanged and return their STAT_* codes.
+
+namespace cfapi
+{
+
+	// ISO 18000-6C (RFIDPRO 0x00).
+	struct Iso6C
+	{
+		static constexpr unsigned char proto = 0x00;
+		static constexpr bool tagAccess = true;		// ReadTag / WriteTag / LockTag / KillTag / SetSelectMask
+		static constexpr bool bank(unsigned int v) { return v <= 0x03; }			// Select MemBank: RFU EPC TID User
+		static constexpr bool target(unsigned int v) { return v <= 0x04; }			// Select Target: S0..S3, SL
+		static constexpr bool action(unsigned int v) { return v <= 0x07; }
+		static constexpr bool condition(unsigned int v) { return v <= 0x03; }		// Query Sel: All, All, ~SL, SL
+		static constexpr bool session(unsigned int v) { return v <= 0x03; }			// S0..S3
+		static constexpr bool queryTarget(unsigned int v) { return v <= 0x01; }		// A, B
+	};
+
+	// GB/T 29768 (RFIDPRO 0x01). The tag access commands of the reader are the ISO ones, a
+	// Reader<GB> has inventory only.
+	struct GB
+	{
+		static constexpr unsigned char proto = 0x01;
+		static constexpr bool tagAccess = false;
+		static constexpr bool bank(unsigned int v) { return v == 0x00 || v == 0x10 || v == 0x20 || (v & 0xF0) == 0x30; }	// Sort MemBank: tag information, coding, security, user subarea 0..15
+		static constexpr bool target(unsigned int v) { return v <= 0x04; }
+		static constexpr bool action(unsigned int v) { return v <= 0x07; }
+		static constexpr bool condition(unsigned int v) { return v <= 0x03; }
+		static constexpr bool session(unsigned int v) { return v <= 0x03; }
+		static constexpr bool queryTarget(unsigned int v) { return v <= 0x01; }
+	};
+
+	namespace detail
+	{
+		static constexpr unsigned short CMD_WRITE_TAG = 0x0004;
+		static constexpr unsigned short CMD_LOCK_TAG = 0x0005;
+		static constexpr unsigned short CMD_KILL_TAG = 0x0006;
+		static constexpr unsigned int SELECT_MASK_BITS = 8 * sizeof(((SelectSortParam*)0)->mask);
+		static constexpr unsigned int TAGOP_MASK_BITS = 8 * sizeof(((TagOp*)0)->mask);
+
+		template <unsigned char... B> struct Last { static constexpr unsigned char value = 0; };
+		template <unsigned char B> struct Last<B> { static constexpr unsigned char value = B; };
+		template <unsigned char B, unsigned char... R> struct Last<B, R...> { static constexpr unsigned char value = Last<R...>::value; };
+
+		// Mask bytes for bits mask bits: (bits + 7) / 8 of them, the bits past the end 0.
+		template <unsigned int Bits, unsigned char... Bytes>
+		struct MaskCheck
+		{
+			static_assert(sizeof...(Bytes) == (Bits + 7) / 8, "the mask needs (Bits + 7) / 8 bytes");
+			static_assert(Bits % 8 == 0 || (Last<Bytes...>::value & (0xFF >> (Bits % 8))) == 0, "the bits after Bits must be 0");
+		};
+	}
+
+	/// <summary>
+	/// Select (ISO) / Sort (GB) parameters of SelectOrSortSet, checked against the protocol P.
+	/// Bits and Ptr count bits of membank, Mask holds (Bits + 7) / 8 bytes.
+	/// </summary>
+	template <class P, unsigned char Target, unsigned char Action, unsigned char Bank, unsigned short Ptr, unsigned char Bits, unsigned char... Mask>
+	struct Select : detail::MaskCheck<Bits, Mask...>
+	{
+		static_assert(P::target(Target), "Select target out of range for the protocol");
+		static_assert(P::action(Action), "Select action out of range for the protocol");
+		static_assert(P::bank(Bank), "Select membank out of range for the protocol");
+		static_assert(Bits <= detail::SELECT_MASK_BITS, "Select mask longer than SelectSortParam.mask");
+		typedef P protocol;
+		static constexpr SelectSortParam param = { Target, 0x00, Action, Bank, Ptr, Bits, { Mask... } };
+	};
+	template <class P, unsigned char Target, unsigned char Action, unsigned char Bank, unsigned short Ptr, unsigned char Bits, unsigned char... Mask>
+	constexpr SelectSortParam Select<P, Target, Action, Bank, Ptr, Bits, Mask...>::param;
+
+	/// <summary>
+	/// Query parameters of QueryCfgSet, checked against the protocol P.
+	/// </summary>
+	template <class P, unsigned char Condition, unsigned char Session, unsigned char Target>
+	struct Query
+	{
+		static_assert(P::condition(Condition), "Query condition (Sel) out of range for the protocol");
+		static_assert(P::session(Session), "Query session out of range for the protocol");
+		static_assert(P::queryTarget(Target), "Query target out of range for the protocol");
+		typedef P protocol;
+		static constexpr QueryParam param = { Condition, Session, Target };
+	};
+	template <class P, unsigned char Condition, unsigned char Session, unsigned char Target>
+	constexpr QueryParam Query<P, Condition, Session, Target>::param;
+
+	/// <summary>
+	/// SetSelectMask of the ISO access commands (EPC bank, Ptr and Bits in bits). NoMask leaves the
+	/// tag to whichever answers.
+	/// </summary>
+	template <unsigned short Ptr, unsigned char Bits, unsigned char... Bytes>
+	struct Mask : detail::MaskCheck<Bits, Bytes...>
+	{
+		static_assert(Bits > 0, "an empty mask is NoMask");
+		static_assert(Bits <= detail::TAGOP_MASK_BITS, "mask longer than TagOp.mask");
+		static constexpr unsigned char option = 0x01;
+		static constexpr unsigned short ptr = Ptr;
+		static constexpr unsigned char bits = Bits;
+		static constexpr unsigned char bytes[sizeof...(Bytes)] = { Bytes... };
+
+		static int set(int64_t hComm)
+		{
+			unsigned char mask[sizeof...(Bytes)] = { Bytes... };
+			return SetSelectMask(hComm, Ptr, Bits, mask);
+		}
+		// CFOpQueueSubmit sends it in front of the operation.
+		static void apply(TagOp* op)
+		{
+			op->option = option;
+			op->maskPtr = Ptr;
+			op->maskBits = Bits;
+			memcpy(op->mask, bytes, sizeof(bytes));
+		}
+	};
+	template <unsigned short Ptr, unsigned char Bits, unsigned char... Bytes>
+	constexpr unsigned char Mask<Ptr, Bits, Bytes...>::bytes[sizeof...(Bytes)];
+
+	struct NoMask
+	{
+		static constexpr unsigned char option = 0x00;
+		static int set(int64_t /*hComm*/) { return STAT_OK; }
+		static void apply(TagOp* op)
+		{
+			op->option = option;
+			op->maskBits = 0;
+		}
+	};
+
+	/// <summary>
+	/// One connection opened by the caller (OpenDevice, OpenDeviceEx, CFPoolAcquire ...), typed by
+	/// the protocol the reader runs. It does not own the handle.
+	/// </summary>
+	template <class P>
+	class Reader
+	{
+	public:
+		typedef P protocol;
+
+		explicit Reader(int64_t hComm) : m_hComm(hComm) {}
+
+		int64_t handle() const { return m_hComm; }
+
+		/// <summary>
+		/// Switch the reader to P (SetRFIDType)
+		/// </summary>
+		int setProtocol() { return SetRFIDType(m_hComm, P::proto); }
+
+		/// <summary>
+		/// SelectOrSortSet with a Select of the same protocol
+		/// </summary>
+		template <class S>
+		int select()
+		{
+			static_assert(std::is_same<typename S::protocol, P>::value, "Select of another protocol");
+			SelectSortParam param = S::param;
+			return SelectOrSortSet(m_hComm, P::proto, &param);
+		}
+
+		/// <summary>
+		/// QueryCfgSet with a Query of the same protocol
+		/// </summary>
+		template <class Q>
+		int query()
+		{
+			static_assert(std::is_same<typename Q::protocol, P>::value, "Query of another protocol");
+			QueryParam param = Q::param;
+			return QueryCfgSet(m_hComm, P::proto, &param);
+		}
+
+		int inventoryStart(unsigned char count = 0, unsigned long param = 0) { return InventoryContinueEx(m_hComm, count, param); }
+		int inventoryStop(unsigned short timeout = 1000) { return InventoryStop(m_hComm, timeout); }
+		int getTag(TagInfo* tag, unsigned short timeout) { return GetTagUii(m_hComm, tag, timeout); }
+		int getTags(TagInfo* out, size_t capacity, size_t* count, unsigned short timeout) { return GetTagUiiBatch(m_hComm, out, capacity, count, timeout); }
+		int getTags(TagInfoCompact* out, size_t capacity, size_t* count, TagCodeArena* arena, unsigned short timeout) { return GetTagUiiBatchCompact(m_hComm, out, capacity, count, arena, timeout); }
+
+		/// <summary>
+		/// ReadTag + GetReadTagResp of Words words at WordPtr of Bank, the tag picked by M
+		/// </summary>
+		/// <param name="data">2 * Words bytes</param>
+		template <unsigned char Bank, unsigned short WordPtr, unsigned char Words, class M = NoMask>
+		int read(unsigned char* accPwd, TagResp* resp, unsigned char* data, unsigned short timeout = DEF_READ_TIMEOUT)
+		{
+			static_assert(P::tagAccess, "the reader has no tag access commands for this protocol");
+			static_assert(Bank <= 0x03, "ReadTag membank: 0 reserved, 1 EPC, 2 TID, 3 user");
+			static_assert(Words >= 1 && Words <= 120, "ReadTag reads 1..120 words");
+			int status = M::set(m_hComm);
+			if (status == STAT_OK)
+				status = ReadTag(m_hComm, M::option, accPwd, Bank, WordPtr, Words);
+			unsigned char wordCount = 0;
+			if (status == STAT_OK)
+				status = GetReadTagResp(m_hComm, resp, &wordCount, data, timeout);
+			return status;
+		}
+
+		/// <summary>
+		/// WriteTag of Words words at WordPtr of Bank, the tag picked by M
+		/// </summary>
+		/// <param name="data">2 * Words bytes</param>
+		template <unsigned char Bank, unsigned short WordPtr, unsigned char Words, class M = NoMask>
+		int write(unsigned char* accPwd, unsigned char* data, TagResp* resp, unsigned short timeout = DEF_WRITE_TIMEOUT)
+		{
+			static_assert(P::tagAccess, "the reader has no tag access commands for this protocol");
+			static_assert(Bank <= 0x03, "WriteTag membank: 0 reserved, 1 EPC, 2 TID, 3 user");
+			static_assert(Words >= 1 && Words <= 120, "WriteTag writes 1..120 words");
+			int status = M::set(m_hComm);
+			if (status == STAT_OK)
+				status = WriteTag(m_hComm, M::option, accPwd, Bank, WordPtr, Words, data);
+			if (status == STAT_OK)
+				status = GetTagResp(m_hComm, detail::CMD_WRITE_TAG, resp, timeout);
+			return status;
+		}
+
+		/// <summary>
+		/// LockTag of Area (0 kill password, 1 access password, 2 EPC, 3 TID, 4 user) with Action
+		/// (0 unlock, 1 lock, 2 permanent unlock, 3 permanent lock)
+		/// </summary>
+		template <unsigned char Area, unsigned char Action, class M = NoMask>
+		int lock(unsigned char* accPwd, TagResp* resp, unsigned short timeout = DEF_WRITE_TIMEOUT)
+		{
+			static_assert(P::tagAccess, "the reader has no tag access commands for this protocol");
+			static_assert(Area <= 0x04, "LockTag erea: 0..4");
+			static_assert(Action <= 0x03, "LockTag action: 0..3");
+			int status = M::set(m_hComm);
+			if (status == STAT_OK)
+				status = LockTag(m_hComm, accPwd, Area, Action);
+			if (status == STAT_OK)
+				status = GetTagResp(m_hComm, detail::CMD_LOCK_TAG, resp, timeout);
+			return status;
+		}
+
+		template <class M = NoMask>
+		int kill(unsigned char* killPwd, TagResp* resp, unsigned short timeout = DEF_WRITE_TIMEOUT)
+		{
+			static_assert(P::tagAccess, "the reader has no tag access commands for this protocol");
+			int status = M::set(m_hComm);
+			if (status == STAT_OK)
+				status = KillTag(m_hComm, killPwd);
+			if (status == STAT_OK)
+				status = GetTagResp(m_hComm, detail::CMD_KILL_TAG, resp, timeout);
+			return status;
+		}
+
+		/// <summary>
+		/// CFOpQueueSubmit of operations built with op()
+		/// </summary>
+		int submit(const TagOp* ops, size_t n, TagOpCallback callback, void* userCtx, unsigned short timeout = DEF_WRITE_TIMEOUT)
+		{
+			static_assert(P::tagAccess, "the reader has no tag access commands for this protocol");
+			return CFOpQueueSubmit(m_hComm, ops, n, callback, userCtx, timeout);
+		}
+
+	private:
+		int64_t m_hComm;
+	};
+
+	/// <summary>
+	/// TagOp of CFOpQueueSubmit with the checks of Reader::read / write / lock; data is the write
+	/// payload (2 * Words bytes) of TAGOP_WRITE.
+	/// </summary>
+	template <unsigned char Type, unsigned char Bank, unsigned short WordPtr, unsigned char Words, class M = NoMask>
+	inline TagOp op(const unsigned char* accPwd, unsigned char* data = NULL, void* opCtx = NULL)
+	{
+		static_assert(Type == TAGOP_READ || Type == TAGOP_WRITE, "op<> builds TAGOP_READ / TAGOP_WRITE, lockOp<> TAGOP_LOCK");
+		static_assert(Bank <= 0x03, "membank: 0 reserved, 1 EPC, 2 TID, 3 user");
+		static_assert(Words >= 1 && Words <= 120, "1..120 words");
+		TagOp op;
+		memset(&op, 0, sizeof(op));
+		op.type = Type;
+		memcpy(op.accPwd, accPwd, 4);
+		op.memBank = Bank;
+		op.wordPtr = WordPtr;
+		op.wordCount = Words;
+		op.data = data;
+		op.opCtx = opCtx;
+		M::apply(&op);
+		return op;
+	}
+
+	template <unsigned char Area, unsigned char Action, class M = NoMask>
+	inline TagOp lockOp(const unsigned char* accPwd, void* opCtx = NULL)
+	{
+		static_assert(Area <= 0x04, "LockTag erea: 0..4");
+		static_assert(Action <= 0x03, "LockTag action: 0..3");
+		TagOp op;
+		memset(&op, 0, sizeof(op));
+		op.type = TAGOP_LOCK;
+		memcpy(op.accPwd, accPwd, 4);
+		op.memBank = Area;
+		op.action = Action;
+		op.opCtx = opCtx;
+		M::apply(&op);
+		return op;
+	}
+}
+
+#endif
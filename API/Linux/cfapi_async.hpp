@@ -0,0 +1,309 @@
+#ifndef _CFAPI_ASYNC_HPP_
+#define _CFAPI_ASYNC_HPP_
+
+#include "cfapi.hpp"
+
+#if __cplusplus < 202002L
+#error "cfapi_async.hpp needs C++20 coroutines, cfapi.hpp is the C++11 layer"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stop_token>
+#include <vector>
+
+//======================== Coroutine layer over CFAsync ========================
+// Header only, C++20. A Loop owns a CFAsync; AsyncReader<P> returns awaitables for inventory
+// batches, tag access and gate events that are submitted when awaited and resume the coroutine
+// from the callback in CFAsyncPoll, on the thread that runs the loop. Results carry the STAT_*
+// code of the operation; a std::stop_token cancels it (CFAsyncCancel, InventoryStop for an
+// inventory) and must be triggered on the thread of the loop as well.
+
+namespace cfapi
+{
+
+	/// <summary>
+	/// CFAsync with a count of the awaitables in it, run() returns once none is left.
+	/// </summary>
+	class Loop
+	{
+	public:
+		Loop() : m_async(CFAsyncCreate()), m_pending(0), m_running(false) {}
+		~Loop() { CFAsyncDestroy(m_async); }
+		Loop(const Loop&) = delete;
+		Loop& operator=(const Loop&) = delete;
+
+		/// <summary>
+		/// NULL when CFAsyncCreate failed
+		/// </summary>
+		CFAsync* get() const { return m_async; }
+		size_t pending() const { return m_pending; }
+
+		int add(int64_t hComm) { return CFAsyncAdd(m_async, hComm); }
+		int remove(int64_t hComm) { return CFAsyncRemove(m_async, hComm); }
+		int poll(int timeout) { return CFAsyncPoll(m_async, timeout); }
+
+		/// <summary>
+		/// CFAsyncRun until the last awaitable completed or stop()
+		/// </summary>
+		int run()
+		{
+			if (m_pending == 0)
+				return STAT_OK;
+			m_running = true;
+			int status = CFAsyncRun(m_async);
+			m_running = false;
+			return status;
+		}
+
+		int stop() { return CFAsyncStop(m_async); }
+
+	private:
+		template <class D, class R> friend class AsyncAwaiter;
+
+		void started() { m_pending++; }
+		void finished()
+		{
+			if (--m_pending == 0 && m_running)
+				CFAsyncStop(m_async);
+		}
+
+		CFAsync* m_async;
+		size_t m_pending;
+		bool m_running;
+	};
+
+	/// <summary>
+	/// Coroutine started right away and never awaited, its frame goes once it returns.
+	/// </summary>
+	struct Task
+	{
+		struct promise_type
+		{
+			Task get_return_object() { return Task(); }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	struct InventoryResult
+	{
+		int status;						// STAT_OK also when the timeout ended it with tags
+		std::vector<TagInfo> tags;
+		unsigned int dropped;			// labels past max
+	};
+
+	// Tag access result, code and data copied out of the response.
+	struct AccessResult
+	{
+		int status;
+		TagOpResult resp;				// code / data pointers cleared
+		std::vector<unsigned char> code;
+		std::vector<unsigned char> data;	// TAGOP_READ
+	};
+
+	struct GateResult
+	{
+		int status;
+		GateParam gate;
+	};
+
+	/// <summary>
+	/// Awaitable of one AsyncOp: D fills m_op before the submit and makes R of the AsyncResult.
+	/// </summary>
+	template <class D, class R>
+	class AsyncAwaiter
+	{
+	public:
+		AsyncAwaiter(Loop& loop, int64_t hComm, std::stop_token stop)
+			: m_loop(&loop), m_hComm(hComm), m_stop(stop), m_id(0)
+		{
+			memset(&m_op, 0, sizeof(m_op));
+		}
+		AsyncAwaiter(const AsyncAwaiter&) = delete;
+		AsyncAwaiter& operator=(const AsyncAwaiter&) = delete;
+
+		bool await_ready() const { return false; }
+
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			m_handle = handle;
+			int status = CFAsyncSubmit(m_loop->get(), m_hComm, &m_op, &AsyncAwaiter::OnDone, this, &m_id);
+			if (status != STAT_OK)
+			{
+				// refused: no callback comes, the coroutine goes on with the status
+				m_result.status = status;
+				return false;
+			}
+			m_loop->started();
+			if (m_stop.stop_possible())
+				m_cancel.emplace(m_stop, Cancel{ m_loop->get(), m_id });
+			return true;
+		}
+
+		R await_resume() { return std::move(m_result); }
+
+	protected:
+		AsyncOp m_op;
+		R m_result{};
+
+	private:
+		struct Cancel
+		{
+			CFAsync* async;
+			uint64_t id;
+			void operator()() const { CFAsyncCancel(async, id); }
+		};
+
+		static void OnDone(CFAsync*, int64_t, const AsyncOp*, const AsyncResult* result, void* userCtx)
+		{
+			AsyncAwaiter* self = static_cast<AsyncAwaiter*>(userCtx);
+			Loop* loop = self->m_loop;
+			self->m_cancel.reset();
+			static_cast<D*>(self)->complete(result);
+			// counted down after the coroutine could submit its next operation, the awaiter may be gone
+			self->m_handle.resume();
+			loop->finished();
+		}
+
+		Loop* m_loop;
+		int64_t m_hComm;
+		std::stop_token m_stop;
+		std::optional<std::stop_callback<Cancel>> m_cancel;
+		std::coroutine_handle<> m_handle;
+		uint64_t m_id;
+	};
+
+	class InventoryAwaiter : public AsyncAwaiter<InventoryAwaiter, InventoryResult>
+	{
+	public:
+		InventoryAwaiter(Loop& loop, int64_t hComm, size_t max, unsigned int timeout, unsigned char cycles, std::stop_token stop)
+			: AsyncAwaiter(loop, hComm, stop)
+		{
+			m_result.tags.resize(max);
+			m_op.type = ASYNC_INVENTORY;
+			m_op.cycles = cycles;
+			m_op.timeout = timeout;
+			m_op.tags = m_result.tags.data();
+			m_op.capacity = max;
+		}
+
+		void complete(const AsyncResult* result)
+		{
+			m_result.status = result->status;
+			m_result.tags.resize(result->count);
+			m_result.dropped = result->dropped;
+		}
+	};
+
+	class AccessAwaiter : public AsyncAwaiter<AccessAwaiter, AccessResult>
+	{
+	public:
+		AccessAwaiter(Loop& loop, int64_t hComm, const TagOp& op, const unsigned char* data, unsigned int timeout, std::stop_token stop)
+			: AsyncAwaiter(loop, hComm, stop), m_tagOp(op)
+		{
+			if (data != NULL)
+			{
+				// the frame may go out after the caller's buffer is gone
+				m_data.assign(data, data + 2 * op.wordCount);
+				m_tagOp.data = m_data.data();
+			}
+			m_op.type = ASYNC_TAGOP;
+			m_op.timeout = timeout;
+			m_op.tagOp = &m_tagOp;
+		}
+
+		void complete(const AsyncResult* result)
+		{
+			const TagOpResult& resp = result->tagOp;
+			m_result.status = result->status;
+			m_result.resp = resp;
+			m_result.resp.code = NULL;
+			m_result.resp.data = NULL;
+			if (resp.code != NULL)
+				m_result.code.assign(resp.code, resp.code + resp.codeLen);
+			if (resp.data != NULL)
+				m_result.data.assign(resp.data, resp.data + 2 * resp.wordCount);
+		}
+
+	private:
+		TagOp m_tagOp;
+		std::vector<unsigned char> m_data;
+	};
+
+	class GateAwaiter : public AsyncAwaiter<GateAwaiter, GateResult>
+	{
+	public:
+		GateAwaiter(Loop& loop, int64_t hComm, unsigned int timeout, std::stop_token stop)
+			: AsyncAwaiter(loop, hComm, stop)
+		{
+			m_op.type = ASYNC_GATE;
+			m_op.timeout = timeout;
+		}
+
+		void complete(const AsyncResult* result)
+		{
+			m_result.status = result->status;
+			m_result.gate = result->gate;
+		}
+	};
+
+	/// <summary>
+	/// Reader<P> of a connection added to loop (CFAsyncAdd), with awaitable operations. The
+	/// synchronous calls of Reader<P> must not be used while the connection is in the loop.
+	/// </summary>
+	template <class P>
+	class AsyncReader : public Reader<P>
+	{
+	public:
+		AsyncReader(Loop& loop, int64_t hComm) : Reader<P>(hComm), m_loop(&loop) {}
+
+		/// <summary>
+		/// Inventory until max tags, timeout ms (0 until stopped) or cycles rounds (0: by time)
+		/// </summary>
+		InventoryAwaiter inventoryBatch(size_t max, unsigned int timeout, unsigned char cycles = 0, std::stop_token stop = {})
+		{
+			return InventoryAwaiter(*m_loop, this->handle(), max, timeout, cycles, stop);
+		}
+
+		template <unsigned char Bank, unsigned short WordPtr, unsigned char Words, class M = NoMask>
+		AccessAwaiter read(const unsigned char* accPwd, unsigned int timeout = DEF_READ_TIMEOUT, std::stop_token stop = {})
+		{
+			static_assert(P::tagAccess, "the reader has no tag access commands for this protocol");
+			return AccessAwaiter(*m_loop, this->handle(), op<TAGOP_READ, Bank, WordPtr, Words, M>(accPwd), NULL, timeout, stop);
+		}
+
+		/// <summary>
+		/// WriteTag of data (2 * Words bytes, copied)
+		/// </summary>
+		template <unsigned char Bank, unsigned short WordPtr, unsigned char Words, class M = NoMask>
+		AccessAwaiter write(const unsigned char* accPwd, const unsigned char* data, unsigned int timeout = DEF_WRITE_TIMEOUT, std::stop_token stop = {})
+		{
+			static_assert(P::tagAccess, "the reader has no tag access commands for this protocol");
+			return AccessAwaiter(*m_loop, this->handle(), op<TAGOP_WRITE, Bank, WordPtr, Words, M>(accPwd), data, timeout, stop);
+		}
+
+		template <unsigned char Area, unsigned char Action, class M = NoMask>
+		AccessAwaiter lock(const unsigned char* accPwd, unsigned int timeout = DEF_WRITE_TIMEOUT, std::stop_token stop = {})
+		{
+			static_assert(P::tagAccess, "the reader has no tag access commands for this protocol");
+			return AccessAwaiter(*m_loop, this->handle(), lockOp<Area, Action, M>(accPwd), NULL, timeout, stop);
+		}
+
+		/// <summary>
+		/// Next gate frame (GetGateStatus), timeout ms, 0 waits until stopped
+		/// </summary>
+		GateAwaiter gateEvent(unsigned int timeout, std::stop_token stop = {})
+		{
+			return GateAwaiter(*m_loop, this->handle(), timeout, stop);
+		}
+
+	private:
+		Loop* m_loop;
+	};
+}
+
+#endif
@@ -0,0 +1,284 @@
+// _cf591: native fast path of chafon_cf591.py for the inventory calls.
+// Tags come back as tuples built in C (the fields of chafon_cf591.Tag, in order), or as a
+// TagBatch whose buffer holds the TagInfoCompact records (numpy.asarray(batch) gives a
+// structured array). The GIL is released while the reader is waited on.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "CFApiEx.h"
+
+#define NATIVE_ARENA_PER_TAG				32		// overflow bytes per label reserved in a TagBatch
+
+static char g_recordFormat[256];
+
+typedef struct
+{
+	PyObject_HEAD
+	TagInfoCompact* tags;
+	Py_ssize_t count;
+	unsigned char* arena;
+	unsigned short arenaUsed;
+}TagBatchObject;
+
+static PyObject* Native_Hex(const unsigned char* code, size_t len)
+{
+	char hex[2 * 255 + 1];
+	size_t n = TagCodeToHex(code, len, hex, sizeof(hex));
+	return PyUnicode_FromStringAndSize(hex, (Py_ssize_t)n);
+}
+
+// (epc, epc_bytes, rssi, antenna, channel, crc, pc, length, sequence)
+static PyObject* Native_TagTuple(const unsigned char* code, unsigned char codeLen, short rssi, unsigned char antenna,
+	unsigned char channel, const unsigned char* crc, const unsigned char* pc, unsigned int sequence)
+{
+	PyObject* epc = Native_Hex(code, codeLen);
+	PyObject* crcHex = Native_Hex(crc, 2);
+	PyObject* pcHex = Native_Hex(pc, 2);
+	if (epc == NULL || crcHex == NULL || pcHex == NULL)
+	{
+		Py_XDECREF(epc);
+		Py_XDECREF(crcHex);
+		Py_XDECREF(pcHex);
+		return NULL;
+	}
+	return Py_BuildValue("(Ny#dBBNNBI)", epc, (const char*)code, (Py_ssize_t)codeLen, rssi / 10.0,
+		antenna, channel, crcHex, pcHex, codeLen, sequence);
+}
+
+static void TagBatch_Dealloc(TagBatchObject* self)
+{
+	PyMem_Free(self->tags);
+	PyMem_Free(self->arena);
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static Py_ssize_t TagBatch_Length(TagBatchObject* self)
+{
+	return self->count;
+}
+
+static PyObject* TagBatch_Item(TagBatchObject* self, Py_ssize_t i)
+{
+	if (i < 0 || i >= self->count)
+	{
+		PyErr_SetString(PyExc_IndexError, "TagBatch index out of range");
+		return NULL;
+	}
+	const TagInfoCompact* tag = &self->tags[i];
+	TagCodeArena arena = { self->arena, self->arenaUsed, self->arenaUsed };
+	return Native_TagTuple(TagCompactCode(tag, &arena), tag->codeLen, tag->rssi, tag->antenna, tag->channel,
+		tag->crc, tag->pc, 0);
+}
+
+static int TagBatch_GetBuffer(TagBatchObject* self, Py_buffer* view, int flags)
+{
+	view->obj = (PyObject*)self;
+	Py_INCREF(self);
+	view->buf = self->tags;
+	view->len = self->count * (Py_ssize_t)sizeof(TagInfoCompact);
+	view->readonly = 1;
+	view->itemsize = sizeof(TagInfoCompact);
+	view->format = (flags & PyBUF_FORMAT) ? g_recordFormat : NULL;
+	view->ndim = 1;
+	view->shape = (flags & PyBUF_ND) ? &self->count : NULL;
+	view->strides = (flags & PyBUF_STRIDES) ? &view->itemsize : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+static PyObject* TagBatch_Arena(TagBatchObject* self, void* closure)
+{
+	return PyBytes_FromStringAndSize((const char*)self->arena, self->arenaUsed);
+}
+
+static PySequenceMethods g_batchSequence = {
+	(lenfunc)TagBatch_Length,
+	0, 0,
+	(ssizeargfunc)TagBatch_Item,
+};
+
+static PyBufferProcs g_batchBuffer = {
+	(getbufferproc)TagBatch_GetBuffer,
+	NULL,
+};
+
+static PyGetSetDef g_batchGetSet[] = {
+	{ (char*)"arena", (getter)TagBatch_Arena, NULL, (char*)"overflow bytes of codes longer than the inline slot (arenaOff)", NULL },
+	{ NULL }
+};
+
+static PyTypeObject g_batchType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+// Overflow bytes of a TagBatch of capacity labels: at least one full code, so a long EPC in a small
+// batch is not cut to the inline slot.
+static size_t Native_ArenaSize(size_t capacity)
+{
+	size_t size = capacity * NATIVE_ARENA_PER_TAG;
+	return size < 255 ? 255 : size;
+}
+
+static TagBatchObject* TagBatch_New(size_t capacity)
+{
+	TagBatchObject* batch = PyObject_New(TagBatchObject, &g_batchType);
+	if (batch == NULL)
+		return NULL;
+	batch->count = 0;
+	batch->arenaUsed = 0;
+	batch->tags = (TagInfoCompact*)PyMem_Malloc((capacity ? capacity : 1) * sizeof(TagInfoCompact));
+	batch->arena = (unsigned char*)PyMem_Malloc(Native_ArenaSize(capacity) + 1);
+	if (batch->tags == NULL || batch->arena == NULL)
+	{
+		Py_DECREF(batch);
+		PyErr_NoMemory();
+		return NULL;
+	}
+	return batch;
+}
+
+static size_t Native_Capacity(Py_ssize_t maxCount)
+{
+	if (maxCount < 1)
+		maxCount = 1;
+	// arena offsets are 16 bit
+	if (maxCount > 0xFFFF / NATIVE_ARENA_PER_TAG)
+		maxCount = 0xFFFF / NATIVE_ARENA_PER_TAG;
+	return (size_t)maxCount;
+}
+
+static PyObject* Native_GetTag(PyObject* module, PyObject* args)
+{
+	long long hComm;
+	unsigned short timeout;
+	if (!PyArg_ParseTuple(args, "LH", &hComm, &timeout))
+		return NULL;
+
+	// a batch of one waits for its turn on the link, a bare GetTagUii would cut into a command of another thread
+	TagInfo tag;
+	size_t count;
+	int status;
+	Py_BEGIN_ALLOW_THREADS
+	status = GetTagUiiBatch(hComm, &tag, 1, &count, timeout);
+	Py_END_ALLOW_THREADS
+	if (status != STAT_OK)
+		return Py_BuildValue("(iO)", status, Py_None);
+	return Py_BuildValue("(iN)", status, Native_TagTuple(tag.code, tag.codeLen, tag.rssi, tag.antenna, tag.channel,
+		tag.crc, tag.pc, tag.NO));
+}
+
+static PyObject* Native_GetTags(PyObject* module, PyObject* args)
+{
+	long long hComm;
+	Py_ssize_t maxCount;
+	unsigned short timeout;
+	if (!PyArg_ParseTuple(args, "LnH", &hComm, &maxCount, &timeout))
+		return NULL;
+
+	size_t capacity = Native_Capacity(maxCount);
+	TagBatchObject* batch = TagBatch_New(capacity);
+	if (batch == NULL)
+		return NULL;
+	TagCodeArena arena = { batch->arena, (unsigned short)Native_ArenaSize(capacity), 0 };
+	size_t count = 0;
+	int status;
+	Py_BEGIN_ALLOW_THREADS
+	status = GetTagUiiBatchCompact(hComm, batch->tags, capacity, &count, &arena, timeout);
+	Py_END_ALLOW_THREADS
+	// STAT_CMD_BUF_OVERFLOW still hands out the one label, truncated to the inline slot
+	batch->count = status == STAT_OK || status == (int)STAT_CMD_BUF_OVERFLOW ? (Py_ssize_t)count : 0;
+	batch->arenaUsed = arena.used;
+	return Py_BuildValue("(iN)", status, (PyObject*)batch);
+}
+
+static PyObject* Native_RingPop(PyObject* module, PyObject* args)
+{
+	long long hComm;
+	Py_ssize_t maxCount;
+	unsigned short timeout;
+	if (!PyArg_ParseTuple(args, "LnH", &hComm, &maxCount, &timeout))
+		return NULL;
+
+	size_t capacity = Native_Capacity(maxCount);
+	TagBatchObject* batch = TagBatch_New(capacity);
+	if (batch == NULL)
+		return NULL;
+	size_t count = 0;
+	int status;
+	Py_BEGIN_ALLOW_THREADS
+	status = TagRingPop(hComm, batch->tags, capacity, &count, timeout);
+	Py_END_ALLOW_THREADS
+	batch->count = status == STAT_OK ? (Py_ssize_t)count : 0;
+	return Py_BuildValue("(iN)", status, (PyObject*)batch);
+}
+
+static PyObject* Native_CodeToHex(PyObject* module, PyObject* args)
+{
+	Py_buffer code;
+	if (!PyArg_ParseTuple(args, "y*", &code))
+		return NULL;
+	PyObject* hex = NULL;
+	char* out = (char*)PyMem_Malloc(2 * code.len + 1);
+	if (out == NULL)
+		PyErr_NoMemory();
+	else
+	{
+		size_t n = TagCodeToHex((const unsigned char*)code.buf, code.len, out, 2 * code.len + 1);
+		hex = PyUnicode_FromStringAndSize(out, (Py_ssize_t)n);
+		PyMem_Free(out);
+	}
+	PyBuffer_Release(&code);
+	return hex;
+}
+
+static PyMethodDef g_methods[] = {
+	{ "get_tag", Native_GetTag, METH_VARARGS,
+		"get_tag(handle, timeout) -> (status, tag tuple or None)\nGetTagUiiBatch of one label without the GIL." },
+	{ "get_tags", Native_GetTags, METH_VARARGS,
+		"get_tags(handle, max_count, timeout) -> (status, TagBatch)\nGetTagUiiBatchCompact without the GIL." },
+	{ "ring_pop", Native_RingPop, METH_VARARGS,
+		"ring_pop(handle, max_count, timeout) -> (status, TagBatch)\nTagRingPop without the GIL." },
+	{ "code_to_hex", Native_CodeToHex, METH_VARARGS,
+		"code_to_hex(code) -> str\nUpper-case hex of a code (TagCodeToHex)." },
+	{ NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef g_module = {
+	PyModuleDef_HEAD_INIT, "_cf591", "Native fast path of chafon_cf591 (libCFApiEx)", -1, g_methods
+};
+
+PyMODINIT_FUNC PyInit__cf591(void)
+{
+	// the records are only readable with the slot length libCFApiEx was built with
+	if (TagCompactCodeLen() != TAGCOMPACT_CODE_LEN)
+	{
+		PyErr_SetString(PyExc_ImportError, "_cf591 was built with a different TAGCOMPACT_CODE_LEN than libCFApiEx");
+		return NULL;
+	}
+	int pad = (int)sizeof(TagInfoCompact) - (7 + TAGCOMPACT_CODE_LEN);
+	snprintf(g_recordFormat, sizeof(g_recordFormat),
+		"T{=h:rssi:H:arenaOff:B:antenna:B:channel:B:codeLen:(2)B:pc:(2)B:crc:(%d)B:code:%s}",
+		TAGCOMPACT_CODE_LEN, pad > 0 ? "x" : "");
+
+	g_batchType.tp_name = "_cf591.TagBatch";
+	g_batchType.tp_basicsize = sizeof(TagBatchObject);
+	g_batchType.tp_dealloc = (destructor)TagBatch_Dealloc;
+	g_batchType.tp_as_sequence = &g_batchSequence;
+	g_batchType.tp_as_buffer = &g_batchBuffer;
+	g_batchType.tp_getset = g_batchGetSet;
+	g_batchType.tp_flags = Py_TPFLAGS_DEFAULT;
+	g_batchType.tp_doc = "Labels of one call: a sequence of tag tuples and a buffer of TagInfoCompact records";
+	if (PyType_Ready(&g_batchType) < 0)
+		return NULL;
+
+	PyObject* module = PyModule_Create(&g_module);
+	if (module == NULL)
+		return NULL;
+	Py_INCREF(&g_batchType);
+	if (PyModule_AddObject(module, "TagBatch", (PyObject*)&g_batchType) < 0)
+	{
+		Py_DECREF(&g_batchType);
+		Py_DECREF(module);
+		return NULL;
+	}
+	PyModule_AddIntConstant(module, "TAGCOMPACT_CODE_LEN", TAGCOMPACT_CODE_LEN);
+	return module;
+}
@@ -0,0 +1,333 @@
+#include "CFHandle.h"
+
+#define ANTSCHED_DEDUP_ENTRIES				4096	// tags remembered for new-tag counting
+
+struct CFAntSched
+{
+	AntSchedConfig config;
+	pthread_mutex_t lock;			// stats, policy and running
+	bool running;					// the worker runs on hComm
+	int policy;
+	AntSchedPolicy custom;
+	void* policyCtx;
+	AntPortStats ports[ANTSCHED_PORTS];
+	int64_t hComm;
+	bool started;					// hComm is set
+	TagStreamCallback callback;
+	void* userCtx;
+	TagDedup* seen;					// new-tag detection across all ports
+	unsigned int dwellNew;			// new tags of the running dwell
+	unsigned char savedMask;		// GetAntenna at start, restored at the end
+};
+
+static void Sched_Defaults(AntSchedConfig* c)
+{
+	if (c->antennaMask == 0)
+		c->antennaMask = 0xFF;
+	if (c->ewmaPercent == 0 || c->ewmaPercent > 100)
+		c->ewmaPercent = 30;
+	if (c->triggerGpi == 0)
+		c->triggerGpi = 0x01;
+	if (c->cycleMs == 0)
+		c->cycleMs = 1000;
+	if (c->minDwellMs == 0)
+		c->minDwellMs = 50;
+	if (c->maxDwellMs == 0)
+		c->maxDwellMs = c->cycleMs;
+	if (c->newTagWindowMs == 0)
+		c->newTagWindowMs = 5000;
+	if (c->triggerHoldMs == 0)
+		c->triggerHoldMs = 2000;
+}
+
+static void Sched_OnSighting(const TagSighting* sighting, void* userCtx)
+{
+	if (sighting->event == DEDUP_ARRIVE)
+		((CFAntSched*)userCtx)->dwellNew++;
+}
+
+// Dwell of every scheduled port for the cycle that starts. Works on a copy of the stats so a
+// custom policy may call back into the scheduler.
+static void Sched_Plan(CFAntSched* s, unsigned int* dwell)
+{
+	const AntSchedConfig& c = s->config;
+	AntPortStats ports[ANTSCHED_PORTS];
+	pthread_mutex_lock(&s->lock);
+	int policy = s->policy;
+	AntSchedPolicy custom = s->custom;
+	void* policyCtx = s->policyCtx;
+	memcpy(ports, s->ports, sizeof(ports));
+	pthread_mutex_unlock(&s->lock);
+
+	int count = 0;
+	float total = 0;
+	float weight[ANTSCHED_PORTS];
+	for (int i = 0; i < ANTSCHED_PORTS; i++)
+	{
+		weight[i] = 0;
+		if (!(c.antennaMask & (1 << i)))
+			continue;
+		count++;
+		// new tags decide, reads break ties, the constant keeps quiet ports probed
+		weight[i] = ports[i].newRate + ports[i].readRate / 10 + 1;
+		total += weight[i];
+	}
+
+	for (int i = 0; i < ANTSCHED_PORTS; i++)
+	{
+		dwell[i] = 0;
+		if (!(c.antennaMask & (1 << i)))
+			continue;
+		unsigned int ms;
+		if (policy == ANTSCHED_CUSTOM)
+		{
+			ms = custom(i, ports, &c, policyCtx);
+			if (ms == 0)
+				continue;
+		}
+		else if (policy == ANTSCHED_ROUND_ROBIN)
+			ms = c.cycleMs / count;
+		else
+			ms = (unsigned int)(c.cycleMs * weight[i] / total);
+		if (ms < c.minDwellMs)
+			ms = c.minDwellMs;
+		if (ms > c.maxDwellMs)
+			ms = c.maxDwellMs;
+		dwell[i] = ms;
+	}
+}
+
+// One inventory round on antenna for dwellMs. Returns STAT_OK or the link error.
+static int Sched_Dwell(CFAntSched* s, CFHandleCtx* ctx, int antenna, unsigned int dwellMs)
+{
+	unsigned char mask = (unsigned char)(1 << antenna);
+	CFSeq_Enter(ctx);
+	int status = SetAntenna(s->hComm, &mask);
+	if (status == STAT_OK)
+		status = InventoryContinueEx(s->hComm, 0, 0);
+	CFSeq_Leave(ctx);
+	if (status != STAT_OK)
+		return status;
+
+	TagInfoCompact tags[STREAM_BATCH_MAX];
+	unsigned char overflow[STREAM_BATCH_MAX * 32];
+	TagCodeArena arena = { overflow, sizeof(overflow), 0 };
+	uint64_t start = CFStats_NowUs() / 1000;
+	uint64_t reads = 0;
+	s->dwellNew = 0;
+	int linkStatus = STAT_OK;
+	while (!ctx->stream.stop)
+	{
+		uint64_t elapsed = CFStats_NowUs() / 1000 - start;
+		if (elapsed >= dwellMs)
+			break;
+		unsigned short timeout = (unsigned short)(dwellMs - elapsed < STREAM_POLL_TIMEOUT ? dwellMs - elapsed : STREAM_POLL_TIMEOUT);
+		size_t count = 0;
+		arena.used = 0;
+		status = GetTagUiiBatchCompact(s->hComm, tags, STREAM_BATCH_MAX, &count, &arena, timeout);
+		if (status == STAT_OK)
+		{
+			s->callback(s->hComm, STAT_OK, tags, count, &arena, s->userCtx);
+			reads += count;
+			TagDedupFeed(s->seen, tags, count, &arena, Sched_OnSighting, s);
+			continue;
+		}
+		if (status == (int)STAT_CMD_COMM_TIMEOUT)
+			continue;
+		// the reader finished the round on its own
+		if (status == (int)STAT_CMD_INVENTORY_STOP)
+			break;
+		linkStatus = status;
+		break;
+	}
+	if (linkStatus == STAT_OK)
+	{
+		CFSeq_Enter(ctx);
+		InventoryStop(s->hComm, COMMON_TIMEOUT);
+		CFSeq_Leave(ctx);
+	}
+
+	uint64_t ms = CFStats_NowUs() / 1000 - start;
+	pthread_mutex_lock(&s->lock);
+	AntPortStats* port = &s->ports[antenna];
+	port->reads += reads;
+	port->newTags += s->dwellNew;
+	port->dwellMs += ms;
+	port->dwells++;
+	port->lastDwellMs = (unsigned int)ms;
+	if (ms > 0)
+	{
+		float a = s->config.ewmaPercent / 100.0f;
+		port->readRate = a * (reads * 1000.0f / ms) + (1 - a) * port->readRate;
+		port->newRate = a * (s->dwellNew * 1000.0f / ms) + (1 - a) * port->newRate;
+	}
+	pthread_mutex_unlock(&s->lock);
+	return linkStatus;
+}
+
+// ANTSCHED_TRIGGER: whether a trigger input is active, GetGateStatus failures count as inactive.
+static bool Sched_Triggered(CFAntSched* s, CFHandleCtx* ctx)
+{
+	GateParam gate;
+	CFSeq_Enter(ctx);
+	int status = GetGateStatus(s->hComm, &gate, STREAM_POLL_TIMEOUT);
+	CFSeq_Leave(ctx);
+	return status == STAT_OK && (gate.GPI & s->config.triggerGpi) != 0;
+}
+
+// Worker of the reader thread of hComm, so CFHandleLock pauses the dwell that runs.
+static int Sched_Run(CFHandleCtx* ctx, void* workerCtx)
+{
+	CFAntSched* s = (CFAntSched*)workerCtx;
+	int status = STAT_OK;
+	uint64_t armedUntil = 0;
+	unsigned int dwell[ANTSCHED_PORTS];
+
+	while (!ctx->stream.stop && status == STAT_OK)
+	{
+		pthread_mutex_lock(&s->lock);
+		int policy = s->policy;
+		pthread_mutex_unlock(&s->lock);
+		if (policy == ANTSCHED_TRIGGER)
+		{
+			if (Sched_Triggered(s, ctx))
+				armedUntil = CFStats_NowUs() / 1000 + s->config.triggerHoldMs;
+			else if (CFStats_NowUs() / 1000 >= armedUntil)
+			{
+				usleep(STREAM_POLL_TIMEOUT * 1000);
+				continue;
+			}
+		}
+
+		Sched_Plan(s, dwell);
+		bool any = false;
+		for (int i = 0; i < ANTSCHED_PORTS && !ctx->stream.stop && status == STAT_OK; i++)
+		{
+			if (dwell[i] == 0)
+				continue;
+			any = true;
+			status = Sched_Dwell(s, ctx, i, dwell[i]);
+		}
+		// a custom policy that skips every port: do not spin
+		if (!any)
+			usleep(STREAM_POLL_TIMEOUT * 1000);
+	}
+
+	if (status != STAT_OK)
+		s->callback(s->hComm, status, NULL, 0, NULL, s->userCtx);
+	else
+	{
+		CFSeq_Enter(ctx);
+		SetAntenna(s->hComm, &s->savedMask);
+		CFSeq_Leave(ctx);
+	}
+	TagDedupFlush(s->seen, NULL, NULL);
+
+	pthread_mutex_lock(&s->lock);
+	s->running = false;
+	pthread_mutex_unlock(&s->lock);
+	return status;
+}
+
+CFAntSched* CFAntSchedCreate(const AntSchedConfig* config)
+{
+	CFAntSched* s = new CFAntSched();
+	if (config != NULL)
+		s->config = *config;
+	Sched_Defaults(&s->config);
+	if (s->config.minDwellMs > s->config.maxDwellMs)
+	{
+		delete s;
+		return NULL;
+	}
+	TagDedupConfig seen = { s->config.newTagWindowMs, ANTSCHED_DEDUP_ENTRIES, DEDUP_ANY_ANTENNA };
+	s->seen = TagDedupCreate(&seen);
+	pthread_mutex_init(&s->lock, NULL);
+	s->running = false;
+	s->started = false;
+	s->policy = ANTSCHED_YIELD;
+	s->custom = NULL;
+	s->policyCtx = NULL;
+	memset(s->ports, 0, sizeof(s->ports));
+	return s;
+}
+
+void CFAntSchedDestroy(CFAntSched* sched)
+{
+	if (sched == NULL)
+		return;
+	// also waits for a worker stopped from its own callback that is still finishing its round
+	CFAntSchedStop(sched);
+	TagDedupDestroy(sched->seen);
+	pthread_mutex_destroy(&sched->lock);
+	delete sched;
+}
+
+int CFAntSchedSetPolicy(CFAntSched* sched, int policy, AntSchedPolicy custom, void* policyCtx)
+{
+	if (sched == NULL || policy < ANTSCHED_ROUND_ROBIN || policy > ANTSCHED_CUSTOM)
+		return STAT_CMD_PARAM_ERR;
+	if (policy == ANTSCHED_CUSTOM && custom == NULL)
+		return STAT_CMD_PARAM_ERR;
+	pthread_mutex_lock(&sched->lock);
+	sched->policy = policy;
+	sched->custom = custom;
+	sched->policyCtx = policyCtx;
+	pthread_mutex_unlock(&sched->lock);
+	return STAT_OK;
+}
+
+int CFAntSchedStart(CFAntSched* sched, int64_t hComm, TagStreamCallback callback, void* userCtx)
+{
+	if (sched == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&sched->lock);
+	if (sched->running)
+	{
+		pthread_mutex_unlock(&sched->lock);
+		return STAT_CMD_PARAM_ERR;
+	}
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFSeq_Enter(ctx);
+	int status = GetAntenna(hComm, &sched->savedMask);
+	CFSeq_Leave(ctx);
+	if (status != STAT_OK)
+	{
+		pthread_mutex_unlock(&sched->lock);
+		return status;
+	}
+	sched->hComm = hComm;
+	sched->started = true;
+	sched->callback = callback;
+	sched->userCtx = userCtx;
+	// the scheduler owns the inventory of hComm like an InventoryStartStreaming thread
+	status = CFStream_StartWorker(hComm, Sched_Run, sched);
+	sched->running = status == STAT_OK;
+	pthread_mutex_unlock(&sched->lock);
+	return status;
+}
+
+int CFAntSchedStop(CFAntSched* sched)
+{
+	if (sched == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&sched->lock);
+	int64_t hComm = sched->hComm;
+	bool started = sched->started;
+	pthread_mutex_unlock(&sched->lock);
+	if (started)
+		CFStream_StopOwner(hComm, sched);
+	return STAT_OK;
+}
+
+int CFAntSchedGetStats(CFAntSched* sched, AntPortStats* ports)
+{
+	if (sched == NULL || ports == NULL)
+		return STAT_CMD_PARAM_ERR;
+	pthread_mutex_lock(&sched->lock);
+	memcpy(ports, sched->ports, sizeof(sched->ports));
+	pthread_mutex_unlock(&sched->lock);
+	return STAT_OK;
+}
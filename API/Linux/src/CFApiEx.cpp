@@ -0,0 +1,256 @@
+#include "CFHandle.h"
+
+// Drains the labels of one burst into sink(tagInfo, index). Blocks for the first label only,
+// then keeps decoding while bytes are waiting in the receive buffer; on HID connections the
+// buffer level is unknown and BATCH_DRAIN_TIMEOUT bounds the wait instead. The wait runs in
+// STREAM_POLL_TIMEOUT polls, a command queued on the handle gets the link between two of them.
+// A label the sink cannot take ends the batch and opens the next call; only when it is the
+// first of a batch does it go out as the sink left it, with STAT_CMD_BUF_OVERFLOW.
+template <class Sink>
+static int DrainTags(int64_t hComm, size_t capacity, size_t* count, unsigned short timeout, Sink& sink)
+{
+	*count = 0;
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFSeq_Enter(ctx);
+	TagInfo tag;
+	int status;
+	if (ctx->held)
+	{
+		tag = ctx->heldTag;
+		ctx->held = false;
+	}
+	else
+	{
+		if (ctx->pendingStatus != STAT_OK)
+		{
+			status = ctx->pendingStatus;
+			ctx->pendingStatus = STAT_OK;
+			CFSeq_Leave(ctx);
+			return status;
+		}
+
+		unsigned short remaining = timeout;
+		uint64_t waitUs = CFStats_NowUs();
+		for (;;)
+		{
+			unsigned short poll = remaining < STREAM_POLL_TIMEOUT ? remaining : STREAM_POLL_TIMEOUT;
+			status = GetTagUii(hComm, &tag, poll);
+			remaining -= poll;
+			if (status != (int)STAT_CMD_COMM_TIMEOUT || remaining == 0)
+				break;
+			CFHandle_Hold(ctx);
+			CFSeq_Leave(ctx);
+			CFSeq_Enter(ctx);
+			CFHandle_Drop(ctx);
+		}
+		// the turns other commands took in between are part of the wait the caller sees
+		CFStats_Hist(&ctx->stats.tagWait, CFStats_NowUs() - waitUs);
+		if (status != STAT_OK)
+		{
+			CFSeq_Leave(ctx);
+			return status;
+		}
+		if (ctx->capture != NULL)
+			CFCapture_Label(ctx, &tag);
+	}
+	status = sink(tag, 0) ? STAT_OK : (int)STAT_CMD_BUF_OVERFLOW;
+	*count = 1;
+
+	while (status == STAT_OK && *count < capacity)
+	{
+		if (CFHandle_Pending(hComm) == 0)
+			break;
+		int next = GetTagUii(hComm, &tag, BATCH_DRAIN_TIMEOUT);
+		if (next != STAT_OK)
+		{
+			// keep the end of inventory for the next call, the labels before it go out now
+			if (next != (int)STAT_CMD_COMM_TIMEOUT)
+				ctx->pendingStatus = next;
+			break;
+		}
+		if (ctx->capture != NULL)
+			CFCapture_Label(ctx, &tag);
+		if (!sink(tag, *count))
+		{
+			ctx->heldTag = tag;
+			ctx->held = true;
+			break;
+		}
+		(*count)++;
+	}
+	ctx->stats.tags.fetch_add(*count, std::memory_order_relaxed);
+	CFSeq_Leave(ctx);
+	return status;
+}
+
+struct TagInfoSink
+{
+	TagInfo* out;
+	bool operator()(const TagInfo& tag, size_t i) { out[i] = tag; return true; }
+};
+
+struct TagCompactSink
+{
+	TagInfoCompact* out;
+	TagCodeArena* arena;
+	bool operator()(const TagInfo& tag, size_t i) { return TagInfoToCompact(&tag, &out[i], arena) == STAT_OK; }
+};
+
+int CloseDeviceEx(int64_t hComm)
+{
+	CFStream_Close(hComm);
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFCapture_Close(ctx);
+	int status = CFHandle_Close(hComm);
+	CFReplay_Close(ctx);
+	CFHandle_Release(hComm);
+	return status;
+}
+
+int InventoryContinueEx(int64_t hComm, unsigned char btInvCount, unsigned long dwInvParam)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	pthread_mutex_lock(&ctx->seq.lock);
+	ctx->seq.invCount = btInvCount;
+	ctx->seq.invParam = dwInvParam;
+	pthread_mutex_unlock(&ctx->seq.lock);
+	return InventoryContinue(hComm, btInvCount, dwInvParam);
+}
+
+int CFHandleLock(int64_t hComm, unsigned int flags)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFSeq_Enter(ctx);
+	if (ctx->seq.depth > 1 || ctx->seq.paused)
+		return STAT_OK;
+
+	// labels of a running inventory would arrive in between the response of the command
+	CFStreamCtx* st = &ctx->stream;
+	pthread_mutex_lock(&st->lock);
+	bool streaming = st->active && !st->stop && !(st->flags & STREAM_NO_INVENTORY);
+	pthread_mutex_unlock(&st->lock);
+	if (!streaming && !(flags & HANDLE_PAUSE_INVENTORY))
+		return STAT_OK;
+	int status = InventoryStop(hComm, COMMON_TIMEOUT);
+	// nothing was running: the command goes ahead and nothing is continued afterwards
+	if (status == (int)STAT_CMD_INVENTORY_STOP)
+		return STAT_OK;
+	if (status != STAT_OK)
+	{
+		CFSeq_Leave(ctx);
+		return status;
+	}
+	ctx->seq.paused = true;
+	return STAT_OK;
+}
+
+int CFHandleUnlock(int64_t hComm)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	pthread_mutex_lock(&ctx->seq.lock);
+	bool owner = ctx->seq.depth > 0 && pthread_equal(ctx->seq.owner, pthread_self());
+	bool last = owner && ctx->seq.depth == 1;
+	unsigned char invCount = ctx->seq.invCount;
+	unsigned long invParam = ctx->seq.invParam;
+	pthread_mutex_unlock(&ctx->seq.lock);
+	if (!owner)
+		return STAT_CMD_PARAM_ERR;
+
+	int status = STAT_OK;
+	if (last && ctx->seq.paused)
+	{
+		ctx->seq.paused = false;
+		status = InventoryContinue(hComm, invCount, invParam);
+	}
+	CFSeq_Leave(ctx);
+	return status;
+}
+
+int CFHandleCall(int64_t hComm, HandleCommand command, void* ctx, unsigned int flags)
+{
+	if (command == NULL)
+		return STAT_CMD_PARAM_ERR;
+	int status = CFHandleLock(hComm, flags);
+	if (status != STAT_OK)
+		return status;
+	status = command(hComm, ctx);
+	int resume = CFHandleUnlock(hComm);
+	return status != STAT_OK ? status : resume;
+}
+
+int CFHandleReserve(int64_t hComm, size_t ringSize, unsigned int flags)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	if (flags & RESERVE_VIEWS)
+		CFView_Reserve(ctx);
+	if (flags & RESERVE_RING)
+		return CFRing_Reserve(ctx, ringSize);
+	return STAT_OK;
+}
+
+int GetTagUiiBatch(int64_t hComm, TagInfo* out, size_t capacity, size_t* count, unsigned short timeout)
+{
+	if (out == NULL || count == NULL || capacity == 0)
+		return STAT_CMD_PARAM_ERR;
+	TagInfoSink sink = { out };
+	return DrainTags(hComm, capacity, count, timeout, sink);
+}
+
+int GetTagUiiCompact(int64_t hComm, TagInfoCompact* tag, TagCodeArena* arena, unsigned short timeout)
+{
+	size_t count;
+	return GetTagUiiBatchCompact(hComm, tag, 1, &count, arena, timeout);
+}
+
+int GetTagUiiBatchCompact(int64_t hComm, TagInfoCompact* out, size_t capacity, size_t* count, TagCodeArena* arena, unsigned short timeout)
+{
+	if (out == NULL || count == NULL || capacity == 0)
+		return STAT_CMD_PARAM_ERR;
+	TagCompactSink sink = { out, arena };
+	return DrainTags(hComm, capacity, count, timeout, sink);
+}
+
+int TagInfoToCompact(const TagInfo* src, TagInfoCompact* dst, TagCodeArena* arena)
+{
+	if (src == NULL || dst == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	dst->rssi = src->rssi;
+	dst->antenna = src->antenna;
+	dst->channel = src->channel;
+	dst->pc[0] = src->pc[0];
+	dst->pc[1] = src->pc[1];
+	dst->crc[0] = src->crc[0];
+	dst->crc[1] = src->crc[1];
+	dst->codeLen = src->codeLen;
+	dst->arenaOff = TAGCOMPACT_NO_ARENA;
+
+	if (src->codeLen <= TAGCOMPACT_CODE_LEN)
+	{
+		memcpy(dst->code, src->code, src->codeLen);
+		return STAT_OK;
+	}
+	if (arena != NULL && arena->base != NULL && arena->size - arena->used >= src->codeLen)
+	{
+		memcpy(arena->base + arena->used, src->code, src->codeLen);
+		memcpy(dst->code, src->code, TAGCOMPACT_CODE_LEN);
+		dst->arenaOff = arena->used;
+		arena->used += src->codeLen;
+		return STAT_OK;
+	}
+	memcpy(dst->code, src->code, TAGCOMPACT_CODE_LEN);
+	dst->codeLen = TAGCOMPACT_CODE_LEN;
+	return STAT_CMD_BUF_OVERFLOW;
+}
+
+const unsigned char* TagCompactCode(const TagInfoCompact* tag, const TagCodeArena* arena)
+{
+	if (tag->arenaOff != TAGCOMPACT_NO_ARENA && arena != NULL && arena->base != NULL)
+		return arena->base + tag->arenaOff;
+	return tag->code;
+}
+
+int TagCompactCodeLen(void)
+{
+	return TAGCOMPACT_CODE_LEN;
+}
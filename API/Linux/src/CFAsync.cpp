@@ -0,0 +1,665 @@
+#include "CFFrame.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <deque>
+#include <map>
+
+#define ASYNC_WAKE_KEY						UINT64_MAX	// epoll key of the eventfd, other keys are hComm
+#define ASYNC_EVENTS_MAX					16
+#define ASYNC_RX_LEN						1024		// receive buffer of a connection, holds a whole frame after any partial one
+#define ASYNC_INV_TIME						0x00		// InvType of the inventory command: seconds, 0 until stopped
+#define ASYNC_INV_CYCLES					0x01		// rounds
+
+enum AsyncState
+{
+	ASYNC_QUEUED,					// behind the operation on the link
+	ASYNC_SENT,						// on the link
+	ASYNC_STOPPING					// inventory: waiting for the answer of its InventoryStop
+};
+
+// One submitted operation. Reported entries have had their callback queued; a sent tag operation
+// stays at the front until its answer (or deadline) even after it was cancelled.
+struct AsyncEntry
+{
+	uint64_t id;
+	const AsyncOp* op;
+	AsyncCallback callback;
+	void* userCtx;
+	uint64_t deadlineUs;			// 0 for none
+	AsyncState state;
+	bool reported;
+	bool selectPending;				// ASYNC_TAGOP: the SetSelectMask in front has not been answered
+	int selectStatus;
+	int endStatus;					// ASYNC_STOPPING: status reported once the stop is answered
+	size_t count;
+	unsigned int dropped;
+	uint64_t sentUs;
+};
+
+struct AsyncConn
+{
+	int64_t hComm;
+	int fd;
+	CFHandleCtx* ctx;
+	int linkStatus;					// read failure that ended the connection, STAT_OK while it works
+	std::deque<AsyncEntry*> queue;	// inventories and tag operations, the front one is on the link
+	std::vector<AsyncEntry*> gates;	// ASYNC_GATE waits
+	unsigned char rx[ASYNC_RX_LEN];
+	size_t rxLen;
+};
+
+// Queued callback with a copy of the frame it reports, code and data are pointed into it at dispatch.
+struct AsyncDone
+{
+	AsyncCallback callback;
+	const AsyncOp* op;
+	void* userCtx;
+	int64_t hComm;
+	AsyncResult result;
+	unsigned char frame[FRAME_MAX_LEN];
+	int codeOff;					// -1 when the result has no code / data
+	int dataOff;
+};
+
+struct CFAsync
+{
+	int epfd;
+	int wakefd;
+	std::atomic<bool> stop;
+	uint64_t nextId;
+	std::map<int64_t, AsyncConn*> conns;
+	std::map<uint64_t, std::pair<AsyncConn*, AsyncEntry*> > ids;	// operations not reported yet
+	std::vector<AsyncDone> done;
+};
+
+static uint64_t Async_Deadline(unsigned int timeout)
+{
+	return CFStats_NowUs() + (uint64_t)timeout * 1000;
+}
+
+// Queues the callback of e, frame (with result pointing into it) is copied along when given.
+static void Async_Report(CFAsync* a, AsyncConn* c, AsyncEntry* e, int status, const unsigned char* frame, const TagOpResult* tagOp, const GateParam* gate)
+{
+	if (e->reported)
+		return;
+	e->reported = true;
+	a->ids.erase(e->id);
+
+	a->done.push_back(AsyncDone());
+	AsyncDone& d = a->done.back();
+	memset(&d.result, 0, sizeof(d.result));
+	d.callback = e->callback;
+	d.op = e->op;
+	d.userCtx = e->userCtx;
+	d.hComm = c->hComm;
+	d.codeOff = -1;
+	d.dataOff = -1;
+	d.result.id = e->id;
+	d.result.status = status;
+	d.result.count = e->count;
+	d.result.dropped = e->dropped;
+	if (tagOp != NULL)
+	{
+		d.result.tagOp = *tagOp;
+		if (frame != NULL)
+		{
+			memcpy(d.frame, frame, FRAME_HEAD_LEN + frame[4] + 2);
+			if (tagOp->code != NULL)
+				d.codeOff = (int)(tagOp->code - frame);
+			if (tagOp->data != NULL)
+				d.dataOff = (int)(tagOp->data - frame);
+		}
+	}
+	if (gate != NULL)
+		d.result.gate = *gate;
+}
+
+static void Async_Dispatch(CFAsync* a)
+{
+	// callbacks may submit, cancel and remove: they run on a list of their own
+	std::vector<AsyncDone> done;
+	done.swap(a->done);
+	for (size_t i = 0; i < done.size(); i++)
+	{
+		AsyncDone& d = done[i];
+		d.result.tagOp.code = d.codeOff >= 0 ? d.frame + d.codeOff : NULL;
+		d.result.tagOp.data = d.dataOff >= 0 ? d.frame + d.dataOff : NULL;
+		d.callback(a, d.hComm, d.op, &d.result, d.userCtx);
+	}
+}
+
+static void Async_Pop(AsyncConn* c)
+{
+	delete c->queue.front();
+	c->queue.pop_front();
+}
+
+// Stops the inventory at the front of c, status is reported once the reader answered the stop.
+static void Async_StopInventory(CFAsync* a, AsyncConn* c, AsyncEntry* e, int status)
+{
+	if (e->state == ASYNC_STOPPING)
+	{
+		e->endStatus = status;
+		return;
+	}
+	unsigned char frame[FRAME_HEAD_LEN + 2];
+	e->state = ASYNC_STOPPING;
+	e->endStatus = status;
+	e->deadlineUs = Async_Deadline(COMMON_TIMEOUT);
+	int ret = CFFrame_Write(c->fd, frame, CFFrame_Build(frame, FRAME_CMD_INVENTORY_STOP, 0), &c->ctx->stats);
+	if (ret != STAT_OK)
+	{
+		Async_Report(a, c, e, ret, NULL, NULL, NULL);
+		Async_Pop(c);
+	}
+}
+
+// Sends the operation at the front of c unless it is on the link already.
+static void Async_Start(CFAsync* a, AsyncConn* c)
+{
+	while (!c->queue.empty() && c->queue.front()->state == ASYNC_QUEUED)
+	{
+		AsyncEntry* e = c->queue.front();
+		const AsyncOp* op = e->op;
+		unsigned char frame[FRAME_MAX_LEN];
+		int status;
+		if (op->type == ASYNC_INVENTORY)
+		{
+			unsigned char* p = frame + FRAME_HEAD_LEN;
+			*p++ = op->cycles != 0 ? ASYNC_INV_CYCLES : ASYNC_INV_TIME;
+			*p++ = 0;
+			*p++ = 0;
+			*p++ = 0;
+			*p++ = op->cycles;
+			status = CFFrame_Write(c->fd, frame, CFFrame_Build(frame, FRAME_CMD_INVENTORY, 5), &c->ctx->stats);
+		}
+		else
+		{
+			// SetSelectMask and the operation go out together, as in CFOpQueueSubmit
+			status = STAT_OK;
+			e->selectPending = op->tagOp->maskBits != 0;
+			e->selectStatus = STAT_OK;
+			if (e->selectPending)
+				status = CFFrame_Write(c->fd, frame, CFOp_BuildSelect(op->tagOp, frame), &c->ctx->stats);
+			if (status == STAT_OK)
+				status = CFFrame_Write(c->fd, frame, CFOp_Build(op->tagOp, frame), &c->ctx->stats);
+		}
+		if (status == STAT_OK)
+		{
+			e->state = ASYNC_SENT;
+			e->sentUs = CFStats_NowUs();
+			return;
+		}
+		Async_Report(a, c, e, status, NULL, NULL, NULL);
+		Async_Pop(c);
+	}
+}
+
+// Ends the operation at the front of c and starts the next one.
+static void Async_Next(CFAsync* a, AsyncConn* c, int status, const unsigned char* frame, const TagOpResult* tagOp)
+{
+	Async_Report(a, c, c->queue.front(), status, frame, tagOp, NULL);
+	Async_Pop(c);
+	Async_Start(a, c);
+}
+
+static void Async_Gate(CFAsync* a, AsyncConn* c, const unsigned char* frame)
+{
+	// DIR GPI SYSTIME[4], after the status byte when the reader sends one
+	size_t len = frame[4];
+	GateParam gate;
+	int status = STAT_OK;
+	memset(&gate, 0, sizeof(gate));
+	if (len < sizeof(gate))
+		status = STAT_CMD_RESP_FORMAT_ERR;
+	else if (len > sizeof(gate) && frame[FRAME_HEAD_LEN] != 0x00)
+		status = CFFrame_Status(frame[FRAME_HEAD_LEN]);
+	else
+		memcpy(&gate, frame + FRAME_HEAD_LEN + len - sizeof(gate), sizeof(gate));
+	std::vector<AsyncEntry*> gates;
+	gates.swap(c->gates);
+	for (size_t i = 0; i < gates.size(); i++)
+	{
+		Async_Report(a, c, gates[i], status, NULL, NULL, &gate);
+		delete gates[i];
+	}
+}
+
+static void Async_Frame(CFAsync* a, AsyncConn* c, const unsigned char* frame)
+{
+	unsigned short cmd = (frame[2] << 8) | frame[3];
+	if (cmd == FRAME_CMD_GATE_STATUS)
+	{
+		Async_Gate(a, c, frame);
+		return;
+	}
+	if (c->queue.empty() || c->queue.front()->state == ASYNC_QUEUED)
+		return;		// labels of an inventory nobody waits for, late answers
+
+	AsyncEntry* e = c->queue.front();
+	const AsyncOp* op = e->op;
+	if (op->type == ASYNC_INVENTORY)
+	{
+		if (cmd == FRAME_CMD_INVENTORY_STOP && e->state == ASYNC_STOPPING)
+		{
+			Async_Next(a, c, e->endStatus, NULL, NULL);
+			return;
+		}
+		if (cmd != FRAME_CMD_INVENTORY)
+			return;
+		if (e->state == ASYNC_STOPPING || e->count == op->capacity)
+		{
+			if (frame[4] > 1)
+				e->dropped++;
+			return;		// the end of the inventory is the answer of the stop
+		}
+		int status = CFFrame_Label(frame, &op->tags[e->count]);
+		if (status == STAT_OK)
+		{
+			e->count++;
+			c->ctx->stats.tags.fetch_add(1, std::memory_order_relaxed);
+			if (e->count == op->capacity)
+				Async_StopInventory(a, c, e, STAT_OK);
+		}
+		else if (status == (int)STAT_CMD_INVENTORY_STOP)
+			Async_Next(a, c, STAT_OK, NULL, NULL);
+		else
+			Async_Next(a, c, status, NULL, NULL);
+		return;
+	}
+
+	const TagOp* tagOp = op->tagOp;
+	if (cmd == FRAME_CMD_SELECT_MASK && e->selectPending)
+	{
+		e->selectPending = false;
+		e->selectStatus = frame[4] < 1 ? STAT_CMD_RESP_FORMAT_ERR : CFFrame_Status(frame[FRAME_HEAD_LEN]);
+		return;
+	}
+	if (cmd != CFOp_Cmd(tagOp))
+		return;
+	TagOpResult result;
+	memset(&result, 0, sizeof(result));
+	int status = CFOp_Parse(frame, cmd == FRAME_CMD_READ_TAG, &result);
+	// the operation went to whatever tag matched: report a failed SetSelectMask first
+	if (e->selectPending)
+		status = STAT_CMD_COMM_TIMEOUT;
+	else if (e->selectStatus != STAT_OK)
+		status = e->selectStatus;
+	result.status = status;
+	CFStats_Rtt(&c->ctx->stats, cmd, CFStats_NowUs() - e->sentUs, false);
+	Async_Next(a, c, status, frame, &result);
+}
+
+// The descriptor ended: every operation of c fails with status, later submits too.
+static void Async_Fail(CFAsync* a, AsyncConn* c, int status)
+{
+	c->linkStatus = status;
+	epoll_ctl(a->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	while (!c->queue.empty())
+	{
+		Async_Report(a, c, c->queue.front(), status, NULL, NULL, NULL);
+		Async_Pop(c);
+	}
+	for (size_t i = 0; i < c->gates.size(); i++)
+	{
+		Async_Report(a, c, c->gates[i], status, NULL, NULL, NULL);
+		delete c->gates[i];
+	}
+	c->gates.clear();
+}
+
+// Takes what the descriptor has and handles every complete frame in it.
+static void Async_Read(CFAsync* a, AsyncConn* c)
+{
+	ssize_t n = read(c->fd, c->rx + c->rxLen, sizeof(c->rx) - c->rxLen);
+	if (n < 0 && (errno == EINTR || errno == EAGAIN))
+		return;
+	if (n <= 0)
+	{
+		Async_Fail(a, c, n == 0 ? STAT_DLL_DISCONNECT : STAT_CMD_COMM_RD_FAILED);
+		return;
+	}
+	CFStatsCtx* stats = &c->ctx->stats;
+	stats->frameRxBytes.fetch_add(n, std::memory_order_relaxed);
+	c->rxLen += n;
+
+	size_t pos = 0;
+	while (pos < c->rxLen)
+	{
+		const unsigned char* head = (const unsigned char*)memchr(c->rx + pos, FRAME_HEAD0, c->rxLen - pos);
+		size_t skipped = (head != NULL ? (size_t)(head - c->rx) : c->rxLen) - pos;
+		if (skipped > 0)
+		{
+			stats->resyncs.fetch_add(1, std::memory_order_relaxed);
+			stats->resyncBytes.fetch_add(skipped, std::memory_order_relaxed);
+		}
+		pos += skipped;
+		if (c->rxLen - pos < FRAME_HEAD_LEN || c->rxLen - pos < (size_t)FRAME_HEAD_LEN + c->rx[pos + 4] + 2)
+			break;
+		const unsigned char* frame = c->rx + pos;
+		size_t len = frame[4];
+		unsigned short crc = CFFrame_Crc16(frame, FRAME_HEAD_LEN + len);
+		if (frame[FRAME_HEAD_LEN + len] != (unsigned char)(crc >> 8) || frame[FRAME_HEAD_LEN + len + 1] != (unsigned char)crc)
+		{
+			// a head byte inside other data: look for the next one
+			stats->crcErrors.fetch_add(1, std::memory_order_relaxed);
+			pos++;
+			continue;
+		}
+		stats->frames.fetch_add(1, std::memory_order_relaxed);
+		Async_Frame(a, c, frame);
+		pos += FRAME_HEAD_LEN + len + 2;
+	}
+	memmove(c->rx, c->rx + pos, c->rxLen - pos);
+	c->rxLen -= pos;
+}
+
+// Ends what has run out of time on c.
+static void Async_Expire(CFAsync* a, AsyncConn* c, uint64_t now)
+{
+	for (size_t i = 0; i < c->gates.size();)
+	{
+		AsyncEntry* e = c->gates[i];
+		if (e->deadlineUs == 0 || e->deadlineUs > now)
+		{
+			i++;
+			continue;
+		}
+		Async_Report(a, c, e, STAT_CMD_COMM_TIMEOUT, NULL, NULL, NULL);
+		delete e;
+		c->gates.erase(c->gates.begin() + i);
+	}
+	// queued operations never go out once their deadline passed
+	for (size_t i = 1; i < c->queue.size();)
+	{
+		AsyncEntry* e = c->queue[i];
+		if (e->deadlineUs == 0 || e->deadlineUs > now)
+		{
+			i++;
+			continue;
+		}
+		Async_Report(a, c, e, STAT_CMD_COMM_TIMEOUT, NULL, NULL, NULL);
+		delete e;
+		c->queue.erase(c->queue.begin() + i);
+	}
+	while (!c->queue.empty())
+	{
+		AsyncEntry* e = c->queue.front();
+		if (e->deadlineUs == 0 || e->deadlineUs > now)
+			break;
+		if (e->op->type == ASYNC_INVENTORY && e->state == ASYNC_SENT)
+		{
+			Async_StopInventory(a, c, e, e->count > 0 ? STAT_OK : STAT_CMD_COMM_TIMEOUT);
+			break;
+		}
+		// a stop without answer ends the inventory as well
+		int status = e->state == ASYNC_STOPPING ? e->endStatus : STAT_CMD_COMM_TIMEOUT;
+		if (e->op->type == ASYNC_TAGOP && e->state == ASYNC_SENT)
+			CFStats_Rtt(&c->ctx->stats, CFOp_Cmd(e->op->tagOp), 0, true);
+		Async_Next(a, c, status, NULL, NULL);
+	}
+}
+
+// ms until the first deadline, capped at timeout (-1 without limit).
+static int Async_Timeout(CFAsync* a, int timeout)
+{
+	uint64_t first = 0;
+	for (std::map<int64_t, AsyncConn*>::iterator it = a->conns.begin(); it != a->conns.end(); ++it)
+	{
+		AsyncConn* c = it->second;
+		for (size_t i = 0; i < c->queue.size(); i++)
+		{
+			if (c->queue[i]->deadlineUs != 0 && (first == 0 || c->queue[i]->deadlineUs < first))
+				first = c->queue[i]->deadlineUs;
+		}
+		for (size_t i = 0; i < c->gates.size(); i++)
+		{
+			if (c->gates[i]->deadlineUs != 0 && (first == 0 || c->gates[i]->deadlineUs < first))
+				first = c->gates[i]->deadlineUs;
+		}
+	}
+	if (first == 0)
+		return timeout;
+	uint64_t now = CFStats_NowUs();
+	int ms = first > now ? (int)((first - now + 999) / 1000) : 0;
+	return timeout < 0 || ms < timeout ? ms : timeout;
+}
+
+CFAsync* CFAsyncCreate()
+{
+	CFAsync* a = new (std::nothrow) CFAsync();
+	if (a == NULL)
+		return NULL;
+	a->stop = false;
+	a->nextId = 1;
+	a->epfd = epoll_create1(EPOLL_CLOEXEC);
+	a->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u64 = ASYNC_WAKE_KEY;
+	if (a->epfd < 0 || a->wakefd < 0 || epoll_ctl(a->epfd, EPOLL_CTL_ADD, a->wakefd, &ev) != 0)
+	{
+		if (a->epfd >= 0)
+			close(a->epfd);
+		if (a->wakefd >= 0)
+			close(a->wakefd);
+		delete a;
+		return NULL;
+	}
+	return a;
+}
+
+void CFAsyncDestroy(CFAsync* async)
+{
+	if (async == NULL)
+		return;
+	while (!async->conns.empty())
+		CFAsyncRemove(async, async->conns.begin()->first);
+	// what they submit from here on fails, the connections are gone
+	Async_Dispatch(async);
+	close(async->epfd);
+	close(async->wakefd);
+	delete async;
+}
+
+int CFAsyncAdd(CFAsync* async, int64_t hComm)
+{
+	if (async == NULL || async->conns.count(hComm) != 0)
+		return STAT_CMD_PARAM_ERR;
+	int fd = CFHandle_Fd(hComm);
+	if (fd < 0)
+		return STAT_CMD_PARAM_ERR;
+
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFStreamCtx* st = &ctx->stream;
+	pthread_mutex_lock(&st->lock);
+	bool streaming = st->active;
+	pthread_mutex_unlock(&st->lock);
+	if (streaming)
+		return STAT_CMD_PARAM_ERR;
+
+	AsyncConn* c = new (std::nothrow) AsyncConn();
+	if (c == NULL)
+		return STAT_DLL_INNER_FAILED;
+	c->hComm = hComm;
+	c->fd = fd;
+	c->ctx = ctx;
+	c->linkStatus = STAT_OK;
+	c->rxLen = 0;
+	CFSeq_Enter(ctx);
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u64 = (uint64_t)hComm;
+	if (epoll_ctl(async->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+	{
+		CFSeq_Leave(ctx);
+		delete c;
+		return STAT_DLL_INNER_FAILED;
+	}
+	async->conns[hComm] = c;
+	return STAT_OK;
+}
+
+int CFAsyncRemove(CFAsync* async, int64_t hComm)
+{
+	if (async == NULL)
+		return STAT_CMD_PARAM_ERR;
+	std::map<int64_t, AsyncConn*>::iterator it = async->conns.find(hComm);
+	if (it == async->conns.end())
+		return STAT_CMD_PARAM_ERR;
+	AsyncConn* c = it->second;
+	async->conns.erase(it);
+
+	if (c->linkStatus == STAT_OK && !c->queue.empty() && c->queue.front()->op->type == ASYNC_INVENTORY
+		&& c->queue.front()->state == ASYNC_SENT)
+	{
+		unsigned char frame[FRAME_HEAD_LEN + 2];
+		CFFrame_Write(c->fd, frame, CFFrame_Build(frame, FRAME_CMD_INVENTORY_STOP, 0), &c->ctx->stats);
+	}
+	Async_Fail(async, c, ASYNC_CANCELLED);
+	CFSeq_Leave(c->ctx);
+	delete c;
+	return STAT_OK;
+}
+
+int CFAsyncSubmit(CFAsync* async, int64_t hComm, const AsyncOp* op, AsyncCallback callback, void* userCtx, uint64_t* id)
+{
+	if (async == NULL || op == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+	if (op->type == ASYNC_INVENTORY && (op->tags == NULL || op->capacity == 0))
+		return STAT_CMD_PARAM_ERR;
+	if (op->type == ASYNC_TAGOP && (op->tagOp == NULL || CFOp_Validate(op->tagOp) != STAT_OK))
+		return STAT_CMD_PARAM_ERR;
+	if (op->type != ASYNC_INVENTORY && op->type != ASYNC_TAGOP && op->type != ASYNC_GATE)
+		return STAT_CMD_PARAM_ERR;
+	std::map<int64_t, AsyncConn*>::iterator it = async->conns.find(hComm);
+	if (it == async->conns.end())
+		return STAT_CMD_PARAM_ERR;
+	AsyncConn* c = it->second;
+	if (c->linkStatus != STAT_OK)
+		return c->linkStatus;
+
+	AsyncEntry* e = new (std::nothrow) AsyncEntry();
+	if (e == NULL)
+		return STAT_DLL_INNER_FAILED;
+	memset(e, 0, sizeof(*e));
+	e->id = async->nextId++;
+	e->op = op;
+	e->callback = callback;
+	e->userCtx = userCtx;
+	e->state = ASYNC_QUEUED;
+	unsigned int timeout = op->timeout != 0 || op->type != ASYNC_TAGOP ? op->timeout : DEF_WRITE_TIMEOUT;
+	e->deadlineUs = timeout != 0 ? Async_Deadline(timeout) : 0;
+	async->ids[e->id] = std::make_pair(c, e);
+	if (id != NULL)
+		*id = e->id;
+
+	if (op->type == ASYNC_GATE)
+		c->gates.push_back(e);
+	else
+	{
+		c->queue.push_back(e);
+		Async_Start(async, c);
+	}
+	return STAT_OK;
+}
+
+int CFAsyncCancel(CFAsync* async, uint64_t id)
+{
+	if (async == NULL)
+		return STAT_CMD_PARAM_ERR;
+	std::map<uint64_t, std::pair<AsyncConn*, AsyncEntry*> >::iterator it = async->ids.find(id);
+	if (it == async->ids.end())
+		return STAT_CMD_PARAM_ERR;
+	AsyncConn* c = it->second.first;
+	AsyncEntry* e = it->second.second;
+
+	if (e->op->type == ASYNC_GATE)
+	{
+		Async_Report(async, c, e, ASYNC_CANCELLED, NULL, NULL, NULL);
+		for (size_t i = 0; i < c->gates.size(); i++)
+		{
+			if (c->gates[i] == e)
+			{
+				c->gates.erase(c->gates.begin() + i);
+				break;
+			}
+		}
+		delete e;
+	}
+	else if (e->state == ASYNC_QUEUED)
+	{
+		Async_Report(async, c, e, ASYNC_CANCELLED, NULL, NULL, NULL);
+		for (size_t i = 0; i < c->queue.size(); i++)
+		{
+			if (c->queue[i] == e)
+			{
+				c->queue.erase(c->queue.begin() + i);
+				break;
+			}
+		}
+		delete e;
+	}
+	else if (e->op->type == ASYNC_INVENTORY)
+		Async_StopInventory(async, c, e, ASYNC_CANCELLED);
+	else
+		Async_Report(async, c, e, ASYNC_CANCELLED, NULL, NULL, NULL);
+	return STAT_OK;
+}
+
+int CFAsyncPoll(CFAsync* async, int timeout)
+{
+	if (async == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	struct epoll_event evs[ASYNC_EVENTS_MAX];
+	int n = epoll_wait(async->epfd, evs, ASYNC_EVENTS_MAX, async->done.empty() ? Async_Timeout(async, timeout) : 0);
+	if (n < 0 && errno != EINTR)
+		return STAT_DLL_INNER_FAILED;
+	for (int i = 0; i < n; i++)
+	{
+		uint64_t key = evs[i].data.u64;
+		if (key == ASYNC_WAKE_KEY)
+		{
+			uint64_t value;
+			ssize_t ret = read(async->wakefd, &value, sizeof(value));
+			(void)ret;
+			continue;
+		}
+		std::map<int64_t, AsyncConn*>::iterator it = async->conns.find((int64_t)key);
+		if (it != async->conns.end() && it->second->linkStatus == STAT_OK)
+			Async_Read(async, it->second);
+	}
+	uint64_t now = CFStats_NowUs();
+	for (std::map<int64_t, AsyncConn*>::iterator it = async->conns.begin(); it != async->conns.end(); ++it)
+		Async_Expire(async, it->second, now);
+
+	bool any = n > 0 || !async->done.empty();
+	Async_Dispatch(async);
+	return any ? STAT_OK : STAT_CMD_COMM_TIMEOUT;
+}
+
+int CFAsyncRun(CFAsync* async)
+{
+	if (async == NULL)
+		return STAT_CMD_PARAM_ERR;
+	while (!async->stop)
+	{
+		int status = CFAsyncPoll(async, -1);
+		if (status != STAT_OK && status != (int)STAT_CMD_COMM_TIMEOUT)
+			return status;
+	}
+	async->stop = false;
+	return STAT_OK;
+}
+
+int CFAsyncStop(CFAsync* async)
+{
+	if (async == NULL)
+		return STAT_CMD_PARAM_ERR;
+	async->stop = true;
+	uint64_t one = 1;
+	ssize_t ret = write(async->wakefd, &one, sizeof(one));
+	(void)ret;
+	return STAT_OK;
+}
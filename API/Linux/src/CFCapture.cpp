@@ -0,0 +1,487 @@
+#include "CFFrame.h"
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#define CAPTURE_CHUNK						4096			// bytes relayed per read
+#define CAPTURE_FILE_BUFFER					(64 * 1024)
+#define REPLAY_BAUD_RATE					115200			// of the pseudo terminal, it moves bytes at any rate
+
+static const char s_captureMagic[4] = { 'C', 'F', 'C', 'P' };
+static const unsigned char s_capturePad[8] = { 0 };
+
+struct CFCapture
+{
+	FILE* fp;
+	pthread_mutex_t lock;			// fp, lastUs and status between the relay and the label path
+	uint64_t lastUs;
+	int status;						// first write failure of fp
+	bool labels;					// CAPTURE_FLAG_LABELS
+	// relay of serial and TCP connections
+	int fd;							// descriptor of hComm, the peer of local while capturing
+	int fdFlags;					// FD_CLOEXEC of fd
+	int device;						// the connection itself
+	int deviceFlags;				// file status flags of the connection to put back
+	int local;
+	int wake[2];
+	pthread_t thread;
+	bool relaying;
+};
+
+struct CFReplay
+{
+	const unsigned char* map;
+	size_t size;
+	double speed;
+	int master;
+	int wake[2];
+	pthread_t thread;
+	uint64_t txSeen;				// bytes the host wrote so far
+};
+
+static void Capture_Append(CFCapture* c, unsigned char dir, const unsigned char* data, size_t len)
+{
+	CaptureRecord rec;
+	size_t pad = (8 - len % 8) % 8;
+	pthread_mutex_lock(&c->lock);
+	// a pause longer than the 32 bit delta (71 minutes) is shortened, nothing happened during it
+	uint64_t now = CFStats_NowUs();
+	uint64_t delta = now - c->lastUs;
+	rec.deltaUs = delta > 0xFFFFFFFFu ? 0xFFFFFFFFu : (unsigned int)delta;
+	rec.len = (unsigned short)len;
+	rec.dir = dir;
+	rec.reserved = 0;
+	c->lastUs = now;
+	if (c->status == STAT_OK && (fwrite(&rec, sizeof(rec), 1, c->fp) != 1 || fwrite(data, 1, len, c->fp) != len
+		|| fwrite(s_capturePad, 1, pad, c->fp) != pad))
+		c->status = STAT_DLL_INNER_FAILED;
+	pthread_mutex_unlock(&c->lock);
+}
+
+// Writes len bytes to fd, false once the relay is stopped or fd fails.
+static bool Capture_Forward(CFCapture* c, int fd, const unsigned char* data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(fd, data, len);
+		if (n > 0)
+		{
+			data += n;
+			len -= n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n == 0 || errno != EAGAIN)
+			return false;
+		struct pollfd pfd[2] = { { fd, POLLOUT, 0 }, { c->wake[0], POLLIN, 0 } };
+		if (poll(pfd, 2, -1) < 0 && errno != EINTR)
+			return false;
+		if (pfd[1].revents != 0)
+			return false;
+	}
+	return true;
+}
+
+static void* Capture_Relay(void* arg)
+{
+	CFCapture* c = (CFCapture*)arg;
+	unsigned char buf[CAPTURE_CHUNK];
+	bool open = true;
+	while (open)
+	{
+		struct pollfd pfd[3] = { { c->device, POLLIN, 0 }, { c->local, POLLIN, 0 }, { c->wake[0], POLLIN, 0 } };
+		if (poll(pfd, 3, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (pfd[2].revents != 0)
+			return NULL;
+		for (int i = 0; i < 2 && open; i++)
+		{
+			if (pfd[i].revents == 0)
+				continue;
+			ssize_t n = read(pfd[i].fd, buf, sizeof(buf));
+			if (n < 0 && (errno == EINTR || errno == EAGAIN))
+				continue;
+			if (n <= 0)
+			{
+				open = false;
+				break;
+			}
+			Capture_Append(c, i == 0 ? CAPTURE_DIR_RX : CAPTURE_DIR_TX, buf, n);
+			open = Capture_Forward(c, i == 0 ? c->local : c->device, buf, n);
+		}
+	}
+	// the connection ended: libCFApi sees the end of a TCP connection, a serial one just goes quiet
+	shutdown(c->local, SHUT_WR);
+	struct pollfd wake = { c->wake[0], POLLIN, 0 };
+	while (poll(&wake, 1, -1) < 0 && errno == EINTR)
+		;
+	return NULL;
+}
+
+static void Capture_CloseFds(CFCapture* c)
+{
+	int fds[] = { c->device, c->local, c->wake[0], c->wake[1] };
+	for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+	{
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+}
+
+static void Capture_SetNonBlock(int fd, bool on)
+{
+	int flags = fcntl(fd, F_GETFL);
+	fcntl(fd, F_SETFL, on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+}
+
+// Puts a pseudo terminal (tty devices) or a socket pair (TCP) in the place of the descriptor of
+// the connection: libCFApi keeps using the same number, the relay moves the bytes and records them.
+static int Capture_Swap(CFCapture* c)
+{
+	int peer = -1;
+	if (pipe2(c->wake, O_CLOEXEC) != 0)
+		return STAT_PORT_HANDLE_ERR;
+	if (isatty(c->fd))
+	{
+		char name[64];
+		c->local = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+		if (c->local >= 0 && grantpt(c->local) == 0 && unlockpt(c->local) == 0 && ptsname_r(c->local, name, sizeof(name)) == 0)
+			peer = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+		// the settings libCFApi made (raw mode, VMIN / VTIME ...) carry over to its new end
+		struct termios tio;
+		if (peer >= 0 && tcgetattr(c->fd, &tio) == 0)
+			tcsetattr(peer, TCSANOW, &tio);
+	}
+	else
+	{
+		int type, sv[2];
+		socklen_t len = sizeof(type);
+		if (getsockopt(c->fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0 && socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == 0)
+		{
+			c->local = sv[0];
+			peer = sv[1];
+		}
+	}
+	c->device = peer >= 0 ? fcntl(c->fd, F_DUPFD_CLOEXEC, 0) : -1;
+	if (c->device < 0)
+	{
+		if (peer >= 0)
+			close(peer);
+		return STAT_PORT_HANDLE_ERR;
+	}
+
+	c->fdFlags = fcntl(c->fd, F_GETFD);
+	c->deviceFlags = fcntl(c->device, F_GETFL);
+	Capture_SetNonBlock(peer, (c->deviceFlags & O_NONBLOCK) != 0);
+	Capture_SetNonBlock(c->device, true);
+	Capture_SetNonBlock(c->local, true);
+	int swapped = dup3(peer, c->fd, (c->fdFlags & FD_CLOEXEC) ? O_CLOEXEC : 0);
+	close(peer);
+	if (swapped < 0 || pthread_create(&c->thread, NULL, Capture_Relay, c) != 0)
+	{
+		if (swapped >= 0)
+			dup3(c->device, c->fd, (c->fdFlags & FD_CLOEXEC) ? O_CLOEXEC : 0);
+		fcntl(c->device, F_SETFL, c->deviceFlags);
+		return STAT_PORT_HANDLE_ERR;
+	}
+	c->relaying = true;
+	return STAT_OK;
+}
+
+static int Capture_End(CFCapture* c)
+{
+	if (c->relaying)
+	{
+		char b = 0;
+		while (write(c->wake[1], &b, 1) < 0 && errno == EINTR)
+			;
+		pthread_join(c->thread, NULL);
+		dup3(c->device, c->fd, (c->fdFlags & FD_CLOEXEC) ? O_CLOEXEC : 0);
+		fcntl(c->fd, F_SETFL, c->deviceFlags);
+	}
+	Capture_CloseFds(c);
+	int status = c->status;
+	if (fclose(c->fp) != 0 && status == STAT_OK)
+		status = STAT_DLL_INNER_FAILED;
+	pthread_mutex_destroy(&c->lock);
+	delete c;
+	return status;
+}
+
+static int Capture_Open(CFHandleCtx* ctx, const char* path, CFCapture** out)
+{
+	CFCapture* c = new CFCapture();
+	c->device = c->local = c->wake[0] = c->wake[1] = -1;
+	c->fd = CFHandle_Fd(ctx->hComm);
+	c->labels = c->fd < 0;
+	c->status = STAT_OK;
+	c->fp = fopen(path, "wbe");
+	if (c->fp == NULL)
+	{
+		delete c;
+		return STAT_CMD_PARAM_ERR;
+	}
+	setvbuf(c->fp, NULL, _IOFBF, CAPTURE_FILE_BUFFER);
+	pthread_mutex_init(&c->lock, NULL);
+
+	CaptureFileHeader head;
+	struct timespec real;
+	clock_gettime(CLOCK_REALTIME, &real);
+	memcpy(head.magic, s_captureMagic, sizeof(head.magic));
+	head.version = CAPTURE_VERSION;
+	head.flags = c->labels ? CAPTURE_FLAG_LABELS : 0;
+	head.startUs = (uint64_t)real.tv_sec * 1000000 + real.tv_nsec / 1000;
+	c->lastUs = CFStats_NowUs();
+	if (fwrite(&head, sizeof(head), 1, c->fp) != 1)
+		c->status = STAT_CMD_PARAM_ERR;
+
+	int status = c->status;
+	if (status == STAT_OK && !c->labels)
+		status = Capture_Swap(c);
+	if (status != STAT_OK)
+	{
+		c->status = STAT_OK;
+		Capture_End(c);
+		unlink(path);
+		return status;
+	}
+	*out = c;
+	return STAT_OK;
+}
+
+int CFCaptureStart(int64_t hComm, const char* path)
+{
+	if (path == NULL)
+		return STAT_CMD_PARAM_ERR;
+	// no exchange is half way through the descriptor while it is swapped
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFSeq_Enter(ctx);
+	int status = ctx->capture != NULL ? STAT_CMD_PARAM_ERR : Capture_Open(ctx, path, &ctx->capture);
+	CFSeq_Leave(ctx);
+	return status;
+}
+
+int CFCaptureStop(int64_t hComm)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFSeq_Enter(ctx);
+	CFCapture* c = ctx->capture;
+	ctx->capture = NULL;
+	int status = c != NULL ? Capture_End(c) : STAT_CMD_PARAM_ERR;
+	CFSeq_Leave(ctx);
+	return status;
+}
+
+void CFCapture_Close(CFHandleCtx* ctx)
+{
+	CFSeq_Enter(ctx);
+	if (ctx->capture != NULL)
+		Capture_End(ctx->capture);
+	ctx->capture = NULL;
+	CFSeq_Leave(ctx);
+}
+
+// Inventory response: status rssi[2] antenna channel codeLen code[codeLen], rssi in dBm big endian.
+void CFCapture_Label(CFHandleCtx* ctx, const TagInfo* tag)
+{
+	CFCapture* c = ctx->capture;
+	if (!c->labels || tag->codeLen > 255 - 6)
+		return;
+	unsigned char frame[FRAME_MAX_LEN];
+	unsigned char* p = frame + FRAME_HEAD_LEN;
+	*p++ = 0x00;
+	*p++ = (unsigned char)((unsigned short)tag->rssi >> 8);
+	*p++ = (unsigned char)tag->rssi;
+	*p++ = tag->antenna;
+	*p++ = tag->channel;
+	*p++ = tag->codeLen;
+	memcpy(p, tag->code, tag->codeLen);
+	p += tag->codeLen;
+	size_t len = CFFrame_BuildFrom(frame, FRAME_ADDR_DEFAULT, FRAME_CMD_INVENTORY, p - frame - FRAME_HEAD_LEN);
+	Capture_Append(c, CAPTURE_DIR_RX, frame, len);
+}
+
+// Waits for the master of r until timeout (NULL for none), taking away what the host wrote.
+// Returns the revents of the master, -1 once the player is stopped or the host closed its end.
+static int Replay_Poll(CFReplay* r, short events, const struct timespec* timeout)
+{
+	struct pollfd pfd[2] = { { r->master, (short)(events | POLLIN), 0 }, { r->wake[0], POLLIN, 0 } };
+	if (ppoll(pfd, 2, timeout, NULL) < 0)
+		return errno == EINTR ? 0 : -1;
+	if (pfd[1].revents != 0 || (pfd[0].revents & (POLLHUP | POLLERR)))
+		return -1;
+	if (pfd[0].revents & POLLIN)
+	{
+		unsigned char buf[CAPTURE_CHUNK];
+		ssize_t n = read(r->master, buf, sizeof(buf));
+		if (n > 0)
+			r->txSeen += n;
+		else if (n == 0 || (errno != EINTR && errno != EAGAIN))
+			return -1;
+	}
+	return pfd[0].revents;
+}
+
+static bool Replay_WaitUntil(CFReplay* r, uint64_t untilUs)
+{
+	for (;;)
+	{
+		uint64_t now = CFStats_NowUs();
+		if (now >= untilUs)
+			return true;
+		struct timespec timeout = { (time_t)((untilUs - now) / 1000000), (long)((untilUs - now) % 1000000) * 1000 };
+		if (Replay_Poll(r, 0, &timeout) < 0)
+			return false;
+	}
+}
+
+static bool Replay_Write(CFReplay* r, const unsigned char* data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(r->master, data, len);
+		if (n > 0)
+		{
+			data += n;
+			len -= n;
+		}
+		else if (n < 0 && errno != EINTR && errno != EAGAIN)
+			return false;
+		else if (n <= 0 && Replay_Poll(r, POLLOUT, NULL) < 0)
+			return false;
+	}
+	return true;
+}
+
+static void* Replay_Play(void* arg)
+{
+	CFReplay* r = (CFReplay*)arg;
+	uint64_t txWanted = 0;
+	uint64_t base = CFStats_NowUs(), due = 0;
+	size_t off = sizeof(CaptureFileHeader);
+	while (off + sizeof(CaptureRecord) <= r->size)
+	{
+		CaptureRecord rec;
+		memcpy(&rec, r->map + off, sizeof(rec));
+		const unsigned char* data = r->map + off + sizeof(rec);
+		if (off + sizeof(rec) + rec.len > r->size)
+			break;	// the last record of a capture that was not stopped
+		off += sizeof(rec) + ((rec.len + 7) & ~(size_t)7);
+
+		if (rec.dir == CAPTURE_DIR_TX)
+		{
+			// commands of the host get the responses that followed them, timed from the command
+			txWanted += rec.len;
+			while (r->txSeen < txWanted)
+			{
+				if (Replay_Poll(r, 0, NULL) < 0)
+					return NULL;
+			}
+			base = CFStats_NowUs();
+			due = 0;
+			continue;
+		}
+		due += rec.deltaUs;
+		if (r->speed > 0 && !Replay_WaitUntil(r, base + (uint64_t)(due / r->speed)))
+			return NULL;
+		if (!Replay_Write(r, data, rec.len))
+			return NULL;
+	}
+	// a reader with nothing left to say, it still takes the commands of the host
+	while (Replay_Poll(r, 0, NULL) >= 0)
+		;
+	return NULL;
+}
+
+static void Replay_Free(CFReplay* r)
+{
+	if (r->map != NULL)
+		munmap((void*)r->map, r->size);
+	int fds[] = { r->master, r->wake[0], r->wake[1] };
+	for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+	{
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+	delete r;
+}
+
+static int Replay_Map(CFReplay* r, const char* path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return STAT_CMD_PARAM_ERR;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CaptureFileHeader))
+	{
+		close(fd);
+		return STAT_CMD_PARAM_ERR;
+	}
+	void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return STAT_CMD_PARAM_ERR;
+	madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+	r->map = (const unsigned char*)map;
+	r->size = (size_t)st.st_size;
+
+	const CaptureFileHeader* head = (const CaptureFileHeader*)map;
+	if (memcmp(head->magic, s_captureMagic, sizeof(head->magic)) != 0 || head->version != CAPTURE_VERSION)
+		return STAT_CMD_PARAM_ERR;
+	return STAT_OK;
+}
+
+int OpenReplayDevice(int64_t* hComm, const char* path, double speed)
+{
+	if (hComm == NULL || path == NULL || !(speed >= 0))
+		return STAT_CMD_PARAM_ERR;
+	CFReplay* r = new CFReplay();
+	r->master = r->wake[0] = r->wake[1] = -1;
+	r->speed = speed;
+	int status = Replay_Map(r, path);
+
+	char name[64];
+	if (status == STAT_OK)
+	{
+		r->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+		if (r->master < 0 || grantpt(r->master) != 0 || unlockpt(r->master) != 0 || ptsname_r(r->master, name, sizeof(name)) != 0
+			|| pipe2(r->wake, O_CLOEXEC) != 0)
+			status = STAT_PORT_OPEN_FAILED;
+		else
+			Capture_SetNonBlock(r->master, true);
+	}
+	// libCFApi opens the other end as the serial port of a reader
+	if (status == STAT_OK)
+		status = CFHandle_OpenSerial(hComm, name, REPLAY_BAUD_RATE);
+	if (status != STAT_OK)
+	{
+		Replay_Free(r);
+		return status;
+	}
+	if (pthread_create(&r->thread, NULL, Replay_Play, r) != 0)
+	{
+		CFHandle_Close(*hComm);
+		Replay_Free(r);
+		return STAT_DLL_INNER_FAILED;
+	}
+	CFHandle_Get(*hComm)->replay = r;
+	return STAT_OK;
+}
+
+void CFReplay_Close(CFHandleCtx* ctx)
+{
+	CFReplay* r = ctx->replay;
+	if (r == NULL)
+		return;
+	char b = 0;
+	while (write(r->wake[1], &b, 1) < 0 && errno == EINTR)
+		;
+	pthread_join(r->thread, NULL);
+	ctx->replay = NULL;
+	Replay_Free(r);
+}
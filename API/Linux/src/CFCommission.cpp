@@ -0,0 +1,357 @@
+#include "CFHandle.h"
+#include <vector>
+
+#define COMMISSION_DEFAULT_WINDOW			16
+#define COMMISSION_DEFAULT_RETRIES			3
+#define COMMISSION_DEFAULT_DELAY			20
+#define COMMISSION_DELAY_MAX				640		// ms the low power pause doubles up to
+#define COMMISSION_BANK_EPC					0x01
+#define COMMISSION_AREAS					5		// LockTag ereas of COMMISSION_LOCK_*
+#define COMMISSION_SELECT_MAX				31		// bytes of a select mask: maskBits is one byte
+
+// State of a job while it is in the window.
+struct CommissionTag
+{
+	size_t index;
+	unsigned char step;				// COMMISSION_STEP_*
+	unsigned int tries;				// retries of the current step
+	unsigned char lockLeft;			// areas still to lock
+	int passStatus;					// first failure of the operations of the current pass
+	bool mismatch;					// the read back differs: the write went wrong, retrying the read does not help
+	unsigned char words;			// EPC words the written PC announces
+	unsigned char antenna;
+	unsigned char oldPc[2];
+	unsigned char oldCodeLen;
+	unsigned char oldCode[COMMISSION_CODE_MAX];
+	unsigned char data[2 + COMMISSION_EPC_MAX];	// PC + new EPC, the write starts at word 1 or 2 of it
+	bool writePc;
+	unsigned int attempts;
+	unsigned int retries;
+	uint64_t startUs;
+};
+
+// Tag status byte of an answer (Appendix A): 0x80 and up is a failure of the tag.
+static int Commission_TagStatus(unsigned char tagStatus)
+{
+	switch (tagStatus)
+	{
+	case 0x82: return STAT_ISO_TAG_MEM_OVF;
+	case 0x83: return STAT_ISO_TAG_MEM_LCK;
+	case 0x84: return STAT_ISO_TAG_LOW_POWER;
+	default: return tagStatus & 0x80 ? STAT_ISO_TAG_UNKNW_ERR : STAT_OK;
+	}
+}
+
+static bool Commission_LowPower(int status)
+{
+	return status == (int)STAT_GB_TAG_LOW_POWER || status == (int)STAT_ISO_TAG_LOW_POWER;
+}
+
+// Failures a later try of the same step can get past.
+static bool Commission_Retryable(int status)
+{
+	return status == (int)STAT_CMD_TAG_NO_RESP || status == (int)STAT_CMD_COMM_TIMEOUT || status == (int)STAT_CMD_DECODE_TAG_DATA_FAIL ||
+		status == (int)STAT_ISO_TAG_TAG_BUSY || Commission_LowPower(status);
+}
+
+static void Commission_Select(TagOp* op, const unsigned char* code, size_t len)
+{
+	if (len > COMMISSION_SELECT_MAX)
+		len = COMMISSION_SELECT_MAX;
+	op->maskPtr = 0;
+	op->maskBits = (unsigned char)(8 * len);
+	memcpy(op->mask, code, len);
+	op->option = len > 0 ? 0x01 : 0x00;
+}
+
+// Operations of the current step of t, appended to ops.
+static void Commission_Ops(const CommissionJob* job, CommissionTag* t, std::vector<TagOp>& ops)
+{
+	TagOp op;
+	memset(&op, 0, sizeof(op));
+	memcpy(op.accPwd, job->accPwd, 4);
+	op.opCtx = t;
+	switch (t->step)
+	{
+	case COMMISSION_STEP_SINGULATE:
+		op.type = TAGOP_READ;
+		op.memBank = COMMISSION_BANK_EPC;
+		op.wordPtr = 1;
+		op.wordCount = 1;
+		op.maskBits = job->maskBits;
+		memcpy(op.mask, job->mask, sizeof(op.mask));
+		op.option = job->maskBits != 0 ? 0x01 : 0x00;
+		ops.push_back(op);
+		break;
+	case COMMISSION_STEP_WRITE:
+		// through the whole EPC the tag answered with, so the write lands on the singulated tag
+		op.type = TAGOP_WRITE;
+		op.memBank = COMMISSION_BANK_EPC;
+		op.wordPtr = t->writePc ? 1 : 2;
+		op.wordCount = t->words + (t->writePc ? 1 : 0);
+		op.data = t->writePc ? t->data : t->data + 2;
+		Commission_Select(&op, t->oldCode, t->oldCodeLen);
+		ops.push_back(op);
+		break;
+	case COMMISSION_STEP_VERIFY:
+		op.type = TAGOP_READ;
+		op.memBank = COMMISSION_BANK_EPC;
+		op.wordPtr = 1;
+		op.wordCount = t->words + 1;
+		Commission_Select(&op, job->epc, job->epcLen);
+		ops.push_back(op);
+		break;
+	case COMMISSION_STEP_LOCK:
+		op.type = TAGOP_LOCK;
+		op.action = job->lockAction;
+		Commission_Select(&op, job->epc, job->epcLen);
+		for (unsigned char area = 0; area < COMMISSION_AREAS; area++)
+		{
+			if (!(t->lockLeft & (1 << area)))
+				continue;
+			op.memBank = area;
+			ops.push_back(op);
+		}
+		break;
+	}
+}
+
+// Per pass: the counters the adaptation looks at.
+struct CommissionPass
+{
+	CommissionStats* stats;
+	unsigned int lowPower;
+	unsigned int lost;
+};
+
+static void Commission_OnOp(int64_t hComm, const TagOp* op, const TagOpResult* result, void* userCtx)
+{
+	CommissionPass* pass = (CommissionPass*)userCtx;
+	CommissionTag* t = (CommissionTag*)op->opCtx;
+	int status = result->status;
+	if (status == STAT_OK)
+		status = Commission_TagStatus(result->tagStatus);
+
+	if (status == STAT_OK && t->step == COMMISSION_STEP_SINGULATE)
+	{
+		if (result->wordCount < 1 || result->codeLen > COMMISSION_CODE_MAX)
+			status = STAT_CMD_RESP_FORMAT_ERR;
+		else
+		{
+			t->antenna = result->antenna;
+			t->oldPc[0] = result->data[0];
+			t->oldPc[1] = result->data[1];
+			t->oldCodeLen = result->codeLen;
+			memcpy(t->oldCode, result->code, result->codeLen);
+			// the length field of the PC (its top 5 bits) has to follow a longer or shorter EPC
+			t->writePc = (t->oldPc[0] >> 3) != t->words;
+			t->data[0] = (unsigned char)((t->words << 3) | (t->oldPc[0] & 0x07));
+			t->data[1] = t->oldPc[1];
+		}
+	}
+	else if (status == STAT_OK && t->step == COMMISSION_STEP_VERIFY)
+	{
+		if (result->wordCount != t->words + 1 || (result->data[0] >> 3) != t->words ||
+			memcmp(result->data + 2, t->data + 2, 2 * t->words) != 0)
+		{
+			status = STAT_CMD_DECODE_TAG_DATA_FAIL;
+			t->mismatch = true;
+		}
+	}
+	else if (status == STAT_OK && t->step == COMMISSION_STEP_LOCK)
+		t->lockLeft &= ~(1 << op->memBank);
+
+	if (Commission_LowPower(status))
+	{
+		pass->lowPower++;
+		pass->stats->lowPower++;
+	}
+	else if (status == (int)STAT_CMD_TAG_NO_RESP)
+		pass->stats->noResp++;
+	else if (status == (int)STAT_CMD_COMM_TIMEOUT)
+	{
+		pass->lost++;
+		pass->stats->lost++;
+	}
+	t->attempts++;
+	pass->stats->ops++;
+	if (status != STAT_OK && t->passStatus == STAT_OK)
+		t->passStatus = status;
+}
+
+static void Commission_Finish(int64_t hComm, const CommissionJob* jobs, CommissionTag* t, int status,
+	CommissionCallback callback, void* userCtx, CommissionStats* stats)
+{
+	if (status == STAT_OK)
+		stats->commissioned++;
+	else
+		stats->failed++;
+	if (callback == NULL)
+		return;
+	CommissionResult result;
+	memset(&result, 0, sizeof(result));
+	result.index = t->index;
+	result.status = status;
+	result.step = t->step;
+	result.antenna = t->antenna;
+	memcpy(result.oldPc, t->oldPc, 2);
+	result.oldCodeLen = t->oldCodeLen;
+	result.oldCode = t->oldCode;
+	result.attempts = t->attempts;
+	result.retries = t->retries;
+	result.elapsedUs = t->startUs != 0 ? (unsigned int)(CFStats_NowUs() - t->startUs) : 0;
+	callback(hComm, &jobs[t->index], &result, userCtx);
+}
+
+static int Commission_Validate(const CommissionJob* job)
+{
+	if (job->epcLen < 2 || job->epcLen > COMMISSION_EPC_MAX || job->epcLen % 2 != 0)
+		return STAT_CMD_PARAM_ERR;
+	if (job->maskBits > 8 * sizeof(job->mask) || job->lockAreas >= (1 << COMMISSION_AREAS))
+		return STAT_CMD_PARAM_ERR;
+	return STAT_OK;
+}
+
+int CFCommissionRun(int64_t hComm, const CommissionJob* jobs, size_t n, const CommissionConfig* config, CommissionCallback callback, void* userCtx, CommissionStats* stats)
+{
+	CommissionStats local;
+	if (stats == NULL)
+		stats = &local;
+	memset(stats, 0, sizeof(*stats));
+	if (jobs == NULL && n > 0)
+		return STAT_CMD_PARAM_ERR;
+
+	CommissionConfig c;
+	memset(&c, 0, sizeof(c));
+	if (config != NULL)
+		c = *config;
+	if (c.window == 0)
+		c.window = COMMISSION_DEFAULT_WINDOW;
+	if (c.retries == 0)
+		c.retries = COMMISSION_DEFAULT_RETRIES;
+	if (c.retryDelayMs == 0)
+		c.retryDelayMs = COMMISSION_DEFAULT_DELAY;
+	if (c.timeout == 0)
+		c.timeout = DEF_WRITE_TIMEOUT;
+
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	unsigned int savedDepth = ctx->opDepth;
+	unsigned int depth = savedDepth ? savedDepth : OPQUEUE_DEFAULT_DEPTH;
+	std::vector<CommissionTag> window;
+	std::vector<TagOp> ops;
+	window.reserve(c.window);
+	ops.reserve(c.window * COMMISSION_AREAS);
+	stats->jobs = n;
+	uint64_t startUs = CFStats_NowUs();
+	unsigned int delay = c.retryDelayMs;
+	size_t next = 0;
+	int linkStatus = STAT_OK;
+
+	while (linkStatus == STAT_OK && (next < n || !window.empty()))
+	{
+		// a job without a selector would singulate whichever tag answers, also one of another job
+		while (next < n && window.size() < c.window && !(window.size() == 1 && jobs[window[0].index].maskBits == 0))
+		{
+			const CommissionJob* job = &jobs[next];
+			if (!window.empty() && job->maskBits == 0)
+				break;
+			CommissionTag t;
+			memset(&t, 0, sizeof(t));
+			t.index = next++;
+			t.step = COMMISSION_STEP_SINGULATE;
+			t.lockLeft = job->lockAreas;
+			t.words = job->epcLen / 2;
+			memcpy(t.data + 2, job->epc, job->epcLen);
+			int status = Commission_Validate(job);
+			if (status != STAT_OK)
+			{
+				Commission_Finish(hComm, jobs, &t, status, callback, userCtx, stats);
+				continue;
+			}
+			t.startUs = CFStats_NowUs();
+			window.push_back(t);
+		}
+		if (window.empty())
+			continue;
+
+		ops.clear();
+		for (size_t i = 0; i < window.size(); i++)
+		{
+			CommissionTag* t = &window[i];
+			t->passStatus = STAT_OK;
+			Commission_Ops(&jobs[t->index], t, ops);
+		}
+		if (!(c.flags & COMMISSION_FIXED_DEPTH))
+			CFOpQueueSetDepth(hComm, depth);
+		CommissionPass pass = { stats, 0, 0 };
+		linkStatus = CFOpQueueSubmit(hComm, &ops[0], ops.size(), Commission_OnOp, &pass, c.timeout);
+		stats->passes++;
+
+		size_t kept = 0;
+		for (size_t i = 0; i < window.size(); i++)
+		{
+			CommissionTag t = window[i];
+			if (t.passStatus == STAT_OK)
+			{
+				t.tries = 0;
+				if (t.step != COMMISSION_STEP_LOCK || t.lockLeft == 0)
+					t.step++;
+				if (t.step == COMMISSION_STEP_LOCK && t.lockLeft == 0)
+					t.step = COMMISSION_STEP_DONE;
+				if (t.step == COMMISSION_STEP_DONE)
+				{
+					Commission_Finish(hComm, jobs, &t, STAT_OK, callback, userCtx, stats);
+					continue;
+				}
+			}
+			else if (t.mismatch || !Commission_Retryable(t.passStatus) || t.tries >= c.retries || linkStatus != STAT_OK)
+			{
+				Commission_Finish(hComm, jobs, &t, t.passStatus, callback, userCtx, stats);
+				continue;
+			}
+			else
+			{
+				t.tries++;
+				t.retries++;
+				stats->retries++;
+			}
+			window[kept++] = t;
+		}
+		window.resize(kept);
+
+		// answers lost on the way back: the reader or the link cannot keep up with the window
+		if (!(c.flags & COMMISSION_FIXED_DEPTH))
+		{
+			if (pass.lost > 0)
+				depth = depth > 1 ? depth / 2 : 1;
+			else if (depth < OPQUEUE_DEPTH_MAX)
+				depth++;
+		}
+		// tags short of energy get a moment to charge up before they are tried again
+		if (pass.lowPower > 0 && !window.empty())
+		{
+			usleep(delay * 1000);
+			delay = delay * 2 < COMMISSION_DELAY_MAX ? delay * 2 : COMMISSION_DELAY_MAX;
+		}
+		else if (pass.lowPower == 0)
+			delay = c.retryDelayMs;
+	}
+
+	for (size_t i = 0; i < window.size(); i++)
+		Commission_Finish(hComm, jobs, &window[i], linkStatus, callback, userCtx, stats);
+	for (; next < n; next++)
+	{
+		CommissionTag t;
+		memset(&t, 0, sizeof(t));
+		t.index = next;
+		t.step = COMMISSION_STEP_SINGULATE;
+		Commission_Finish(hComm, jobs, &t, linkStatus, callback, userCtx, stats);
+	}
+
+	ctx->opDepth = savedDepth;
+	stats->depth = depth;
+	stats->elapsedMs = (CFStats_NowUs() - startUs) / 1000;
+	if (stats->elapsedMs > 0)
+		stats->perMinute = (unsigned int)(stats->commissioned * 60000 / stats->elapsedMs);
+	return linkStatus;
+}
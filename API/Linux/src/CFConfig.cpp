@@ -0,0 +1,368 @@
+#include "CFFrame.h"
+
+#define CONFIG_MAGIC						"CFCS"
+#define CONFIG_HEAD_LEN						18		// magic[4] version proto sn[12]
+
+// Parts the device parameters also carry: region and frequencies, RF power, Q and session.
+#define CONFIG_DEVICE_OVERLAP				(CONFIG_FREQ | CONFIG_ANT_POWER | CONFIG_QUERY)
+
+static const unsigned int g_configParts[] = { CONFIG_DEVICE_PARA, CONFIG_FREQ, CONFIG_ANT_POWER, CONFIG_GPIO, CONFIG_QUERY, CONFIG_SELECT };
+
+static unsigned char* Config_Put16(unsigned char* p, unsigned short v)
+{
+	*p++ = (unsigned char)v;
+	*p++ = (unsigned char)(v >> 8);
+	return p;
+}
+
+static unsigned short Config_Get16(const unsigned char* p)
+{
+	return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+// Field by field encoding of one part, the blob and the diff use it. Returns the length.
+static size_t Config_Encode(const ConfigSnapshot* snap, unsigned int part, unsigned char* out)
+{
+	unsigned char* p = out;
+	switch (part)
+	{
+	case CONFIG_DEVICE_PARA:
+	{
+		const DevicePara* d = &snap->device;
+		const unsigned char fields[] = { d->DEVICEARRD, d->RFIDPRO, d->WORKMODE, d->INTERFACE, d->BAUDRATE, d->WGSET, d->ANT, d->REGION,
+			d->STRATFREI[0], d->STRATFREI[1], d->STRATFRED[0], d->STRATFRED[1], d->STEPFRE[0], d->STEPFRE[1], d->CN, d->RFIDPOWER,
+			d->INVENTORYAREA, d->QVALUE, d->SESSION, d->ACSADDR, d->ACSDATALEN, d->FILTERTIME, d->TRIGGLETIME, d->BUZZERTIME, d->INTENERLTIME };
+		memcpy(p, fields, sizeof(fields));
+		p += sizeof(fields);
+		break;
+	}
+	case CONFIG_FREQ:
+		*p++ = snap->freq.region;
+		p = Config_Put16(p, snap->freq.StartFreq);
+		p = Config_Put16(p, snap->freq.StopFreq);
+		p = Config_Put16(p, snap->freq.StepFreq);
+		*p++ = snap->freq.cnt;
+		break;
+	case CONFIG_ANT_POWER:
+		*p++ = snap->antPower.Enable;
+		memcpy(p, snap->antPower.AntPower, sizeof(snap->antPower.AntPower));
+		p += sizeof(snap->antPower.AntPower);
+		break;
+	case CONFIG_GPIO:
+	{
+		const GpioPara* g = &snap->gpio;
+		*p++ = g->KCEn;
+		*p++ = g->RelayTime;
+		*p++ = g->KCPowerEn;
+		*p++ = g->TriggleMode;
+		*p++ = g->BufferEn;
+		*p++ = g->ProtocolEn;
+		*p++ = g->ProtocolType;
+		memcpy(p, g->ProtocolFormat, sizeof(g->ProtocolFormat));
+		p += sizeof(g->ProtocolFormat);
+		break;
+	}
+	case CONFIG_QUERY:
+		*p++ = snap->query.condition;
+		*p++ = snap->query.session;
+		*p++ = snap->query.target;
+		break;
+	case CONFIG_SELECT:
+	{
+		const SelectSortParam* s = &snap->select;
+		*p++ = s->target;
+		*p++ = s->trucate;
+		*p++ = s->action;
+		*p++ = s->membank;
+		p = Config_Put16(p, s->m_ptr);
+		*p++ = s->len;
+		memcpy(p, s->mask, sizeof(s->mask));
+		p += sizeof(s->mask);
+		break;
+	}
+	}
+	return p - out;
+}
+
+// Inverse of Config_Encode, false if len does not fit the part.
+static bool Config_Decode(ConfigSnapshot* snap, unsigned int part, const unsigned char* p, size_t len)
+{
+	// every part has a fixed length
+	unsigned char check[CONFIG_BLOB_MAX_LEN];
+	if (len != Config_Encode(snap, part, check))
+		return false;
+	switch (part)
+	{
+	case CONFIG_DEVICE_PARA:
+	{
+		DevicePara* d = &snap->device;
+		unsigned char* fields[] = { &d->DEVICEARRD, &d->RFIDPRO, &d->WORKMODE, &d->INTERFACE, &d->BAUDRATE, &d->WGSET, &d->ANT, &d->REGION,
+			&d->STRATFREI[0], &d->STRATFREI[1], &d->STRATFRED[0], &d->STRATFRED[1], &d->STEPFRE[0], &d->STEPFRE[1], &d->CN, &d->RFIDPOWER,
+			&d->INVENTORYAREA, &d->QVALUE, &d->SESSION, &d->ACSADDR, &d->ACSDATALEN, &d->FILTERTIME, &d->TRIGGLETIME, &d->BUZZERTIME, &d->INTENERLTIME };
+		for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+			*fields[i] = p[i];
+		break;
+	}
+	case CONFIG_FREQ:
+		snap->freq.region = p[0];
+		snap->freq.StartFreq = Config_Get16(p + 1);
+		snap->freq.StopFreq = Config_Get16(p + 3);
+		snap->freq.StepFreq = Config_Get16(p + 5);
+		snap->freq.cnt = p[7];
+		break;
+	case CONFIG_ANT_POWER:
+		snap->antPower.Enable = p[0];
+		memcpy(snap->antPower.AntPower, p + 1, sizeof(snap->antPower.AntPower));
+		break;
+	case CONFIG_GPIO:
+	{
+		GpioPara* g = &snap->gpio;
+		g->KCEn = p[0];
+		g->RelayTime = p[1];
+		g->KCPowerEn = p[2];
+		g->TriggleMode = p[3];
+		g->BufferEn = p[4];
+		g->ProtocolEn = p[5];
+		g->ProtocolType = p[6];
+		memcpy(g->ProtocolFormat, p + 7, sizeof(g->ProtocolFormat));
+		break;
+	}
+	case CONFIG_QUERY:
+		snap->query.condition = p[0];
+		snap->query.session = p[1];
+		snap->query.target = p[2];
+		break;
+	case CONFIG_SELECT:
+	{
+		SelectSortParam* s = &snap->select;
+		s->target = p[0];
+		s->trucate = p[1];
+		s->action = p[2];
+		s->membank = p[3];
+		s->m_ptr = Config_Get16(p + 4);
+		s->len = p[6];
+		memcpy(s->mask, p + 7, sizeof(s->mask));
+		break;
+	}
+	default:
+		return false;
+	}
+	snap->valid |= part;
+	return true;
+}
+
+static int Config_Get(int64_t hComm, unsigned int part, ConfigSnapshot* snap)
+{
+	switch (part)
+	{
+	case CONFIG_DEVICE_PARA: return GetDevicePara(hComm, &snap->device);
+	case CONFIG_FREQ: return GetFreq(hComm, &snap->freq);
+	case CONFIG_ANT_POWER: return GetAntPower(hComm, &snap->antPower);
+	case CONFIG_GPIO: return GetGpioPara(hComm, &snap->gpio);
+	case CONFIG_QUERY: return QueryCfgGet(hComm, snap->proto, &snap->query);
+	case CONFIG_SELECT: return SelectOrSortGet(hComm, snap->proto, &snap->select);
+	default: return STAT_CMD_PARAM_ERR;
+	}
+}
+
+static int Config_Set(int64_t hComm, unsigned int part, const ConfigSnapshot* snap)
+{
+	// the setters take their arguments by value or as non-const pointers
+	ConfigSnapshot copy = *snap;
+	switch (part)
+	{
+	case CONFIG_DEVICE_PARA: return SetDevicePara(hComm, copy.device);
+	case CONFIG_FREQ: return SetFreq(hComm, &copy.freq);
+	case CONFIG_ANT_POWER: return SetAntPower(hComm, copy.antPower);
+	case CONFIG_GPIO: return SetGpioPara(hComm, copy.gpio);
+	case CONFIG_QUERY: return QueryCfgSet(hComm, copy.proto, &copy.query);
+	case CONFIG_SELECT: return SelectOrSortSet(hComm, copy.proto, &copy.select);
+	default: return STAT_CMD_PARAM_ERR;
+	}
+}
+
+// Read the parts into snap, which already has its SN and protocol. Parts the reader refuses stay out of
+// snap->valid, only a lost link ends the pass.
+static int Config_ReadParts(int64_t hComm, unsigned int parts, ConfigSnapshot* snap)
+{
+	for (size_t i = 0; i < sizeof(g_configParts) / sizeof(g_configParts[0]); i++)
+	{
+		unsigned int part = g_configParts[i];
+		if (!(parts & part))
+			continue;
+		snap->valid &= ~part;
+		int status = Config_Get(hComm, part, snap);
+		if (status == STAT_OK)
+			snap->valid |= part;
+		else if (status == (int)STAT_DLL_DISCONNECT || status == (int)STAT_CMD_COMM_RD_FAILED)
+			return status;
+	}
+	return STAT_OK;
+}
+
+int CFConfigRead(int64_t hComm, unsigned char proto, unsigned int parts, ConfigSnapshot* snap)
+{
+	if (snap == NULL || (parts & ~CONFIG_ALL))
+		return STAT_CMD_PARAM_ERR;
+	memset(snap, 0, sizeof(*snap));
+	snap->proto = proto;
+
+	// one turn on the link: the parts describe the same moment of the reader
+	int status = CFHandleLock(hComm, 0);
+	if (status != STAT_OK)
+		return status;
+	DeviceInfo info;
+	memset(&info, 0, sizeof(info));
+	status = GetInfo(hComm, &info);
+	if (status == STAT_OK)
+	{
+		memcpy(snap->sn, info.SN, sizeof(snap->sn));
+		status = Config_ReadParts(hComm, parts ? parts : CONFIG_ALL, snap);
+	}
+	int unlock = CFHandleUnlock(hComm);
+	return status != STAT_OK ? status : unlock;
+}
+
+// blob: magic[4] version proto sn[12] { part len data[len] }... crc16 (little endian, over everything in front)
+int CFConfigSerialize(const ConfigSnapshot* snap, unsigned char* blob, size_t size, size_t* len)
+{
+	if (snap == NULL || blob == NULL || len == NULL)
+		return STAT_CMD_PARAM_ERR;
+	unsigned char buf[CONFIG_BLOB_MAX_LEN];
+	unsigned char* p = buf;
+	memcpy(p, CONFIG_MAGIC, 4);
+	p += 4;
+	*p++ = CONFIG_BLOB_VERSION;
+	*p++ = snap->proto;
+	memcpy(p, snap->sn, sizeof(snap->sn));
+	p += sizeof(snap->sn);
+	for (size_t i = 0; i < sizeof(g_configParts) / sizeof(g_configParts[0]); i++)
+	{
+		unsigned int part = g_configParts[i];
+		if (!(snap->valid & part))
+			continue;
+		*p++ = (unsigned char)part;
+		size_t partLen = Config_Encode(snap, part, p + 1);
+		*p++ = (unsigned char)partLen;
+		p += partLen;
+	}
+	p = Config_Put16(p, CFFrame_Crc16(buf, p - buf));
+
+	*len = p - buf;
+	if (size < *len)
+		return STAT_CMD_BUF_OVERFLOW;
+	memcpy(blob, buf, *len);
+	return STAT_OK;
+}
+
+int CFConfigDeserialize(const unsigned char* blob, size_t len, ConfigSnapshot* snap)
+{
+	if (blob == NULL || snap == NULL || len < CONFIG_HEAD_LEN + 2)
+		return STAT_CMD_PARAM_ERR;
+	if (memcmp(blob, CONFIG_MAGIC, 4) != 0 || blob[4] == 0)
+		return STAT_CMD_PARAM_ERR;
+	if (CFFrame_Crc16(blob, len - 2) != Config_Get16(blob + len - 2))
+		return STAT_CMD_PARAM_ERR;
+
+	ConfigSnapshot out;
+	memset(&out, 0, sizeof(out));
+	out.proto = blob[5];
+	memcpy(out.sn, blob + 6, sizeof(out.sn));
+	const unsigned char* p = blob + CONFIG_HEAD_LEN;
+	const unsigned char* end = blob + len - 2;
+	while (p < end)
+	{
+		if (end - p < 2 || end - p - 2 < p[1])
+			return STAT_CMD_PARAM_ERR;
+		unsigned int part = p[0];
+		// a part of a later version is skipped, a known one has to have its length
+		bool known = false;
+		for (size_t i = 0; i < sizeof(g_configParts) / sizeof(g_configParts[0]); i++)
+			known = known || part == g_configParts[i];
+		if (known && !Config_Decode(&out, part, p + 2, p[1]))
+			return STAT_CMD_PARAM_ERR;
+		p += 2 + p[1];
+	}
+	*snap = out;
+	return STAT_OK;
+}
+
+unsigned int CFConfigDiff(const ConfigSnapshot* a, const ConfigSnapshot* b)
+{
+	if (a == NULL || b == NULL)
+		return 0;
+	unsigned int diff = 0;
+	for (size_t i = 0; i < sizeof(g_configParts) / sizeof(g_configParts[0]); i++)
+	{
+		unsigned int part = g_configParts[i];
+		if (!(a->valid & b->valid & part))
+			continue;
+		unsigned char ea[CONFIG_BLOB_MAX_LEN], eb[CONFIG_BLOB_MAX_LEN];
+		size_t n = Config_Encode(a, part, ea);
+		// the query and select parts only compare within one protocol
+		if ((part & (CONFIG_QUERY | CONFIG_SELECT)) && a->proto != b->proto)
+			diff |= part;
+		else if (n != Config_Encode(b, part, eb) || memcmp(ea, eb, n) != 0)
+			diff |= part;
+	}
+	return diff;
+}
+
+static int Config_Apply(int64_t hComm, const ConfigSnapshot* target, ConfigSnapshot* now, unsigned int* applied)
+{
+	// parts the reader would not report are written blind
+	unsigned int todo = CFConfigDiff(target, now) | (target->valid & ~now->valid);
+	if (todo & CONFIG_DEVICE_PARA)
+	{
+		int status = Config_Set(hComm, CONFIG_DEVICE_PARA, target);
+		if (status != STAT_OK)
+			return status;
+		*applied |= CONFIG_DEVICE_PARA;
+		// the device parameters may have brought the overlapping parts to the target already
+		unsigned int reread = todo & CONFIG_DEVICE_OVERLAP;
+		if (reread)
+		{
+			status = Config_ReadParts(hComm, reread, now);
+			if (status != STAT_OK)
+				return status;
+			todo = (todo & ~reread) | (CFConfigDiff(target, now) & reread) | (reread & ~now->valid);
+		}
+	}
+	for (size_t i = 0; i < sizeof(g_configParts) / sizeof(g_configParts[0]); i++)
+	{
+		unsigned int part = g_configParts[i];
+		if (part == CONFIG_DEVICE_PARA || !(todo & part))
+			continue;
+		int status = Config_Set(hComm, part, target);
+		if (status != STAT_OK)
+			return status;
+		*applied |= part;
+	}
+	return STAT_OK;
+}
+
+int CFConfigApply(int64_t hComm, const ConfigSnapshot* target, const ConfigSnapshot* current, unsigned int flags, unsigned int* applied)
+{
+	unsigned int written = 0;
+	if (applied != NULL)
+		*applied = 0;
+	if (target == NULL || (target->valid & ~CONFIG_ALL))
+		return STAT_CMD_PARAM_ERR;
+
+	int status = CFHandleLock(hComm, 0);
+	if (status != STAT_OK)
+		return status;
+	ConfigSnapshot now;
+	if (current != NULL)
+		now = *current;
+	else
+		status = CFConfigRead(hComm, target->proto, target->valid, &now);
+	if (status == STAT_OK && !(flags & CONFIG_APPLY_ANY_SN) && memcmp(now.sn, target->sn, sizeof(now.sn)) != 0)
+		status = STAT_CMD_PARAM_ERR;
+	if (status == STAT_OK)
+		status = Config_Apply(hComm, target, &now, &written);
+	int unlock = CFHandleUnlock(hComm);
+	if (applied != NULL)
+		*applied = written;
+	return status != STAT_OK ? status : unlock;
+}
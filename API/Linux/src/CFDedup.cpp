@@ -0,0 +1,265 @@
+#include "CFHandle.h"
+#include <vector>
+
+#define DEDUP_NONE							0xFFFFFFFFu
+
+// One tag (per antenna) seen within the window, kept in a hash chain and in the LRU list.
+struct DedupEntry
+{
+	uint64_t hash;
+	unsigned int chain;				// next entry of the bucket
+	unsigned int prev, next;		// LRU list, head is the least recently seen
+	uint64_t firstMs, lastMs;
+	unsigned int count;
+	short peakRssi;
+	TagInfoCompact tag;				// last read
+	unsigned char codeLen;
+	unsigned char code[DEDUP_CODE_MAX];
+};
+
+struct TagDedup
+{
+	TagDedupConfig config;
+	std::vector<DedupEntry> entries;
+	std::vector<unsigned int> buckets;
+	unsigned int mask;
+	unsigned int free;				// free entries, linked through chain
+	unsigned int head, tail;
+	unsigned int used;
+	TagSightingCallback streamCallback;	// InventoryStartDedup
+	void* streamCtx;
+};
+
+// FNV-1a over the full code (and the antenna unless DEDUP_ANY_ANTENNA)
+static uint64_t Dedup_Hash(const unsigned char* code, size_t len, int antenna)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ code[i]) * 1099511628211ULL;
+	if (antenna >= 0)
+		hash = (hash ^ (unsigned int)antenna) * 1099511628211ULL;
+	return hash;
+}
+
+static void Dedup_Unlink(TagDedup* dd, unsigned int i)
+{
+	DedupEntry& e = dd->entries[i];
+	if (e.prev != DEDUP_NONE)
+		dd->entries[e.prev].next = e.next;
+	else
+		dd->head = e.next;
+	if (e.next != DEDUP_NONE)
+		dd->entries[e.next].prev = e.prev;
+	else
+		dd->tail = e.prev;
+}
+
+static void Dedup_Append(TagDedup* dd, unsigned int i)
+{
+	DedupEntry& e = dd->entries[i];
+	e.prev = dd->tail;
+	e.next = DEDUP_NONE;
+	if (dd->tail != DEDUP_NONE)
+		dd->entries[dd->tail].next = i;
+	else
+		dd->head = i;
+	dd->tail = i;
+}
+
+static void Dedup_Emit(TagDedup* dd, unsigned int i, int event, TagSightingCallback callback, void* userCtx)
+{
+	const DedupEntry& e = dd->entries[i];
+	TagSighting s;
+	s.event = event;
+	s.tag = e.tag;
+	s.antenna = e.tag.antenna;
+	s.peakRssi = e.peakRssi;
+	s.count = e.count;
+	s.firstSeenMs = e.firstMs;
+	s.lastSeenMs = e.lastMs;
+	s.codeLen = e.codeLen;
+	s.code = e.code;
+	callback(&s, userCtx);
+}
+
+// Takes entry i out of its bucket, the LRU list and the table.
+static void Dedup_Remove(TagDedup* dd, unsigned int i)
+{
+	unsigned int* link = &dd->buckets[dd->entries[i].hash & dd->mask];
+	while (*link != i)
+		link = &dd->entries[*link].chain;
+	*link = dd->entries[i].chain;
+	Dedup_Unlink(dd, i);
+	dd->entries[i].chain = dd->free;
+	dd->free = i;
+	dd->used--;
+}
+
+static unsigned int Dedup_Find(TagDedup* dd, uint64_t hash, const unsigned char* code, size_t codeLen, int antenna)
+{
+	for (unsigned int i = dd->buckets[hash & dd->mask]; i != DEDUP_NONE; i = dd->entries[i].chain)
+	{
+		const DedupEntry& e = dd->entries[i];
+		if (e.hash == hash && e.codeLen == codeLen && memcmp(e.code, code, codeLen) == 0
+			&& (antenna < 0 || e.tag.antenna == antenna))
+			return i;
+	}
+	return DEDUP_NONE;
+}
+
+static void Dedup_ExpireAt(TagDedup* dd, uint64_t now, TagSightingCallback callback, void* userCtx)
+{
+	// the LRU head is the entry seen longest ago, stop at the first one still inside the window
+	while (dd->head != DEDUP_NONE && now - dd->entries[dd->head].lastMs >= dd->config.windowMs)
+	{
+		unsigned int i = dd->head;
+		Dedup_Emit(dd, i, DEDUP_DEPART, callback, userCtx);
+		Dedup_Remove(dd, i);
+	}
+}
+
+TagDedup* TagDedupCreate(const TagDedupConfig* config)
+{
+	if (config == NULL || config->windowMs == 0 || config->maxEntries == 0 || config->maxEntries >= DEDUP_NONE / 2)
+		return NULL;
+
+	TagDedup* dd = new TagDedup();
+	dd->config = *config;
+	dd->entries.resize(config->maxEntries);
+	unsigned int buckets = 16;
+	while (buckets < 2 * config->maxEntries)
+		buckets <<= 1;
+	dd->buckets.assign(buckets, DEDUP_NONE);
+	dd->mask = buckets - 1;
+	for (unsigned int i = 0; i < config->maxEntries; i++)
+		dd->entries[i].chain = i + 1 < config->maxEntries ? i + 1 : DEDUP_NONE;
+	dd->free = 0;
+	dd->head = dd->tail = DEDUP_NONE;
+	dd->used = 0;
+	dd->streamCallback = NULL;
+	dd->streamCtx = NULL;
+	return dd;
+}
+
+void TagDedupDestroy(TagDedup* dedup)
+{
+	delete dedup;
+}
+
+int TagDedupFeed(TagDedup* dedup, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, TagSightingCallback callback, void* userCtx)
+{
+	if (dedup == NULL || callback == NULL || (tags == NULL && count != 0))
+		return STAT_CMD_PARAM_ERR;
+
+	TagDedup* dd = dedup;
+	uint64_t now = CFStats_NowUs() / 1000;
+	Dedup_ExpireAt(dd, now, callback, userCtx);
+
+	for (size_t t = 0; t < count; t++)
+	{
+		const TagInfoCompact& tag = tags[t];
+		const unsigned char* code = TagCompactCode(&tag, arena);
+		size_t codeLen = tag.codeLen;
+		int antenna = (dd->config.flags & DEDUP_ANY_ANTENNA) ? -1 : tag.antenna;
+		uint64_t hash = Dedup_Hash(code, codeLen, antenna);
+		if (codeLen > DEDUP_CODE_MAX)
+			codeLen = DEDUP_CODE_MAX;
+
+		unsigned int i = Dedup_Find(dd, hash, code, codeLen, antenna);
+		if (i != DEDUP_NONE)
+		{
+			DedupEntry& e = dd->entries[i];
+			e.lastMs = now;
+			e.count++;
+			if (tag.rssi > e.peakRssi)
+				e.peakRssi = tag.rssi;
+			e.tag = tag;
+			Dedup_Unlink(dd, i);
+			Dedup_Append(dd, i);
+			continue;
+		}
+
+		if (dd->free == DEDUP_NONE)
+		{
+			// full: the tag seen longest ago makes room and reports what it had so far
+			unsigned int victim = dd->head;
+			Dedup_Emit(dd, victim, DEDUP_EVICT, callback, userCtx);
+			Dedup_Remove(dd, victim);
+		}
+		i = dd->free;
+		DedupEntry& e = dd->entries[i];
+		dd->free = e.chain;
+		e.hash = hash;
+		e.firstMs = e.lastMs = now;
+		e.count = 1;
+		e.peakRssi = tag.rssi;
+		e.tag = tag;
+		e.tag.arenaOff = TAGCOMPACT_NO_ARENA;
+		if (e.tag.codeLen > TAGCOMPACT_CODE_LEN)
+			e.tag.codeLen = TAGCOMPACT_CODE_LEN;
+		e.codeLen = (unsigned char)codeLen;
+		memcpy(e.code, code, codeLen);
+		unsigned int* bucket = &dd->buckets[hash & dd->mask];
+		e.chain = *bucket;
+		*bucket = i;
+		Dedup_Append(dd, i);
+		dd->used++;
+		if (!(dd->config.flags & DEDUP_NO_ARRIVE))
+			Dedup_Emit(dd, i, DEDUP_ARRIVE, callback, userCtx);
+	}
+	return STAT_OK;
+}
+
+int TagDedupExpire(TagDedup* dedup, TagSightingCallback callback, void* userCtx)
+{
+	if (dedup == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+	Dedup_ExpireAt(dedup, CFStats_NowUs() / 1000, callback, userCtx);
+	return STAT_OK;
+}
+
+int TagDedupFlush(TagDedup* dedup, TagSightingCallback callback, void* userCtx)
+{
+	if (dedup == NULL)
+		return STAT_CMD_PARAM_ERR;
+	while (dedup->head != DEDUP_NONE)
+	{
+		unsigned int i = dedup->head;
+		if (callback != NULL)
+			Dedup_Emit(dedup, i, DEDUP_FLUSH, callback, userCtx);
+		Dedup_Remove(dedup, i);
+	}
+	return STAT_OK;
+}
+
+size_t TagDedupCount(const TagDedup* dedup)
+{
+	return dedup ? dedup->used : 0;
+}
+
+static void Dedup_StreamSink(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	TagDedup* dd = (TagDedup*)userCtx;
+	if (status != STAT_OK)
+	{
+		// inventory over: what is still open will not be seen again on this stream
+		TagDedupFlush(dd, dd->streamCallback, dd->streamCtx);
+		return;
+	}
+	TagDedupFeed(dd, tags, count, arena, dd->streamCallback, dd->streamCtx);
+}
+
+static void Dedup_StreamIdle(int64_t hComm, void* userCtx)
+{
+	TagDedup* dd = (TagDedup*)userCtx;
+	Dedup_ExpireAt(dd, CFStats_NowUs() / 1000, dd->streamCallback, dd->streamCtx);
+}
+
+int InventoryStartDedup(int64_t hComm, TagDedup* dedup, TagSightingCallback callback, void* userCtx, unsigned int flags)
+{
+	if (dedup == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+	dedup->streamCallback = callback;
+	dedup->streamCtx = userCtx;
+	return CFStream_Start(hComm, Dedup_StreamSink, Dedup_StreamIdle, dedup, flags);
+}
@@ -0,0 +1,500 @@
+#include "CFHandle.h"
+#include "hid.h"
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#define DISCOVER_DEFAULT_BAUD				115200
+#define DISCOVER_HID_INFO_LEN				512		// CFHid_GetUsbInfo buffer
+#define DISCOVER_SYSFS_DEPTH				6		// levels from a tty up to its USB device
+
+// What a path was found to be last time, keyed by the path.
+struct Discover_Entry
+{
+	unsigned short vendorId;
+	unsigned short productId;
+	std::string serial;
+	bool reader;
+	unsigned char sn[12];
+};
+
+static pthread_mutex_t s_cacheLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, Discover_Entry> s_cache;
+static std::string s_cacheFile;		// file s_cache was loaded from
+
+// A serial probe runs OpenDevice / GetInfo, which may block past the deadline: its result is
+// taken at the deadline, and CFDiscoverAll joins it before returning so no port stays open.
+struct Discover_Probe
+{
+	struct Discover_Run* run;
+	DiscoverResult result;
+	int baudRate;
+	bool finished;					// guarded by run->lock
+};
+
+struct Discover_Run
+{
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	unsigned int pending;
+	std::vector<Discover_Probe*> probes;
+	std::vector<pthread_t> threads;	// joined by CFDiscoverAll
+};
+
+static void Discover_FreeRun(Discover_Run* run)
+{
+	for (size_t i = 0; i < run->probes.size(); i++)
+		delete run->probes[i];
+	pthread_mutex_destroy(&run->lock);
+	pthread_cond_destroy(&run->done);
+	delete run;
+}
+
+// Copies src into dst[size], cut to fit.
+static void Discover_Copy(char* dst, size_t size, const char* src)
+{
+	size_t len = strnlen(src, size - 1);
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+static bool Discover_ReadLine(const std::string& path, char* buf, size_t size)
+{
+	FILE* f = fopen(path.c_str(), "r");
+	if (f == NULL)
+		return false;
+	bool ok = fgets(buf, (int)size, f) != NULL;
+	fclose(f);
+	if (ok)
+		buf[strcspn(buf, "\r\n")] = '\0';
+	return ok;
+}
+
+// USB ids of a tty from sysfs, walking up from the interface to the device that carries idVendor.
+static bool Discover_UsbIds(const char* name, unsigned short* vendorId, unsigned short* productId, std::string* serial)
+{
+	char link[PATH_MAX];
+	char dir[PATH_MAX];
+	snprintf(link, sizeof(link), "/sys/class/tty/%s/device", name);
+	if (realpath(link, dir) == NULL)
+		return false;
+	std::string path = dir;
+	for (int level = 0; level < DISCOVER_SYSFS_DEPTH && path.size() > 1; level++)
+	{
+		char value[DISCOVER_SERIAL_LEN];
+		if (Discover_ReadLine(path + "/idVendor", value, sizeof(value)))
+		{
+			*vendorId = (unsigned short)strtoul(value, NULL, 16);
+			if (Discover_ReadLine(path + "/idProduct", value, sizeof(value)))
+				*productId = (unsigned short)strtoul(value, NULL, 16);
+			serial->clear();
+			if (Discover_ReadLine(path + "/serial", value, sizeof(value)))
+				*serial = value;
+			return true;
+		}
+		path = path.substr(0, path.rfind('/'));
+	}
+	return false;
+}
+
+// Cache file: one line per path, "path vid pid reader sn serial" with '-' for an empty serial.
+static void Discover_LoadCache(const char* file)
+{
+	if (file == NULL || s_cacheFile == file)
+		return;
+	s_cacheFile = file;
+	FILE* f = fopen(file, "r");
+	if (f == NULL)
+		return;
+	char line[DISCOVER_PATH_LEN + DISCOVER_SERIAL_LEN + 64];
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		char path[DISCOVER_PATH_LEN], sn[32], serial[DISCOVER_SERIAL_LEN];
+		unsigned int vid, pid, reader;
+		if (sscanf(line, "%127s %x %x %u %24s %63s", path, &vid, &pid, &reader, sn, serial) != 6)
+			continue;
+		Discover_Entry entry;
+		entry.vendorId = (unsigned short)vid;
+		entry.productId = (unsigned short)pid;
+		entry.reader = reader != 0;
+		entry.serial = strcmp(serial, "-") == 0 ? "" : serial;
+		memset(entry.sn, 0, sizeof(entry.sn));
+		for (size_t i = 0; i < sizeof(entry.sn) && sn[2 * i] != '\0' && sn[2 * i + 1] != '\0'; i++)
+		{
+			char byte[3] = { sn[2 * i], sn[2 * i + 1], '\0' };
+			entry.sn[i] = (unsigned char)strtoul(byte, NULL, 16);
+		}
+		s_cache[path] = entry;
+	}
+	fclose(f);
+}
+
+static void Discover_SaveCache(const char* file)
+{
+	if (file == NULL)
+		return;
+	std::string tmp = std::string(file) + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "w");
+	if (f == NULL)
+		return;
+	for (std::map<std::string, Discover_Entry>::iterator it = s_cache.begin(); it != s_cache.end(); ++it)
+	{
+		const Discover_Entry& e = it->second;
+		char sn[2 * sizeof(e.sn) + 1];
+		TagCodeToHex(e.sn, sizeof(e.sn), sn, sizeof(sn));
+		fprintf(f, "%s %04x %04x %u %s %s\n", it->first.c_str(), e.vendorId, e.productId, e.reader ? 1 : 0, sn,
+			e.serial.empty() ? "-" : e.serial.c_str());
+	}
+	// readers of the file never see it half written
+	if (fclose(f) == 0)
+		rename(tmp.c_str(), file);
+}
+
+static void* Discover_ProbeThread(void* arg)
+{
+	Discover_Probe* probe = (Discover_Probe*)arg;
+	Discover_Run* run = probe->run;
+	// CFDiscoverAll may read probe->result at the deadline, the probe fills a copy
+	pthread_mutex_lock(&run->lock);
+	DiscoverResult r = probe->result;
+	pthread_mutex_unlock(&run->lock);
+	int64_t hComm = 0;
+	int status = CFHandle_OpenSerial(&hComm, r.path, probe->baudRate);
+	if (status == STAT_OK)
+	{
+		DeviceInfo info;
+		status = GetInfo(hComm, &info);
+		if (status == STAT_OK)
+		{
+			r.flags |= DISCOVER_READER;
+			memcpy(r.sn, info.SN, sizeof(r.sn));
+		}
+		CFHandle_Close(hComm);
+	}
+	r.status = status;
+
+	pthread_mutex_lock(&run->lock);
+	probe->result = r;
+	probe->finished = true;
+	run->pending--;
+	pthread_cond_broadcast(&run->done);
+	pthread_mutex_unlock(&run->lock);
+	return NULL;
+}
+
+static std::vector<std::string> Discover_SerialPorts()
+{
+	std::vector<std::string> ports;
+	DIR* dir = opendir("/dev");
+	if (dir == NULL)
+		return ports;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (strncmp(entry->d_name, "ttyUSB", 6) == 0 || strncmp(entry->d_name, "ttyACM", 6) == 0)
+			ports.push_back(entry->d_name);
+	}
+	closedir(dir);
+	std::sort(ports.begin(), ports.end());
+	return ports;
+}
+
+static void Discover_Narrow(char* dst, size_t size, const wchar_t* src)
+{
+	size_t i = 0;
+	// USB serial numbers are ASCII
+	for (; src != NULL && src[i] != 0 && i + 1 < size; i++)
+		dst[i] = src[i] < 0x80 ? (char)src[i] : '?';
+	dst[i] = '\0';
+}
+
+// HID readers as libCFApi numbers them for OpenHidConnection, with the ids of the matching hid_enumerate entry.
+static void Discover_Hid(std::vector<DiscoverResult>& found)
+{
+	int count = CFHid_GetUsbCount();
+	if (count <= 0)
+		return;
+	struct hid_device_info* devs = hid_enumerate(0, 0);
+	for (int i = 0; i < count; i++)
+	{
+		char info[DISCOVER_HID_INFO_LEN];
+		memset(info, 0, sizeof(info));
+		if (CFHid_GetUsbInfo((unsigned short)i, info) != STAT_OK)
+			continue;
+		DiscoverResult r;
+		memset(&r, 0, sizeof(r));
+		r.kind = DISCOVER_HID;
+		r.flags = DISCOVER_READER;
+		r.index = (unsigned short)i;
+		r.status = STAT_OK;
+		Discover_Copy(r.path, sizeof(r.path), info);
+		for (struct hid_device_info* d = devs; d != NULL; d = d->next)
+		{
+			if (d->path == NULL || strstr(info, d->path) == NULL)
+				continue;
+			r.vendorId = d->vendor_id;
+			r.productId = d->product_id;
+			Discover_Copy(r.path, sizeof(r.path), d->path);
+			Discover_Narrow(r.serial, sizeof(r.serial), d->serial_number);
+			break;
+		}
+		found.push_back(r);
+	}
+	hid_free_enumeration(devs);
+}
+
+struct Discover_Net
+{
+	const DiscoverOptions* options;
+	struct timespec deadline;
+	std::vector<DiscoverResult> found;
+};
+
+// Broadcasts the probe payload and collects the hosts that answer until the deadline.
+static void* Discover_NetThread(void* arg)
+{
+	Discover_Net* net = (Discover_Net*)arg;
+	const DiscoverOptions* o = net->options;
+	int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return NULL;
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+	struct sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons(o->netUdpPort);
+	to.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+	if (sendto(fd, o->netProbe, o->netProbeLen, 0, (struct sockaddr*)&to, sizeof(to)) < 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	for (;;)
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long ms = (net->deadline.tv_sec - now.tv_sec) * 1000 + (net->deadline.tv_nsec - now.tv_nsec) / 1000000;
+		if (ms <= 0)
+			break;
+		struct pollfd p = { fd, POLLIN, 0 };
+		if (poll(&p, 1, (int)ms) <= 0)
+			break;
+		unsigned char reply[512];
+		struct sockaddr_in from;
+		socklen_t fromLen = sizeof(from);
+		if (recvfrom(fd, reply, sizeof(reply), 0, (struct sockaddr*)&from, &fromLen) < 0)
+			continue;
+		DiscoverResult r;
+		memset(&r, 0, sizeof(r));
+		r.kind = DISCOVER_NET;
+		r.flags = DISCOVER_READER;
+		r.port = o->netTcpPort;
+		r.status = STAT_OK;
+		inet_ntop(AF_INET, &from.sin_addr, r.path, sizeof(r.path));
+		bool seen = false;
+		for (size_t i = 0; i < net->found.size() && !seen; i++)
+			seen = strcmp(net->found[i].path, r.path) == 0;
+		if (!seen)
+			net->found.push_back(r);
+	}
+	close(fd);
+	return NULL;
+}
+
+static bool Discover_PathLess(const DiscoverResult& a, const DiscoverResult& b)
+{
+	return strcmp(a.path, b.path) < 0;
+}
+
+int CFDiscoverAll(const DiscoverOptions* options, DiscoverResult* results, size_t n, size_t* count)
+{
+	if (count == NULL || (results == NULL && n != 0))
+		return STAT_CMD_PARAM_ERR;
+	*count = 0;
+	DiscoverOptions o;
+	memset(&o, 0, sizeof(o));
+	if (options != NULL)
+		o = *options;
+	if (o.kinds == 0)
+		o.kinds = DISCOVER_HID | DISCOVER_SERIAL;
+	if (o.timeoutMs == 0)
+		o.timeoutMs = DISCOVER_DEFAULT_TIMEOUT;
+	if (o.baudRate == 0)
+		o.baudRate = DISCOVER_DEFAULT_BAUD;
+	if ((o.kinds & DISCOVER_NET) && (o.netUdpPort == 0 || o.netProbe == NULL || o.netProbeLen == 0))
+		return STAT_CMD_PARAM_ERR;
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += o.timeoutMs / 1000;
+	deadline.tv_nsec += (long)(o.timeoutMs % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	std::vector<DiscoverResult> found;
+	std::vector<DiscoverResult> cached;
+
+	// serial ports first: their probes are the slow part and run while the rest is enumerated
+	Discover_Run* run = new Discover_Run();
+	pthread_mutex_init(&run->lock, NULL);
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&run->done, &attr);
+	pthread_condattr_destroy(&attr);
+	run->pending = 0;
+	if (o.kinds & DISCOVER_SERIAL)
+	{
+		std::vector<std::string> ports = Discover_SerialPorts();
+		pthread_mutex_lock(&s_cacheLock);
+		Discover_LoadCache(o.cacheFile);
+		for (size_t i = 0; i < ports.size(); i++)
+		{
+			DiscoverResult r;
+			memset(&r, 0, sizeof(r));
+			r.kind = DISCOVER_SERIAL;
+			snprintf(r.path, sizeof(r.path), "/dev/%s", ports[i].c_str());
+			std::string serial;
+			if (Discover_UsbIds(ports[i].c_str(), &r.vendorId, &r.productId, &serial))
+				Discover_Copy(r.serial, sizeof(r.serial), serial.c_str());
+			if ((o.vendorId != 0 && r.vendorId != o.vendorId) || (o.productId != 0 && r.productId != o.productId))
+				continue;
+
+			std::map<std::string, Discover_Entry>::iterator it = s_cache.find(r.path);
+			if (!(o.flags & DISCOVER_VERIFY) && it != s_cache.end() && it->second.vendorId == r.vendorId
+				&& it->second.productId == r.productId && it->second.serial == r.serial)
+			{
+				r.flags = DISCOVER_CACHED | (it->second.reader ? DISCOVER_READER : 0);
+				r.status = STAT_OK;
+				memcpy(r.sn, it->second.sn, sizeof(r.sn));
+				cached.push_back(r);
+				continue;
+			}
+
+			Discover_Probe* probe = new Discover_Probe();
+			probe->run = run;
+			probe->result = r;
+			probe->baudRate = o.baudRate;
+			probe->finished = false;
+			pthread_t thread;
+			pthread_mutex_lock(&run->lock);
+			run->probes.push_back(probe);
+			run->pending++;
+			pthread_mutex_unlock(&run->lock);
+			if (pthread_create(&thread, NULL, Discover_ProbeThread, probe) != 0)
+			{
+				pthread_mutex_lock(&run->lock);
+				probe->result.status = STAT_DLL_INNER_FAILED;
+				probe->finished = true;
+				run->pending--;
+				pthread_mutex_unlock(&run->lock);
+				continue;
+			}
+			run->threads.push_back(thread);
+		}
+		pthread_mutex_unlock(&s_cacheLock);
+	}
+
+	Discover_Net net;
+	net.options = &o;
+	net.deadline = deadline;
+	pthread_t netThread;
+	bool netStarted = (o.kinds & DISCOVER_NET) && pthread_create(&netThread, NULL, Discover_NetThread, &net) == 0;
+
+	if (o.kinds & DISCOVER_HID)
+		Discover_Hid(found);
+
+	// take what the probes found by the deadline, the rest is reported as timed out
+	pthread_mutex_lock(&run->lock);
+	while (run->pending > 0)
+	{
+		if (pthread_cond_timedwait(&run->done, &run->lock, &deadline) == ETIMEDOUT)
+			break;
+	}
+	std::vector<DiscoverResult> probed;
+	for (size_t i = 0; i < run->probes.size(); i++)
+	{
+		Discover_Probe* probe = run->probes[i];
+		probed.push_back(probe->result);
+		if (!probe->finished)
+		{
+			probed.back().flags |= DISCOVER_TIMEOUT;
+			probed.back().status = STAT_CMD_COMM_TIMEOUT;
+		}
+	}
+	pthread_mutex_unlock(&run->lock);
+	// a late probe closes its port once GetInfo gives up, nothing of it outlives the call
+	for (size_t i = 0; i < run->threads.size(); i++)
+		pthread_join(run->threads[i], NULL);
+	Discover_FreeRun(run);
+
+	if (netStarted)
+		pthread_join(netThread, NULL);
+
+	pthread_mutex_lock(&s_cacheLock);
+	for (size_t i = 0; i < probed.size(); i++)
+	{
+		const DiscoverResult& r = probed[i];
+		if (r.flags & DISCOVER_TIMEOUT)
+			continue;
+		Discover_Entry& e = s_cache[r.path];
+		e.vendorId = r.vendorId;
+		e.productId = r.productId;
+		e.serial = r.serial;
+		e.reader = (r.flags & DISCOVER_READER) != 0;
+		memcpy(e.sn, r.sn, sizeof(e.sn));
+	}
+	if (!probed.empty())
+		Discover_SaveCache(o.cacheFile);
+	pthread_mutex_unlock(&s_cacheLock);
+
+	// HID, serial in port order, network
+	std::vector<DiscoverResult> serial(cached);
+	serial.insert(serial.end(), probed.begin(), probed.end());
+	std::sort(serial.begin(), serial.end(), Discover_PathLess);
+	for (size_t i = 0; i < serial.size(); i++)
+	{
+		if ((serial[i].flags & DISCOVER_READER) || (o.flags & DISCOVER_ALL_PORTS))
+			found.push_back(serial[i]);
+	}
+	found.insert(found.end(), net.found.begin(), net.found.end());
+
+	*count = found.size() < n ? found.size() : n;
+	for (size_t i = 0; i < *count; i++)
+		results[i] = found[i];
+	return found.size() > n ? STAT_CMD_BUF_OVERFLOW : STAT_OK;
+}
+
+int CFDiscoverOpen(const DiscoverResult* results, size_t n, int baudRate, unsigned int timeoutMs, int64_t* handles, int* statuses)
+{
+	if ((results == NULL || handles == NULL || statuses == NULL) && n != 0)
+		return STAT_CMD_PARAM_ERR;
+
+	// one after the other: the opens of libCFApi take turns anyway (CFHandle_OpenSerial)
+	int first = STAT_OK;
+	for (size_t i = 0; i < n; i++)
+	{
+		const DiscoverResult* r = &results[i];
+		handles[i] = 0;
+		if (r->kind == DISCOVER_HID)
+			statuses[i] = CFHandle_OpenHid(&handles[i], r->index);
+		else if (r->kind == DISCOVER_NET)
+			statuses[i] = CFHandle_OpenNet(&handles[i], (char*)r->path, r->port, timeoutMs ? timeoutMs : POOL_DEFAULT_CONNECT_TIMEOUT);
+		else
+			statuses[i] = CFHandle_OpenSerial(&handles[i], (char*)r->path, baudRate ? baudRate : DISCOVER_DEFAULT_BAUD);
+		if (first == STAT_OK && statuses[i] != STAT_OK)
+			first = statuses[i];
+	}
+	return first;
+}
@@ -0,0 +1,278 @@
+#include "CFFrame.h"
+#include <poll.h>
+
+// Slice-by-8 tables: crc[k][b] is the CRC contribution of byte b followed by k zero bytes.
+struct FrameCrcTables
+{
+	unsigned short crc[8][256];
+
+	FrameCrcTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			unsigned short c = (unsigned short)i;
+			for (int bit = 0; bit < 8; bit++)
+				c = (c & 1) ? (unsigned short)((c >> 1) ^ 0x8408) : (unsigned short)(c >> 1);
+			crc[0][i] = c;
+		}
+		for (int k = 1; k < 8; k++)
+			for (int i = 0; i < 256; i++)
+				crc[k][i] = (unsigned short)((crc[k - 1][i] >> 8) ^ crc[0][crc[k - 1][i] & 0xFF]);
+	}
+};
+
+static const FrameCrcTables g_crcTables;
+
+unsigned short CFFrame_Crc16(const unsigned char* data, size_t len)
+{
+	const unsigned short (*t)[256] = g_crcTables.crc;
+	unsigned int crc = 0xFFFF;
+	// 8 bytes per step, the 16 bit register only overlaps the first two of them
+	for (; len >= 8; len -= 8, data += 8)
+	{
+		unsigned int x = crc ^ (data[0] | (data[1] << 8));
+		crc = t[7][x & 0xFF] ^ t[6][x >> 8] ^ t[5][data[2]] ^ t[4][data[3]]
+			^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+	}
+	for (; len > 0; len--, data++)
+		crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+	return (unsigned short)crc;
+}
+
+size_t CFFrame_Build(unsigned char* buf, unsigned short cmd, size_t len)
+{
+	return CFFrame_BuildFrom(buf, FRAME_ADDR_BROADCAST, cmd, len);
+}
+
+size_t CFFrame_BuildFrom(unsigned char* buf, unsigned char addr, unsigned short cmd, size_t len)
+{
+	buf[0] = FRAME_HEAD0;
+	buf[1] = addr;
+	buf[2] = (unsigned char)(cmd >> 8);
+	buf[3] = (unsigned char)cmd;
+	buf[4] = (unsigned char)len;
+	unsigned short crc = CFFrame_Crc16(buf, FRAME_HEAD_LEN + len);
+	buf[FRAME_HEAD_LEN + len] = (unsigned char)(crc >> 8);
+	buf[FRAME_HEAD_LEN + len + 1] = (unsigned char)crc;
+	return FRAME_HEAD_LEN + len + 2;
+}
+
+size_t CFFrame_BuildLong(unsigned char* buf, unsigned short cmd, size_t len)
+{
+	buf[0] = FRAME_HEAD0;
+	buf[1] = FRAME_ADDR_BROADCAST;
+	buf[2] = (unsigned char)(cmd >> 8);
+	buf[3] = (unsigned char)cmd;
+	buf[4] = (unsigned char)(len >> 8);
+	buf[5] = (unsigned char)len;
+	unsigned short crc = CFFrame_Crc16(buf, FRAME_LONG_HEAD_LEN + len);
+	buf[FRAME_LONG_HEAD_LEN + len] = (unsigned char)(crc >> 8);
+	buf[FRAME_LONG_HEAD_LEN + len + 1] = (unsigned char)crc;
+	return FRAME_LONG_HEAD_LEN + len + 2;
+}
+
+void CFFrame_Deadline(struct timespec* deadline, unsigned short timeout)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += timeout / 1000;
+	deadline->tv_nsec += (long)(timeout % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+int CFFrame_RemainingMs(const struct timespec* deadline)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long ms = (deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+	return ms > 0 ? (int)ms : 0;
+}
+
+static int Frame_ReadFull(int fd, unsigned char* buf, size_t len, const struct timespec* deadline)
+{
+	size_t got = 0;
+	while (got < len)
+	{
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		int ret = poll(&pfd, 1, CFFrame_RemainingMs(deadline));
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			return STAT_CMD_COMM_RD_FAILED;
+		if (ret == 0)
+			return STAT_CMD_COMM_TIMEOUT;
+		ssize_t n = read(fd, buf + got, len - got);
+		if (n < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (n < 0)
+			return STAT_CMD_COMM_RD_FAILED;
+		if (n == 0)
+			return STAT_DLL_DISCONNECT;
+		got += n;
+	}
+	return STAT_OK;
+}
+
+// Whether the CRC at buf + headLen + len closes the frame. libCFApi checks long frames over
+// (unsigned char)(headLen + len) bytes; the reader's full-length CRC is taken as well.
+static bool Frame_CrcOk(const unsigned char* buf, size_t headLen, size_t len)
+{
+	unsigned short got = (unsigned short)((buf[headLen + len] << 8) | buf[headLen + len + 1]);
+	if (CFFrame_Crc16(buf, headLen + len) == got)
+		return true;
+	return headLen == FRAME_LONG_HEAD_LEN && headLen + len > 0xFF && CFFrame_Crc16(buf, (unsigned char)(headLen + len)) == got;
+}
+
+// CFFrame_Read of a short (5 byte head) or long (6 byte head, 16 bit length) frame.
+static int Frame_Read(int fd, unsigned char* buf, size_t* frameLen, const struct timespec* deadline, CFStatsCtx* stats, bool longFrame)
+{
+	// resynchronise on the head, a frame cut by a previous timeout leaves its tail behind. Every
+	// frame is longer than its head, so reading what is missing of the head never takes bytes
+	// past the frame; the bytes read are scanned for the head at once instead of one read each.
+	// A head byte inside a payload starts a false frame: when its CRC fails, the bytes read are
+	// scanned again from the byte after it, so the frame behind it is not lost.
+	size_t headLen = longFrame ? FRAME_LONG_HEAD_LEN : FRAME_HEAD_LEN;
+	size_t have = 0, skipped = 0, need = 0;
+	unsigned int crcErrors = 0;
+	int status = STAT_OK;
+	for (;;)
+	{
+		while (have < headLen)
+		{
+			status = Frame_ReadFull(fd, buf + have, headLen - have, deadline);
+			if (status != STAT_OK)
+				break;
+			have = headLen;
+			const unsigned char* p = (const unsigned char*)memchr(buf, FRAME_HEAD0, have);
+			if (p == NULL)
+			{
+				skipped += have;
+				have = 0;
+			}
+			else if (p != buf)
+			{
+				skipped += p - buf;
+				have -= p - buf;
+				memmove(buf, p, have);
+			}
+		}
+		if (status != STAT_OK)
+			break;
+
+		size_t len = longFrame ? (size_t)((buf[4] << 8) | buf[5]) : buf[4];
+		// a long head claiming more than any frame carries is a false start, nothing more is read for it
+		bool fits = len <= FRAME_LONG_MAX_PAYLOAD;
+		need = headLen + len + 2;
+		if (fits && have < need)
+		{
+			status = Frame_ReadFull(fd, buf + have, need - have, deadline);
+			if (status != STAT_OK)
+				break;
+			have = need;
+		}
+		if (fits && Frame_CrcOk(buf, headLen, len))
+		{
+			// what a false start read past this frame is gone with it
+			skipped += have - need;
+			*frameLen = need;
+			break;
+		}
+		if (fits)
+			crcErrors++;
+		const unsigned char* p = (const unsigned char*)memchr(buf + 1, FRAME_HEAD0, have - 1);
+		if (p == NULL)
+		{
+			status = STAT_CMD_RESP_CRC_ERR;
+			need = have;
+			break;
+		}
+		skipped += p - buf;
+		have -= p - buf;
+		memmove(buf, p, have);
+	}
+
+	if (stats != NULL)
+	{
+		// the part of a frame cut by a timeout is left out, its tail is counted once a later read skips it
+		if (skipped > 0)
+		{
+			stats->resyncs.fetch_add(1, std::memory_order_relaxed);
+			stats->resyncBytes.fetch_add(skipped, std::memory_order_relaxed);
+		}
+		if (crcErrors > 0)
+			stats->crcErrors.fetch_add(crcErrors, std::memory_order_relaxed);
+		if (status == STAT_OK)
+			stats->frames.fetch_add(1, std::memory_order_relaxed);
+		stats->frameRxBytes.fetch_add(skipped + (status == STAT_OK || status == (int)STAT_CMD_RESP_CRC_ERR ? need : 0), std::memory_order_relaxed);
+	}
+	return status;
+}
+
+int CFFrame_Read(int fd, unsigned char* buf, size_t* frameLen, const struct timespec* deadline, CFStatsCtx* stats)
+{
+	return Frame_Read(fd, buf, frameLen, deadline, stats, false);
+}
+
+int CFFrame_ReadLong(int fd, unsigned char* buf, size_t* frameLen, const struct timespec* deadline, CFStatsCtx* stats)
+{
+	return Frame_Read(fd, buf, frameLen, deadline, stats, true);
+}
+
+int CFFrame_Write(int fd, const unsigned char* frame, size_t frameLen, CFStatsCtx* stats)
+{
+	size_t done = 0;
+	while (done < frameLen)
+	{
+		ssize_t n = write(fd, frame + done, frameLen - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	if (stats != NULL)
+		stats->frameTxBytes.fetch_add(done, std::memory_order_relaxed);
+	return done < frameLen ? STAT_CMD_COMM_WR_FAILED : STAT_OK;
+}
+
+int CFFrame_Label(const unsigned char* frame, TagInfo* tag)
+{
+	size_t len = frame[4];
+	const unsigned char* p = frame + FRAME_HEAD_LEN;
+	if (len < 1)
+		return STAT_CMD_RESP_FORMAT_ERR;
+	if (p[0] != 0x00)
+		return CFFrame_Status(p[0]);
+	if (len < 6 || p[5] > len - 6)
+		return STAT_CMD_RESP_FORMAT_ERR;
+	memset(tag, 0, sizeof(*tag));
+	tag->rssi = (short)((p[1] << 8) | p[2]);
+	tag->antenna = p[3];
+	tag->channel = p[4];
+	tag->codeLen = p[5];
+	memcpy(tag->code, p + 6, p[5]);
+	return STAT_OK;
+}
+
+int CFFrame_Status(unsigned char status)
+{
+	switch (status)
+	{
+	case 0x00: return STAT_OK;
+	case 0x01: return STAT_CMD_PARAM_ERR;
+	case 0x02: return STAT_CMD_INNER_ERR;
+	case 0x03: return STAT_CMD_SERIAL_NUM_EXIT;
+	case 0x12: return STAT_CMD_INVENTORY_STOP;
+	case 0x14: return STAT_CMD_TAG_NO_RESP;
+	case 0x15: return STAT_CMD_DECODE_TAG_DATA_FAIL;
+	case 0x16: return STAT_CMD_AUTH_FAIL;
+	case 0x17: return STAT_CMD_PWD_ERR;
+	case 0x21: return STAT_CMD_SAM_NO_RESP;
+	case 0x22: return STAT_CMD_SAM_CMD_FAIL;
+	case 0xFF: return STAT_CMD_NOMORE_DATA;
+	default: return status;
+	}
+}
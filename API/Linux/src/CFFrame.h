@@ -0,0 +1,70 @@
+#ifndef _CFFRAME_H_
+#define _CFFRAME_H_
+
+#include "CFHandle.h"
+
+// Reader link frame: CF addr cmdH cmdL len payload[len] crcH crcL, CRC over head to payload.
+// Commands go to the broadcast address, responses carry the address of the reader (0x00 from
+// the factory). Response payloads start with the status byte.
+#define FRAME_HEAD0							0xCF
+#define FRAME_ADDR_BROADCAST				0xFF
+#define FRAME_ADDR_DEFAULT					0x00
+#define FRAME_HEAD_LEN						5
+#define FRAME_MAX_LEN						(FRAME_HEAD_LEN + 255 + 2)
+
+// Long frame of the whitelist transfer (SetWhiteList / GetWhiteList): CF addr cmdH cmdL lenH lenL
+// payload[len] crcH crcL. A download frame fills a WhiteList as GetWhiteList copies it.
+#define FRAME_LONG_HEAD_LEN					6
+#define FRAME_LONG_MAX_PAYLOAD				sizeof(WhiteList)
+#define FRAME_LONG_MAX_LEN					(FRAME_LONG_HEAD_LEN + FRAME_LONG_MAX_PAYLOAD + 2)
+
+#define FRAME_CMD_INVENTORY					0x0001
+#define FRAME_CMD_INVENTORY_STOP			0x0002
+#define FRAME_CMD_READ_TAG					0x0003
+#define FRAME_CMD_WRITE_TAG					0x0004
+#define FRAME_CMD_LOCK_TAG					0x0005
+#define FRAME_CMD_SELECT_MASK				0x0007
+#define FRAME_CMD_GATE_STATUS				0x0082	// sent by gate readers on their own, see GetGateStatus
+#define FRAME_CMD_WHITELIST					0x008C
+
+// CRC-16 of the link (init 0xFFFF, reflected polynomial 0x8408).
+unsigned short CFFrame_Crc16(const unsigned char* data, size_t len);
+// Fills head, length and CRC around payload[len] already placed at buf + FRAME_HEAD_LEN.
+// Returns the frame length.
+size_t CFFrame_Build(unsigned char* buf, unsigned short cmd, size_t len);
+// CFFrame_Build of a frame as it comes from the reader at addr.
+size_t CFFrame_BuildFrom(unsigned char* buf, unsigned char addr, unsigned short cmd, size_t len);
+// CFFrame_Build of a long frame, payload[len] at buf + FRAME_LONG_HEAD_LEN.
+size_t CFFrame_BuildLong(unsigned char* buf, unsigned short cmd, size_t len);
+// Reads one frame of any command from fd into buf (FRAME_MAX_LEN bytes) with exact reads, so
+// nothing past the frame is taken from the descriptor (unless a false start in front of it
+// claimed more). A CRC failure resyncs on the next head byte already read, STAT_CMD_RESP_CRC_ERR
+// when there is none. Returns STAT_OK and the frame length.
+// Bytes, frames, CRC errors and resyncs are counted in stats unless it is NULL.
+int CFFrame_Read(int fd, unsigned char* buf, size_t* frameLen, const struct timespec* deadline, CFStatsCtx* stats);
+// CFFrame_Read of a long frame into buf (FRAME_LONG_MAX_LEN bytes).
+int CFFrame_ReadLong(int fd, unsigned char* buf, size_t* frameLen, const struct timespec* deadline, CFStatsCtx* stats);
+// Writes a whole frame to fd, counted in stats unless it is NULL.
+int CFFrame_Write(int fd, const unsigned char* frame, size_t frameLen, CFStatsCtx* stats);
+// Maps the status byte of a response to the STAT_* code libCFApi reports for it.
+int CFFrame_Status(unsigned char status);
+// Inventory response: status rssi[2] antenna channel codeLen code[codeLen], as CFCapture_Label lays
+// it out. Returns STAT_OK with the label in tag, or the status of a frame without one (0x12 ...).
+int CFFrame_Label(const unsigned char* frame, TagInfo* tag);
+// Absolute CLOCK_MONOTONIC deadline timeout ms from now.
+void CFFrame_Deadline(struct timespec* deadline, unsigned short timeout);
+// Milliseconds left until deadline, 0 once it has passed.
+int CFFrame_RemainingMs(const struct timespec* deadline);
+
+// TagOp frames, see CFOpQueue.cpp. Command code of op->type, 0 for an unknown type.
+unsigned short CFOp_Cmd(const TagOp* op);
+// STAT_CMD_PARAM_ERR for an operation CFOpQueueSubmit would refuse.
+int CFOp_Validate(const TagOp* op);
+// SetSelectMask frame of op. Returns the frame length.
+size_t CFOp_BuildSelect(const TagOp* op, unsigned char* frame);
+// ReadTag / WriteTag / LockTag frame of op. Returns the frame length.
+size_t CFOp_Build(const TagOp* op, unsigned char* frame);
+// Fills result from the response frame of a TagOp, code and data point into frame.
+int CFOp_Parse(const unsigned char* frame, bool read, TagOpResult* result);
+
+#endif
@@ -0,0 +1,177 @@
+#include "CFHandle.h"
+#include <sys/ioctl.h>
+#include <map>
+
+static pthread_mutex_t s_ctxLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<int64_t, CFHandleCtx*> s_ctxMap;
+// libCFApi takes the first free slot of its connection table without a lock and fills it only
+// once the port is open, so two opens (or an open and a close) at once can share a slot.
+static pthread_mutex_t s_openLock = PTHREAD_MUTEX_INITIALIZER;
+
+CFHandleCtx* CFHandle_Get(int64_t hComm)
+{
+	pthread_mutex_lock(&s_ctxLock);
+	CFHandleCtx*& ctx = s_ctxMap[hComm];
+	if (ctx == NULL)
+	{
+		ctx = new CFHandleCtx();
+		ctx->hComm = hComm;
+		ctx->pendingStatus = STAT_OK;
+		ctx->held = false;
+		ctx->ring = NULL;
+		ctx->link.started = false;
+		ctx->views = NULL;
+		ctx->capture = NULL;
+		ctx->replay = NULL;
+		ctx->trigger = NULL;
+		ctx->opDepth = 0;
+		ctx->refs = 0;
+		ctx->released = false;
+		pthread_mutex_init(&ctx->stream.lock, NULL);
+		pthread_cond_init(&ctx->stream.done, NULL);
+		ctx->stream.active = false;
+		ctx->stream.stop = false;
+		ctx->stream.selfStop = false;
+		ctx->stream.worker = NULL;
+		ctx->stream.workerCtx = NULL;
+		pthread_mutex_init(&ctx->seq.lock, NULL);
+		pthread_cond_init(&ctx->seq.turn, NULL);
+		ctx->seq.next = 0;
+		ctx->seq.serving = 0;
+		ctx->seq.depth = 0;
+		ctx->seq.paused = false;
+		ctx->seq.invCount = 0;
+		ctx->seq.invParam = 0;
+		ctx->stats.startUs = CFStats_NowUs();
+		ctx->stats.rateUs = ctx->stats.startUs;
+	}
+	CFHandleCtx* ret = ctx;
+	pthread_mutex_unlock(&s_ctxLock);
+	return ret;
+}
+
+// Called with s_ctxLock held, once the context is out of the table and nobody holds it.
+static void Handle_Free(CFHandleCtx* ctx)
+{
+	pthread_mutex_destroy(&ctx->stream.lock);
+	pthread_cond_destroy(&ctx->stream.done);
+	pthread_mutex_destroy(&ctx->seq.lock);
+	pthread_cond_destroy(&ctx->seq.turn);
+	CFRing_Free(ctx->ring);
+	CFView_Free(ctx->views);
+	CFTrigger_Free(ctx->trigger);
+	delete ctx;
+}
+
+void CFHandle_Release(int64_t hComm)
+{
+	pthread_mutex_lock(&s_ctxLock);
+	std::map<int64_t, CFHandleCtx*>::iterator it = s_ctxMap.find(hComm);
+	if (it != s_ctxMap.end())
+	{
+		CFHandleCtx* ctx = it->second;
+		s_ctxMap.erase(it);
+		// a command of another thread still on (or queued for) the link frees it on CFSeq_Leave
+		ctx->released = true;
+		if (ctx->refs == 0)
+			Handle_Free(ctx);
+	}
+	pthread_mutex_unlock(&s_ctxLock);
+}
+
+void CFHandle_Hold(CFHandleCtx* ctx)
+{
+	pthread_mutex_lock(&s_ctxLock);
+	ctx->refs++;
+	pthread_mutex_unlock(&s_ctxLock);
+}
+
+void CFHandle_Drop(CFHandleCtx* ctx)
+{
+	pthread_mutex_lock(&s_ctxLock);
+	if (--ctx->refs == 0 && ctx->released)
+		Handle_Free(ctx);
+	pthread_mutex_unlock(&s_ctxLock);
+}
+
+int CFHandle_OpenSerial(int64_t* hComm, char* path, int baudRate)
+{
+	pthread_mutex_lock(&s_openLock);
+	int status = OpenDevice(hComm, path, baudRate);
+	pthread_mutex_unlock(&s_openLock);
+	return status;
+}
+
+int CFHandle_OpenNet(int64_t* hComm, char* ip, unsigned short port, long timeoutMs)
+{
+	pthread_mutex_lock(&s_openLock);
+	int status = OpenNetConnection(hComm, ip, port, timeoutMs);
+	pthread_mutex_unlock(&s_openLock);
+	return status;
+}
+
+int CFHandle_OpenHid(int64_t* hComm, unsigned short index)
+{
+	pthread_mutex_lock(&s_openLock);
+	int status = OpenHidConnection(hComm, index);
+	pthread_mutex_unlock(&s_openLock);
+	return status;
+}
+
+int CFHandle_Close(int64_t hComm)
+{
+	pthread_mutex_lock(&s_openLock);
+	int status = CloseDevice(hComm);
+	pthread_mutex_unlock(&s_openLock);
+	return status;
+}
+
+int CFHandle_Fd(int64_t hComm)
+{
+	if (hComm < 0 || hComm > 0xFFFF)
+		return -1;
+	if (fcntl((int)hComm, F_GETFD) < 0)
+		return -1;
+	return (int)hComm;
+}
+
+int CFHandle_Pending(int64_t hComm)
+{
+	int fd = CFHandle_Fd(hComm);
+	int bytes = 0;
+	if (fd < 0 || ioctl(fd, FIONREAD, &bytes) < 0)
+		return -1;
+	return bytes;
+}
+
+void CFSeq_Enter(CFHandleCtx* ctx)
+{
+	CFHandle_Hold(ctx);
+	CFCmdSeq* seq = &ctx->seq;
+	pthread_mutex_lock(&seq->lock);
+	if (seq->depth > 0 && pthread_equal(seq->owner, pthread_self()))
+	{
+		seq->depth++;
+		pthread_mutex_unlock(&seq->lock);
+		return;
+	}
+	unsigned long ticket = seq->next++;
+	while (seq->serving != ticket)
+		pthread_cond_wait(&seq->turn, &seq->lock);
+	seq->owner = pthread_self();
+	seq->depth = 1;
+	pthread_mutex_unlock(&seq->lock);
+}
+
+void CFSeq_Leave(CFHandleCtx* ctx)
+{
+	CFCmdSeq* seq = &ctx->seq;
+	pthread_mutex_lock(&seq->lock);
+	if (--seq->depth == 0)
+	{
+		seq->serving++;
+		pthread_cond_broadcast(&seq->turn);
+	}
+	pthread_mutex_unlock(&seq->lock);
+	CFHandle_Drop(ctx);
+}
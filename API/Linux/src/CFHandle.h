@@ -0,0 +1,184 @@
+#ifndef _CFHANDLE_H_
+#define _CFHANDLE_H_
+
+#include "CFApiEx.h"
+#include <atomic>
+
+// Called by the reader thread each STREAM_POLL_TIMEOUT without labels.
+typedef void (*CFStreamIdle)(int64_t hComm, void* userCtx);
+struct CFHandleCtx;
+// Body of a worker run on the reader thread instead of the label loop (CFStream_StartWorker).
+// Returns once stream.stop is set or the link failed, with the inventory stopped.
+typedef int (*CFStreamWorker)(CFHandleCtx* ctx, void* workerCtx);
+
+// Library-owned reader thread of InventoryStartStreaming.
+struct CFStreamCtx
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	bool active;					// thread running, guarded by lock
+	std::atomic<bool> stop;
+	bool selfStop;					// stop requested from the callback, guarded by lock
+	TagStreamCallback callback;
+	CFStreamIdle idle;
+	void* userCtx;
+	unsigned int flags;
+	unsigned short stopTimeout;		// InventoryStop timeout when the stream is stopped from its own callback
+	CFStreamWorker worker;			// NULL for the label loop of InventoryStartStreaming
+	void* workerCtx;
+};
+
+// Link counters of GetLinkStats, relative to OpenDeviceEx (or the first GetLinkStats call).
+struct CFLinkCtx
+{
+	bool started;
+	bool counted;					// the link has byte counters (TIOCGICOUNT / TCP_INFO)
+	unsigned int applied;			// SERIAL_OPT_* OpenDeviceEx managed to apply
+	uint64_t openMs;
+	uint64_t lastMs;
+	uint64_t rxBase, txBase;
+	uint64_t rxLast, txLast;
+};
+
+// FIFO command sequencer of a handle: one exchange on the link at a time, in arrival order, so
+// a poll loop that enters again at once cannot starve a waiting command. Recursive per thread.
+struct CFCmdSeq
+{
+	pthread_mutex_t lock;
+	pthread_cond_t turn;
+	unsigned long next;				// next ticket handed out
+	unsigned long serving;			// ticket that owns the link
+	pthread_t owner;
+	unsigned int depth;				// nesting of owner, 0 while free
+	bool paused;					// CFHandleLock stopped the inventory of a stream, restarted on the last unlock
+	unsigned char invCount;			// InventoryContinueEx arguments the last unlock restarts with, guarded by lock
+	unsigned long invParam;
+};
+
+// Lock-free latency histogram, buckets as in LatencyHist.
+struct CFHistCtx
+{
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sumUs;
+	std::atomic<uint64_t> maxUs;
+	std::atomic<uint64_t> buckets[STATS_HIST_BUCKETS];
+};
+
+// Round trip histogram of the command code cmd - 0x10000, slot free while cmd is 0.
+struct CFCmdRttCtx
+{
+	std::atomic<unsigned int> cmd;
+	std::atomic<uint64_t> lost;
+	CFHistCtx rtt;
+};
+
+// Hot path counters of CFGetStats, relaxed atomics only: the parser, the drain and the command
+// paths of different threads add to them without a lock.
+struct CFStatsCtx
+{
+	uint64_t startUs;
+	std::atomic<uint64_t> frameRxBytes, frameTxBytes;
+	std::atomic<uint64_t> frames, crcErrors, resyncs, resyncBytes;
+	std::atomic<uint64_t> tags;
+	std::atomic<uint64_t> cmdUntracked;
+	CFHistCtx tagWait;
+	CFCmdRttCtx cmds[STATS_CMD_SLOTS];
+	uint64_t rateUs, rateTags;		// interval of tagRate, guarded by the caller of CFGetStats
+};
+
+struct CFTagRing;
+struct CFViewPool;
+struct CFCapture;
+struct CFReplay;
+struct CFTrigger;
+
+// Host-side state kept next to each libCFApi connection, looked up by hComm.
+struct CFHandleCtx
+{
+	int64_t hComm;
+	int pendingStatus;		// status consumed while draining a batch, reported by the next call
+	bool held;				// heldTag did not fit the arena of the last compact batch, it opens the next call
+	TagInfo heldTag;
+	CFStreamCtx stream;
+	CFLinkCtx link;
+	std::atomic<CFViewPool*> views;	// receive slots of GetReadTagRespView, allocated on first use or by CFHandleReserve
+	unsigned int opDepth;	// CFOpQueueSetDepth, 0 for OPQUEUE_DEFAULT_DEPTH
+	CFTagRing* ring;		// InventoryStartRing ring, kept after the stream ends until the handle is released
+	CFCmdSeq seq;
+	CFStatsCtx stats;
+	CFCapture* capture;		// CFCaptureStart, changed only while holding the turn on the link
+	CFReplay* replay;		// player of OpenReplayDevice
+	CFTrigger* trigger;		// CFTriggerArm, changed only while holding the turn on the link
+	unsigned int refs;		// turns entered or waited for plus CFHandle_Hold, guarded by the table lock
+	bool released;			// CFHandle_Release ran, freed when refs drops to 0
+};
+
+// Returns the context of hComm, creating it on first use. Never returns NULL.
+CFHandleCtx* CFHandle_Get(int64_t hComm);
+// Drops the context of hComm once the connection is closed. A thread that still waits for or holds
+// the turn on the link keeps it, it is freed when the last one leaves.
+void CFHandle_Release(int64_t hComm);
+// Keeps ctx across a stretch without the turn (CFSeq_Leave ... CFSeq_Enter), CFHandle_Drop ends it.
+void CFHandle_Hold(CFHandleCtx* ctx);
+void CFHandle_Drop(CFHandleCtx* ctx);
+// OpenDevice / OpenNetConnection / OpenHidConnection / CloseDevice one at a time in the process:
+// the connection table of libCFApi is not locked. Every open and close of the extensions goes
+// through these; a TCP connect holds the others back for up to timeoutMs.
+int CFHandle_OpenSerial(int64_t* hComm, char* path, int baudRate);
+int CFHandle_OpenNet(int64_t* hComm, char* ip, unsigned short port, long timeoutMs);
+int CFHandle_OpenHid(int64_t* hComm, unsigned short index);
+int CFHandle_Close(int64_t hComm);
+// libCFApi hands back the OS file descriptor as hComm for serial and TCP connections
+// (HID connections carry a hid_device pointer). Returns the descriptor or -1.
+int CFHandle_Fd(int64_t hComm);
+// Number of bytes waiting in the kernel receive buffer of hComm, or -1 if unknown.
+int CFHandle_Pending(int64_t hComm);
+// Waits for the turn of the calling thread on the link of ctx (CFCmdSeq), holding ctx.
+void CFSeq_Enter(CFHandleCtx* ctx);
+// Ends the turn entered last, the next waiter gets the link. ctx may be gone afterwards if the
+// handle was released meanwhile.
+void CFSeq_Leave(CFHandleCtx* ctx);
+
+// Monotonic clock in microseconds.
+uint64_t CFStats_NowUs();
+// Adds a sample of us microseconds to hist.
+void CFStats_Hist(CFHistCtx* hist, uint64_t us);
+// Adds a round trip of cmd; counts it as lost instead when lost is set.
+void CFStats_Rtt(CFStatsCtx* stats, unsigned short cmd, uint64_t us, bool lost);
+// Kernel byte counters of the link of ctx since OpenDeviceEx (or the first GetLinkStats call).
+bool CFLink_Bytes(CFHandleCtx* ctx, uint64_t* rx, uint64_t* tx);
+
+// InventoryStartStreaming with an idle hook for stages that keep time (dedup windows ...).
+int CFStream_Start(int64_t hComm, TagStreamCallback callback, CFStreamIdle idle, void* userCtx, unsigned int flags);
+// CFStream_Start with stream.lock of ctx held by the caller.
+int CFStream_StartLocked(CFHandleCtx* ctx, TagStreamCallback callback, CFStreamIdle idle, void* userCtx, unsigned int flags);
+// Runs worker on the reader thread of hComm as the owner of its inventory: CFHandleLock pauses
+// the inventory around other commands, InventoryStopStreaming stops the worker. The worker starts
+// the inventory itself and takes the turn on the link around each command it sends.
+// STAT_CMD_PARAM_ERR while a stream runs on hComm.
+int CFStream_StartWorker(int64_t hComm, CFStreamWorker worker, void* workerCtx);
+// Stops the stream of hComm if it still runs for owner (the workerCtx of a worker, the userCtx of
+// the label loop) and waits until it has exited; called from the stream itself only the request is made.
+void CFStream_StopOwner(int64_t hComm, void* owner);
+// Stops a running stream of hComm and waits until its reader thread has exited.
+void CFStream_Close(int64_t hComm);
+// Frees the ring of InventoryStartRing.
+void CFRing_Free(CFTagRing* ring);
+// Allocates the ring of InventoryStartRing, or empties the one of ctx if it has that size already.
+// STAT_CMD_PARAM_ERR while a stream or a TagRingPop is using the ring.
+int CFRing_Reserve(CFHandleCtx* ctx, size_t ringSize);
+// Frees the receive slots of GetReadTagRespView.
+void CFView_Free(CFViewPool* pool);
+// Receive slots of GetReadTagRespView, allocated on the first call (under stream.lock).
+CFViewPool* CFView_Reserve(CFHandleCtx* ctx);
+// Records a label decoded by libCFApi when the capture of ctx rebuilds frames (HID connections).
+void CFCapture_Label(CFHandleCtx* ctx, const TagInfo* tag);
+// Ends a running capture of ctx, called by CloseDeviceEx before the connection closes.
+void CFCapture_Close(CFHandleCtx* ctx);
+// Stops the player of OpenReplayDevice and closes its pseudo terminal, after CloseDevice.
+void CFReplay_Close(CFHandleCtx* ctx);
+// Frees the armed state of CFTriggerArm without touching the reader.
+void CFTrigger_Free(CFTrigger* trigger);
+
+#endif
@@ -0,0 +1,133 @@
+#include "CFHandle.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define HEX_X86
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HEX_NEON
+#endif
+
+typedef void (*HexFn)(const unsigned char* in, size_t len, char* out);
+
+static const char g_hexDigits[] = "0123456789ABCDEF";
+
+static void Hex_Scalar(const unsigned char* in, size_t len, char* out)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		out[2 * i] = g_hexDigits[in[i] >> 4];
+		out[2 * i + 1] = g_hexDigits[in[i] & 0x0F];
+	}
+}
+
+#ifdef HEX_X86
+// x86 builds target the baseline ISA, SSSE3 is picked at run time.
+__attribute__((target("ssse3")))
+static void Hex_Ssse3(const unsigned char* in, size_t len, char* out)
+{
+	const __m128i digits = _mm_loadu_si128((const __m128i*)g_hexDigits);
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+		__m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, nibble));
+		_mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	// 12-byte EPCs and the tail of longer codes
+	for (; i + 8 <= len; i += 8)
+	{
+		__m128i v = _mm_loadl_epi64((const __m128i*)(in + i));
+		__m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+		__m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, nibble));
+		_mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+	}
+	Hex_Scalar(in + i, len - i, out + 2 * i);
+}
+
+static HexFn Hex_Select()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3") ? Hex_Ssse3 : Hex_Scalar;
+}
+#elif defined(HEX_NEON)
+// NEON is part of ARM64 and of ARM builds made with -mfpu=neon.
+static void Hex_Neon(const unsigned char* in, size_t len, char* out)
+{
+	size_t i = 0;
+#ifdef __aarch64__
+	const uint8x16_t digits = vld1q_u8((const uint8_t*)g_hexDigits);
+	for (; i + 16 <= len; i += 16)
+	{
+		uint8x16_t v = vld1q_u8(in + i);
+		uint8x16x2_t pair;
+		pair.val[0] = vqtbl1q_u8(digits, vshrq_n_u8(v, 4));
+		pair.val[1] = vqtbl1q_u8(digits, vandq_u8(v, vdupq_n_u8(0x0F)));
+		vst2q_u8((uint8_t*)out + 2 * i, pair);
+	}
+	for (; i + 8 <= len; i += 8)
+	{
+		uint8x8_t v = vld1_u8(in + i);
+		uint8x8x2_t pair;
+		pair.val[0] = vqtbl1_u8(digits, vshr_n_u8(v, 4));
+		pair.val[1] = vqtbl1_u8(digits, vand_u8(v, vdup_n_u8(0x0F)));
+		vst2_u8((uint8_t*)out + 2 * i, pair);
+	}
+#else
+	uint8x8x2_t digits;
+	digits.val[0] = vld1_u8((const uint8_t*)g_hexDigits);
+	digits.val[1] = vld1_u8((const uint8_t*)g_hexDigits + 8);
+	for (; i + 8 <= len; i += 8)
+	{
+		uint8x8_t v = vld1_u8(in + i);
+		uint8x8x2_t pair;
+		pair.val[0] = vtbl2_u8(digits, vshr_n_u8(v, 4));
+		pair.val[1] = vtbl2_u8(digits, vand_u8(v, vdup_n_u8(0x0F)));
+		vst2_u8((uint8_t*)out + 2 * i, pair);
+	}
+#endif
+	Hex_Scalar(in + i, len - i, out + 2 * i);
+}
+
+static HexFn Hex_Select()
+{
+	return Hex_Neon;
+}
+#else
+static HexFn Hex_Select()
+{
+	return Hex_Scalar;
+}
+#endif
+
+static void Hex_First(const unsigned char* in, size_t len, char* out);
+
+// Constant-initialised, so a static constructor of another unit may call TagCodeToHex before
+// this one has run: the first call picks the routine.
+static std::atomic<HexFn> g_hex(Hex_First);
+
+static void Hex_First(const unsigned char* in, size_t len, char* out)
+{
+	HexFn fn = Hex_Select();
+	g_hex.store(fn, std::memory_order_relaxed);
+	fn(in, len, out);
+}
+
+size_t TagCodeToHex(const unsigned char* code, size_t len, char* out, size_t outSize)
+{
+	if ((code == NULL && len != 0) || out == NULL || outSize < 2 * len + 1)
+		return 0;
+	g_hex.load(std::memory_order_relaxed)(code, len, out);
+	out[2 * len] = '\0';
+	return 2 * len;
+}
+
+size_t TagCompactToHex(const TagInfoCompact* tag, const TagCodeArena* arena, char* out, size_t outSize)
+{
+	if (tag == NULL)
+		return 0;
+	return TagCodeToHex(TagCompactCode(tag, arena), tag->codeLen, out, outSize);
+}
@@ -0,0 +1,521 @@
+#include "CFHandle.h"
+#include <list>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define JOURNAL_PAGE						4096
+#define JOURNAL_MIN_BUCKETS					16
+
+static const char s_journalMagic[4] = { 'C', 'F', 'J', 'S' };
+
+// A segment file mapped whole, writable for the journal and read-only for queries.
+struct JournalSegment
+{
+	int fd;
+	unsigned char* base;
+	size_t size;
+	JournalSegmentHeader* header;
+	const uint64_t* index;
+	unsigned int* buckets;
+	JournalRecord* records;
+};
+
+// State of one InventoryStartJournal handle, kept until TagJournalClose because a stream that is
+// stopped from outside does not tell its sink.
+struct JournalStream
+{
+	TagJournal* journal;
+	int64_t hComm;
+	unsigned int source;
+	TagStreamCallback callback;
+	void* userCtx;
+};
+
+struct TagJournal
+{
+	std::string dir;
+	TagJournalConfig config;
+	pthread_mutex_t lock;			// seg, lastUs and streams between the feeding threads
+	JournalSegment seg;
+	uint64_t sequence;				// of seg, or of the segment a failed rotation is to create
+	uint64_t lastUs;
+	std::list<JournalStream> streams;
+};
+
+static uint64_t Journal_NowUs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// FNV-1a over the full code
+static uint64_t Journal_Hash(const unsigned char* code, size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ code[i]) * 1099511628211ULL;
+	return hash;
+}
+
+static std::string Journal_Path(const std::string& dir, uint64_t sequence)
+{
+	char name[40];
+	snprintf(name, sizeof(name), "/seg-%010llu.cfj", (unsigned long long)sequence);
+	return dir + name;
+}
+
+// Sequence numbers of the segment files in dir, oldest first.
+static bool Journal_List(const std::string& dir, std::vector<uint64_t>* sequences)
+{
+	DIR* d = opendir(dir.c_str());
+	if (d == NULL)
+		return false;
+	struct dirent* entry;
+	while ((entry = readdir(d)) != NULL)
+	{
+		unsigned long long sequence;
+		int end = 0;
+		if (sscanf(entry->d_name, "seg-%llu.cfj%n", &sequence, &end) == 1 && end > 0 && entry->d_name[end] == '\0')
+			sequences->push_back(sequence);
+	}
+	closedir(d);
+	std::sort(sequences->begin(), sequences->end());
+	return true;
+}
+
+static void Journal_Layout(JournalSegment* seg)
+{
+	JournalSegmentHeader* h = (JournalSegmentHeader*)seg->base;
+	seg->header = h;
+	seg->index = (const uint64_t*)(seg->base + h->indexOffset);
+	seg->buckets = (unsigned int*)(seg->base + h->bucketOffset);
+	seg->records = (JournalRecord*)(seg->base + h->recordOffset);
+}
+
+static void Journal_Unmap(JournalSegment* seg)
+{
+	if (seg->base != NULL)
+		munmap(seg->base, seg->size);
+	if (seg->fd >= 0)
+		close(seg->fd);
+	seg->fd = -1;
+	seg->base = NULL;
+}
+
+// Map an existing segment and check that its header describes the file.
+static bool Journal_Map(const std::string& path, bool writable, JournalSegment* seg)
+{
+	seg->fd = open(path.c_str(), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+	seg->base = NULL;
+	if (seg->fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(seg->fd, &st) != 0 || (uint64_t)st.st_size < JOURNAL_PAGE)
+	{
+		Journal_Unmap(seg);
+		return false;
+	}
+	seg->size = (size_t)st.st_size;
+	void* base = mmap(NULL, seg->size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, seg->fd, 0);
+	if (base == MAP_FAILED)
+	{
+		Journal_Unmap(seg);
+		return false;
+	}
+	seg->base = (unsigned char*)base;
+
+	const JournalSegmentHeader* h = (const JournalSegmentHeader*)seg->base;
+	uint64_t entries = h->indexStride != 0 ? ((uint64_t)h->capacity + h->indexStride - 1) / h->indexStride : 0;
+	if (memcmp(h->magic, s_journalMagic, sizeof(s_journalMagic)) != 0 || h->version != JOURNAL_VERSION
+		|| h->recordSize != sizeof(JournalRecord) || h->indexStride == 0 || h->buckets == 0
+		|| (h->buckets & (h->buckets - 1)) != 0 || h->count > h->capacity
+		|| h->indexOffset % 8 != 0 || h->indexOffset + entries * 8 > h->bucketOffset
+		|| h->bucketOffset % 4 != 0 || h->bucketOffset + (uint64_t)h->buckets * 4 > h->recordOffset
+		|| h->recordOffset % 8 != 0 || h->recordOffset + (uint64_t)h->capacity * sizeof(JournalRecord) > seg->size)
+	{
+		Journal_Unmap(seg);
+		return false;
+	}
+	Journal_Layout(seg);
+	return true;
+}
+
+// Create a segment at its full size so the mapping cannot run out of disk later.
+static bool Journal_Create(TagJournal* j, uint64_t sequence)
+{
+	unsigned int stride = j->config.indexStride;
+	unsigned int capacity = (j->config.segmentRecords + stride - 1) / stride * stride;
+	unsigned int buckets = JOURNAL_MIN_BUCKETS;
+	while (buckets < capacity / 4)
+		buckets <<= 1;
+	uint64_t indexOffset = JOURNAL_PAGE;
+	uint64_t bucketOffset = indexOffset + (uint64_t)(capacity / stride) * 8;
+	uint64_t recordOffset = (bucketOffset + (uint64_t)buckets * 4 + JOURNAL_PAGE - 1) / JOURNAL_PAGE * JOURNAL_PAGE;
+	uint64_t size = recordOffset + (uint64_t)capacity * sizeof(JournalRecord);
+
+	std::string path = Journal_Path(j->dir, sequence);
+	JournalSegment* seg = &j->seg;
+	j->sequence = sequence;
+	seg->fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	seg->base = NULL;
+	if (seg->fd < 0)
+		return false;
+	void* base = MAP_FAILED;
+	if (posix_fallocate(seg->fd, 0, (off_t)size) == 0)
+		base = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+	if (base == MAP_FAILED)
+	{
+		Journal_Unmap(seg);
+		unlink(path.c_str());
+		return false;
+	}
+	seg->base = (unsigned char*)base;
+	seg->size = (size_t)size;
+	madvise(seg->base + recordOffset, seg->size - recordOffset, MADV_SEQUENTIAL);
+
+	// the file reads as zeros, the magic goes in last so a reader never sees half a header
+	JournalSegmentHeader* h = (JournalSegmentHeader*)seg->base;
+	h->version = JOURNAL_VERSION;
+	h->recordSize = sizeof(JournalRecord);
+	h->capacity = capacity;
+	h->indexStride = stride;
+	h->buckets = buckets;
+	h->sequence = sequence;
+	h->indexOffset = indexOffset;
+	h->bucketOffset = bucketOffset;
+	h->recordOffset = recordOffset;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(h->magic, s_journalMagic, sizeof(s_journalMagic));
+	Journal_Layout(seg);
+
+	std::vector<uint64_t> sequences;
+	if (j->config.maxSegments != 0 && Journal_List(j->dir, &sequences))
+	{
+		for (size_t i = 0; i + j->config.maxSegments < sequences.size(); i++)
+			unlink(Journal_Path(j->dir, sequences[i]).c_str());
+	}
+	return true;
+}
+
+// Next segment once the current one is full. The full one is handed to writeback, not waited for.
+static bool Journal_Rotate(TagJournal* j)
+{
+	uint64_t sequence = j->sequence + 1;
+	if (j->seg.base != NULL)
+	{
+		msync(j->seg.base, j->seg.size, MS_ASYNC);
+		Journal_Unmap(&j->seg);
+	}
+	else
+		sequence = j->sequence;
+	return Journal_Create(j, sequence);
+}
+
+static void Journal_Put(TagJournal* j, unsigned int source, const TagInfoCompact& tag, const TagCodeArena* arena, uint64_t now)
+{
+	JournalSegment* seg = &j->seg;
+	JournalSegmentHeader* h = seg->header;
+	const unsigned char* code = TagCompactCode(&tag, arena);
+	size_t codeLen = tag.codeLen;
+	if (code == tag.code && codeLen > TAGCOMPACT_CODE_LEN)
+		codeLen = TAGCOMPACT_CODE_LEN;
+	unsigned int* bucket = &seg->buckets[Journal_Hash(code, codeLen) & (h->buckets - 1)];
+
+	unsigned int n = h->count;
+	JournalRecord* r = &seg->records[n];
+	r->timeUs = now;
+	r->source = source;
+	r->chain = *bucket;
+	r->rssi = tag.rssi;
+	r->antenna = tag.antenna;
+	r->channel = tag.channel;
+	r->codeLen = (unsigned char)codeLen;
+	r->pc[0] = tag.pc[0];
+	r->pc[1] = tag.pc[1];
+	r->reserved = 0;
+	memcpy(r->code, code, std::min(codeLen, (size_t)JOURNAL_CODE_MAX));
+	if (n % h->indexStride == 0)
+		((uint64_t*)seg->index)[n / h->indexStride] = now;
+	__atomic_store_n(&h->count, n + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(bucket, n + 1, __ATOMIC_RELEASE);
+}
+
+TagJournal* TagJournalOpen(const char* dir, const TagJournalConfig* config)
+{
+	if (dir == NULL || *dir == '\0')
+		return NULL;
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+		return NULL;
+
+	TagJournal* j = new TagJournal();
+	j->dir = dir;
+	if (config != NULL)
+		j->config = *config;
+	if (j->config.segmentRecords == 0)
+		j->config.segmentRecords = JOURNAL_DEFAULT_RECORDS;
+	if (j->config.indexStride == 0)
+		j->config.indexStride = JOURNAL_DEFAULT_STRIDE;
+	j->seg.fd = -1;
+	j->seg.base = NULL;
+	pthread_mutex_init(&j->lock, NULL);
+
+	std::vector<uint64_t> sequences;
+	bool ready = false;
+	if (Journal_List(j->dir, &sequences) && !sequences.empty())
+	{
+		// carry on in the newest segment if it has room, else start the one after it
+		uint64_t newest = sequences.back();
+		j->sequence = newest;
+		if (Journal_Map(Journal_Path(j->dir, newest), true, &j->seg))
+		{
+			unsigned int count = j->seg.header->count;
+			if (count > 0)
+				j->lastUs = j->seg.records[count - 1].timeUs;
+			ready = count < j->seg.header->capacity;
+			if (!ready)
+				Journal_Unmap(&j->seg);
+		}
+		if (!ready)
+			ready = Journal_Create(j, newest + 1);
+	}
+	else
+		ready = Journal_Create(j, 1);
+
+	if (!ready)
+	{
+		TagJournalClose(j);
+		return NULL;
+	}
+	return j;
+}
+
+void TagJournalClose(TagJournal* journal)
+{
+	if (journal == NULL)
+		return;
+	// the streams feeding the journal hold a slot of it; they are stopped without the lock, their
+	// sink appends under it
+	pthread_mutex_lock(&journal->lock);
+	std::vector<JournalStream*> streams;
+	for (std::list<JournalStream>::iterator it = journal->streams.begin(); it != journal->streams.end(); ++it)
+		streams.push_back(&*it);
+	pthread_mutex_unlock(&journal->lock);
+	for (size_t i = 0; i < streams.size(); i++)
+		CFStream_StopOwner(streams[i]->hComm, streams[i]);
+
+	if (journal->seg.base != NULL)
+		msync(journal->seg.base, journal->seg.size, MS_ASYNC);
+	Journal_Unmap(&journal->seg);
+	pthread_mutex_destroy(&journal->lock);
+	delete journal;
+}
+
+int TagJournalAppend(TagJournal* journal, unsigned int source, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena)
+{
+	if (journal == NULL || (tags == NULL && count != 0))
+		return STAT_CMD_PARAM_ERR;
+
+	TagJournal* j = journal;
+	int status = STAT_OK;
+	pthread_mutex_lock(&j->lock);
+	uint64_t now = Journal_NowUs();
+	if (now < j->lastUs)
+		now = j->lastUs;
+	j->lastUs = now;
+	for (size_t t = 0; t < count; t++)
+	{
+		if (j->seg.base == NULL || j->seg.header->count == j->seg.header->capacity)
+		{
+			// a failed rotation is tried again with the next labels
+			if (!Journal_Rotate(j))
+			{
+				status = STAT_DLL_INNER_FAILED;
+				break;
+			}
+		}
+		Journal_Put(j, source, tags[t], arena, now);
+	}
+	pthread_mutex_unlock(&j->lock);
+	return status;
+}
+
+int TagJournalSync(TagJournal* journal)
+{
+	if (journal == NULL)
+		return STAT_CMD_PARAM_ERR;
+	// the mapping stays while the data is written, rotation waits for the lock at most that long
+	pthread_mutex_lock(&journal->lock);
+	int status = STAT_OK;
+	if (journal->seg.base != NULL && (msync(journal->seg.base, journal->seg.size, MS_SYNC) != 0 || fdatasync(journal->seg.fd) != 0))
+		status = STAT_DLL_INNER_FAILED;
+	pthread_mutex_unlock(&journal->lock);
+	return status;
+}
+
+static void Journal_StreamSink(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	JournalStream* js = (JournalStream*)userCtx;
+	if (status == STAT_OK)
+		TagJournalAppend(js->journal, js->source, tags, count, arena);
+	if (js->callback != NULL)
+		js->callback(hComm, status, tags, count, arena, js->userCtx);
+}
+
+int InventoryStartJournal(int64_t hComm, TagJournal* journal, unsigned int source, TagStreamCallback callback, void* userCtx, unsigned int flags)
+{
+	if (journal == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	// one slot per handle, reused by its next stream: it is refilled and the stream started under
+	// stream.lock, so no stream of hComm reads it meanwhile
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	pthread_mutex_lock(&journal->lock);
+	pthread_mutex_lock(&ctx->stream.lock);
+	if (ctx->stream.active)
+	{
+		pthread_mutex_unlock(&ctx->stream.lock);
+		pthread_mutex_unlock(&journal->lock);
+		return STAT_CMD_PARAM_ERR;
+	}
+	JournalStream* js = NULL;
+	for (std::list<JournalStream>::iterator it = journal->streams.begin(); it != journal->streams.end(); ++it)
+	{
+		if (it->hComm == hComm)
+			js = &*it;
+	}
+	if (js == NULL)
+	{
+		journal->streams.push_back(JournalStream());
+		js = &journal->streams.back();
+	}
+	js->journal = journal;
+	js->hComm = hComm;
+	js->source = source;
+	js->callback = callback;
+	js->userCtx = userCtx;
+	int status = CFStream_StartLocked(ctx, Journal_StreamSink, NULL, js, flags);
+	pthread_mutex_unlock(&ctx->stream.lock);
+	pthread_mutex_unlock(&journal->lock);
+	return status;
+}
+
+// Walk the segments of dir in order (newest first if reverse) with visit returning a status.
+template <class Visit>
+static int Journal_Each(const char* dir, bool reverse, Visit visit)
+{
+	std::vector<uint64_t> sequences;
+	if (dir == NULL || !Journal_List(dir, &sequences))
+		return STAT_CMD_PARAM_ERR;
+	if (reverse)
+		std::reverse(sequences.begin(), sequences.end());
+
+	for (size_t i = 0; i < sequences.size(); i++)
+	{
+		// a segment can be deleted by the writer's rotation in between, or still be created
+		JournalSegment seg;
+		if (!Journal_Map(Journal_Path(dir, sequences[i]), false, &seg))
+			continue;
+		unsigned int count = __atomic_load_n(&seg.header->count, __ATOMIC_ACQUIRE);
+		int status = count > 0 ? visit(seg, count) : STAT_OK;
+		Journal_Unmap(&seg);
+		if (status != STAT_OK)
+			return status;
+	}
+	return STAT_OK;
+}
+
+struct JournalRangeVisit
+{
+	uint64_t fromUs, toUs;
+	JournalRecordCallback callback;
+	void* userCtx;
+
+	int operator()(const JournalSegment& seg, unsigned int count) const
+	{
+		if (seg.records[count - 1].timeUs < fromUs || seg.records[0].timeUs > toUs)
+			return STAT_OK;
+		// first index entry at or after fromUs, the records before it may still be in range
+		unsigned int stride = seg.header->indexStride;
+		unsigned int lo = 0, hi = (count + stride - 1) / stride;
+		while (lo < hi)
+		{
+			unsigned int mid = lo + (hi - lo) / 2;
+			if (seg.index[mid] < fromUs)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (unsigned int i = lo > 0 ? (lo - 1) * stride : 0; i < count; i++)
+		{
+			const JournalRecord& r = seg.records[i];
+			if (r.timeUs > toUs)
+				break;
+			// records of a writer that lost power may be zero behind a count that made it to disk
+			if (r.timeUs < fromUs || r.timeUs == 0)
+				continue;
+			int status = callback(&r, userCtx);
+			if (status != STAT_OK)
+				return status;
+		}
+		return STAT_OK;
+	}
+};
+
+struct JournalCodeVisit
+{
+	const unsigned char* code;
+	size_t codeLen;
+	uint64_t hash;
+	uint64_t fromUs, toUs;
+	JournalRecordCallback callback;
+	void* userCtx;
+
+	int operator()(const JournalSegment& seg, unsigned int count) const
+	{
+		if (seg.records[count - 1].timeUs < fromUs || seg.records[0].timeUs > toUs)
+			return STAT_OK;
+		size_t kept = std::min(codeLen, (size_t)JOURNAL_CODE_MAX);
+		unsigned int chain = __atomic_load_n(&seg.buckets[hash & (seg.header->buckets - 1)], __ATOMIC_ACQUIRE);
+		// chains run newest to oldest; a bucket can be ahead of the count loaded before it
+		while (chain != 0 && chain <= seg.header->capacity)
+		{
+			const JournalRecord& r = seg.records[chain - 1];
+			if (chain <= count)
+			{
+				if (r.timeUs < fromUs)
+					break;
+				if (r.timeUs <= toUs && r.codeLen == codeLen && memcmp(r.code, code, kept) == 0)
+				{
+					int status = callback(&r, userCtx);
+					if (status != STAT_OK)
+						return status;
+				}
+			}
+			// links only go back, anything else is a damaged file
+			if (r.chain >= chain)
+				break;
+			chain = r.chain;
+		}
+		return STAT_OK;
+	}
+};
+
+int TagJournalQueryRange(const char* dir, uint64_t fromUs, uint64_t toUs, JournalRecordCallback callback, void* userCtx)
+{
+	if (callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+	JournalRangeVisit visit = { fromUs, toUs, callback, userCtx };
+	return Journal_Each(dir, false, visit);
+}
+
+int TagJournalQueryCode(const char* dir, const unsigned char* code, size_t codeLen, uint64_t fromUs, uint64_t toUs, JournalRecordCallback callback, void* userCtx)
+{
+	if (callback == NULL || (code == NULL && codeLen != 0) || codeLen > 0xFF)
+		return STAT_CMD_PARAM_ERR;
+	JournalCodeVisit visit = { code, codeLen, Journal_Hash(code, codeLen), fromUs, toUs, callback, userCtx };
+	return Journal_Each(dir, true, visit);
+}
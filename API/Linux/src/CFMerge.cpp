@@ -0,0 +1,437 @@
+#include "CFHandle.h"
+#include "CFRing.h"
+#include <limits.h>
+#include <vector>
+
+#define MERGE_NONE							0xFFFFFFFFu
+#define MERGE_DEFAULT_WINDOW				500
+#define MERGE_DEFAULT_DEPART				2000
+#define MERGE_DEFAULT_HYSTERESIS			30
+#define MERGE_DEFAULT_TAGS					8192
+#define MERGE_DEFAULT_SHARDS				16
+
+// What one reader saw of a tag: its peak RSSI keeps until windowMs after it was taken.
+struct MergeReader
+{
+	int64_t hComm;
+	uint64_t peakMs, lastMs;
+	short peakRssi;
+	unsigned char antenna;
+};
+
+// One tag of all readers, kept in a hash chain and in the LRU list of its shard.
+struct MergeEntry
+{
+	uint64_t hash;
+	unsigned int chain;				// next entry of the bucket
+	unsigned int prev, next;		// LRU list, head is the tag read longest ago
+	uint64_t firstMs, lastMs;
+	unsigned int count;
+	unsigned char owner;			// index in readers
+	unsigned char readerCount;
+	unsigned char codeLen;
+	MergeReader readers[MERGE_READERS];
+	unsigned char code[MERGE_CODE_MAX];
+};
+
+// Independently locked part of the table, picked by the upper half of the code hash so the
+// reader threads of different tags rarely meet on the same lock.
+struct MergeShard
+{
+	pthread_mutex_t lock;
+	std::vector<MergeEntry> entries;
+	std::vector<unsigned int> buckets;
+	unsigned int mask;
+	unsigned int free;				// free entries, linked through chain
+	unsigned int head, tail;
+};
+
+struct TagMerge
+{
+	TagMergeConfig config;
+	std::vector<MergeShard*> shards;
+	unsigned int shardMask;
+	Mpsc_Ring<TagMergeEvent>* ring;
+	Ring_Waiter waiter;
+	Ring_Counters counters;			// pushed: events queued
+	std::atomic<uint64_t> reads;
+	std::atomic<uint64_t> handoffs;
+	std::atomic<uint64_t> contended;
+	std::atomic<size_t> tags;
+};
+
+// FNV-1a over the full code
+static uint64_t Merge_Hash(const unsigned char* code, size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ code[i]) * 1099511628211ULL;
+	return hash;
+}
+
+// Feeding threads take their time before the shard lock: another one may have stamped a later read.
+static uint64_t Merge_Age(uint64_t now, uint64_t ms)
+{
+	return now > ms ? now - ms : 0;
+}
+
+static void Merge_Lock(TagMerge* merge, MergeShard* shard)
+{
+	if (pthread_mutex_trylock(&shard->lock) == 0)
+		return;
+	merge->contended.fetch_add(1, std::memory_order_relaxed);
+	pthread_mutex_lock(&shard->lock);
+}
+
+static void Merge_Unlink(MergeShard* sh, unsigned int i)
+{
+	MergeEntry& e = sh->entries[i];
+	if (e.prev != MERGE_NONE)
+		sh->entries[e.prev].next = e.next;
+	else
+		sh->head = e.next;
+	if (e.next != MERGE_NONE)
+		sh->entries[e.next].prev = e.prev;
+	else
+		sh->tail = e.prev;
+}
+
+static void Merge_Append(MergeShard* sh, unsigned int i)
+{
+	MergeEntry& e = sh->entries[i];
+	e.prev = sh->tail;
+	e.next = MERGE_NONE;
+	if (sh->tail != MERGE_NONE)
+		sh->entries[sh->tail].next = i;
+	else
+		sh->head = i;
+	sh->tail = i;
+}
+
+// Queues an event about entry e; from is the previous owner of a MERGE_HANDOFF.
+static void Merge_Emit(TagMerge* merge, const MergeEntry& e, int event, int from, uint64_t now)
+{
+	const MergeReader& owner = e.readers[e.owner];
+	TagMergeEvent ev;
+	ev.event = event;
+	ev.hComm = owner.hComm;
+	ev.rssi = owner.peakRssi;
+	ev.antenna = owner.antenna;
+	ev.fromHComm = from >= 0 ? e.readers[from].hComm : 0;
+	ev.fromRssi = from >= 0 ? e.readers[from].peakRssi : 0;
+	ev.readers = 0;
+	for (unsigned int r = 0; r < e.readerCount; r++)
+	{
+		if (Merge_Age(now, e.readers[r].lastMs) <= merge->config.windowMs)
+			ev.readers++;
+	}
+	ev.codeLen = e.codeLen;
+	memcpy(ev.code, e.code, e.codeLen);
+	ev.count = e.count;
+	ev.firstMs = e.firstMs;
+	ev.timeMs = now;
+	if (merge->ring->Push(ev))
+		merge->counters.pushed.fetch_add(1, std::memory_order_relaxed);
+	else
+		merge->counters.overflow.fetch_add(1, std::memory_order_relaxed);
+	merge->waiter.Notify();
+}
+
+// Takes entry i out of its bucket, the LRU list and the shard.
+static void Merge_Remove(TagMerge* merge, MergeShard* sh, unsigned int i)
+{
+	unsigned int* link = &sh->buckets[sh->entries[i].hash & sh->mask];
+	while (*link != i)
+		link = &sh->entries[*link].chain;
+	*link = sh->entries[i].chain;
+	Merge_Unlink(sh, i);
+	sh->entries[i].chain = sh->free;
+	sh->free = i;
+	merge->tags.fetch_sub(1, std::memory_order_relaxed);
+}
+
+static unsigned int Merge_Find(MergeShard* sh, uint64_t hash, const unsigned char* code, size_t codeLen)
+{
+	for (unsigned int i = sh->buckets[hash & sh->mask]; i != MERGE_NONE; i = sh->entries[i].chain)
+	{
+		const MergeEntry& e = sh->entries[i];
+		if (e.hash == hash && e.codeLen == codeLen && memcmp(e.code, code, codeLen) == 0)
+			return i;
+	}
+	return MERGE_NONE;
+}
+
+static void Merge_ExpireShard(TagMerge* merge, MergeShard* sh, uint64_t now)
+{
+	// the LRU head is the tag read longest ago, stop at the first one some reader still sees
+	while (sh->head != MERGE_NONE && Merge_Age(now, sh->entries[sh->head].lastMs) >= merge->config.departMs)
+	{
+		unsigned int i = sh->head;
+		Merge_Emit(merge, sh->entries[i], MERGE_DEPART, -1, now);
+		Merge_Remove(merge, sh, i);
+	}
+}
+
+// Slot of hComm in e; a reader not tracked yet takes a free slot or the one heard from longest ago.
+static unsigned int Merge_Reader(MergeEntry& e, int64_t hComm)
+{
+	for (unsigned int r = 0; r < e.readerCount; r++)
+	{
+		if (e.readers[r].hComm == hComm)
+			return r;
+	}
+	unsigned int r = e.readerCount;
+	if (r < MERGE_READERS)
+		e.readerCount++;
+	else
+	{
+		r = e.owner == 0 ? 1 : 0;
+		for (unsigned int k = 0; k < MERGE_READERS; k++)
+		{
+			if (k != e.owner && e.readers[k].lastMs < e.readers[r].lastMs)
+				r = k;
+		}
+	}
+	e.readers[r].hComm = hComm;
+	e.readers[r].peakMs = 0;
+	e.readers[r].lastMs = 0;
+	e.readers[r].peakRssi = SHRT_MIN;
+	return r;
+}
+
+static void Merge_Read(MergeReader& reader, const TagInfoCompact& tag, unsigned int windowMs, uint64_t now)
+{
+	if (tag.rssi >= reader.peakRssi || Merge_Age(now, reader.peakMs) > windowMs)
+	{
+		reader.peakRssi = tag.rssi;
+		reader.peakMs = now;
+	}
+	if (now > reader.lastMs)
+		reader.lastMs = now;
+	reader.antenna = tag.antenna;
+}
+
+static void Merge_One(TagMerge* merge, int64_t hComm, const TagInfoCompact& tag, const TagCodeArena* arena, uint64_t now)
+{
+	const unsigned char* code = TagCompactCode(&tag, arena);
+	size_t codeLen = tag.codeLen;
+	uint64_t hash = Merge_Hash(code, codeLen);
+	if (codeLen > MERGE_CODE_MAX)
+		codeLen = MERGE_CODE_MAX;
+	MergeShard* sh = merge->shards[(hash >> 32) & merge->shardMask];
+
+	Merge_Lock(merge, sh);
+	Merge_ExpireShard(merge, sh, now);
+	unsigned int i = Merge_Find(sh, hash, code, codeLen);
+	if (i != MERGE_NONE)
+	{
+		MergeEntry& e = sh->entries[i];
+		if (now > e.lastMs)
+			e.lastMs = now;
+		e.count++;
+		Merge_Unlink(sh, i);
+		Merge_Append(sh, i);
+		unsigned int r = Merge_Reader(e, hComm);
+		Merge_Read(e.readers[r], tag, merge->config.windowMs, now);
+
+		// the owner keeps the tag while it reads it, unless another reader is clearly stronger
+		const MergeReader& owner = e.readers[e.owner];
+		if (r != e.owner && (Merge_Age(now, owner.lastMs) > merge->config.windowMs
+			|| e.readers[r].peakRssi > owner.peakRssi + merge->config.hysteresis))
+		{
+			int from = e.owner;
+			e.owner = (unsigned char)r;
+			merge->handoffs.fetch_add(1, std::memory_order_relaxed);
+			Merge_Emit(merge, e, MERGE_HANDOFF, from, now);
+		}
+		pthread_mutex_unlock(&sh->lock);
+		return;
+	}
+
+	if (sh->free == MERGE_NONE)
+	{
+		// full: the tag read longest ago makes room
+		unsigned int victim = sh->head;
+		Merge_Emit(merge, sh->entries[victim], MERGE_EVICT, -1, now);
+		Merge_Remove(merge, sh, victim);
+	}
+	i = sh->free;
+	MergeEntry& e = sh->entries[i];
+	sh->free = e.chain;
+	e.hash = hash;
+	e.firstMs = e.lastMs = now;
+	e.count = 1;
+	e.owner = 0;
+	e.readerCount = 0;
+	Merge_Read(e.readers[Merge_Reader(e, hComm)], tag, merge->config.windowMs, now);
+	e.codeLen = (unsigned char)codeLen;
+	memcpy(e.code, code, codeLen);
+	unsigned int* bucket = &sh->buckets[hash & sh->mask];
+	e.chain = *bucket;
+	*bucket = i;
+	Merge_Append(sh, i);
+	merge->tags.fetch_add(1, std::memory_order_relaxed);
+	Merge_Emit(merge, e, MERGE_ARRIVE, -1, now);
+	pthread_mutex_unlock(&sh->lock);
+}
+
+TagMerge* TagMergeCreate(const TagMergeConfig* config)
+{
+	TagMergeConfig c;
+	memset(&c, 0, sizeof(c));
+	if (config != NULL)
+		c = *config;
+	if (c.windowMs == 0)
+		c.windowMs = MERGE_DEFAULT_WINDOW;
+	if (c.departMs == 0)
+		c.departMs = c.windowMs > MERGE_DEFAULT_DEPART ? c.windowMs : MERGE_DEFAULT_DEPART;
+	if (c.hysteresis == 0)
+		c.hysteresis = MERGE_DEFAULT_HYSTERESIS;
+	if (c.maxTags == 0)
+		c.maxTags = MERGE_DEFAULT_TAGS;
+	if (c.shards == 0)
+		c.shards = MERGE_DEFAULT_SHARDS;
+	if (c.ringSize == 0)
+		c.ringSize = RING_DEFAULT_SIZE;
+	if (c.departMs < c.windowMs || c.maxTags >= MERGE_NONE / 2 || c.shards > c.maxTags)
+		return NULL;
+	unsigned int shards = 1;
+	while (shards < c.shards)
+		shards <<= 1;
+	c.shards = shards;
+
+	TagMerge* merge = new TagMerge();
+	merge->config = c;
+	merge->shardMask = shards - 1;
+	merge->reads = 0;
+	merge->handoffs = 0;
+	merge->contended = 0;
+	merge->tags = 0;
+	merge->ring = Mpsc_Ring<TagMergeEvent>::Create(c.ringSize);
+	if (merge->ring == NULL)
+	{
+		delete merge;
+		return NULL;
+	}
+	unsigned int perShard = (c.maxTags + shards - 1) / shards;
+	unsigned int buckets = 16;
+	while (buckets < 2 * perShard)
+		buckets <<= 1;
+	for (unsigned int s = 0; s < shards; s++)
+	{
+		MergeShard* sh = new MergeShard();
+		pthread_mutex_init(&sh->lock, NULL);
+		sh->entries.resize(perShard);
+		sh->buckets.assign(buckets, MERGE_NONE);
+		sh->mask = buckets - 1;
+		for (unsigned int i = 0; i < perShard; i++)
+			sh->entries[i].chain = i + 1 < perShard ? i + 1 : MERGE_NONE;
+		sh->free = 0;
+		sh->head = sh->tail = MERGE_NONE;
+		merge->shards.push_back(sh);
+	}
+	return merge;
+}
+
+void TagMergeDestroy(TagMerge* merge)
+{
+	if (merge == NULL)
+		return;
+	for (size_t s = 0; s < merge->shards.size(); s++)
+	{
+		pthread_mutex_destroy(&merge->shards[s]->lock);
+		delete merge->shards[s];
+	}
+	Mpsc_Ring<TagMergeEvent>::Destroy(merge->ring);
+	delete merge;
+}
+
+int TagMergeFeed(TagMerge* merge, int64_t hComm, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena)
+{
+	if (merge == NULL || (tags == NULL && count != 0))
+		return STAT_CMD_PARAM_ERR;
+	uint64_t now = CFStats_NowUs() / 1000;
+	merge->reads.fetch_add(count, std::memory_order_relaxed);
+	for (size_t t = 0; t < count; t++)
+		Merge_One(merge, hComm, tags[t], arena, now);
+	return STAT_OK;
+}
+
+void TagMergeStreamCallback(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	// one reader ending its stream leaves its tags to the others, or to departMs
+	if (status != STAT_OK)
+		return;
+	TagMergeFeed((TagMerge*)userCtx, hComm, tags, count, arena);
+}
+
+int TagMergeExpire(TagMerge* merge)
+{
+	if (merge == NULL)
+		return STAT_CMD_PARAM_ERR;
+	uint64_t now = CFStats_NowUs() / 1000;
+	for (size_t s = 0; s < merge->shards.size(); s++)
+	{
+		MergeShard* sh = merge->shards[s];
+		if (pthread_mutex_trylock(&sh->lock) != 0)
+			continue;
+		Merge_ExpireShard(merge, sh, now);
+		pthread_mutex_unlock(&sh->lock);
+	}
+	return STAT_OK;
+}
+
+int TagMergeFlush(TagMerge* merge)
+{
+	if (merge == NULL)
+		return STAT_CMD_PARAM_ERR;
+	uint64_t now = CFStats_NowUs() / 1000;
+	for (size_t s = 0; s < merge->shards.size(); s++)
+	{
+		MergeShard* sh = merge->shards[s];
+		pthread_mutex_lock(&sh->lock);
+		while (sh->head != MERGE_NONE)
+		{
+			unsigned int i = sh->head;
+			Merge_Emit(merge, sh->entries[i], MERGE_FLUSH, -1, now);
+			Merge_Remove(merge, sh, i);
+		}
+		pthread_mutex_unlock(&sh->lock);
+	}
+	return STAT_OK;
+}
+
+static void Merge_StreamIdle(int64_t hComm, void* userCtx)
+{
+	TagMergeExpire((TagMerge*)userCtx);
+}
+
+int InventoryStartMerged(int64_t hComm, TagMerge* merge, unsigned int flags)
+{
+	if (merge == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return CFStream_Start(hComm, TagMergeStreamCallback, Merge_StreamIdle, merge, flags);
+}
+
+int TagMergePop(TagMerge* merge, TagMergeEvent* out, size_t capacity, size_t* count, unsigned short timeout)
+{
+	if (merge == NULL || out == NULL || count == NULL || capacity == 0)
+		return STAT_CMD_PARAM_ERR;
+	*count = 0;
+	TagMergeExpire(merge);
+	return Ring_PopWait(merge->ring, merge->waiter, merge->counters, out, capacity, count, timeout);
+}
+
+int TagMergeGetStats(TagMerge* merge, TagMergeStats* stats)
+{
+	if (merge == NULL || stats == NULL)
+		return STAT_CMD_PARAM_ERR;
+	stats->reads = merge->reads.load(std::memory_order_relaxed);
+	stats->events = merge->counters.pushed.load(std::memory_order_relaxed);
+	stats->handoffs = merge->handoffs.load(std::memory_order_relaxed);
+	stats->overflow = merge->counters.overflow.load(std::memory_order_relaxed);
+	stats->contended = merge->contended.load(std::memory_order_relaxed);
+	stats->tags = merge->tags.load(std::memory_order_relaxed);
+	stats->queued = merge->ring->Size();
+	return STAT_OK;
+}
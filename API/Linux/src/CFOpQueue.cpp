@@ -0,0 +1,349 @@
+#include "CFFrame.h"
+
+#define OPQUEUE_DRAIN_QUIET					50		// ms without input that ends draining late answers after a timeout
+
+// Command sent for one TagOp and still waiting for its response.
+struct OpPending
+{
+	unsigned short cmd;
+	size_t index;
+	bool select;					// the SetSelectMask in front of the operation
+	uint64_t sentUs;
+};
+
+unsigned short CFOp_Cmd(const TagOp* op)
+{
+	switch (op->type)
+	{
+	case TAGOP_READ: return FRAME_CMD_READ_TAG;
+	case TAGOP_WRITE: return FRAME_CMD_WRITE_TAG;
+	case TAGOP_LOCK: return FRAME_CMD_LOCK_TAG;
+	default: return 0;
+	}
+}
+
+size_t CFOp_BuildSelect(const TagOp* op, unsigned char* frame)
+{
+	unsigned char* p = frame + FRAME_HEAD_LEN;
+	size_t maskLen = (op->maskBits + 7) / 8;
+	*p++ = (unsigned char)(op->maskPtr >> 8);
+	*p++ = (unsigned char)op->maskPtr;
+	*p++ = op->maskBits;
+	memcpy(p, op->mask, maskLen);
+	return CFFrame_Build(frame, FRAME_CMD_SELECT_MASK, 3 + maskLen);
+}
+
+// Same payloads as ReadTag / WriteTag / LockTag.
+size_t CFOp_Build(const TagOp* op, unsigned char* frame)
+{
+	unsigned char* p = frame + FRAME_HEAD_LEN;
+	if (op->type == TAGOP_LOCK)
+	{
+		memcpy(p, op->accPwd, 4);
+		p[4] = op->memBank;
+		p[5] = op->action;
+		return CFFrame_Build(frame, FRAME_CMD_LOCK_TAG, 6);
+	}
+	*p++ = op->option;
+	memcpy(p, op->accPwd, 4);
+	p += 4;
+	*p++ = op->memBank;
+	*p++ = (unsigned char)(op->wordPtr >> 8);
+	*p++ = (unsigned char)op->wordPtr;
+	*p++ = op->wordCount;
+	if (op->type == TAGOP_WRITE)
+	{
+		memcpy(p, op->data, 2 * op->wordCount);
+		p += 2 * op->wordCount;
+	}
+	return CFFrame_Build(frame, CFOp_Cmd(op), p - frame - FRAME_HEAD_LEN);
+}
+
+int CFOp_Validate(const TagOp* op)
+{
+	if (CFOp_Cmd(op) == 0)
+		return STAT_CMD_PARAM_ERR;
+	if (op->maskBits > 8 * sizeof(op->mask))
+		return STAT_CMD_PARAM_ERR;
+	if (op->type == TAGOP_WRITE && (op->data == NULL || op->wordCount == 0 || op->wordCount > 120))
+		return STAT_CMD_PARAM_ERR;
+	if (op->type == TAGOP_READ && op->wordCount > 120)
+		return STAT_CMD_PARAM_ERR;
+	return STAT_OK;
+}
+
+// Tag response payload: status tagStatus antenna crc[2] pc[2] codeLen code[codeLen] (read: wordCount data[2 * wordCount])
+int CFOp_Parse(const unsigned char* frame, bool read, TagOpResult* result)
+{
+	size_t len = frame[4];
+	if (len == 1)
+		return frame[5] == 0x00 ? STAT_CMD_RESP_FORMAT_ERR : CFFrame_Status(frame[5]);
+	if (frame[5] != 0x00 || len < 8)
+		return STAT_CMD_RESP_FORMAT_ERR;
+	unsigned char codeLen = frame[12];
+	size_t expected = 8 + (size_t)codeLen;
+	if (read)
+	{
+		if (len < expected + 1)
+			return STAT_CMD_RESP_FORMAT_ERR;
+		result->wordCount = frame[13 + codeLen];
+		result->data = frame + 14 + codeLen;
+		expected += 1 + 2 * result->wordCount;
+	}
+	if (len != expected)
+		return STAT_CMD_RESP_FORMAT_ERR;
+
+	result->tagStatus = frame[6];
+	result->antenna = frame[7];
+	result->crc[0] = frame[8];
+	result->crc[1] = frame[9];
+	result->pc[0] = frame[10];
+	result->pc[1] = frame[11];
+	result->codeLen = codeLen;
+	result->code = frame + 13;
+	return STAT_OK;
+}
+
+static void Op_Complete(int64_t hComm, const TagOp* ops, size_t index, int status, TagOpResult* result, TagOpCallback callback, void* userCtx)
+{
+	result->index = index;
+	result->status = status;
+	callback(hComm, &ops[index], result, userCtx);
+}
+
+static void Op_Fail(int64_t hComm, const TagOp* ops, size_t index, int status, TagOpCallback callback, void* userCtx)
+{
+	TagOpResult result;
+	memset(&result, 0, sizeof(result));
+	Op_Complete(hComm, ops, index, status, &result, callback, userCtx);
+}
+
+// HID connections: no descriptor to pipeline on, run the operations one by one through libCFApi.
+static int Op_RunSequential(int64_t hComm, const TagOp* ops, size_t n, TagOpCallback callback, void* userCtx, unsigned short timeout)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		const TagOp* op = &ops[i];
+		TagOpResult result;
+		memset(&result, 0, sizeof(result));
+		int status = CFOp_Validate(op);
+		if (status == STAT_OK && op->maskBits != 0)
+			status = SetSelectMask(hComm, op->maskPtr, op->maskBits, (unsigned char*)op->mask);
+		if (status != STAT_OK)
+		{
+			Op_Complete(hComm, ops, i, status, &result, callback, userCtx);
+			continue;
+		}
+
+		TagResp resp;
+		unsigned char data[255];
+		if (op->type == TAGOP_READ)
+		{
+			status = ReadTag(hComm, op->option, (unsigned char*)op->accPwd, op->memBank, op->wordPtr, op->wordCount);
+			if (status == STAT_OK)
+				status = GetReadTagResp(hComm, &resp, &result.wordCount, data, timeout);
+			result.data = data;
+		}
+		else if (op->type == TAGOP_WRITE)
+		{
+			status = WriteTag(hComm, op->option, (unsigned char*)op->accPwd, op->memBank, op->wordPtr, op->wordCount, op->data);
+			if (status == STAT_OK)
+				status = GetTagResp(hComm, FRAME_CMD_WRITE_TAG, &resp, timeout);
+		}
+		else
+		{
+			status = LockTag(hComm, (unsigned char*)op->accPwd, op->memBank, op->action);
+			if (status == STAT_OK)
+				status = GetTagResp(hComm, FRAME_CMD_LOCK_TAG, &resp, timeout);
+		}
+		if (status == STAT_OK)
+		{
+			result.tagStatus = resp.tagStatus;
+			result.antenna = resp.antenna;
+			memcpy(result.crc, resp.crc, 2);
+			memcpy(result.pc, resp.pc, 2);
+			result.codeLen = resp.codeLen;
+			result.code = resp.code;
+		}
+		Op_Complete(hComm, ops, i, status, &result, callback, userCtx);
+	}
+	return STAT_OK;
+}
+
+int CFOpQueueSetDepth(int64_t hComm, unsigned int depth)
+{
+	if (depth == 0 || depth > OPQUEUE_DEPTH_MAX)
+		return STAT_CMD_PARAM_ERR;
+	CFHandle_Get(hComm)->opDepth = depth;
+	return STAT_OK;
+}
+
+// Answers of a window lost to a timeout may still arrive and would match the next operation of
+// the same command: read them away before sending more. Returns false if the link has not gone
+// quiet within timeout ms.
+static bool Op_Drain(CFHandleCtx* ctx, int fd, unsigned short timeout)
+{
+	unsigned char frame[FRAME_MAX_LEN];
+	struct timespec end;
+	CFFrame_Deadline(&end, timeout);
+	for (;;)
+	{
+		int left = CFFrame_RemainingMs(&end);
+		if (left == 0)
+			return false;
+		struct timespec deadline;
+		CFFrame_Deadline(&deadline, left < OPQUEUE_DRAIN_QUIET ? left : OPQUEUE_DRAIN_QUIET);
+		size_t frameLen;
+		int status = CFFrame_Read(fd, frame, &frameLen, &deadline, &ctx->stats);
+		if (status == (int)STAT_CMD_COMM_TIMEOUT)
+			return left >= OPQUEUE_DRAIN_QUIET;
+		if (status != STAT_OK && status != (int)STAT_CMD_RESP_CRC_ERR)
+			return true;	// the link failed, the next write reports it
+	}
+}
+
+static int Op_RunPipelined(CFHandleCtx* ctx, int fd, const TagOp* ops, size_t n, TagOpCallback callback, void* userCtx, unsigned short timeout)
+{
+	int64_t hComm = ctx->hComm;
+	size_t depth = ctx->opDepth ? ctx->opDepth : OPQUEUE_DEFAULT_DEPTH;
+	// a SetSelectMask travels with its operation, two commands per slot at most
+	OpPending pending[2 * OPQUEUE_DEPTH_MAX];
+	size_t head = 0, count = 0, inFlightOps = 0;
+	int selectStatus[OPQUEUE_DEPTH_MAX * 2];
+	unsigned char frame[FRAME_MAX_LEN];
+	size_t next = 0, done = 0;
+	int linkStatus = STAT_OK;
+
+	while (done < n)
+	{
+		// keep the window full: the reader works through the commands while the answers travel back
+		while (linkStatus == STAT_OK && next < n && inFlightOps < depth)
+		{
+			const TagOp* op = &ops[next];
+			int status = CFOp_Validate(op);
+			if (status != STAT_OK)
+			{
+				Op_Fail(hComm, ops, next++, status, callback, userCtx);
+				done++;
+				continue;
+			}
+			if (op->maskBits != 0)
+			{
+				linkStatus = CFFrame_Write(fd, frame, CFOp_BuildSelect(op, frame), &ctx->stats);
+				if (linkStatus != STAT_OK)
+					break;
+				size_t slot = (head + count++) % (2 * OPQUEUE_DEPTH_MAX);
+				pending[slot].cmd = FRAME_CMD_SELECT_MASK;
+				pending[slot].index = next;
+				pending[slot].select = true;
+				pending[slot].sentUs = CFStats_NowUs();
+			}
+			linkStatus = CFFrame_Write(fd, frame, CFOp_Build(op, frame), &ctx->stats);
+			if (linkStatus != STAT_OK)
+				break;
+			size_t slot = (head + count++) % (2 * OPQUEUE_DEPTH_MAX);
+			pending[slot].cmd = CFOp_Cmd(op);
+			pending[slot].index = next;
+			pending[slot].select = false;
+			pending[slot].sentUs = CFStats_NowUs();
+			selectStatus[next % (2 * OPQUEUE_DEPTH_MAX)] = STAT_OK;
+			inFlightOps++;
+			next++;
+		}
+		if (count == 0)
+		{
+			if (linkStatus != STAT_OK)
+				break;
+			continue;
+		}
+
+		struct timespec deadline;
+		CFFrame_Deadline(&deadline, timeout);
+		size_t frameLen;
+		int status = CFFrame_Read(fd, frame, &frameLen, &deadline, &ctx->stats);
+		if (status == (int)STAT_CMD_RESP_CRC_ERR)
+			continue;
+		if (status != STAT_OK)
+		{
+			// nothing more is coming back for what is in flight
+			if (status == (int)STAT_CMD_COMM_RD_FAILED || status == (int)STAT_DLL_DISCONNECT)
+				linkStatus = status;
+			while (count > 0)
+			{
+				OpPending* p = &pending[head];
+				head = (head + 1) % (2 * OPQUEUE_DEPTH_MAX);
+				count--;
+				CFStats_Rtt(&ctx->stats, p->cmd, 0, true);
+				if (p->select)
+					continue;
+				Op_Fail(hComm, ops, p->index, status, callback, userCtx);
+				inFlightOps--;
+				done++;
+			}
+			// the rest of the batch fails too if late answers keep coming
+			if (linkStatus == STAT_OK && !Op_Drain(ctx, fd, timeout))
+				linkStatus = status;
+			continue;
+		}
+
+		// match by command code: commands in front of the match have lost their response
+		unsigned short cmd = (frame[2] << 8) | frame[3];
+		size_t match = 0;
+		while (match < count && pending[(head + match) % (2 * OPQUEUE_DEPTH_MAX)].cmd != cmd)
+			match++;
+		if (match == count)
+			continue;	// inventory label or an answer that already timed out
+		for (size_t i = 0; i <= match; i++)
+		{
+			OpPending* p = &pending[head];
+			head = (head + 1) % (2 * OPQUEUE_DEPTH_MAX);
+			count--;
+			CFStats_Rtt(&ctx->stats, p->cmd, CFStats_NowUs() - p->sentUs, i < match);
+			int* selStatus = &selectStatus[p->index % (2 * OPQUEUE_DEPTH_MAX)];
+			if (p->select)
+			{
+				if (i < match)
+					*selStatus = STAT_CMD_COMM_TIMEOUT;
+				else if (frame[4] < 1)
+					*selStatus = STAT_CMD_RESP_FORMAT_ERR;
+				else
+					*selStatus = CFFrame_Status(frame[5]);
+				continue;
+			}
+			TagOpResult result;
+			memset(&result, 0, sizeof(result));
+			if (i < match)
+				status = STAT_CMD_COMM_TIMEOUT;
+			else
+				status = CFOp_Parse(frame, p->cmd == FRAME_CMD_READ_TAG, &result);
+			// the operation went to whatever tag matched: report a failed SetSelectMask first
+			if (*selStatus != STAT_OK)
+				status = *selStatus;
+			Op_Complete(hComm, ops, p->index, status, &result, callback, userCtx);
+			inFlightOps--;
+			done++;
+		}
+	}
+
+	for (; next < n; next++)
+		Op_Fail(hComm, ops, next, linkStatus, callback, userCtx);
+	return linkStatus;
+}
+
+int CFOpQueueSubmit(int64_t hComm, const TagOp* ops, size_t n, TagOpCallback callback, void* userCtx, unsigned short timeout)
+{
+	if (ops == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	// the whole window is one turn on the link, other commands of the handle wait for it
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFSeq_Enter(ctx);
+	int fd = CFHandle_Fd(hComm);
+	int status;
+	if (fd < 0)
+		status = Op_RunSequential(hComm, ops, n, callback, userCtx, timeout);
+	else
+		status = Op_RunPipelined(ctx, fd, ops, n, callback, userCtx, timeout);
+	CFSeq_Leave(ctx);
+	return status;
+}
@@ -0,0 +1,95 @@
+#include "CFHandle.h"
+
+// The by-value setters of libCFApi copy their block once more at this boundary; callers of the
+// _Ptr forms keep a single block and no longer build a temporary for every call.
+
+int SetDevicePara_Ptr(int64_t hComm, const DevicePara* devInfo)
+{
+	if (devInfo == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetDevicePara(hComm, *devInfo);
+}
+
+int SetLongPermissonPara_Ptr(int64_t hComm, const LongPermissonPara* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetLongPermissonPara(hComm, *param);
+}
+
+int SetPermissonPara_Ptr(int64_t hComm, const PermissonPara* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetPermissonPara(hComm, *param);
+}
+
+int SetGpioPara_Ptr(int64_t hComm, const GpioPara* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetGpioPara(hComm, *param);
+}
+
+int SetNetInfo_Ptr(int64_t hComm, const NetInfo* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetNetInfo(hComm, *param);
+}
+
+int SetwifiPara_Ptr(int64_t hComm, const WiFiPara* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetwifiPara(hComm, *param);
+}
+
+int SetRemoteNetInfo_Ptr(int64_t hComm, const RemoteNetInfo* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetRemoteNetInfo(hComm, *param);
+}
+
+int SetAntPower_Ptr(int64_t hComm, const AntPower* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetAntPower(hComm, *param);
+}
+
+int SetGPIOWorkParam_Ptr(int64_t hComm, const GPIOWorkParam* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetGPIOWorkParam(hComm, *param);
+}
+
+int SetGateWorkParam_Ptr(int64_t hComm, const GateWorkParam* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetGateWorkParam(hComm, *param);
+}
+
+int SetEASMask_Ptr(int64_t hComm, const EASMask* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetEASMask(hComm, *param);
+}
+
+int SetHeartbeat_Ptr(int64_t hComm, const Heartbeat* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetHeartbeat(hComm, *param);
+}
+
+int SetAccessOperateParam_Ptr(int64_t hComm, const AccessOperateParam* param)
+{
+	if (param == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return SetAccessOperateParam(hComm, *param);
+}
@@ -0,0 +1,516 @@
+#include "CFHandle.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define POOL_TICK_MS						1000	// keepalive thread period, also the retry period of broken sessions
+#define POOL_KEEPALIVE_PROBES				3		// TCP keepalive probes before the kernel drops a session
+
+struct PoolSession
+{
+	std::string ip;
+	unsigned short port;
+	int64_t hComm;
+	bool connected;
+	bool broken;					// link error seen, reconnect before the next use
+	bool busy;						// acquired, the holder does the I/O without the pool lock
+	bool streamWanted;				// CFPoolStartStreaming until CFPoolStopStreaming
+	bool streamRunning;
+	TagStreamCallback callback;
+	void* userCtx;
+	unsigned int flags;
+	unsigned int connects;
+	unsigned int commands;
+	uint64_t lastUsedMs;
+	uint64_t lastProbeMs;
+	CFPool* pool;
+};
+
+struct CFPool
+{
+	PoolConfig config;
+	pthread_mutex_t lock;			// sessions and their flags
+	pthread_cond_t changed;			// a session became free or broken, or the pool stops
+	pthread_t thread;
+	bool stop;
+	std::map<std::string, PoolSession*> sessions;
+};
+
+static std::string Pool_Key(const char* ip, unsigned short port)
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), ":%u", port);
+	return std::string(ip) + buf;
+}
+
+// Pool lock held.
+static PoolSession* Pool_Find(CFPool* pool, const char* ip, unsigned short port, bool create)
+{
+	std::string key = Pool_Key(ip, port);
+	std::map<std::string, PoolSession*>::iterator it = pool->sessions.find(key);
+	if (it != pool->sessions.end())
+		return it->second;
+	if (!create)
+		return NULL;
+	PoolSession* s = new PoolSession();
+	s->ip = ip;
+	s->port = port;
+	s->hComm = 0;
+	s->connected = false;
+	s->broken = false;
+	s->busy = false;
+	s->streamWanted = false;
+	s->streamRunning = false;
+	s->callback = NULL;
+	s->userCtx = NULL;
+	s->flags = 0;
+	s->connects = 0;
+	s->commands = 0;
+	s->lastUsedMs = s->lastProbeMs = CFStats_NowUs() / 1000;
+	s->pool = pool;
+	pool->sessions[key] = s;
+	return s;
+}
+
+// Pool lock held. Waits until s is free unless wait is false.
+static bool Pool_Take(CFPool* pool, PoolSession* s, bool wait)
+{
+	while (s->busy)
+	{
+		if (!wait)
+			return false;
+		pthread_cond_wait(&pool->changed, &pool->lock);
+	}
+	s->busy = true;
+	return true;
+}
+
+// Pool lock held.
+static void Pool_Give(CFPool* pool, PoolSession* s)
+{
+	s->busy = false;
+	pthread_cond_broadcast(&pool->changed);
+}
+
+// Readers drop sessions that stay silent, the kernel keeps the socket alive between probes.
+static void Pool_SetKeepalive(CFPool* pool, int64_t hComm)
+{
+	int fd = CFHandle_Fd(hComm);
+	if (fd < 0)
+		return;
+	int on = 1;
+	int idle = pool->config.keepaliveMs / 1000 ? pool->config.keepaliveMs / 1000 : 1;
+	int count = POOL_KEEPALIVE_PROBES;
+	setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &idle, sizeof(idle));
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+}
+
+// Session taken, pool lock not held.
+static void Pool_Close(CFPool* pool, PoolSession* s)
+{
+	if (!s->connected)
+		return;
+	// CloseDeviceEx also ends a stream that is still running
+	CloseDeviceEx(s->hComm);
+	pthread_mutex_lock(&pool->lock);
+	s->connected = false;
+	s->streamRunning = false;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// Session taken, pool lock not held. (Re)opens the session if it is not usable.
+static int Pool_Connect(CFPool* pool, PoolSession* s)
+{
+	if (s->connected && !s->broken)
+		return STAT_OK;
+	Pool_Close(pool, s);
+	int64_t hComm = 0;
+	int status = CFHandle_OpenNet(&hComm, (char*)s->ip.c_str(), s->port, pool->config.connectTimeoutMs);
+	if (status == STAT_OK)
+		Pool_SetKeepalive(pool, hComm);
+	pthread_mutex_lock(&pool->lock);
+	s->broken = status != STAT_OK;
+	if (status == STAT_OK)
+	{
+		s->hComm = hComm;
+		s->connected = true;
+		s->connects++;
+		s->lastProbeMs = CFStats_NowUs() / 1000;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return status;
+}
+
+static void Pool_StreamSink(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	PoolSession* s = (PoolSession*)userCtx;
+	if (status == STAT_OK)
+	{
+		s->callback(hComm, status, tags, count, arena, s->userCtx);
+		return;
+	}
+	CFPool* pool = s->pool;
+	if (status == (int)STAT_CMD_INVENTORY_STOP)
+	{
+		// the reader ended the inventory itself, that is the end of the stream
+		s->callback(hComm, status, tags, count, arena, s->userCtx);
+		pthread_mutex_lock(&pool->lock);
+		s->streamWanted = false;
+		s->streamRunning = false;
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+	// link error: the keepalive thread reconnects and resumes the stream
+	pthread_mutex_lock(&pool->lock);
+	s->broken = true;
+	s->streamRunning = false;
+	pthread_cond_broadcast(&pool->changed);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// Session taken, pool lock not held.
+static void Pool_Resume(CFPool* pool, PoolSession* s)
+{
+	pthread_mutex_lock(&pool->lock);
+	bool start = s->streamWanted && !s->streamRunning && s->connected && !s->broken;
+	pthread_mutex_unlock(&pool->lock);
+	if (!start)
+		return;
+	int status = CFStream_Start(s->hComm, Pool_StreamSink, NULL, s, s->flags);
+	pthread_mutex_lock(&pool->lock);
+	if (status == STAT_OK)
+		s->streamRunning = true;
+	else
+		s->broken = true;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// Session taken, pool lock not held.
+static void Pool_Pause(CFPool* pool, PoolSession* s)
+{
+	pthread_mutex_lock(&pool->lock);
+	bool running = s->streamRunning;
+	s->streamRunning = false;
+	pthread_mutex_unlock(&pool->lock);
+	if (running && InventoryStopStreaming(s->hComm, COMMON_TIMEOUT) == (int)STAT_DLL_DISCONNECT)
+	{
+		pthread_mutex_lock(&pool->lock);
+		s->broken = true;
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+// ms from then to now, 0 when then was stamped after now was read.
+static uint64_t Pool_Since(uint64_t now, uint64_t then)
+{
+	return now > then ? now - then : 0;
+}
+
+// Session unused for idleCloseMs, pool lock held or session taken.
+static bool Pool_Idle(CFPool* pool, PoolSession* s, uint64_t now)
+{
+	return pool->config.idleCloseMs != 0 && !s->streamWanted && Pool_Since(now, s->lastUsedMs) >= pool->config.idleCloseMs;
+}
+
+// One keepalive pass: reconnect broken sessions, probe idle ones, close the unused.
+static void Pool_Maintain(CFPool* pool)
+{
+	std::vector<PoolSession*> due;
+	pthread_mutex_lock(&pool->lock);
+	// read under the lock: a session given back in between stamps lastUsedMs after it
+	uint64_t now = CFStats_NowUs() / 1000;
+	for (std::map<std::string, PoolSession*>::iterator it = pool->sessions.begin(); it != pool->sessions.end(); ++it)
+	{
+		PoolSession* s = it->second;
+		if (!s->connected && !s->streamWanted)
+			continue;
+		bool probe = !s->streamRunning && Pool_Since(now, s->lastProbeMs) >= pool->config.keepaliveMs;
+		if ((s->broken || probe || Pool_Idle(pool, s, now)) && Pool_Take(pool, s, false))
+			due.push_back(s);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	for (size_t i = 0; i < due.size(); i++)
+	{
+		PoolSession* s = due[i];
+		if (Pool_Idle(pool, s, now))
+			Pool_Close(pool, s);
+		else
+		{
+			if (s->connected && !s->broken && !s->streamRunning)
+			{
+				// any answer keeps the session warm, GetHeartbeat is a read-only round trip
+				Heartbeat heart;
+				int status = GetHeartbeat(s->hComm, &heart);
+				pthread_mutex_lock(&pool->lock);
+				s->lastProbeMs = CFStats_NowUs() / 1000;
+				if (status != STAT_OK)
+					s->broken = true;
+				pthread_mutex_unlock(&pool->lock);
+			}
+			if (Pool_Connect(pool, s) == STAT_OK)
+				Pool_Resume(pool, s);
+		}
+		pthread_mutex_lock(&pool->lock);
+		Pool_Give(pool, s);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+static void* PoolThread(void* arg)
+{
+	CFPool* pool = (CFPool*)arg;
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->stop)
+	{
+		struct timespec until;
+		clock_gettime(CLOCK_MONOTONIC, &until);
+		until.tv_sec += POOL_TICK_MS / 1000;
+		pthread_cond_timedwait(&pool->changed, &pool->lock, &until);
+		if (pool->stop)
+			break;
+		pthread_mutex_unlock(&pool->lock);
+		Pool_Maintain(pool);
+		pthread_mutex_lock(&pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+CFPool* CFPoolCreate(const PoolConfig* config)
+{
+	CFPool* pool = new CFPool();
+	if (config != NULL)
+		pool->config = *config;
+	if (pool->config.connectTimeoutMs == 0)
+		pool->config.connectTimeoutMs = POOL_DEFAULT_CONNECT_TIMEOUT;
+	if (pool->config.keepaliveMs == 0)
+		pool->config.keepaliveMs = POOL_DEFAULT_KEEPALIVE;
+	if (pool->config.retries == 0)
+		pool->config.retries = 1;
+	pool->stop = false;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&pool->changed, &attr);
+	pthread_condattr_destroy(&attr);
+	if (pthread_create(&pool->thread, NULL, PoolThread, pool) != 0)
+	{
+		pthread_mutex_destroy(&pool->lock);
+		pthread_cond_destroy(&pool->changed);
+		delete pool;
+		return NULL;
+	}
+	return pool;
+}
+
+void CFPoolDestroy(CFPool* pool)
+{
+	if (pool == NULL)
+		return;
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->changed);
+	pthread_mutex_unlock(&pool->lock);
+	pthread_join(pool->thread, NULL);
+
+	for (std::map<std::string, PoolSession*>::iterator it = pool->sessions.begin(); it != pool->sessions.end(); ++it)
+	{
+		PoolSession* s = it->second;
+		pthread_mutex_lock(&pool->lock);
+		Pool_Take(pool, s, true);
+		s->streamWanted = false;
+		pthread_mutex_unlock(&pool->lock);
+		Pool_Pause(pool, s);
+		Pool_Close(pool, s);
+		delete s;
+	}
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->changed);
+	delete pool;
+}
+
+int CFPoolAcquire(CFPool* pool, const char* ip, unsigned short port, int64_t* hComm)
+{
+	if (pool == NULL || ip == NULL || hComm == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&pool->lock);
+	PoolSession* s = Pool_Find(pool, ip, port, true);
+	Pool_Take(pool, s, true);
+	s->commands++;
+	pthread_mutex_unlock(&pool->lock);
+
+	// the reader answers one request at a time on its only session: labels wait until the command is done
+	Pool_Pause(pool, s);
+	int status = Pool_Connect(pool, s);
+	if (status != STAT_OK)
+	{
+		pthread_mutex_lock(&pool->lock);
+		s->lastUsedMs = CFStats_NowUs() / 1000;
+		Pool_Give(pool, s);
+		pthread_mutex_unlock(&pool->lock);
+		return status;
+	}
+	*hComm = s->hComm;
+	return STAT_OK;
+}
+
+int CFPoolRelease(CFPool* pool, int64_t hComm, int status)
+{
+	if (pool == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	PoolSession* s = NULL;
+	pthread_mutex_lock(&pool->lock);
+	for (std::map<std::string, PoolSession*>::iterator it = pool->sessions.begin(); it != pool->sessions.end(); ++it)
+	{
+		if (it->second->busy && it->second->connected && it->second->hComm == hComm)
+		{
+			s = it->second;
+			break;
+		}
+	}
+	if (s == NULL)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		return STAT_CMD_PARAM_ERR;
+	}
+	if (status == (int)STAT_DLL_DISCONNECT)
+		s->broken = true;
+	uint64_t now = CFStats_NowUs() / 1000;
+	s->lastUsedMs = now;
+	s->lastProbeMs = now;
+	bool reconnect = s->broken && s->streamWanted;
+	pthread_mutex_unlock(&pool->lock);
+
+	// a stream resumes on a good session at once, plain sessions reconnect on their next use
+	if (reconnect)
+		Pool_Connect(pool, s);
+	Pool_Resume(pool, s);
+
+	pthread_mutex_lock(&pool->lock);
+	Pool_Give(pool, s);
+	pthread_mutex_unlock(&pool->lock);
+	return STAT_OK;
+}
+
+int CFPoolCall(CFPool* pool, const char* ip, unsigned short port, HandleCommand command, void* ctx)
+{
+	if (command == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	int64_t hComm;
+	int status = CFPoolAcquire(pool, ip, port, &hComm);
+	if (status != STAT_OK)
+		return status;
+	status = command(hComm, ctx);
+	for (unsigned int retry = 0; status == (int)STAT_DLL_DISCONNECT && retry < pool->config.retries; retry++)
+	{
+		pthread_mutex_lock(&pool->lock);
+		PoolSession* s = Pool_Find(pool, ip, port, false);
+		s->broken = true;
+		pthread_mutex_unlock(&pool->lock);
+		status = Pool_Connect(pool, s);
+		if (status != STAT_OK)
+		{
+			// hComm is closed, give the session back by hand
+			pthread_mutex_lock(&pool->lock);
+			s->lastUsedMs = CFStats_NowUs() / 1000;
+			Pool_Give(pool, s);
+			pthread_mutex_unlock(&pool->lock);
+			return status;
+		}
+		hComm = s->hComm;
+		status = command(hComm, ctx);
+	}
+	CFPoolRelease(pool, hComm, status);
+	return status;
+}
+
+int CFPoolStartStreaming(CFPool* pool, const char* ip, unsigned short port, TagStreamCallback callback, void* userCtx, unsigned int flags)
+{
+	if (pool == NULL || ip == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&pool->lock);
+	PoolSession* s = Pool_Find(pool, ip, port, true);
+	Pool_Take(pool, s, true);
+	if (s->streamWanted)
+	{
+		Pool_Give(pool, s);
+		pthread_mutex_unlock(&pool->lock);
+		return STAT_CMD_PARAM_ERR;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	int status = Pool_Connect(pool, s);
+	if (status == STAT_OK)
+	{
+		s->callback = callback;
+		s->userCtx = userCtx;
+		s->flags = flags;
+		status = CFStream_Start(s->hComm, Pool_StreamSink, NULL, s, flags);
+	}
+	pthread_mutex_lock(&pool->lock);
+	if (status == STAT_OK)
+		s->streamWanted = s->streamRunning = true;
+	s->lastUsedMs = CFStats_NowUs() / 1000;
+	Pool_Give(pool, s);
+	pthread_mutex_unlock(&pool->lock);
+	return status;
+}
+
+int CFPoolStopStreaming(CFPool* pool, const char* ip, unsigned short port)
+{
+	if (pool == NULL || ip == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&pool->lock);
+	PoolSession* s = Pool_Find(pool, ip, port, false);
+	if (s == NULL)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		return STAT_OK;
+	}
+	Pool_Take(pool, s, true);
+	s->streamWanted = false;
+	pthread_mutex_unlock(&pool->lock);
+
+	Pool_Pause(pool, s);
+
+	pthread_mutex_lock(&pool->lock);
+	s->lastUsedMs = CFStats_NowUs() / 1000;
+	Pool_Give(pool, s);
+	pthread_mutex_unlock(&pool->lock);
+	return STAT_OK;
+}
+
+int CFPoolGetInfo(CFPool* pool, const char* ip, unsigned short port, PoolSessionInfo* info)
+{
+	if (pool == NULL || ip == NULL || info == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&pool->lock);
+	PoolSession* s = Pool_Find(pool, ip, port, false);
+	if (s == NULL)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		return STAT_CMD_PARAM_ERR;
+	}
+	info->hComm = s->hComm;
+	info->connected = s->connected && !s->broken;
+	info->streaming = s->streamRunning;
+	info->busy = s->busy;
+	info->connects = s->connects;
+	info->commands = s->commands;
+	info->lastUsedMs = s->lastUsedMs;
+	pthread_mutex_unlock(&pool->lock);
+	return STAT_OK;
+}
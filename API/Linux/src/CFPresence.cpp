@@ -0,0 +1,414 @@
+#include "CFHandle.h"
+#include <vector>
+#include <limits.h>
+
+#define PRESENCE_NONE						0xFFFFFFFFu
+#define PRESENCE_DEFAULT_HYSTERESIS			30
+#define PRESENCE_DEFAULT_SMOOTH				30
+#define PRESENCE_DEFAULT_EXIT_MS			1000
+#define PRESENCE_DEFAULT_DIRECTION_MS		3000
+#define PRESENCE_DEFAULT_TAGS				4096
+
+// One tag, kept in a hash chain and in the LRU list. Entries come from a pool allocated at create
+// time and go back to its free list, the read path never allocates.
+struct PresenceEntry
+{
+	uint64_t hash;
+	unsigned int chain;				// next entry of the bucket, or of the free list
+	unsigned int prev, next;		// LRU list, head is the least recently read
+	uint64_t lastMs;				// last read on any antenna
+	unsigned int inside;			// zones the tag is in, bit z for zone z
+	unsigned int lastZone;			// zone the tag entered last, PRESENCE_NONE before
+	uint64_t lastZoneMs;			// when it was last in lastZone
+	short rssi[PRESENCE_ANTENNAS];	// smoothed per antenna
+	uint64_t antennaMs[PRESENCE_ANTENNAS];	// last read per antenna, 0 never
+	uint64_t enteredMs[PRESENCE_ZONES];
+	unsigned char codeLen;
+	unsigned char code[PRESENCE_CODE_MAX];
+};
+
+struct TagPresence
+{
+	TagPresenceConfig config;
+	std::vector<PresenceEntry> entries;
+	std::vector<unsigned int> buckets;
+	unsigned int mask;
+	unsigned int free;
+	unsigned int head, tail;
+	unsigned int used;
+	uint64_t holdMs;				// an entry out of all zones is kept this long after its last read for ZONE_DIRECTION
+	unsigned short antennaZones[PRESENCE_ANTENNAS];	// zones each antenna belongs to
+	ZoneEventCallback streamCallback;	// InventoryStartPresence
+	void* streamCtx;
+};
+
+// FNV-1a over the full code
+static uint64_t Presence_Hash(const unsigned char* code, size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ code[i]) * 1099511628211ULL;
+	return hash;
+}
+
+static void Presence_Unlink(TagPresence* p, unsigned int i)
+{
+	PresenceEntry& e = p->entries[i];
+	if (e.prev != PRESENCE_NONE)
+		p->entries[e.prev].next = e.next;
+	else
+		p->head = e.next;
+	if (e.next != PRESENCE_NONE)
+		p->entries[e.next].prev = e.prev;
+	else
+		p->tail = e.prev;
+}
+
+static void Presence_Append(TagPresence* p, unsigned int i)
+{
+	PresenceEntry& e = p->entries[i];
+	e.prev = p->tail;
+	e.next = PRESENCE_NONE;
+	if (p->tail != PRESENCE_NONE)
+		p->entries[p->tail].next = i;
+	else
+		p->head = i;
+	p->tail = i;
+}
+
+static void Presence_Remove(TagPresence* p, unsigned int i)
+{
+	unsigned int* link = &p->buckets[p->entries[i].hash & p->mask];
+	while (*link != i)
+		link = &p->entries[*link].chain;
+	*link = p->entries[i].chain;
+	Presence_Unlink(p, i);
+	p->entries[i].chain = p->free;
+	p->free = i;
+	p->used--;
+}
+
+static unsigned int Presence_Find(const TagPresence* p, uint64_t hash, const unsigned char* code, size_t codeLen)
+{
+	for (unsigned int i = p->buckets[hash & p->mask]; i != PRESENCE_NONE; i = p->entries[i].chain)
+	{
+		const PresenceEntry& e = p->entries[i];
+		if (e.hash == hash && e.codeLen == codeLen && memcmp(e.code, code, codeLen) == 0)
+			return i;
+	}
+	return PRESENCE_NONE;
+}
+
+// Margin of the best antenna of zone that read the tag within exitMs, INT_MIN if none did.
+static int Presence_Margin(const TagPresence* p, const PresenceEntry& e, unsigned int zone, uint64_t now, short* rssi)
+{
+	int best = INT_MIN;
+	unsigned int antennas = p->config.zoneAntennas[zone];
+	for (unsigned int a = 0; a < PRESENCE_ANTENNAS; a++)
+	{
+		if (!(antennas & (1u << a)) || e.antennaMs[a] == 0 || now - e.antennaMs[a] >= p->config.exitMs)
+			continue;
+		int margin = e.rssi[a] - p->config.enterRssi[a];
+		if (margin > best)
+		{
+			best = margin;
+			*rssi = e.rssi[a];
+		}
+	}
+	return best;
+}
+
+static void Presence_Emit(const PresenceEntry& e, int event, unsigned int zone, int antenna, short rssi, uint64_t now,
+	ZoneEventCallback callback, void* userCtx)
+{
+	if (callback == NULL)
+		return;
+	ZoneEvent ev;
+	ev.event = event;
+	ev.zone = zone;
+	ev.fromZone = event == ZONE_DIRECTION ? e.lastZone : zone;
+	ev.direction = event != ZONE_DIRECTION ? 0 : (zone > e.lastZone ? ZONE_DIR_IN : ZONE_DIR_OUT);
+	ev.code = e.code;
+	ev.codeLen = e.codeLen;
+	ev.antenna = (unsigned char)antenna;
+	ev.rssi = rssi;
+	ev.timeMs = now;
+	ev.enteredMs = event == ZONE_EXIT ? e.enteredMs[zone] : 0;
+	callback(&ev, userCtx);
+}
+
+static void Presence_Exit(TagPresence* p, PresenceEntry& e, unsigned int zone, int antenna, short rssi, uint64_t now,
+	ZoneEventCallback callback, void* userCtx)
+{
+	e.inside &= ~(1u << zone);
+	if (zone == e.lastZone)
+		e.lastZoneMs = now;
+	Presence_Emit(e, ZONE_EXIT, zone, antenna, rssi, now, callback, userCtx);
+}
+
+// Zones the entry is in leave without a read behind it, with the last level of their best antenna.
+static void Presence_ExitAll(TagPresence* p, PresenceEntry& e, uint64_t now, ZoneEventCallback callback, void* userCtx)
+{
+	for (unsigned int z = 0; z < p->config.zoneCount; z++)
+	{
+		if (!(e.inside & (1u << z)))
+			continue;
+		short rssi = SHRT_MIN;
+		for (unsigned int a = 0; a < PRESENCE_ANTENNAS; a++)
+		{
+			if ((p->config.zoneAntennas[z] & (1u << a)) && e.antennaMs[a] != 0 && e.rssi[a] > rssi)
+				rssi = e.rssi[a];
+		}
+		Presence_Exit(p, e, z, 0, rssi, now, callback, userCtx);
+	}
+}
+
+static void Presence_ExpireAt(TagPresence* p, uint64_t now, ZoneEventCallback callback, void* userCtx)
+{
+	// the LRU head was read longest ago, stop at the first one read within exitMs
+	unsigned int i = p->head;
+	while (i != PRESENCE_NONE && now - p->entries[i].lastMs >= p->config.exitMs)
+	{
+		PresenceEntry& e = p->entries[i];
+		unsigned int next = e.next;
+		if (e.inside != 0)
+			Presence_ExitAll(p, e, now, callback, userCtx);
+		if (now - e.lastMs >= p->holdMs)
+			Presence_Remove(p, i);
+		i = next;
+	}
+}
+
+// Update the zones of the entry a read on antenna a went into: exits first, then entries, so a
+// move reports where the tag came from.
+static void Presence_Update(TagPresence* p, PresenceEntry& e, unsigned int a, uint64_t now, ZoneEventCallback callback, void* userCtx)
+{
+	unsigned int candidates = e.inside | p->antennaZones[a];
+	int hysteresis = p->config.hysteresis;
+	for (unsigned int z = 0; z < p->config.zoneCount; z++)
+	{
+		if (!(e.inside & (1u << z)))
+			continue;
+		short rssi = e.rssi[a];
+		if (Presence_Margin(p, e, z, now, &rssi) < -hysteresis)
+			Presence_Exit(p, e, z, a + 1, rssi, now, callback, userCtx);
+		else if (z == e.lastZone)
+			e.lastZoneMs = now;
+	}
+	for (unsigned int z = 0; z < p->config.zoneCount; z++)
+	{
+		if (!(candidates & (1u << z)) || (e.inside & (1u << z)))
+			continue;
+		short rssi = e.rssi[a];
+		if (Presence_Margin(p, e, z, now, &rssi) < 0)
+			continue;
+		e.inside |= 1u << z;
+		e.enteredMs[z] = now;
+		Presence_Emit(e, ZONE_ENTER, z, a + 1, rssi, now, callback, userCtx);
+		if (e.lastZone != PRESENCE_NONE && e.lastZone != z && now - e.lastZoneMs <= p->config.directionMs)
+			Presence_Emit(e, ZONE_DIRECTION, z, a + 1, rssi, now, callback, userCtx);
+		e.lastZone = z;
+		e.lastZoneMs = now;
+	}
+}
+
+int TagPresenceConfigFromRssiPara(TagPresenceConfig* config, const RssiPara* para)
+{
+	if (config == NULL || para == NULL)
+		return STAT_CMD_PARAM_ERR;
+	for (unsigned int a = 0; a < PRESENCE_ANTENNAS; a++)
+	{
+		int dbm = para->BasciRssi - para->AntDelta[a];
+		// 0 would select the default, the filter of the reader is off below -174 dBm anyway
+		config->enterRssi[a] = (short)(dbm < -3276 ? -32760 : (dbm >= 0 ? -1 : dbm * 10));
+	}
+	return STAT_OK;
+}
+
+TagPresence* TagPresenceCreate(const TagPresenceConfig* config)
+{
+	if (config == NULL || config->zoneCount == 0 || config->zoneCount > PRESENCE_ZONES
+		|| config->smoothPercent > 100 || config->maxTags >= PRESENCE_NONE / 2)
+		return NULL;
+	for (unsigned int z = 0; z < config->zoneCount; z++)
+	{
+		if (config->zoneAntennas[z] == 0)
+			return NULL;
+	}
+
+	TagPresence* p = new TagPresence();
+	p->config = *config;
+	TagPresenceConfig& c = p->config;
+	for (unsigned int a = 0; a < PRESENCE_ANTENNAS; a++)
+	{
+		if (c.enterRssi[a] == 0)
+			c.enterRssi[a] = PRESENCE_DEFAULT_ENTER;
+	}
+	if (c.hysteresis == 0)
+		c.hysteresis = PRESENCE_DEFAULT_HYSTERESIS;
+	if (c.smoothPercent == 0)
+		c.smoothPercent = PRESENCE_DEFAULT_SMOOTH;
+	if (c.exitMs == 0)
+		c.exitMs = PRESENCE_DEFAULT_EXIT_MS;
+	if (c.directionMs == 0)
+		c.directionMs = PRESENCE_DEFAULT_DIRECTION_MS;
+	if (c.maxTags == 0)
+		c.maxTags = PRESENCE_DEFAULT_TAGS;
+	p->holdMs = c.directionMs > c.exitMs ? c.directionMs : c.exitMs;
+	for (unsigned int z = 0; z < c.zoneCount; z++)
+	{
+		for (unsigned int a = 0; a < PRESENCE_ANTENNAS; a++)
+		{
+			if (c.zoneAntennas[z] & (1u << a))
+				p->antennaZones[a] |= 1u << z;
+		}
+	}
+
+	p->entries.resize(c.maxTags);
+	unsigned int buckets = 16;
+	while (buckets < 2 * c.maxTags)
+		buckets <<= 1;
+	p->buckets.assign(buckets, PRESENCE_NONE);
+	p->mask = buckets - 1;
+	for (unsigned int i = 0; i < c.maxTags; i++)
+		p->entries[i].chain = i + 1 < c.maxTags ? i + 1 : PRESENCE_NONE;
+	p->free = 0;
+	p->head = p->tail = PRESENCE_NONE;
+	p->used = 0;
+	p->streamCallback = NULL;
+	p->streamCtx = NULL;
+	return p;
+}
+
+void TagPresenceDestroy(TagPresence* presence)
+{
+	delete presence;
+}
+
+int TagPresenceFeed(TagPresence* presence, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, ZoneEventCallback callback, void* userCtx)
+{
+	if (presence == NULL || callback == NULL || (tags == NULL && count != 0))
+		return STAT_CMD_PARAM_ERR;
+
+	TagPresence* p = presence;
+	uint64_t now = CFStats_NowUs() / 1000;
+	Presence_ExpireAt(p, now, callback, userCtx);
+
+	for (size_t t = 0; t < count; t++)
+	{
+		const TagInfoCompact& tag = tags[t];
+		unsigned int a = tag.antenna > 0 ? tag.antenna - 1u : 0;
+		if (a >= PRESENCE_ANTENNAS)
+			continue;
+		const unsigned char* code = TagCompactCode(&tag, arena);
+		size_t codeLen = tag.codeLen;
+		if (code == tag.code && codeLen > TAGCOMPACT_CODE_LEN)
+			codeLen = TAGCOMPACT_CODE_LEN;
+		uint64_t hash = Presence_Hash(code, codeLen);
+		if (codeLen > PRESENCE_CODE_MAX)
+			codeLen = PRESENCE_CODE_MAX;
+
+		unsigned int i = Presence_Find(p, hash, code, codeLen);
+		if (i != PRESENCE_NONE)
+			Presence_Unlink(p, i);
+		else
+		{
+			if (p->free == PRESENCE_NONE)
+			{
+				// full: the tag read longest ago makes room and leaves its zones
+				unsigned int victim = p->head;
+				Presence_ExitAll(p, p->entries[victim], now, callback, userCtx);
+				Presence_Remove(p, victim);
+			}
+			i = p->free;
+			PresenceEntry& e = p->entries[i];
+			p->free = e.chain;
+			e.hash = hash;
+			e.inside = 0;
+			e.lastZone = PRESENCE_NONE;
+			e.lastZoneMs = 0;
+			memset(e.antennaMs, 0, sizeof(e.antennaMs));
+			e.codeLen = (unsigned char)codeLen;
+			memcpy(e.code, code, codeLen);
+			unsigned int* bucket = &p->buckets[hash & p->mask];
+			e.chain = *bucket;
+			*bucket = i;
+			p->used++;
+		}
+		Presence_Append(p, i);
+
+		PresenceEntry& e = p->entries[i];
+		// a read after a gap starts the average again instead of dragging the old level along
+		if (e.antennaMs[a] == 0 || now - e.antennaMs[a] >= p->config.exitMs)
+			e.rssi[a] = tag.rssi;
+		else
+			e.rssi[a] = (short)(e.rssi[a] + ((int)tag.rssi - e.rssi[a]) * (int)p->config.smoothPercent / 100);
+		e.antennaMs[a] = now;
+		e.lastMs = now;
+		Presence_Update(p, e, a, now, callback, userCtx);
+	}
+	return STAT_OK;
+}
+
+int TagPresenceExpire(TagPresence* presence, ZoneEventCallback callback, void* userCtx)
+{
+	if (presence == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+	Presence_ExpireAt(presence, CFStats_NowUs() / 1000, callback, userCtx);
+	return STAT_OK;
+}
+
+int TagPresenceFlush(TagPresence* presence, ZoneEventCallback callback, void* userCtx)
+{
+	if (presence == NULL)
+		return STAT_CMD_PARAM_ERR;
+	uint64_t now = CFStats_NowUs() / 1000;
+	while (presence->head != PRESENCE_NONE)
+	{
+		unsigned int i = presence->head;
+		Presence_ExitAll(presence, presence->entries[i], now, callback, userCtx);
+		Presence_Remove(presence, i);
+	}
+	return STAT_OK;
+}
+
+unsigned int TagPresenceZones(const TagPresence* presence, const unsigned char* code, size_t codeLen)
+{
+	if (presence == NULL || (code == NULL && codeLen != 0))
+		return 0;
+	uint64_t hash = Presence_Hash(code, codeLen);
+	unsigned int i = Presence_Find(presence, hash, code, codeLen > PRESENCE_CODE_MAX ? PRESENCE_CODE_MAX : codeLen);
+	return i != PRESENCE_NONE ? presence->entries[i].inside : 0;
+}
+
+size_t TagPresenceCount(const TagPresence* presence)
+{
+	return presence ? presence->used : 0;
+}
+
+static void Presence_StreamSink(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	TagPresence* p = (TagPresence*)userCtx;
+	if (status != STAT_OK)
+	{
+		// inventory over: no tag will be seen leaving on this stream
+		TagPresenceFlush(p, p->streamCallback, p->streamCtx);
+		return;
+	}
+	TagPresenceFeed(p, tags, count, arena, p->streamCallback, p->streamCtx);
+}
+
+static void Presence_StreamIdle(int64_t hComm, void* userCtx)
+{
+	TagPresence* p = (TagPresence*)userCtx;
+	Presence_ExpireAt(p, CFStats_NowUs() / 1000, p->streamCallback, p->streamCtx);
+}
+
+int InventoryStartPresence(int64_t hComm, TagPresence* presence, ZoneEventCallback callback, void* userCtx, unsigned int flags)
+{
+	if (presence == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+	presence->streamCallback = callback;
+	presence->streamCtx = userCtx;
+	return CFStream_Start(hComm, Presence_StreamSink, Presence_StreamIdle, presence, flags);
+}
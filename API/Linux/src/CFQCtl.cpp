@@ -0,0 +1,342 @@
+#include "CFHandle.h"
+#include <math.h>
+
+#define QCTL_DEDUP_ENTRIES					4096	// different tags counted per round
+#define QCTL_POPULATION_WEIGHT				0.5f	// weight of the last round in the population estimate
+#define QCTL_COLLISION_DROP					0.75f	// read rate below this share of the previous round counts as collisions
+
+struct CFQCtl
+{
+	QCtlConfig config;
+	pthread_mutex_t lock;			// state and running
+	bool running;					// the worker runs on hComm
+	int64_t hComm;
+	bool started;					// hComm is set
+	TagStreamCallback callback;
+	void* userCtx;
+	QCtlTelemetryCallback telemetry;
+	void* telemetryCtx;
+	TagDedup* seen;					// unique tags of the running round
+	unsigned int roundUnique;
+	QueryParam query;				// QueryCfgGet at start
+	unsigned int quietRounds;		// rounds in a row without new tags
+	bool primed;					// population estimate has a first round
+	QCtlEvent state;
+};
+
+static void QCtl_Defaults(QCtlConfig* c)
+{
+	if (c->qMax == 0 || c->qMax > 15)
+		c->qMax = 15;
+	if (c->stepPercent == 0 || c->stepPercent > 100)
+		c->stepPercent = 30;
+	if (c->sessionHigh == 0 || c->sessionHigh > 3)
+		c->sessionHigh = 1;
+	if (c->targetFlipWindows == 0)
+		c->targetFlipWindows = 3;
+	if (c->windowMs == 0)
+		c->windowMs = 500;
+	if (c->sessionHighTags == 0)
+		c->sessionHighTags = 32;
+	if (c->sessionLowTags == 0)
+		c->sessionLowTags = 8;
+}
+
+static void QCtl_OnSighting(const TagSighting* sighting, void* userCtx)
+{
+	if (sighting->event == DEDUP_ARRIVE)
+		((CFQCtl*)userCtx)->roundUnique++;
+}
+
+// One inventory round of windowMs. Returns STAT_OK or the link error, the round in ev.
+static int QCtl_Round(CFQCtl* ctl, CFHandleCtx* ctx, QCtlEvent* ev)
+{
+	CFSeq_Enter(ctx);
+	int status = InventoryContinueEx(ctl->hComm, 0, 0);
+	CFSeq_Leave(ctx);
+	if (status != STAT_OK)
+		return status;
+
+	TagInfoCompact tags[STREAM_BATCH_MAX];
+	unsigned char overflow[STREAM_BATCH_MAX * 32];
+	TagCodeArena arena = { overflow, sizeof(overflow), 0 };
+	unsigned int windowMs = ctl->config.windowMs;
+	uint64_t start = CFStats_NowUs() / 1000;
+	unsigned int reads = 0;
+	ctl->roundUnique = 0;
+	int linkStatus = STAT_OK;
+	while (!ctx->stream.stop)
+	{
+		uint64_t elapsed = CFStats_NowUs() / 1000 - start;
+		if (elapsed >= windowMs)
+			break;
+		unsigned short timeout = (unsigned short)(windowMs - elapsed < STREAM_POLL_TIMEOUT ? windowMs - elapsed : STREAM_POLL_TIMEOUT);
+		size_t count = 0;
+		arena.used = 0;
+		status = GetTagUiiBatchCompact(ctl->hComm, tags, STREAM_BATCH_MAX, &count, &arena, timeout);
+		if (status == STAT_OK)
+		{
+			ctl->callback(ctl->hComm, STAT_OK, tags, count, &arena, ctl->userCtx);
+			reads += (unsigned int)count;
+			TagDedupFeed(ctl->seen, tags, count, &arena, QCtl_OnSighting, ctl);
+			continue;
+		}
+		if (status == (int)STAT_CMD_COMM_TIMEOUT)
+			continue;
+		if (status == (int)STAT_CMD_INVENTORY_STOP)
+			break;
+		linkStatus = status;
+		break;
+	}
+	if (linkStatus == STAT_OK)
+	{
+		CFSeq_Enter(ctx);
+		InventoryStop(ctl->hComm, COMMON_TIMEOUT);
+		CFSeq_Leave(ctx);
+	}
+	// every round counts its own tags
+	TagDedupFlush(ctl->seen, NULL, NULL);
+
+	ev->timeMs = CFStats_NowUs() / 1000;
+	ev->windowMs = (unsigned int)(ev->timeMs - start);
+	ev->reads = reads;
+	ev->uniqueTags = ctl->roundUnique;
+	ev->readRate = ev->windowMs ? reads * 1000.0f / ev->windowMs : 0;
+	return linkStatus;
+}
+
+// Host-side Q algorithm: the reader reports no slot statistics, so Q is steered from what the
+// rounds bring in. Q moves toward log2 of the population by at most C per round, up on a
+// collision signature and down on empty rounds. Fills the new settings and reasons into ev.
+static void QCtl_Decide(CFQCtl* ctl, const QCtlEvent* prev, QCtlEvent* ev)
+{
+	const QCtlConfig& c = ctl->config;
+	float step = c.stepPercent / 100.0f;
+	ev->prevQ = prev->q;
+	ev->prevSession = prev->session;
+	ev->prevTarget = prev->target;
+	ev->q = prev->q;
+	ev->session = prev->session;
+	ev->target = prev->target;
+	ev->qfp = prev->qfp;
+	ev->reasons = 0;
+
+	if (!ctl->primed)
+		ev->population = (float)ev->uniqueTags;
+	else
+		ev->population = QCTL_POPULATION_WEIGHT * ev->uniqueTags + (1 - QCTL_POPULATION_WEIGHT) * prev->population;
+	ctl->primed = true;
+
+	unsigned char reasons = 0;
+	if (ev->reads == 0)
+	{
+		ev->qfp -= step;
+		reasons |= QCTL_REASON_EMPTY;
+	}
+	else if (prev->reads != 0 && ev->uniqueTags >= prev->uniqueTags && ev->readRate < prev->readRate * QCTL_COLLISION_DROP
+		&& ev->population > (float)(1 << ev->q))
+	{
+		ev->qfp += step;
+		reasons |= QCTL_REASON_COLLISION;
+	}
+	else
+	{
+		float goal = ev->population > 1 ? log2f(ev->population) : 0;
+		float move = goal - ev->qfp;
+		if (move > step)
+			move = step;
+		if (move < -step)
+			move = -step;
+		ev->qfp += move;
+		reasons |= QCTL_REASON_POPULATION;
+	}
+	if (ev->qfp < c.qMin)
+		ev->qfp = c.qMin;
+	if (ev->qfp > c.qMax)
+		ev->qfp = c.qMax;
+	unsigned char q = (unsigned char)lrintf(ev->qfp);
+	if (q != ev->q)
+	{
+		ev->q = q;
+		ev->reasons |= reasons;
+	}
+
+	// large populations: a session with persistence lets the weaker tags answer once the strong ones went quiet
+	if (!(c.flags & QCTL_NO_SESSION))
+	{
+		if (ev->session == 0 && ev->population >= c.sessionHighTags)
+			ev->session = c.sessionHigh;
+		else if (ev->session != 0 && ev->population < c.sessionLowTags)
+			ev->session = 0;
+		if (ev->session != prev->session)
+			ev->reasons |= QCTL_REASON_SESSION;
+	}
+
+	// with persistence every tag answers once per target: flip it once the inventoried side is exhausted
+	ctl->quietRounds = ev->uniqueTags == 0 ? ctl->quietRounds + 1 : 0;
+	if (!(c.flags & QCTL_NO_TARGET) && ev->session != 0 && ctl->quietRounds >= c.targetFlipWindows)
+	{
+		ev->target ^= 1;
+		ev->reasons |= QCTL_REASON_TARGET;
+		ctl->quietRounds = 0;
+	}
+}
+
+// Sends the new settings in one turn on the link, between two rounds.
+static int QCtl_Apply(CFQCtl* ctl, CFHandleCtx* ctx, const QCtlEvent* ev)
+{
+	int status = STAT_OK;
+	CFSeq_Enter(ctx);
+	if (ev->q != ev->prevQ)
+		status = SetCoilPRM(ctl->hComm, ev->q, 0);
+	if (status == STAT_OK && (ev->session != ev->prevSession || ev->target != ev->prevTarget))
+	{
+		QueryParam query = ctl->query;
+		query.session = ev->session;
+		query.target = ev->target;
+		status = QueryCfgSet(ctl->hComm, ctl->config.proto, &query);
+	}
+	CFSeq_Leave(ctx);
+	return status;
+}
+
+// Worker of the reader thread of hComm, so CFHandleLock pauses the round that runs.
+static int QCtl_Run(CFHandleCtx* ctx, void* workerCtx)
+{
+	CFQCtl* ctl = (CFQCtl*)workerCtx;
+	int status = STAT_OK;
+
+	while (!ctx->stream.stop && status == STAT_OK)
+	{
+		pthread_mutex_lock(&ctl->lock);
+		QCtlEvent prev = ctl->state;
+		pthread_mutex_unlock(&ctl->lock);
+
+		QCtlEvent ev = prev;
+		status = QCtl_Round(ctl, ctx, &ev);
+		if (status != STAT_OK)
+			break;
+		QCtl_Decide(ctl, &prev, &ev);
+		if (ev.reasons != 0)
+			status = QCtl_Apply(ctl, ctx, &ev);
+		if (status != STAT_OK)
+		{
+			// the reader kept what it had
+			ev.q = ev.prevQ;
+			ev.session = ev.prevSession;
+			ev.target = ev.prevTarget;
+		}
+		pthread_mutex_lock(&ctl->lock);
+		ctl->state = ev;
+		pthread_mutex_unlock(&ctl->lock);
+		if (status == STAT_OK && ev.reasons != 0 && ctl->telemetry != NULL)
+			ctl->telemetry(ctl->hComm, &ev, ctl->telemetryCtx);
+	}
+
+	if (status != STAT_OK)
+		ctl->callback(ctl->hComm, status, NULL, 0, NULL, ctl->userCtx);
+
+	pthread_mutex_lock(&ctl->lock);
+	ctl->running = false;
+	pthread_mutex_unlock(&ctl->lock);
+	return status;
+}
+
+CFQCtl* CFQCtlCreate(const QCtlConfig* config)
+{
+	CFQCtl* ctl = new CFQCtl();
+	if (config != NULL)
+		ctl->config = *config;
+	QCtl_Defaults(&ctl->config);
+	if (ctl->config.qMin > ctl->config.qMax || ctl->config.sessionLowTags > ctl->config.sessionHighTags)
+	{
+		delete ctl;
+		return NULL;
+	}
+	TagDedupConfig seen = { 0xFFFFFFFFu, QCTL_DEDUP_ENTRIES, DEDUP_ANY_ANTENNA };
+	ctl->seen = TagDedupCreate(&seen);
+	pthread_mutex_init(&ctl->lock, NULL);
+	ctl->running = false;
+	ctl->started = false;
+	memset(&ctl->state, 0, sizeof(ctl->state));
+	return ctl;
+}
+
+void CFQCtlDestroy(CFQCtl* ctl)
+{
+	if (ctl == NULL)
+		return;
+	// also waits for a worker stopped from one of its callbacks that is still finishing its round
+	CFQCtlStop(ctl);
+	TagDedupDestroy(ctl->seen);
+	pthread_mutex_destroy(&ctl->lock);
+	delete ctl;
+}
+
+int CFQCtlStart(CFQCtl* ctl, int64_t hComm, TagStreamCallback callback, void* userCtx, QCtlTelemetryCallback telemetry, void* telemetryCtx)
+{
+	if (ctl == NULL || callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&ctl->lock);
+	if (ctl->running)
+	{
+		pthread_mutex_unlock(&ctl->lock);
+		return STAT_CMD_PARAM_ERR;
+	}
+	// start from what the reader is set to
+	unsigned char q = 0, reserved = 0;
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFSeq_Enter(ctx);
+	int status = GetCoilPRM(hComm, &q, &reserved);
+	if (status == STAT_OK)
+		status = QueryCfgGet(hComm, ctl->config.proto, &ctl->query);
+	CFSeq_Leave(ctx);
+	if (status != STAT_OK)
+	{
+		pthread_mutex_unlock(&ctl->lock);
+		return status;
+	}
+	memset(&ctl->state, 0, sizeof(ctl->state));
+	ctl->state.q = ctl->state.prevQ = q;
+	ctl->state.qfp = q;
+	ctl->state.session = ctl->state.prevSession = ctl->query.session;
+	ctl->state.target = ctl->state.prevTarget = ctl->query.target;
+	ctl->quietRounds = 0;
+	ctl->primed = false;
+	ctl->hComm = hComm;
+	ctl->started = true;
+	ctl->callback = callback;
+	ctl->userCtx = userCtx;
+	ctl->telemetry = telemetry;
+	ctl->telemetryCtx = telemetryCtx;
+	// the controller owns the inventory of hComm like an InventoryStartStreaming thread
+	status = CFStream_StartWorker(hComm, QCtl_Run, ctl);
+	ctl->running = status == STAT_OK;
+	pthread_mutex_unlock(&ctl->lock);
+	return status;
+}
+
+int CFQCtlStop(CFQCtl* ctl)
+{
+	if (ctl == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&ctl->lock);
+	int64_t hComm = ctl->hComm;
+	bool started = ctl->started;
+	pthread_mutex_unlock(&ctl->lock);
+	if (started)
+		CFStream_StopOwner(hComm, ctl);
+	return STAT_OK;
+}
+
+int CFQCtlGetState(CFQCtl* ctl, QCtlEvent* state)
+{
+	if (ctl == NULL || state == NULL)
+		return STAT_CMD_PARAM_ERR;
+	pthread_mutex_lock(&ctl->lock);
+	*state = ctl->state;
+	pthread_mutex_unlock(&ctl->lock);
+	return STAT_OK;
+}
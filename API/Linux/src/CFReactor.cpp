@@ -0,0 +1,420 @@
+#include "CFHandle.h"
+#include "CFRing.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <map>
+
+#define REACTOR_WAKE_KEY					UINT64_MAX	// epoll key of the eventfd, other keys are hComm
+#define REACTOR_EVENTS_MAX					16
+
+// One connection of a reactor. Serial and TCP handles are watched by epoll directly; HID handles
+// have no descriptor and keep a streaming reader thread that feeds the reactor ring instead.
+struct CFReactorEntry
+{
+	int64_t hComm;
+	unsigned int flags;
+	bool hid;
+	bool busy;						// a Run thread is draining it, guarded by the reactor lock
+	bool removed;					// removed while busy from the callback of its own Run thread
+	pthread_t owner;
+	unsigned short stopTimeout;
+};
+
+struct CFReactor
+{
+	int epfd;
+	int wakefd;
+	TagStreamCallback callback;
+	void* userCtx;
+	std::atomic<bool> stop;
+	pthread_mutex_t lock;
+	pthread_cond_t idle;
+	std::map<int64_t, CFReactorEntry*> entries;
+	std::vector<std::pair<int64_t, int> > ended;	// end status of HID streams, guarded by lock
+	Mpsc_Ring<TagInfoSourced>* ring;				// labels of HID streams
+	Ring_Counters counters;
+};
+
+static int Reactor_Arm(CFReactor* reactor, int op, int fd, uint64_t key)
+{
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.u64 = key;
+	return epoll_ctl(reactor->epfd, op, fd, &ev);
+}
+
+static void Reactor_Wake(CFReactor* reactor)
+{
+	uint64_t one = 1;
+	ssize_t ret = write(reactor->wakefd, &one, sizeof(one));
+	(void)ret;
+}
+
+static void Reactor_StopEntry(CFReactorEntry* entry, unsigned short timeout)
+{
+	if (entry->hid)
+		InventoryStopStreaming(entry->hComm, timeout);
+	else if (!(entry->flags & STREAM_NO_INVENTORY))
+		InventoryStop(entry->hComm, timeout);
+}
+
+// Reader thread callback of HID connections: only hands the labels over to the Run threads.
+static void Reactor_HidSink(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	CFReactor* reactor = (CFReactor*)userCtx;
+	if (status != STAT_OK)
+	{
+		pthread_mutex_lock(&reactor->lock);
+		reactor->ended.push_back(std::make_pair(hComm, status));
+		pthread_mutex_unlock(&reactor->lock);
+		Reactor_Wake(reactor);
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		TagInfoSourced rec;
+		rec.hComm = hComm;
+		rec.tag = tags[i];
+		bool truncated = Ring_Truncate(&rec.tag);
+		if (!reactor->ring->Push(rec))
+		{
+			reactor->counters.overflow.fetch_add(count - i, std::memory_order_relaxed);
+			break;
+		}
+		reactor->counters.pushed.fetch_add(1, std::memory_order_relaxed);
+		if (truncated)
+			reactor->counters.truncated.fetch_add(1, std::memory_order_relaxed);
+	}
+	Reactor_Wake(reactor);
+}
+
+// Drains the labels an fd became readable for; returns false once the connection has ended.
+static bool Reactor_DrainFd(CFReactor* reactor, CFReactorEntry* entry)
+{
+	size_t capacity = (entry->flags & STREAM_PER_TAG) ? 1 : STREAM_BATCH_MAX;
+	TagInfoCompact tags[STREAM_BATCH_MAX];
+	unsigned char overflow[STREAM_BATCH_MAX * 32];
+	TagCodeArena arena = { overflow, sizeof(overflow), 0 };
+
+	do
+	{
+		size_t count = 0;
+		arena.used = 0;
+		int status = GetTagUiiBatchCompact(entry->hComm, tags, capacity, &count, &arena, BATCH_DRAIN_TIMEOUT);
+		if (status == (int)STAT_CMD_COMM_TIMEOUT)
+			break;
+		if (status != STAT_OK)
+		{
+			reactor->callback(entry->hComm, status, NULL, 0, NULL, reactor->userCtx);
+			return false;
+		}
+		reactor->callback(entry->hComm, STAT_OK, tags, count, &arena, reactor->userCtx);
+	}
+	while (CFHandle_Pending(entry->hComm) > 0 && !entry->removed);
+	return true;
+}
+
+// Hands the HID labels queued by the reader threads to the callback, one call per run of a connection.
+static void Reactor_DrainRing(CFReactor* reactor)
+{
+	uint64_t value;
+	ssize_t ret = read(reactor->wakefd, &value, sizeof(value));
+	(void)ret;
+
+	// take the end status first: the labels a stream pushed before it are then visible in the ring
+	pthread_mutex_lock(&reactor->lock);
+	std::vector<std::pair<int64_t, int> > ended;
+	ended.swap(reactor->ended);
+	for (size_t i = 0; i < ended.size(); i++)
+	{
+		// the reader thread of an ended HID stream has detached itself
+		std::map<int64_t, CFReactorEntry*>::iterator it = reactor->entries.find(ended[i].first);
+		if (it != reactor->entries.end())
+		{
+			delete it->second;
+			reactor->entries.erase(it);
+		}
+	}
+	pthread_mutex_unlock(&reactor->lock);
+
+	TagInfoSourced recs[STREAM_BATCH_MAX];
+	TagInfoCompact tags[STREAM_BATCH_MAX];
+	size_t count;
+	while ((count = reactor->ring->Pop(recs, STREAM_BATCH_MAX)) > 0)
+	{
+		reactor->counters.popped.fetch_add(count, std::memory_order_relaxed);
+		size_t begin = 0;
+		while (begin < count)
+		{
+			size_t end = begin;
+			while (end < count && recs[end].hComm == recs[begin].hComm)
+			{
+				tags[end - begin] = recs[end].tag;
+				end++;
+			}
+			reactor->callback(recs[begin].hComm, STAT_OK, tags, end - begin, NULL, reactor->userCtx);
+			begin = end;
+		}
+	}
+	for (size_t i = 0; i < ended.size(); i++)
+		reactor->callback(ended[i].first, ended[i].second, NULL, 0, NULL, reactor->userCtx);
+}
+
+static void Reactor_Dispatch(CFReactor* reactor, uint64_t key)
+{
+	pthread_mutex_lock(&reactor->lock);
+	std::map<int64_t, CFReactorEntry*>::iterator it = reactor->entries.find((int64_t)key);
+	if (it == reactor->entries.end())
+	{
+		// removed after epoll_wait returned its event
+		pthread_mutex_unlock(&reactor->lock);
+		return;
+	}
+	CFReactorEntry* entry = it->second;
+	entry->busy = true;
+	entry->owner = pthread_self();
+	pthread_mutex_unlock(&reactor->lock);
+
+	bool alive = Reactor_DrainFd(reactor, entry);
+
+	pthread_mutex_lock(&reactor->lock);
+	entry->busy = false;
+	bool removed = entry->removed;	// removed from its own callback, the entry is ours to free
+	it = reactor->entries.find(entry->hComm);
+	bool listed = it != reactor->entries.end() && it->second == entry;
+	if (listed && !alive)
+	{
+		epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, CFHandle_Fd(entry->hComm), NULL);
+		reactor->entries.erase(it);
+	}
+	else if (listed)
+		Reactor_Arm(reactor, EPOLL_CTL_MOD, CFHandle_Fd(entry->hComm), key);
+	// otherwise CFReactorRemove is waiting for the entry and frees it
+	pthread_cond_broadcast(&reactor->idle);
+	pthread_mutex_unlock(&reactor->lock);
+
+	if (removed)
+	{
+		if (alive)
+			Reactor_StopEntry(entry, entry->stopTimeout);
+		delete entry;
+	}
+	else if (listed && !alive)
+		delete entry;
+}
+
+CFReactor* CFReactorCreate(TagStreamCallback callback, void* userCtx)
+{
+	if (callback == NULL)
+		return NULL;
+
+	CFReactor* reactor = new CFReactor();
+	reactor->callback = callback;
+	reactor->userCtx = userCtx;
+	reactor->stop = false;
+	reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+	reactor->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	reactor->ring = Mpsc_Ring<TagInfoSourced>::Create(RING_DEFAULT_SIZE);
+	if (reactor->epfd < 0 || reactor->wakefd < 0 || reactor->ring == NULL
+		|| Reactor_Arm(reactor, EPOLL_CTL_ADD, reactor->wakefd, REACTOR_WAKE_KEY) != 0)
+	{
+		if (reactor->epfd >= 0)
+			close(reactor->epfd);
+		if (reactor->wakefd >= 0)
+			close(reactor->wakefd);
+		Mpsc_Ring<TagInfoSourced>::Destroy(reactor->ring);
+		delete reactor;
+		return NULL;
+	}
+	pthread_mutex_init(&reactor->lock, NULL);
+	pthread_cond_init(&reactor->idle, NULL);
+	return reactor;
+}
+
+void CFReactorDestroy(CFReactor* reactor)
+{
+	if (reactor == NULL)
+		return;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&reactor->lock);
+		if (reactor->entries.empty())
+		{
+			pthread_mutex_unlock(&reactor->lock);
+			break;
+		}
+		int64_t hComm = reactor->entries.begin()->first;
+		pthread_mutex_unlock(&reactor->lock);
+		CFReactorRemove(reactor, hComm, COMMON_TIMEOUT);
+	}
+	close(reactor->epfd);
+	close(reactor->wakefd);
+	Mpsc_Ring<TagInfoSourced>::Destroy(reactor->ring);
+	pthread_mutex_destroy(&reactor->lock);
+	pthread_cond_destroy(&reactor->idle);
+	delete reactor;
+}
+
+int CFReactorAdd(CFReactor* reactor, int64_t hComm, unsigned int flags)
+{
+	if (reactor == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&reactor->lock);
+	bool known = reactor->entries.count(hComm) != 0;
+	pthread_mutex_unlock(&reactor->lock);
+	if (known)
+		return STAT_CMD_PARAM_ERR;
+
+	CFReactorEntry* entry = new CFReactorEntry();
+	entry->hComm = hComm;
+	entry->flags = flags;
+	entry->hid = CFHandle_Fd(hComm) < 0;
+	entry->busy = false;
+	entry->removed = false;
+	entry->stopTimeout = COMMON_TIMEOUT;
+
+	if (entry->hid)
+	{
+		pthread_mutex_lock(&reactor->lock);
+		reactor->entries[hComm] = entry;
+		pthread_mutex_unlock(&reactor->lock);
+		int status = InventoryStartStreaming(hComm, Reactor_HidSink, reactor, flags);
+		if (status != STAT_OK)
+		{
+			pthread_mutex_lock(&reactor->lock);
+			reactor->entries.erase(hComm);
+			pthread_mutex_unlock(&reactor->lock);
+			delete entry;
+		}
+		return status;
+	}
+
+	// the reactor threads take over the receive path of an InventoryStartStreaming thread otherwise
+	CFStreamCtx* st = &CFHandle_Get(hComm)->stream;
+	pthread_mutex_lock(&st->lock);
+	bool streaming = st->active;
+	pthread_mutex_unlock(&st->lock);
+	if (streaming)
+	{
+		delete entry;
+		return STAT_CMD_PARAM_ERR;
+	}
+	if (!(flags & STREAM_NO_INVENTORY))
+	{
+		int status = InventoryContinueEx(hComm, 0, 0);
+		if (status != STAT_OK)
+		{
+			delete entry;
+			return status;
+		}
+	}
+	pthread_mutex_lock(&reactor->lock);
+	reactor->entries[hComm] = entry;
+	int ret = Reactor_Arm(reactor, EPOLL_CTL_ADD, CFHandle_Fd(hComm), (uint64_t)hComm);
+	if (ret != 0)
+		reactor->entries.erase(hComm);
+	pthread_mutex_unlock(&reactor->lock);
+	if (ret != 0)
+	{
+		if (!(flags & STREAM_NO_INVENTORY))
+			InventoryStop(hComm, COMMON_TIMEOUT);
+		delete entry;
+		return STAT_DLL_INNER_FAILED;
+	}
+	return STAT_OK;
+}
+
+int CFReactorRemove(CFReactor* reactor, int64_t hComm, unsigned short timeout)
+{
+	if (reactor == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	pthread_mutex_lock(&reactor->lock);
+	std::map<int64_t, CFReactorEntry*>::iterator it = reactor->entries.find(hComm);
+	if (it == reactor->entries.end())
+	{
+		pthread_mutex_unlock(&reactor->lock);
+		return STAT_CMD_PARAM_ERR;
+	}
+	CFReactorEntry* entry = it->second;
+	reactor->entries.erase(it);
+	if (!entry->hid)
+		epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, CFHandle_Fd(hComm), NULL);
+	if (entry->busy && pthread_equal(entry->owner, pthread_self()))
+	{
+		// called from the callback: Reactor_Dispatch stops the reader once the drain returns
+		entry->removed = true;
+		entry->stopTimeout = timeout;
+		pthread_mutex_unlock(&reactor->lock);
+		return STAT_OK;
+	}
+	while (entry->busy)
+		pthread_cond_wait(&reactor->idle, &reactor->lock);
+	pthread_mutex_unlock(&reactor->lock);
+
+	Reactor_StopEntry(entry, timeout);
+	delete entry;
+	return STAT_OK;
+}
+
+int CFReactorPoll(CFReactor* reactor, int timeout)
+{
+	if (reactor == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	struct epoll_event evs[REACTOR_EVENTS_MAX];
+	int n = epoll_wait(reactor->epfd, evs, REACTOR_EVENTS_MAX, timeout);
+	if (n < 0)
+		return errno == EINTR ? STAT_CMD_COMM_TIMEOUT : STAT_DLL_INNER_FAILED;
+	if (n == 0)
+		return STAT_CMD_COMM_TIMEOUT;
+
+	for (int i = 0; i < n; i++)
+	{
+		uint64_t key = evs[i].data.u64;
+		if (key != REACTOR_WAKE_KEY)
+		{
+			Reactor_Dispatch(reactor, key);
+			continue;
+		}
+		// one-shot: one Run thread at a time is the consumer of the HID ring; after
+		// CFReactorStop the eventfd stays readable and wakes every other Run thread in turn
+		if (!reactor->stop)
+			Reactor_DrainRing(reactor);
+		Reactor_Arm(reactor, EPOLL_CTL_MOD, reactor->wakefd, REACTOR_WAKE_KEY);
+	}
+	return STAT_OK;
+}
+
+int CFReactorRun(CFReactor* reactor)
+{
+	if (reactor == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	while (!reactor->stop)
+	{
+		int status = CFReactorPoll(reactor, -1);
+		if (status != STAT_OK && status != (int)STAT_CMD_COMM_TIMEOUT)
+			return status;
+	}
+	return STAT_OK;
+}
+
+int CFReactorStop(CFReactor* reactor)
+{
+	if (reactor == NULL)
+		return STAT_CMD_PARAM_ERR;
+	reactor->stop = true;
+	Reactor_Wake(reactor);
+	return STAT_OK;
+}
+
+int CFReactorGetStats(CFReactor* reactor, TagRingStats* stats)
+{
+	if (reactor == NULL || stats == NULL)
+		return STAT_CMD_PARAM_ERR;
+	Ring_FillStats(reactor->counters, reactor->ring->Capacity(), reactor->ring->Size(), stats);
+	return STAT_OK;
+}
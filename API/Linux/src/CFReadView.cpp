@@ -0,0 +1,155 @@
+#include "CFFrame.h"
+
+// Receive slots lent out by GetReadTagRespView, one frame each.
+struct CFViewPool
+{
+	unsigned char frames[READVIEW_POOL_SIZE][FRAME_MAX_LEN];
+	std::atomic<bool> used[READVIEW_POOL_SIZE];
+};
+
+void CFView_Free(CFViewPool* pool)
+{
+	delete pool;
+}
+
+CFViewPool* CFView_Reserve(CFHandleCtx* ctx)
+{
+	CFViewPool* pool = ctx->views.load(std::memory_order_acquire);
+	if (pool != NULL)
+		return pool;
+	// first use from several threads: one allocates under the handle lock, the others see its pool
+	pthread_mutex_lock(&ctx->stream.lock);
+	pool = ctx->views.load(std::memory_order_relaxed);
+	if (pool == NULL)
+	{
+		pool = new CFViewPool();
+		ctx->views.store(pool, std::memory_order_release);
+	}
+	pthread_mutex_unlock(&ctx->stream.lock);
+	return pool;
+}
+
+static int View_Acquire(CFViewPool* pool)
+{
+	for (int i = 0; i < READVIEW_POOL_SIZE; i++)
+	{
+		bool expected = false;
+		if (pool->used[i].compare_exchange_strong(expected, true, std::memory_order_acquire))
+			return i;
+	}
+	return -1;
+}
+
+// HID connections have no descriptor to read from: let libCFApi decode the response and lay it
+// out as the frame it came in, so the view looks the same on every link.
+static int View_ReadHid(int64_t hComm, unsigned char* frame, size_t* frameLen, unsigned short timeout)
+{
+	TagResp resp;
+	unsigned char wordCount = 0;
+	unsigned char data[255];
+	int status = GetReadTagResp(hComm, &resp, &wordCount, data, timeout);
+	if (status != STAT_OK)
+		return status;
+	if (resp.codeLen > 255 - 9 - 2 * wordCount)
+		return STAT_CMD_RESP_FORMAT_ERR;
+
+	unsigned char* p = frame + FRAME_HEAD_LEN;
+	*p++ = 0x00;
+	*p++ = resp.tagStatus;
+	*p++ = resp.antenna;
+	*p++ = resp.crc[0];
+	*p++ = resp.crc[1];
+	*p++ = resp.pc[0];
+	*p++ = resp.pc[1];
+	*p++ = resp.codeLen;
+	memcpy(p, resp.code, resp.codeLen);
+	p += resp.codeLen;
+	*p++ = wordCount;
+	memcpy(p, data, 2 * wordCount);
+	p += 2 * wordCount;
+	*frameLen = CFFrame_Build(frame, FRAME_CMD_READ_TAG, p - frame - FRAME_HEAD_LEN);
+	return STAT_OK;
+}
+
+// Payload of a read response: status tagStatus antenna crc[2] pc[2] codeLen code[codeLen] wordCount data[2 * wordCount]
+static int View_Parse(const unsigned char* frame, size_t frameLen, TagReadView* view)
+{
+	size_t len = frame[4];
+	if (len == 1)
+		return frame[5] == 0x00 ? STAT_CMD_RESP_FORMAT_ERR : CFFrame_Status(frame[5]);
+	if (frame[5] != 0x00 || len < 9)
+		return STAT_CMD_RESP_FORMAT_ERR;
+
+	unsigned char codeLen = frame[12];
+	if (len < 9 + (size_t)codeLen)
+		return STAT_CMD_RESP_FORMAT_ERR;
+	unsigned char wordCount = frame[13 + codeLen];
+	if (len != 9 + (size_t)codeLen + 2 * wordCount)
+		return STAT_CMD_RESP_FORMAT_ERR;
+
+	view->frame = frame;
+	view->frameLen = (unsigned short)frameLen;
+	view->tagStatus = frame[6];
+	view->antenna = frame[7];
+	view->crcOff = 8;
+	view->pcOff = 10;
+	view->codeLen = codeLen;
+	view->codeOff = 13;
+	view->dataOff = 14 + codeLen;
+	view->dataLen = 2 * wordCount;
+	return STAT_OK;
+}
+
+int GetReadTagRespView(int64_t hComm, TagReadView* view, unsigned short timeout)
+{
+	if (view == NULL)
+		return STAT_CMD_PARAM_ERR;
+	memset(view, 0, sizeof(*view));
+	view->slot = -1;
+
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFViewPool* pool = CFView_Reserve(ctx);
+	int slot = View_Acquire(pool);
+	if (slot < 0)
+		return STAT_CMD_BUF_OVERFLOW;
+	unsigned char* frame = pool->frames[slot];
+
+	size_t frameLen = 0;
+	int status;
+	CFSeq_Enter(ctx);
+	int fd = CFHandle_Fd(hComm);
+	if (fd < 0)
+		status = View_ReadHid(hComm, frame, &frameLen, timeout);
+	else
+	{
+		struct timespec deadline;
+		CFFrame_Deadline(&deadline, timeout);
+		do
+			status = CFFrame_Read(fd, frame, &frameLen, &deadline, &ctx->stats);
+		// labels of a running inventory may still be queued in front of the response
+		while (status == STAT_OK && ((frame[2] << 8) | frame[3]) != FRAME_CMD_READ_TAG);
+	}
+	CFSeq_Leave(ctx);
+	if (status == STAT_OK)
+		status = View_Parse(frame, frameLen, view);
+	if (status != STAT_OK)
+	{
+		pool->used[slot].store(false, std::memory_order_release);
+		return status;
+	}
+	view->slot = slot;
+	return STAT_OK;
+}
+
+int ReleaseTagReadView(int64_t hComm, TagReadView* view)
+{
+	if (view == NULL || view->slot < 0 || view->slot >= READVIEW_POOL_SIZE)
+		return STAT_CMD_PARAM_ERR;
+	CFViewPool* pool = CFHandle_Get(hComm)->views.load(std::memory_order_acquire);
+	if (pool == NULL)
+		return STAT_CMD_PARAM_ERR;
+	pool->used[view->slot].store(false, std::memory_order_release);
+	view->slot = -1;
+	view->frame = NULL;
+	return STAT_OK;
+}
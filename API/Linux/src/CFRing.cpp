@@ -0,0 +1,194 @@
+#include "CFHandle.h"
+#include "CFRing.h"
+
+struct TagAggregator
+{
+	Mpsc_Ring<TagInfoSourced>* ring;
+	Ring_Waiter waiter;
+	Ring_Counters counters;
+};
+
+static void RingSink(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	CFTagRing* r = (CFTagRing*)userCtx;
+	if (status != STAT_OK)
+	{
+		r->counters.endStatus.store(status, std::memory_order_release);
+		r->waiter.Notify();
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		TagInfoCompact tag = tags[i];
+		bool truncated = Ring_Truncate(&tag);
+		if (!r->ring->Push(tag))
+		{
+			r->counters.overflow.fetch_add(count - i, std::memory_order_relaxed);
+			break;
+		}
+		r->counters.pushed.fetch_add(1, std::memory_order_relaxed);
+		if (truncated)
+			r->counters.truncated.fetch_add(1, std::memory_order_relaxed);
+	}
+	r->waiter.Notify();
+}
+
+static void AggregatorSink(int64_t hComm, int status, const TagInfoCompact* tags, size_t count, const TagCodeArena* arena, void* userCtx)
+{
+	TagAggregator* agg = (TagAggregator*)userCtx;
+	if (status != STAT_OK)
+		return;
+	for (size_t i = 0; i < count; i++)
+	{
+		TagInfoSourced rec;
+		rec.hComm = hComm;
+		rec.tag = tags[i];
+		bool truncated = Ring_Truncate(&rec.tag);
+		if (!agg->ring->Push(rec))
+		{
+			agg->counters.overflow.fetch_add(count - i, std::memory_order_relaxed);
+			break;
+		}
+		agg->counters.pushed.fetch_add(1, std::memory_order_relaxed);
+		if (truncated)
+			agg->counters.truncated.fetch_add(1, std::memory_order_relaxed);
+	}
+	agg->waiter.Notify();
+}
+
+void CFRing_Free(CFTagRing* r)
+{
+	if (r == NULL)
+		return;
+	Spsc_Ring<TagInfoCompact>::Destroy(r->ring);
+	delete r;
+}
+
+// CFRing_Reserve with stream.lock held.
+static int Ring_ReserveLocked(CFHandleCtx* ctx, size_t ringSize)
+{
+	if (ringSize == 0)
+		ringSize = RING_DEFAULT_SIZE;
+	// a producer or a consumer may still be inside the ring
+	if (ctx->stream.active || (ctx->ring != NULL && ctx->ring->users > 0))
+		return STAT_CMD_PARAM_ERR;
+
+	// a ring of the same size starts over, another one is replaced
+	if (ctx->ring != NULL && ctx->ring->ring->Capacity() == Ring_PowerOfTwo(ringSize))
+	{
+		ctx->ring->ring->Reset();
+		ctx->ring->counters.Reset();
+		return STAT_OK;
+	}
+	CFRing_Free(ctx->ring);
+	ctx->ring = new CFTagRing();
+	ctx->ring->users = 0;
+	ctx->ring->ring = Spsc_Ring<TagInfoCompact>::Create(ringSize);
+	if (ctx->ring->ring == NULL)
+	{
+		CFRing_Free(ctx->ring);
+		ctx->ring = NULL;
+		return STAT_DLL_INNER_FAILED;
+	}
+	return STAT_OK;
+}
+
+int CFRing_Reserve(CFHandleCtx* ctx, size_t ringSize)
+{
+	pthread_mutex_lock(&ctx->stream.lock);
+	int status = Ring_ReserveLocked(ctx, ringSize);
+	pthread_mutex_unlock(&ctx->stream.lock);
+	return status;
+}
+
+int InventoryStartRing(int64_t hComm, size_t ringSize, unsigned int flags)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFStreamCtx* st = &ctx->stream;
+	// one hold of the lock from the reset of the ring to the start of its producer
+	pthread_mutex_lock(&st->lock);
+	int status = Ring_ReserveLocked(ctx, ringSize);
+	if (status == STAT_OK)
+		status = CFStream_StartLocked(ctx, RingSink, NULL, ctx->ring, flags);
+	pthread_mutex_unlock(&st->lock);
+	return status;
+}
+
+int TagRingPop(int64_t hComm, TagInfoCompact* out, size_t capacity, size_t* count, unsigned short timeout)
+{
+	if (out == NULL || count == NULL || capacity == 0)
+		return STAT_CMD_PARAM_ERR;
+	*count = 0;
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	pthread_mutex_lock(&ctx->stream.lock);
+	CFTagRing* r = ctx->ring;
+	if (r != NULL)
+		r->users++;
+	pthread_mutex_unlock(&ctx->stream.lock);
+	if (r == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	int status = Ring_PopWait(r->ring, r->waiter, r->counters, out, capacity, count, timeout);
+	pthread_mutex_lock(&ctx->stream.lock);
+	r->users--;
+	pthread_mutex_unlock(&ctx->stream.lock);
+	return status;
+}
+
+int TagRingGetStats(int64_t hComm, TagRingStats* stats)
+{
+	if (stats == NULL)
+		return STAT_CMD_PARAM_ERR;
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	pthread_mutex_lock(&ctx->stream.lock);
+	CFTagRing* r = ctx->ring;
+	if (r != NULL)
+		Ring_FillStats(r->counters, r->ring->Capacity(), r->ring->Size(), stats);
+	pthread_mutex_unlock(&ctx->stream.lock);
+	return r != NULL ? STAT_OK : (int)STAT_CMD_PARAM_ERR;
+}
+
+TagAggregator* TagAggregatorCreate(size_t ringSize)
+{
+	if (ringSize == 0)
+		ringSize = RING_DEFAULT_SIZE;
+	TagAggregator* agg = new TagAggregator();
+	agg->ring = Mpsc_Ring<TagInfoSourced>::Create(ringSize);
+	if (agg->ring == NULL)
+	{
+		delete agg;
+		return NULL;
+	}
+	return agg;
+}
+
+void TagAggregatorDestroy(TagAggregator* agg)
+{
+	if (agg == NULL)
+		return;
+	Mpsc_Ring<TagInfoSourced>::Destroy(agg->ring);
+	delete agg;
+}
+
+int InventoryStartAggregated(int64_t hComm, TagAggregator* agg, unsigned int flags)
+{
+	if (agg == NULL)
+		return STAT_CMD_PARAM_ERR;
+	return InventoryStartStreaming(hComm, AggregatorSink, agg, flags);
+}
+
+int TagAggregatorPop(TagAggregator* agg, TagInfoSourced* out, size_t capacity, size_t* count, unsigned short timeout)
+{
+	if (agg == NULL || out == NULL || count == NULL || capacity == 0)
+		return STAT_CMD_PARAM_ERR;
+	*count = 0;
+	return Ring_PopWait(agg->ring, agg->waiter, agg->counters, out, capacity, count, timeout);
+}
+
+int TagAggregatorGetStats(TagAggregator* agg, TagRingStats* stats)
+{
+	if (agg == NULL || stats == NULL)
+		return STAT_CMD_PARAM_ERR;
+	Ring_FillStats(agg->counters, agg->ring->Capacity(), agg->ring->Size(), stats);
+	return STAT_OK;
+}
@@ -0,0 +1,320 @@
+#ifndef _CFRING_H_
+#define _CFRING_H_
+
+#include "CFApiEx.h"
+#include <atomic>
+#include <new>
+
+#define RING_CACHE_LINE						64
+
+// Rounds n up to a power of two (at least 2) so ring indices can be masked.
+static inline size_t Ring_PowerOfTwo(size_t n)
+{
+	size_t size = 2;
+	while (size < n)
+		size <<= 1;
+	return size;
+}
+
+// Ring records keep fixed-size labels only: codes longer than the inline slot lose their arena part.
+static inline bool Ring_Truncate(TagInfoCompact* tag)
+{
+	if (tag->arenaOff == TAGCOMPACT_NO_ARENA)
+		return false;
+	tag->arenaOff = TAGCOMPACT_NO_ARENA;
+	tag->codeLen = TAGCOMPACT_CODE_LEN;
+	return true;
+}
+
+// Lets a consumer sleep on an empty ring without the producer paying a syscall per push:
+// the producer only posts when the consumer has announced that it is about to wait.
+class Ring_Waiter
+{
+public:
+	Ring_Waiter() : m_waiting(false) { sem_init(&m_sem, 0, 0); }
+	~Ring_Waiter() { sem_destroy(&m_sem); }
+
+	// consumer: call Prepare, re-check the ring, then Wait if it is still empty. The fences here
+	// and in Notify order each side's store before its load (the ring index and m_waiting), so
+	// either the consumer sees the push or the producer sees the waiter.
+	void Prepare()
+	{
+		m_waiting.store(true, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	void Cancel() { m_waiting.store(false, std::memory_order_relaxed); }
+	bool Wait(const struct timespec* deadline)
+	{
+		int ret;
+		do
+			ret = sem_timedwait(&m_sem, deadline);
+		while (ret != 0 && errno == EINTR);
+		m_waiting.store(false, std::memory_order_relaxed);
+		return ret == 0;
+	}
+	// producer: after a successful push
+	void Notify()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_waiting.load(std::memory_order_seq_cst) && m_waiting.exchange(false))
+			sem_post(&m_sem);
+	}
+
+private:
+	sem_t m_sem;
+	std::atomic<bool> m_waiting;
+};
+
+// Bounded single-producer/single-consumer ring. Push only from one thread and Pop only
+// from one (other) thread; neither side takes a lock.
+template <class T>
+class Spsc_Ring
+{
+public:
+	static Spsc_Ring* Create(size_t capacity)
+	{
+		void* mem = NULL;
+		if (posix_memalign(&mem, RING_CACHE_LINE, sizeof(Spsc_Ring)) != 0)
+			return NULL;
+		Spsc_Ring* ring = new (mem) Spsc_Ring();
+		size_t size = Ring_PowerOfTwo(capacity);
+		if (posix_memalign((void**)&ring->m_slots, RING_CACHE_LINE, size * sizeof(T)) != 0)
+		{
+			Destroy(ring);
+			return NULL;
+		}
+		ring->m_mask = size - 1;
+		return ring;
+	}
+	static void Destroy(Spsc_Ring* ring)
+	{
+		if (ring == NULL)
+			return;
+		free(ring->m_slots);
+		ring->~Spsc_Ring();
+		free(ring);
+	}
+
+	bool Push(const T& item)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_cachedTail > m_mask)
+		{
+			m_cachedTail = m_tail.load(std::memory_order_acquire);
+			if (head - m_cachedTail > m_mask)
+				return false;
+		}
+		m_slots[head & m_mask] = item;
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+	size_t Pop(T* out, size_t max)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (m_cachedHead == tail)
+			m_cachedHead = m_head.load(std::memory_order_acquire);
+		size_t count = m_cachedHead - tail;
+		if (count > max)
+			count = max;
+		for (size_t i = 0; i < count; i++)
+			out[i] = m_slots[(tail + i) & m_mask];
+		m_tail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+	bool Empty() const { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire); }
+	size_t Size() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+	size_t Capacity() const { return m_mask + 1; }
+	// Drops what is queued, only while neither side runs.
+	void Reset()
+	{
+		m_head.store(0, std::memory_order_relaxed);
+		m_tail.store(0, std::memory_order_relaxed);
+		m_cachedTail = 0;
+		m_cachedHead = 0;
+	}
+
+private:
+	Spsc_Ring() : m_head(0), m_cachedTail(0), m_tail(0), m_cachedHead(0), m_mask(0), m_slots(NULL) {}
+
+	alignas(RING_CACHE_LINE) std::atomic<size_t> m_head;	// producer line
+	size_t m_cachedTail;
+	alignas(RING_CACHE_LINE) std::atomic<size_t> m_tail;	// consumer line
+	size_t m_cachedHead;
+	alignas(RING_CACHE_LINE) size_t m_mask;
+	T* m_slots;
+};
+
+// Bounded multi-producer/single-consumer ring (sequence-numbered cells), lock-free on both sides.
+template <class T>
+class Mpsc_Ring
+{
+public:
+	static Mpsc_Ring* Create(size_t capacity)
+	{
+		void* mem = NULL;
+		if (posix_memalign(&mem, RING_CACHE_LINE, sizeof(Mpsc_Ring)) != 0)
+			return NULL;
+		Mpsc_Ring* ring = new (mem) Mpsc_Ring();
+		size_t size = Ring_PowerOfTwo(capacity);
+		if (posix_memalign((void**)&ring->m_cells, RING_CACHE_LINE, size * sizeof(Cell)) != 0)
+		{
+			Destroy(ring);
+			return NULL;
+		}
+		for (size_t i = 0; i < size; i++)
+			new (&ring->m_cells[i].seq) std::atomic<size_t>(i);
+		ring->m_mask = size - 1;
+		return ring;
+	}
+	static void Destroy(Mpsc_Ring* ring)
+	{
+		if (ring == NULL)
+			return;
+		free(ring->m_cells);
+		ring->~Mpsc_Ring();
+		free(ring);
+	}
+
+	bool Push(const T& item)
+	{
+		size_t pos = m_enqueue.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+			if (dif == 0)
+			{
+				if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (dif < 0)
+				return false;
+			else
+				pos = m_enqueue.load(std::memory_order_relaxed);
+		}
+		cell->data = item;
+		cell->seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+	size_t Pop(T* out, size_t max)
+	{
+		size_t count = 0;
+		while (count < max)
+		{
+			Cell* cell = &m_cells[m_dequeue & m_mask];
+			if (cell->seq.load(std::memory_order_acquire) != m_dequeue + 1)
+				break;
+			out[count++] = cell->data;
+			cell->seq.store(m_dequeue + m_mask + 1, std::memory_order_release);
+			m_dequeue++;
+		}
+		return count;
+	}
+	bool Empty() const { return m_cells[m_dequeue & m_mask].seq.load(std::memory_order_acquire) != m_dequeue + 1; }
+	size_t Size() const
+	{
+		size_t enq = m_enqueue.load(std::memory_order_acquire);
+		return enq > m_dequeue ? enq - m_dequeue : 0;
+	}
+	size_t Capacity() const { return m_mask + 1; }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> seq;
+		T data;
+	};
+
+	Mpsc_Ring() : m_enqueue(0), m_dequeue(0), m_mask(0), m_cells(NULL) {}
+
+	alignas(RING_CACHE_LINE) std::atomic<size_t> m_enqueue;	// producers line
+	alignas(RING_CACHE_LINE) size_t m_dequeue;				// consumer line
+	alignas(RING_CACHE_LINE) size_t m_mask;
+	Cell* m_cells;
+};
+
+// Counters shared by the per-handle ring and the aggregator, updated without locks.
+struct Ring_Counters
+{
+	std::atomic<uint64_t> pushed;
+	std::atomic<uint64_t> popped;
+	std::atomic<uint64_t> overflow;
+	std::atomic<uint64_t> truncated;
+	std::atomic<int> endStatus;		// status that ended the feeding stream, STAT_OK while running
+
+	Ring_Counters() : pushed(0), popped(0), overflow(0), truncated(0), endStatus(STAT_OK) {}
+	void Reset()
+	{
+		pushed.store(0, std::memory_order_relaxed);
+		popped.store(0, std::memory_order_relaxed);
+		overflow.store(0, std::memory_order_relaxed);
+		truncated.store(0, std::memory_order_relaxed);
+		endStatus.store(STAT_OK, std::memory_order_release);
+	}
+};
+
+static inline void Ring_FillStats(const Ring_Counters& counters, size_t capacity, size_t used, TagRingStats* stats)
+{
+	stats->pushed = counters.pushed.load(std::memory_order_relaxed);
+	stats->popped = counters.popped.load(std::memory_order_relaxed);
+	stats->overflow = counters.overflow.load(std::memory_order_relaxed);
+	stats->truncated = counters.truncated.load(std::memory_order_relaxed);
+	stats->capacity = capacity;
+	stats->used = used;
+}
+
+static inline void Ring_Deadline(struct timespec* deadline, unsigned short timeout)
+{
+	clock_gettime(CLOCK_REALTIME, deadline);
+	deadline->tv_sec += timeout / 1000;
+	deadline->tv_nsec += (long)(timeout % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+// Common consumer loop: pop what is there, otherwise sleep on the waiter until the deadline.
+template <class Ring, class T>
+static int Ring_PopWait(Ring* ring, Ring_Waiter& waiter, Ring_Counters& counters, T* out, size_t capacity, size_t* count, unsigned short timeout)
+{
+	struct timespec deadline;
+	Ring_Deadline(&deadline, timeout);
+	for (;;)
+	{
+		*count = ring->Pop(out, capacity);
+		if (*count > 0)
+		{
+			counters.popped.fetch_add(*count, std::memory_order_relaxed);
+			return STAT_OK;
+		}
+		int endStatus = counters.endStatus.load(std::memory_order_acquire);
+		if (endStatus != STAT_OK)
+			return endStatus;
+		if (timeout == 0)
+			return STAT_CMD_COMM_TIMEOUT;
+
+		waiter.Prepare();
+		if (!ring->Empty() || counters.endStatus.load(std::memory_order_acquire) != STAT_OK)
+		{
+			waiter.Cancel();
+			continue;
+		}
+		if (!waiter.Wait(&deadline) && ring->Empty())
+			return STAT_CMD_COMM_TIMEOUT;
+	}
+}
+
+// Per-handle ring fed by the streaming reader thread (InventoryStartRing).
+struct CFTagRing
+{
+	Spsc_Ring<TagInfoCompact>* ring;
+	unsigned int users;				// TagRingPop calls inside the ring, guarded by stream.lock of the handle
+	Ring_Waiter waiter;
+	Ring_Counters counters;
+};
+
+#endif
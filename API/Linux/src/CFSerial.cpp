@@ -0,0 +1,194 @@
+#include "CFHandle.h"
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/serial.h>
+#include <linux/tcp.h>
+#include <limits.h>
+
+// FTDI adapters hold received bytes for latency_timer ms (16 by default) before sending them up
+// the USB link, ftdi_sio exposes it next to the tty. Other adapters have no such file.
+static bool Link_SetLatencyTimer(const char* port, unsigned char ms)
+{
+	char real[PATH_MAX];
+	if (realpath(port, real) == NULL)
+		return false;
+	const char* tty = strrchr(real, '/');
+	tty = tty ? tty + 1 : real;
+
+	char path[PATH_MAX + 64];
+	snprintf(path, sizeof(path), "/sys/class/tty/%s/device/latency_timer", tty);
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL)
+		return false;
+	bool ok = fprintf(fp, "%u", ms) > 0;
+	ok = (fclose(fp) == 0) && ok;
+	return ok;
+}
+
+// Byte counters of the link below hComm: TIOCGICOUNT for tty devices, TCP_INFO for sockets.
+static bool Link_Counters(int fd, uint64_t* rx, uint64_t* tx)
+{
+	struct serial_icounter_struct icount;
+	if (ioctl(fd, TIOCGICOUNT, &icount) == 0)
+	{
+		*rx = (unsigned int)icount.rx;
+		*tx = (unsigned int)icount.tx;
+		return true;
+	}
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+	memset(&info, 0, sizeof(info));
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0
+		&& len >= offsetof(struct tcp_info, tcpi_bytes_received) + sizeof(info.tcpi_bytes_received))
+	{
+		*rx = info.tcpi_bytes_received;
+		*tx = info.tcpi_bytes_acked;
+		return true;
+	}
+	return false;
+}
+
+static void Link_Reset(CFHandleCtx* ctx)
+{
+	CFLinkCtx* link = &ctx->link;
+	int fd = CFHandle_Fd(ctx->hComm);
+	link->counted = fd >= 0 && Link_Counters(fd, &link->rxBase, &link->txBase);
+	link->rxLast = link->rxBase;
+	link->txLast = link->txBase;
+	link->openMs = CFStats_NowUs() / 1000;
+	link->lastMs = link->openMs;
+	link->started = true;
+}
+
+static int Link_Apply(int fd, const char* port, const SerialOptions* options, unsigned int* applied)
+{
+	*applied = 0;
+	if (options->flags & SERIAL_OPT_EXCLUSIVE)
+	{
+		// a second OpenDevice on the port now fails with EBUSY instead of stealing half the frames
+		if (ioctl(fd, TIOCEXCL) != 0)
+			return STAT_PORT_OPEN_FAILED;
+		*applied |= SERIAL_OPT_EXCLUSIVE;
+	}
+
+	if (options->flags & SERIAL_OPT_VMIN_VTIME)
+	{
+		struct termios tio;
+		if (tcgetattr(fd, &tio) != 0)
+			return STAT_PORT_HANDLE_ERR;
+		tio.c_cc[VMIN] = options->vmin;
+		tio.c_cc[VTIME] = options->vtime;
+		if (tcsetattr(fd, TCSANOW, &tio) != 0)
+			return STAT_CMD_PARAM_ERR;
+		*applied |= SERIAL_OPT_VMIN_VTIME;
+	}
+
+	if (options->flags & SERIAL_OPT_LOW_LATENCY)
+	{
+		// drivers without TIOCSSERIAL (ch341, cp210x ...) are not an error, applied tells
+		struct serial_struct ser;
+		if (ioctl(fd, TIOCGSERIAL, &ser) == 0)
+		{
+			ser.flags |= ASYNC_LOW_LATENCY;
+			if (ioctl(fd, TIOCSSERIAL, &ser) == 0)
+				*applied |= SERIAL_OPT_LOW_LATENCY;
+		}
+		// ftdi_sio also drops its latency timer to 1 ms on ASYNC_LOW_LATENCY, set it explicitly
+		// for kernels that do not
+		if (options->latencyTimer == 0 && Link_SetLatencyTimer(port, 1))
+			*applied |= SERIAL_OPT_LOW_LATENCY;
+	}
+
+	if (options->latencyTimer != 0 && Link_SetLatencyTimer(port, options->latencyTimer))
+		*applied |= SERIAL_OPT_LATENCY_TIMER;
+	return STAT_OK;
+}
+
+int OpenDeviceEx(int64_t* hComm, char* pcCom, int iBaudRate, const SerialOptions* options)
+{
+	if (hComm == NULL || pcCom == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	int status = CFHandle_OpenSerial(hComm, pcCom, iBaudRate);
+	if (status != STAT_OK)
+		return status;
+
+	CFHandleCtx* ctx = CFHandle_Get(*hComm);
+	ctx->link.applied = 0;
+	if (options != NULL)
+	{
+		int fd = CFHandle_Fd(*hComm);
+		status = fd < 0 ? STAT_PORT_HANDLE_ERR : Link_Apply(fd, pcCom, options, &ctx->link.applied);
+		if (status != STAT_OK)
+		{
+			CloseDeviceEx(*hComm);
+			*hComm = 0;
+			return status;
+		}
+	}
+	Link_Reset(ctx);
+	return STAT_OK;
+}
+
+bool CFLink_Bytes(CFHandleCtx* ctx, uint64_t* rx, uint64_t* tx)
+{
+	CFLinkCtx* link = &ctx->link;
+	if (!link->started)
+		Link_Reset(ctx);
+	int fd = CFHandle_Fd(ctx->hComm);
+	if (fd < 0 || !link->counted || !Link_Counters(fd, rx, tx))
+		return false;
+	*rx -= link->rxBase;
+	*tx -= link->txBase;
+	return true;
+}
+
+int GetLinkStats(int64_t hComm, LinkStats* stats)
+{
+	if (stats == NULL)
+		return STAT_CMD_PARAM_ERR;
+	memset(stats, 0, sizeof(*stats));
+
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFLinkCtx* link = &ctx->link;
+	if (!link->started)
+		Link_Reset(ctx);
+	stats->applied = link->applied;
+
+	int fd = CFHandle_Fd(hComm);
+	if (fd < 0)
+		return STAT_CMD_PARAM_ERR;
+	struct termios tio;
+	if (tcgetattr(fd, &tio) == 0)
+	{
+		static const struct { speed_t speed; unsigned int baud; } s_speeds[] = {
+			{ B9600, 9600 }, { B19200, 19200 }, { B38400, 38400 }, { B57600, 57600 },
+			{ B115200, 115200 }, { B230400, 230400 }, { B460800, 460800 }, { B921600, 921600 },
+		};
+		speed_t speed = cfgetispeed(&tio);
+		for (size_t i = 0; i < sizeof(s_speeds) / sizeof(s_speeds[0]); i++)
+		{
+			if (s_speeds[i].speed == speed)
+				stats->baudRate = s_speeds[i].baud;
+		}
+	}
+
+	uint64_t rx, tx;
+	if (!link->counted || !Link_Counters(fd, &rx, &tx))
+		return STAT_OK;
+
+	uint64_t now = CFStats_NowUs() / 1000;
+	stats->rxBytes = rx - link->rxBase;
+	stats->txBytes = tx - link->txBase;
+	stats->elapsedMs = (unsigned int)(now - link->openMs);
+	uint64_t interval = now - link->lastMs;
+	if (interval > 0)
+	{
+		stats->rxRate = (unsigned int)((rx - link->rxLast) * 1000 / interval);
+		stats->txRate = (unsigned int)((tx - link->txLast) * 1000 / interval);
+	}
+	link->rxLast = rx;
+	link->txLast = tx;
+	link->lastMs = now;
+	return STAT_OK;
+}
@@ -0,0 +1,225 @@
+#include "CFHandle.h"
+#include <stdarg.h>
+
+uint64_t CFStats_NowUs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void CFStats_Hist(CFHistCtx* hist, uint64_t us)
+{
+	size_t bucket = 0;
+	for (uint64_t v = us; v != 0 && bucket < STATS_HIST_BUCKETS - 1; v >>= 1)
+		bucket++;
+	hist->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	hist->sumUs.fetch_add(us, std::memory_order_relaxed);
+	uint64_t max = hist->maxUs.load(std::memory_order_relaxed);
+	while (us > max && !hist->maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed))
+		;
+	hist->count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CFStats_Rtt(CFStatsCtx* stats, unsigned short cmd, uint64_t us, bool lost)
+{
+	// slots are claimed once and never given back, a lookup is a short scan of the used ones
+	unsigned int key = 0x10000u | cmd;
+	for (size_t i = 0; i < STATS_CMD_SLOTS; i++)
+	{
+		CFCmdRttCtx* slot = &stats->cmds[i];
+		unsigned int current = slot->cmd.load(std::memory_order_acquire);
+		if (current == 0 && slot->cmd.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+			current = key;
+		if (current != key)
+			continue;
+		if (lost)
+			slot->lost.fetch_add(1, std::memory_order_relaxed);
+		else
+			CFStats_Hist(&slot->rtt, us);
+		return;
+	}
+	stats->cmdUntracked.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void Stats_Copy(const CFHistCtx* in, LatencyHist* out)
+{
+	out->count = in->count.load(std::memory_order_relaxed);
+	out->sumUs = in->sumUs.load(std::memory_order_relaxed);
+	out->maxUs = in->maxUs.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < STATS_HIST_BUCKETS; i++)
+		out->buckets[i] = in->buckets[i].load(std::memory_order_relaxed);
+}
+
+int CFGetStats(int64_t hComm, CFStats* stats)
+{
+	if (stats == NULL)
+		return STAT_CMD_PARAM_ERR;
+	memset(stats, 0, sizeof(*stats));
+
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFStatsCtx* s = &ctx->stats;
+	uint64_t now = CFStats_NowUs();
+	stats->elapsedMs = (now - s->startUs) / 1000;
+	stats->linkCounted = CFLink_Bytes(ctx, &stats->rxBytes, &stats->txBytes) ? 1 : 0;
+	stats->frameRxBytes = s->frameRxBytes.load(std::memory_order_relaxed);
+	stats->frameTxBytes = s->frameTxBytes.load(std::memory_order_relaxed);
+	stats->frames = s->frames.load(std::memory_order_relaxed);
+	stats->crcErrors = s->crcErrors.load(std::memory_order_relaxed);
+	stats->resyncs = s->resyncs.load(std::memory_order_relaxed);
+	stats->resyncBytes = s->resyncBytes.load(std::memory_order_relaxed);
+	stats->tags = s->tags.load(std::memory_order_relaxed);
+	Stats_Copy(&s->tagWait, &stats->tagWait);
+
+	uint64_t interval = now - s->rateUs;
+	if (interval > 0)
+		stats->tagRate = (unsigned int)((stats->tags - s->rateTags) * 1000000 / interval);
+	s->rateUs = now;
+	s->rateTags = stats->tags;
+
+	TagRingStats ring;
+	if (TagRingGetStats(hComm, &ring) == STAT_OK)
+		stats->ringOverflow = ring.overflow;
+
+	stats->cmdUntracked = s->cmdUntracked.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < STATS_CMD_SLOTS; i++)
+	{
+		unsigned int key = s->cmds[i].cmd.load(std::memory_order_acquire);
+		if (key == 0)
+			break;
+		CmdStats* cmd = &stats->cmds[stats->cmdCount++];
+		cmd->cmd = (unsigned short)key;
+		cmd->lost = s->cmds[i].lost.load(std::memory_order_relaxed);
+		Stats_Copy(&s->cmds[i].rtt, &cmd->rtt);
+	}
+	return STAT_OK;
+}
+
+// Text of CFStatsFormatOpenMetrics, len keeps counting once buf is full.
+struct StatsText
+{
+	char* buf;
+	size_t size;
+	size_t len;
+};
+
+static void Stats_Printf(StatsText* t, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	bool room = t->len < t->size;
+	int n = vsnprintf(room ? t->buf + t->len : NULL, room ? t->size - t->len : 0, fmt, args);
+	va_end(args);
+	if (n > 0)
+		t->len += n;
+}
+
+// reader="..." with the escapes of the exposition format.
+static void Stats_Reader(StatsText* t, const char* reader)
+{
+	Stats_Printf(t, "reader=\"");
+	for (const char* p = reader != NULL ? reader : ""; *p != '\0'; p++)
+	{
+		if (*p == '\\' || *p == '"')
+			Stats_Printf(t, "\\%c", *p);
+		else if (*p == '\n')
+			Stats_Printf(t, "\\n");
+		else
+			Stats_Printf(t, "%c", *p);
+	}
+	Stats_Printf(t, "\"");
+}
+
+static void Stats_Family(StatsText* t, const char* name, const char* type, const char* help)
+{
+	Stats_Printf(t, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+// One counter family, field picks the value of a snapshot. Readers without link counters are
+// left out of the link families.
+static void Stats_Counter(StatsText* t, const CFStats* stats, const char* const* readers, size_t n,
+	const char* name, const char* help, uint64_t CFStats::*field, bool link)
+{
+	Stats_Family(t, name, "counter", help);
+	for (size_t i = 0; i < n; i++)
+	{
+		if (link && !stats[i].linkCounted)
+			continue;
+		Stats_Printf(t, "%s_total{", name);
+		Stats_Reader(t, readers[i]);
+		Stats_Printf(t, "} %llu\n", (unsigned long long)(stats[i].*field));
+	}
+}
+
+static void Stats_Hist(StatsText* t, const char* name, const char* reader, const char* cmd, const LatencyHist* hist)
+{
+	uint64_t cumulative = 0;
+	for (size_t b = 0; b < STATS_HIST_BUCKETS; b++)
+	{
+		cumulative += hist->buckets[b];
+		Stats_Printf(t, "%s_bucket{", name);
+		Stats_Reader(t, reader);
+		if (cmd != NULL)
+			Stats_Printf(t, ",cmd=\"%s\"", cmd);
+		if (b + 1 < STATS_HIST_BUCKETS)
+			Stats_Printf(t, ",le=\"%g\"} %llu\n", (double)(1ull << b) / 1e6, (unsigned long long)cumulative);
+		else
+			Stats_Printf(t, ",le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+	}
+	Stats_Printf(t, "%s_sum{", name);
+	Stats_Reader(t, reader);
+	if (cmd != NULL)
+		Stats_Printf(t, ",cmd=\"%s\"", cmd);
+	Stats_Printf(t, "} %.6f\n%s_count{", (double)hist->sumUs / 1e6, name);
+	Stats_Reader(t, reader);
+	if (cmd != NULL)
+		Stats_Printf(t, ",cmd=\"%s\"", cmd);
+	Stats_Printf(t, "} %llu\n", (unsigned long long)hist->count);
+}
+
+int CFStatsFormatOpenMetrics(const CFStats* stats, const char* const* readers, size_t n, char* buf, size_t size, size_t* len)
+{
+	if ((n > 0 && (stats == NULL || readers == NULL)) || (buf == NULL && size > 0) || len == NULL)
+		return STAT_CMD_PARAM_ERR;
+	StatsText t = { buf, size, 0 };
+
+	Stats_Counter(&t, stats, readers, n, "cfapi_link_receive_bytes", "Bytes received on the link.", &CFStats::rxBytes, true);
+	Stats_Counter(&t, stats, readers, n, "cfapi_link_transmit_bytes", "Bytes sent on the link.", &CFStats::txBytes, true);
+	Stats_Counter(&t, stats, readers, n, "cfapi_frame_receive_bytes", "Bytes taken by the frame parser.", &CFStats::frameRxBytes, false);
+	Stats_Counter(&t, stats, readers, n, "cfapi_frame_transmit_bytes", "Bytes of the frames written.", &CFStats::frameTxBytes, false);
+	Stats_Counter(&t, stats, readers, n, "cfapi_frames", "Frames parsed with a good CRC.", &CFStats::frames, false);
+	Stats_Counter(&t, stats, readers, n, "cfapi_frame_crc_errors", "Frames dropped for a bad CRC.", &CFStats::crcErrors, false);
+	Stats_Counter(&t, stats, readers, n, "cfapi_frame_resyncs", "Frames found behind stray bytes.", &CFStats::resyncs, false);
+	Stats_Counter(&t, stats, readers, n, "cfapi_frame_resync_bytes", "Stray bytes skipped.", &CFStats::resyncBytes, false);
+	Stats_Counter(&t, stats, readers, n, "cfapi_tags", "Labels decoded.", &CFStats::tags, false);
+	Stats_Counter(&t, stats, readers, n, "cfapi_ring_overflow", "Labels dropped by a full ring.", &CFStats::ringOverflow, false);
+
+	Stats_Family(&t, "cfapi_tag_wait_seconds", "histogram", "Time blocked waiting for the first label of a burst.");
+	for (size_t i = 0; i < n; i++)
+		Stats_Hist(&t, "cfapi_tag_wait_seconds", readers[i], NULL, &stats[i].tagWait);
+
+	Stats_Family(&t, "cfapi_command_rtt_seconds", "histogram", "Round trip of a command by command code.");
+	for (size_t i = 0; i < n; i++)
+	{
+		for (size_t c = 0; c < stats[i].cmdCount && c < STATS_CMD_SLOTS; c++)
+		{
+			char cmd[8];
+			snprintf(cmd, sizeof(cmd), "0x%04X", stats[i].cmds[c].cmd);
+			Stats_Hist(&t, "cfapi_command_rtt_seconds", readers[i], cmd, &stats[i].cmds[c].rtt);
+		}
+	}
+	Stats_Family(&t, "cfapi_command_lost", "counter", "Commands sent and never answered.");
+	for (size_t i = 0; i < n; i++)
+	{
+		for (size_t c = 0; c < stats[i].cmdCount && c < STATS_CMD_SLOTS; c++)
+		{
+			Stats_Printf(&t, "cfapi_command_lost_total{");
+			Stats_Reader(&t, readers[i]);
+			Stats_Printf(&t, ",cmd=\"0x%04X\"} %llu\n", stats[i].cmds[c].cmd, (unsigned long long)stats[i].cmds[c].lost);
+		}
+	}
+	Stats_Printf(&t, "# EOF\n");
+
+	*len = t.len;
+	return t.len < size ? STAT_OK : STAT_CMD_BUF_OVERFLOW;
+}
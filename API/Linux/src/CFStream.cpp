@@ -0,0 +1,207 @@
+#include "CFHandle.h"
+
+// Label loop of InventoryStartStreaming, until stop is set or the inventory ends.
+static int Stream_Poll(CFHandleCtx* ctx)
+{
+	CFStreamCtx* st = &ctx->stream;
+	size_t capacity = (st->flags & STREAM_PER_TAG) ? 1 : STREAM_BATCH_MAX;
+	TagInfoCompact tags[STREAM_BATCH_MAX];
+	unsigned char overflow[STREAM_BATCH_MAX * 32];
+	TagCodeArena arena = { overflow, sizeof(overflow), 0 };
+	int status = STAT_OK;
+
+	while (!st->stop)
+	{
+		size_t count = 0;
+		arena.used = 0;
+		status = GetTagUiiBatchCompact(ctx->hComm, tags, capacity, &count, &arena, STREAM_POLL_TIMEOUT);
+		if (status == STAT_OK)
+		{
+			st->callback(ctx->hComm, STAT_OK, tags, count, &arena, st->userCtx);
+			continue;
+		}
+		if (status == (int)STAT_CMD_COMM_TIMEOUT)
+		{
+			if (st->idle != NULL)
+				st->idle(ctx->hComm, st->userCtx);
+			continue;
+		}
+		// inventory finished (btInvCount) or the link failed: report once and end the stream
+		st->callback(ctx->hComm, status, NULL, 0, NULL, st->userCtx);
+		break;
+	}
+	return status;
+}
+
+static void* StreamThread(void* arg)
+{
+	CFHandleCtx* ctx = (CFHandleCtx*)arg;
+	CFStreamCtx* st = &ctx->stream;
+	int status = st->worker != NULL ? st->worker(ctx, st->workerCtx) : Stream_Poll(ctx);
+
+	pthread_mutex_lock(&st->lock);
+	// a worker has stopped the inventory itself
+	if (st->selfStop && st->worker == NULL && !(st->flags & STREAM_NO_INVENTORY) && (status == STAT_OK || status == (int)STAT_CMD_COMM_TIMEOUT))
+		InventoryStop(ctx->hComm, st->stopTimeout);
+	// nobody joins a thread that ended on its own or was stopped from its callback
+	if (!st->stop || st->selfStop)
+		pthread_detach(pthread_self());
+	st->active = false;
+	pthread_cond_broadcast(&st->done);
+	pthread_mutex_unlock(&st->lock);
+	return NULL;
+}
+
+// Starts the reader thread of ctx with stream.lock held, the fields of the run already set.
+static int Stream_Spawn(CFHandleCtx* ctx)
+{
+	CFStreamCtx* st = &ctx->stream;
+	st->stop = false;
+	st->selfStop = false;
+	if (pthread_create(&st->thread, NULL, StreamThread, ctx) != 0)
+		return STAT_DLL_INNER_FAILED;
+	st->active = true;
+	return STAT_OK;
+}
+
+int CFStream_StartLocked(CFHandleCtx* ctx, TagStreamCallback callback, CFStreamIdle idle, void* userCtx, unsigned int flags)
+{
+	if (callback == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	CFStreamCtx* st = &ctx->stream;
+	if (st->active)
+		return STAT_CMD_PARAM_ERR;
+
+	if (!(flags & STREAM_NO_INVENTORY))
+	{
+		int status = InventoryContinueEx(ctx->hComm, 0, 0);
+		if (status != STAT_OK)
+			return status;
+	}
+
+	st->callback = callback;
+	st->idle = idle;
+	st->userCtx = userCtx;
+	st->flags = flags;
+	st->worker = NULL;
+	st->workerCtx = NULL;
+	int status = Stream_Spawn(ctx);
+	if (status != STAT_OK && !(flags & STREAM_NO_INVENTORY))
+		InventoryStop(ctx->hComm, COMMON_TIMEOUT);
+	return status;
+}
+
+int CFStream_Start(int64_t hComm, TagStreamCallback callback, CFStreamIdle idle, void* userCtx, unsigned int flags)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	pthread_mutex_lock(&ctx->stream.lock);
+	int status = CFStream_StartLocked(ctx, callback, idle, userCtx, flags);
+	pthread_mutex_unlock(&ctx->stream.lock);
+	return status;
+}
+
+int CFStream_StartWorker(int64_t hComm, CFStreamWorker worker, void* workerCtx)
+{
+	if (worker == NULL)
+		return STAT_CMD_PARAM_ERR;
+
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFStreamCtx* st = &ctx->stream;
+	pthread_mutex_lock(&st->lock);
+	int status = STAT_CMD_PARAM_ERR;
+	if (!st->active)
+	{
+		st->callback = NULL;
+		st->idle = NULL;
+		st->userCtx = NULL;
+		st->flags = 0;
+		st->worker = worker;
+		st->workerCtx = workerCtx;
+		status = Stream_Spawn(ctx);
+	}
+	pthread_mutex_unlock(&st->lock);
+	return status;
+}
+
+int InventoryStartStreaming(int64_t hComm, TagStreamCallback callback, void* userCtx, unsigned int flags)
+{
+	return CFStream_Start(hComm, callback, NULL, userCtx, flags);
+}
+
+// InventoryStopStreaming, of the stream run for owner only unless any is set.
+static int Stream_Stop(int64_t hComm, unsigned short timeout, bool any, void* owner)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFStreamCtx* st = &ctx->stream;
+
+	pthread_mutex_lock(&st->lock);
+	if (!any && (!st->active || (st->worker != NULL ? st->workerCtx : st->userCtx) != owner))
+	{
+		pthread_mutex_unlock(&st->lock);
+		return STAT_OK;
+	}
+	if (!st->active)
+	{
+		pthread_mutex_unlock(&st->lock);
+		return InventoryStop(hComm, timeout);
+	}
+	if (st->stop)
+	{
+		// stopped already, from the callback or by another thread: only that one joins (or
+		// the thread detached itself), the others wait until it has exited
+		if (!pthread_equal(st->thread, pthread_self()))
+		{
+			while (st->active)
+				pthread_cond_wait(&st->done, &st->lock);
+		}
+		pthread_mutex_unlock(&st->lock);
+		return STAT_OK;
+	}
+	st->stop = true;
+	st->stopTimeout = timeout;
+	if (pthread_equal(st->thread, pthread_self()))
+	{
+		// called from the callback: the thread sends InventoryStop once the callback returns
+		st->selfStop = true;
+		pthread_mutex_unlock(&st->lock);
+		return STAT_OK;
+	}
+	pthread_t thread = st->thread;
+	bool stopped = (st->flags & STREAM_NO_INVENTORY) || st->worker != NULL;
+	pthread_mutex_unlock(&st->lock);
+
+	// the reader thread owns the receive path until it has left GetTagUii
+	pthread_join(thread, NULL);
+	if (stopped)
+		return STAT_OK;
+	return InventoryStop(hComm, timeout);
+}
+
+int InventoryStopStreaming(int64_t hComm, unsigned short timeout)
+{
+	return Stream_Stop(hComm, timeout, true, NULL);
+}
+
+void CFStream_StopOwner(int64_t hComm, void* owner)
+{
+	Stream_Stop(hComm, COMMON_TIMEOUT, false, owner);
+}
+
+void CFStream_Close(int64_t hComm)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFStreamCtx* st = &ctx->stream;
+
+	pthread_mutex_lock(&st->lock);
+	bool active = st->active;
+	pthread_mutex_unlock(&st->lock);
+	if (active)
+		InventoryStopStreaming(hComm, COMMON_TIMEOUT);
+
+	// a thread stopped from its own callback may still be finishing InventoryStop
+	pthread_mutex_lock(&st->lock);
+	while (st->active)
+		pthread_cond_wait(&st->done, &st->lock);
+	pthread_mutex_unlock(&st->lock);
+}
@@ -0,0 +1,333 @@
+#include "CFFrame.h"
+#include <poll.h>
+#include <termios.h>
+
+#define TRIGGER_INV_CYCLES					0x01	// InvType of the inventory command: rounds instead of seconds
+
+// Armed state of a handle, see CFTriggerArm.
+struct CFTrigger
+{
+	TriggerConfig config;
+	bool open;						// an inventory whose end (status 0x12) the host has not seen yet
+	bool restoreDevice;				// TRIGGER_GPIO: device, gpio and work hold the values before the arm
+	bool restoreWork;				// the firmware answered GetGPIOWorkParam
+	DevicePara device;
+	GpioPara gpio;
+	GPIOWorkParam work;
+	unsigned char start[FRAME_HEAD_LEN + 5 + 2];	// inventory command of TRIGGER_HOST, built once
+	size_t startLen;
+};
+
+void CFTrigger_Free(CFTrigger* trigger)
+{
+	delete trigger;
+}
+
+// Next label or end of inventory (STAT_CMD_INVENTORY_STOP) of hComm until deadline. Frames with a
+// bad CRC and answers of other commands are dropped and counted in skipped.
+static int Trigger_Next(CFHandleCtx* ctx, TagInfo* tag, const struct timespec* deadline, unsigned int* skipped)
+{
+	int fd = CFHandle_Fd(ctx->hComm);
+	if (fd < 0)
+	{
+		int ms = CFFrame_RemainingMs(deadline);
+		if (ms == 0)
+			return STAT_CMD_COMM_TIMEOUT;
+		return GetTagUii(ctx->hComm, tag, (unsigned short)ms);
+	}
+	for (;;)
+	{
+		unsigned char frame[FRAME_MAX_LEN];
+		size_t frameLen = 0;
+		int status = CFFrame_Read(fd, frame, &frameLen, deadline, &ctx->stats);
+		if (status == (int)STAT_CMD_RESP_CRC_ERR || (status == STAT_OK && ((frame[2] << 8) | frame[3]) != FRAME_CMD_INVENTORY))
+		{
+			(*skipped)++;
+			continue;
+		}
+		if (status != STAT_OK)
+			return status;
+		return CFFrame_Label(frame, tag);
+	}
+}
+
+// Starts the bounded inventory of TRIGGER_HOST.
+static int Trigger_Start(CFHandleCtx* ctx, CFTrigger* t)
+{
+	int fd = CFHandle_Fd(ctx->hComm);
+	int status;
+	if (fd < 0)
+		status = InventoryContinue(ctx->hComm, TRIGGER_INV_CYCLES, t->config.cycles);
+	else
+		status = CFFrame_Write(fd, t->start, t->startLen, &ctx->stats);
+	if (status == STAT_OK)
+		t->open = true;
+	return status;
+}
+
+// Earlier of deadline and one STREAM_POLL_TIMEOUT from now: the turn on the link is given up in
+// between, so commands of other threads are not held off for the whole wait.
+static void Trigger_Slice(const struct timespec* deadline, struct timespec* slice)
+{
+	CFFrame_Deadline(slice, STREAM_POLL_TIMEOUT);
+	if (deadline->tv_sec < slice->tv_sec || (deadline->tv_sec == slice->tv_sec && deadline->tv_nsec < slice->tv_nsec))
+		*slice = *deadline;
+}
+
+// Gives the turn on the link to the commands waiting for it. Returns false once another thread
+// disarmed (or armed again) meanwhile.
+static bool Trigger_Yield(CFHandleCtx* ctx, CFTrigger* t)
+{
+	CFHandle_Hold(ctx);
+	CFSeq_Leave(ctx);
+	CFSeq_Enter(ctx);
+	CFHandle_Drop(ctx);
+	return ctx->trigger == t;
+}
+
+// Reads off what is left of the inventory of the previous trigger.
+static int Trigger_Drain(CFHandleCtx* ctx, CFTrigger* t, const struct timespec* deadline, unsigned int* skipped)
+{
+	TagInfo tag;
+	while (t->open)
+	{
+		struct timespec slice;
+		Trigger_Slice(deadline, &slice);
+		int status = Trigger_Next(ctx, &tag, &slice, skipped);
+		if (status == STAT_OK)
+			(*skipped)++;
+		else if (status == (int)STAT_CMD_INVENTORY_STOP)
+			t->open = false;
+		else if (status != (int)STAT_CMD_COMM_TIMEOUT)
+			return status;
+		else if (CFFrame_RemainingMs(deadline) == 0)
+			return STAT_CMD_COMM_TIMEOUT;
+		if (!Trigger_Yield(ctx, t))
+			return STAT_CMD_PARAM_ERR;
+	}
+	return STAT_OK;
+}
+
+// Waits until triggerFd is readable or deadline.
+static int Trigger_Poll(int triggerFd, const struct timespec* deadline)
+{
+	for (;;)
+	{
+		struct pollfd pfd = { triggerFd, POLLIN | POLLPRI, 0 };
+		int ret = poll(&pfd, 1, CFFrame_RemainingMs(deadline));
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 || (pfd.revents & POLLNVAL))
+			return STAT_CMD_PARAM_ERR;
+		return ret == 0 ? STAT_CMD_COMM_TIMEOUT : STAT_OK;
+	}
+}
+
+// Puts back what CFTriggerArm changed on the reader, the first failure is returned.
+static int Trigger_Restore(int64_t hComm, CFTrigger* t)
+{
+	if (!t->restoreDevice)
+		return STAT_OK;
+	int status = SetDevicePara(hComm, t->device);
+	int gpio = SetGpioPara(hComm, t->gpio);
+	if (status == STAT_OK)
+		status = gpio;
+	if (t->restoreWork)
+	{
+		int work = SetGPIOWorkParam(hComm, t->work);
+		if (status == STAT_OK)
+			status = work;
+	}
+	return status;
+}
+
+// Switches the reader to TRIGGER_WORKMODE, keeping the values it had in t.
+static int Trigger_ConfigureGpio(int64_t hComm, CFTrigger* t)
+{
+	int status = GetDevicePara(hComm, &t->device);
+	if (status == STAT_OK)
+		status = GetGpioPara(hComm, &t->gpio);
+	if (status != STAT_OK)
+		return status;
+	t->restoreWork = GetGPIOWorkParam(hComm, &t->work) == STAT_OK;
+
+	DevicePara device = t->device;
+	device.WORKMODE = TRIGGER_WORKMODE;
+	device.TRIGGLETIME = t->config.triggerTime;
+	GpioPara gpio = t->gpio;
+	gpio.TriggleMode = t->config.level;
+	status = SetDevicePara(hComm, device);
+	// from here on the reader may hold some of the new values, put all of them back on a failure
+	t->restoreDevice = true;
+	if (status == STAT_OK)
+		status = SetGpioPara(hComm, gpio);
+	if (status == STAT_OK && t->restoreWork)
+	{
+		GPIOWorkParam work = t->work;
+		work.GPIEnable = 0x01;
+		work.InLevel = t->config.level;
+		status = SetGPIOWorkParam(hComm, work);
+	}
+	if (status != STAT_OK)
+		Trigger_Restore(hComm, t);
+	return status;
+}
+
+int CFTriggerArm(int64_t hComm, const TriggerConfig* config)
+{
+	TriggerConfig c;
+	memset(&c, 0, sizeof(c));
+	if (config != NULL)
+		c = *config;
+	if (c.source > TRIGGER_GPIO || c.level > 0x01)
+		return STAT_CMD_PARAM_ERR;
+	if (c.triggerTime == 0)
+		c.triggerTime = 1;
+	if (c.cycles == 0)
+		c.cycles = 1;
+
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFStreamCtx* st = &ctx->stream;
+	pthread_mutex_lock(&st->lock);
+	bool streaming = st->active;
+	pthread_mutex_unlock(&st->lock);
+	if (streaming)
+		return STAT_CMD_PARAM_ERR;
+
+	CFSeq_Enter(ctx);
+	int status = CFTriggerDisarm(hComm);
+	if (status != STAT_OK)
+	{
+		CFSeq_Leave(ctx);
+		return status;
+	}
+	// a reader with nothing running answers the stop with an error, that is what we want anyway
+	InventoryStop(hComm, COMMON_TIMEOUT);
+
+	CFTrigger* t = new (std::nothrow) CFTrigger();
+	if (t == NULL)
+	{
+		CFSeq_Leave(ctx);
+		return STAT_DLL_INNER_FAILED;
+	}
+	t->config = c;
+	if (c.source == TRIGGER_GPIO)
+		status = Trigger_ConfigureGpio(hComm, t);
+	if (status != STAT_OK)
+	{
+		delete t;
+		CFSeq_Leave(ctx);
+		return status;
+	}
+
+	unsigned char* p = t->start + FRAME_HEAD_LEN;
+	*p++ = TRIGGER_INV_CYCLES;
+	*p++ = 0;
+	*p++ = 0;
+	*p++ = 0;
+	*p++ = c.cycles;
+	t->startLen = CFFrame_Build(t->start, FRAME_CMD_INVENTORY, 5);
+
+	// labels and answers queued before the arm would pass for the first trigger
+	int fd = CFHandle_Fd(hComm);
+	if (fd >= 0)
+		tcflush(fd, TCIFLUSH);
+	ctx->trigger = t;
+	CFSeq_Leave(ctx);
+	return STAT_OK;
+}
+
+int CFTriggerWaitTag(int64_t hComm, int triggerFd, TagInfo* tag, TriggerResult* result, unsigned short timeout)
+{
+	if (tag == NULL || result == NULL)
+		return STAT_CMD_PARAM_ERR;
+	memset(result, 0, sizeof(*result));
+
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	struct timespec deadline;
+	CFFrame_Deadline(&deadline, timeout);
+	CFSeq_Enter(ctx);
+	CFTrigger* t = ctx->trigger;
+	if (t == NULL)
+	{
+		CFSeq_Leave(ctx);
+		return STAT_CMD_PARAM_ERR;
+	}
+	bool host = t->config.source == TRIGGER_HOST;
+	int status = Trigger_Drain(ctx, t, &deadline, &result->skipped);
+	if (status == STAT_OK && host && triggerFd >= 0)
+	{
+		// the trigger may take long: other commands can have the link meanwhile
+		CFHandle_Hold(ctx);
+		CFSeq_Leave(ctx);
+		status = Trigger_Poll(triggerFd, &deadline);
+		CFSeq_Enter(ctx);
+		CFHandle_Drop(ctx);
+		if (ctx->trigger != t)
+			status = STAT_CMD_PARAM_ERR;
+	}
+	if (status == STAT_OK && host)
+	{
+		result->triggerUs = CFStats_NowUs();
+		status = Trigger_Start(ctx, t);
+		result->rounds = 1;
+	}
+
+	while (status == STAT_OK)
+	{
+		struct timespec slice;
+		Trigger_Slice(&deadline, &slice);
+		status = Trigger_Next(ctx, tag, &slice, &result->skipped);
+		if (status == STAT_OK)
+		{
+			// the rest of these rounds is read off by the next call
+			t->open = true;
+			break;
+		}
+		if (status == (int)STAT_CMD_INVENTORY_STOP)
+		{
+			// rounds without a label end on their own; in trigger work mode the next edge starts anew
+			t->open = false;
+			if (CFFrame_RemainingMs(&deadline) == 0)
+				status = STAT_CMD_COMM_TIMEOUT;
+			else if (host)
+			{
+				status = Trigger_Start(ctx, t);
+				result->rounds++;
+			}
+			else
+				status = STAT_OK;
+			continue;
+		}
+		if (status == (int)STAT_CMD_COMM_TIMEOUT && CFFrame_RemainingMs(&deadline) > 0)
+			status = Trigger_Yield(ctx, t) ? STAT_OK : STAT_CMD_PARAM_ERR;
+	}
+	if (status == STAT_OK)
+	{
+		result->tagUs = CFStats_NowUs();
+		if (host)
+			result->latencyUs = (unsigned int)(result->tagUs - result->triggerUs);
+		ctx->stats.tags.fetch_add(1, std::memory_order_relaxed);
+	}
+	CFSeq_Leave(ctx);
+	return status;
+}
+
+int CFTriggerDisarm(int64_t hComm)
+{
+	CFHandleCtx* ctx = CFHandle_Get(hComm);
+	CFSeq_Enter(ctx);
+	CFTrigger* t = ctx->trigger;
+	int status = STAT_OK;
+	if (t != NULL)
+	{
+		// a round still running would answer in between the parameter commands
+		if (t->open)
+			InventoryStop(hComm, COMMON_TIMEOUT);
+		status = Trigger_Restore(hComm, t);
+		ctx->trigger = NULL;
+		delete t;
+	}
+	CFSeq_Leave(ctx);
+	return status;
+}
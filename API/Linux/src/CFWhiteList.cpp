@@ -0,0 +1,329 @@
+#include "CFFrame.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stddef.h>
+
+#define WHITELIST_DATA_STATUS				0x8C	// status byte of a download frame carrying records
+#define WHITELIST_FRAME_HEAD				3		// FRAMENUM[2] INFOCOUNT in front of the records
+
+// libCFApi implements BeginWhiteList(int64_t, unsigned char, unsigned long*) and EndWhiteList(int64_t,
+// unsigned long*): the count goes in and comes back through the pointer, 8 bytes wide. CFApi.h
+// declares them with an unsigned short count, so they are called through their real signature.
+typedef int (*WhiteListBeginFn)(int64_t hComm, unsigned char option, unsigned long* count);
+typedef int (*WhiteListEndFn)(int64_t hComm, unsigned long* count);
+
+struct WhiteListUpload
+{
+	int64_t hComm;
+	WhiteListSource source;
+	void* ctx;
+	size_t total;
+	size_t frames;
+	WhiteListOptions options;
+	WhiteListTransfer* transfer;
+	CFStatsCtx* stats;
+};
+
+struct WhiteListFile
+{
+	const unsigned char* data;
+};
+
+static int WhiteList_Begin(int64_t hComm, unsigned char option, size_t count)
+{
+	unsigned long value = count;
+	return ((WhiteListBeginFn)(void*)BeginWhiteList)(hComm, option, &value);
+}
+
+static int WhiteList_End(int64_t hComm, unsigned short* infoCount)
+{
+	unsigned long value = 0;
+	int status = ((WhiteListEndFn)(void*)EndWhiteList)(hComm, &value);
+	*infoCount = (unsigned short)(value < 0xFFFF ? value : 0xFFFF);
+	return status;
+}
+
+static int WhiteList_Options(const WhiteListOptions* in, WhiteListOptions* out)
+{
+	memset(out, 0, sizeof(*out));
+	if (in != NULL)
+		*out = *in;
+	if (out->window == 0)
+		out->window = WHITELIST_DEFAULT_WINDOW;
+	if (out->frameRecords == 0)
+		out->frameRecords = WHITELIST_FRAME_RECORDS;
+	if (out->timeout == 0)
+		out->timeout = COMMON_TIMEOUT;
+	if (out->window > WHITELIST_WINDOW_MAX || out->frameRecords > WHITELIST_FRAME_RECORDS)
+		return STAT_CMD_PARAM_ERR;
+	return STAT_OK;
+}
+
+// Frames below nextFrame are acknowledged by the reader.
+static void WhiteList_Acked(WhiteListUpload* up, size_t nextFrame)
+{
+	size_t records = nextFrame * up->options.frameRecords;
+	up->transfer->nextFrame = (unsigned short)nextFrame;
+	up->transfer->records = records < up->total ? records : up->total;
+	if (up->options.progress != NULL)
+		up->options.progress(up->options.progressCtx, up->transfer->records, up->total);
+}
+
+// SetWhiteList payload: FRAMENUM (big endian) INFOCOUNT CUSTOMERINFO[INFOCOUNT], the records straight from the source.
+static int WhiteList_Fill(WhiteListUpload* up, size_t frameNum, unsigned char* payload, size_t* len)
+{
+	size_t first = frameNum * up->options.frameRecords;
+	size_t count = up->total - first < up->options.frameRecords ? up->total - first : up->options.frameRecords;
+	payload[0] = (unsigned char)(frameNum >> 8);
+	payload[1] = (unsigned char)frameNum;
+	payload[2] = (unsigned char)count;
+	*len = WHITELIST_FRAME_HEAD + count * WHITELIST_RECORD_LEN;
+	return up->source(up->ctx, first, payload + WHITELIST_FRAME_HEAD, count);
+}
+
+// HID connections: one SetWhiteList after the other through libCFApi.
+static int WhiteList_UploadSequential(WhiteListUpload* up)
+{
+	unsigned char payload[255];
+	for (size_t frame = up->options.resumeFrame; frame < up->frames; frame++)
+	{
+		size_t len;
+		int status = WhiteList_Fill(up, frame, payload, &len);
+		if (status == STAT_OK)
+			status = SetWhiteList(up->hComm, (unsigned short)len, payload);
+		if (status != STAT_OK)
+			return status;
+		WhiteList_Acked(up, frame + 1);
+	}
+	return STAT_OK;
+}
+
+static int WhiteList_UploadPipelined(WhiteListUpload* up, int fd)
+{
+	unsigned char frame[FRAME_LONG_MAX_LEN];
+	uint64_t sentUs[WHITELIST_WINDOW_MAX];
+	size_t next = up->options.resumeFrame, acked = next;
+	int status = STAT_OK;
+
+	// the reader takes the frames in FRAMENUM order, so the acknowledgements come back in order too
+	while (acked < next || (status == STAT_OK && next < up->frames))
+	{
+		while (status == STAT_OK && next < up->frames && next - acked < up->options.window)
+		{
+			size_t len;
+			status = WhiteList_Fill(up, next, frame + FRAME_LONG_HEAD_LEN, &len);
+			if (status != STAT_OK)
+				break;
+			status = CFFrame_Write(fd, frame, CFFrame_BuildLong(frame, FRAME_CMD_WHITELIST, len), up->stats);
+			if (status != STAT_OK)
+				break;
+			sentUs[next++ % WHITELIST_WINDOW_MAX] = CFStats_NowUs();
+		}
+		if (acked == next)
+			break;
+
+		struct timespec deadline;
+		CFFrame_Deadline(&deadline, up->options.timeout);
+		size_t frameLen;
+		int readStatus = CFFrame_ReadLong(fd, frame, &frameLen, &deadline, up->stats);
+		if (readStatus == (int)STAT_CMD_RESP_CRC_ERR)
+			continue;
+		if (readStatus != STAT_OK)
+		{
+			for (; acked < next; acked++)
+				CFStats_Rtt(up->stats, FRAME_CMD_WHITELIST, 0, true);
+			return status != STAT_OK ? status : readStatus;
+		}
+		if (((frame[2] << 8) | frame[3]) != FRAME_CMD_WHITELIST)
+			continue;	// label of an inventory stopped just before
+		CFStats_Rtt(up->stats, FRAME_CMD_WHITELIST, CFStats_NowUs() - sentUs[acked % WHITELIST_WINDOW_MAX], false);
+		int ack = frame[4] == 0 && frame[5] == 0 ? STAT_CMD_RESP_FORMAT_ERR : CFFrame_Status(frame[FRAME_LONG_HEAD_LEN]);
+		// a refused frame ends the upload, the reader does not take the ones behind it out of order
+		if (ack != STAT_OK)
+			return ack;
+		WhiteList_Acked(up, ++acked);
+	}
+	return status;
+}
+
+int UploadWhiteListStream(int64_t hComm, WhiteListSource source, void* ctx, size_t total, const WhiteListOptions* options, WhiteListTransfer* transfer)
+{
+	WhiteListTransfer local;
+	WhiteListUpload up;
+	memset(&up, 0, sizeof(up));
+	up.transfer = transfer != NULL ? transfer : &local;
+	memset(up.transfer, 0, sizeof(*up.transfer));
+	if (source == NULL || total > 0xFFFF || WhiteList_Options(options, &up.options) != STAT_OK)
+		return STAT_CMD_PARAM_ERR;
+	up.hComm = hComm;
+	up.stats = &CFHandle_Get(hComm)->stats;
+	up.source = source;
+	up.ctx = ctx;
+	up.total = total;
+	up.frames = (total + up.options.frameRecords - 1) / up.options.frameRecords;
+	if (up.options.resumeFrame > up.frames)
+		return STAT_CMD_PARAM_ERR;
+	up.transfer->nextFrame = up.options.resumeFrame;
+	up.transfer->records = (size_t)up.options.resumeFrame * up.options.frameRecords;
+	if (up.transfer->records > total)
+		up.transfer->records = total;
+
+	// the whole list is one turn on the link
+	int status = CFHandleLock(hComm, 0);
+	if (status != STAT_OK)
+		return status;
+	// a resumed upload is still in the update flow its BeginWhiteList started
+	if (up.options.resumeFrame == 0)
+		status = WhiteList_Begin(hComm, 0x01, total);
+	if (status == STAT_OK)
+	{
+		int fd = CFHandle_Fd(hComm);
+		status = fd < 0 ? WhiteList_UploadSequential(&up) : WhiteList_UploadPipelined(&up, fd);
+	}
+	if (status == STAT_OK)
+		status = WhiteList_End(hComm, &up.transfer->infoCount);
+	int unlock = CFHandleUnlock(hComm);
+	return status != STAT_OK ? status : unlock;
+}
+
+static int WhiteList_FileSource(void* ctx, size_t first, unsigned char* records, size_t count)
+{
+	WhiteListFile* file = (WhiteListFile*)ctx;
+	memcpy(records, file->data + first * WHITELIST_RECORD_LEN, count * WHITELIST_RECORD_LEN);
+	return STAT_OK;
+}
+
+int UploadWhiteListFile(int64_t hComm, const char* path, const WhiteListOptions* options, WhiteListTransfer* transfer)
+{
+	if (path == NULL)
+		return STAT_CMD_PARAM_ERR;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return STAT_CMD_PARAM_ERR;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size % WHITELIST_RECORD_LEN != 0)
+	{
+		close(fd);
+		return STAT_CMD_PARAM_ERR;
+	}
+
+	WhiteListFile file = { NULL };
+	size_t size = (size_t)st.st_size;
+	if (size > 0)
+	{
+		void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
+		{
+			close(fd);
+			return STAT_CMD_PARAM_ERR;
+		}
+		madvise(map, size, MADV_SEQUENTIAL);
+		file.data = (const unsigned char*)map;
+	}
+	close(fd);
+	int status = UploadWhiteListStream(hComm, WhiteList_FileSource, &file, size / WHITELIST_RECORD_LEN, options, transfer);
+	if (size > 0)
+		munmap((void*)file.data, size);
+	return status;
+}
+
+// One download frame: STATUS FRAMENUM INFOCOUNT CUSTOMERINFO[INFOCOUNT]. Sets done after the last one.
+static int WhiteList_Take(WhiteListSink sink, void* ctx, unsigned char status, unsigned short frameNum, size_t count,
+	const unsigned char* records, size_t total, unsigned short* expect, WhiteListTransfer* transfer, bool* done)
+{
+	if (status != WHITELIST_DATA_STATUS && status != 0x00 && status != 0xFF)
+		return CFFrame_Status(status);
+	if (status == 0xFF || count == 0)
+	{
+		*done = true;
+		return STAT_OK;
+	}
+	if (frameNum != *expect)
+		return STAT_CMD_RESP_FORMAT_ERR;
+	int result = sink(ctx, transfer->records, records, count);
+	if (result != STAT_OK)
+		return result;
+	(*expect)++;
+	transfer->records += count;
+	*done = transfer->records >= total;
+	return STAT_OK;
+}
+
+int DownloadWhiteListStream(int64_t hComm, WhiteListSink sink, void* ctx, const WhiteListOptions* options, WhiteListTransfer* transfer)
+{
+	WhiteListTransfer local;
+	WhiteListOptions opt;
+	if (transfer == NULL)
+		transfer = &local;
+	memset(transfer, 0, sizeof(*transfer));
+	if (sink == NULL || WhiteList_Options(options, &opt) != STAT_OK)
+		return STAT_CMD_PARAM_ERR;
+
+	int status = CFHandleLock(hComm, 0);
+	if (status != STAT_OK)
+		return status;
+	AccessInfo info;
+	memset(&info, 0, sizeof(info));
+	status = GetAccessInfo(hComm, &info);
+	if (status == STAT_OK)
+		status = WhiteList_Begin(hComm, 0x02, 0);
+	bool begun = status == STAT_OK;
+
+	size_t total = info.CUSTOMERCOUNT;
+	unsigned short expect = 0;
+	bool done = !begun || total == 0;
+	int fd = CFHandle_Fd(hComm);
+	CFStatsCtx* stats = &CFHandle_Get(hComm)->stats;
+	unsigned char frame[FRAME_LONG_MAX_LEN];
+	while (!done)
+	{
+		if (fd < 0)
+		{
+			WhiteList wl;
+			status = GetWhiteList(hComm, &wl, opt.timeout);
+			if (status == STAT_OK)
+				status = WhiteList_Take(sink, ctx, wl.STATUS, wl.FRAMENUM, wl.INFOCOUNT, wl.WHITELIST, total, &expect, transfer, &done);
+		}
+		else
+		{
+			// the records are handed over in place in the receive buffer. The payload is laid out as
+			// GetWhiteList copies it into a WhiteList, so both paths read the same fields.
+			struct timespec deadline;
+			CFFrame_Deadline(&deadline, opt.timeout);
+			size_t frameLen;
+			status = CFFrame_ReadLong(fd, frame, &frameLen, &deadline, stats);
+			if (status == (int)STAT_CMD_RESP_CRC_ERR || (status == STAT_OK && ((frame[2] << 8) | frame[3]) != FRAME_CMD_WHITELIST))
+				continue;
+			const unsigned char* payload = frame + FRAME_LONG_HEAD_LEN;
+			size_t len = status == STAT_OK ? frameLen - FRAME_LONG_HEAD_LEN - 2 : 0;
+			if (status == STAT_OK && len == 1)
+				status = WhiteList_Take(sink, ctx, payload[0], expect, 0, NULL, total, &expect, transfer, &done);
+			else if (status == STAT_OK)
+			{
+				size_t count = len > offsetof(WhiteList, INFOCOUNT) ? payload[offsetof(WhiteList, INFOCOUNT)] : 0;
+				if (len != offsetof(WhiteList, WHITELIST) + count * WHITELIST_RECORD_LEN)
+					status = STAT_CMD_RESP_FORMAT_ERR;
+				else
+				{
+					unsigned short frameNum;
+					memcpy(&frameNum, payload + offsetof(WhiteList, FRAMENUM), sizeof(frameNum));
+					status = WhiteList_Take(sink, ctx, payload[0], frameNum, count,
+						payload + offsetof(WhiteList, WHITELIST), total, &expect, transfer, &done);
+				}
+			}
+		}
+		if (status != STAT_OK)
+			break;
+		if (opt.progress != NULL)
+			opt.progress(opt.progressCtx, transfer->records, total);
+	}
+	// leave the transfer flow also after a failure, the reader would keep sending otherwise
+	if (begun)
+	{
+		int end = WhiteList_End(hComm, &transfer->infoCount);
+		if (status == STAT_OK)
+			status = end;
+	}
+	int unlock = CFHandleUnlock(hComm);
+	return status != STAT_OK ? status : unlock;
+}
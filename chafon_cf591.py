@@ -46,17 +46,24 @@ Author: Auto-generated from CHAFON CF591 SDK
 import ctypes
 import ctypes.util
 from ctypes import (
-    Structure, POINTER, c_int64, c_char_p, c_int, c_ubyte, c_ushort, 
-    c_short, c_ulong, c_uint, c_void_p, byref, sizeof, cast
+    Structure, POINTER, CFUNCTYPE, c_int64, c_uint64, c_char, c_char_p, c_int, c_ubyte, c_ushort, 
+    c_short, c_ulong, c_uint, c_double, c_void_p, c_size_t, byref, sizeof, cast
 )
 import os
 import sys
 import time
 import threading
-from typing import Optional, List, Dict, Generator, Callable, Any
+from contextlib import contextmanager
+from typing import Optional, List, Dict, Generator, Callable, Any, Tuple
 from enum import IntEnum
 from dataclasses import dataclass
 
+try:
+    # Native fast path for the inventory calls, built from API/Linux/python (see README)
+    import _cf591
+except ImportError:
+    _cf591 = None
+
 
 # ============================================================================
 # Constants and Error Codes
@@ -173,6 +180,422 @@ class TagResp(Structure):
     ]
 
 
+def _make_tag_info_compact(code_len: int = 12):
+    """Build the TagInfoCompact structure for the slot length libCFApiEx was built with"""
+    class TagInfoCompact(Structure):
+        """Compact tag record filled by GetTagUiiBatchCompact (libCFApiEx)"""
+        _fields_ = [
+            ("rssi", c_short),          # Signal strength (RSSI) in 0.1 dBm
+            ("arenaOff", c_ushort),     # Offset of long codes in TagCodeArena
+            ("antenna", c_ubyte),       # Antenna number
+            ("channel", c_ubyte),       # Frequency channel
+            ("codeLen", c_ubyte),       # EPC code length in bytes
+            ("pc", c_ubyte * 2),        # Protocol control bytes
+            ("crc", c_ubyte * 2),       # CRC bytes
+            ("code", c_ubyte * code_len)  # Inline EPC code slot
+        ]
+    return TagInfoCompact
+
+
+TagInfoCompact = _make_tag_info_compact()
+TAGCOMPACT_NO_ARENA = 0xFFFF
+
+
+class TagCodeArena(Structure):
+    """Overflow storage for codes longer than the TagInfoCompact slot"""
+    _fields_ = [
+        ("base", POINTER(c_ubyte)),
+        ("size", c_ushort),
+        ("used", c_ushort)
+    ]
+
+
+# void (*TagStreamCallback)(int64_t hComm, int status, const TagInfoCompact* tags,
+#                           size_t count, const TagCodeArena* arena, void* userCtx)
+TagStreamCallback = CFUNCTYPE(None, c_int64, c_int, c_void_p, c_size_t, POINTER(TagCodeArena), c_void_p)
+
+STREAM_PER_TAG = 0x01       # One callback per tag instead of per burst
+STREAM_NO_INVENTORY = 0x02  # Don't send InventoryContinue (reader reports on its own)
+
+# CFHandleLock flags
+HANDLE_PAUSE_INVENTORY = 0x01  # Also stop an inventory started with InventoryContinueEx
+
+RING_DEFAULT_SIZE = 1024    # Tags held by the InventoryStartRing ring when size is 0
+
+# CFHandleReserve flags
+RESERVE_VIEWS = 0x01  # Receive slots of GetReadTagRespView
+RESERVE_RING = 0x02   # Ring of InventoryStartRing
+
+
+SERIAL_OPT_LOW_LATENCY = 0x01    # ASYNC_LOW_LATENCY (+ 1 ms FTDI latency timer)
+SERIAL_OPT_EXCLUSIVE = 0x02      # TIOCEXCL, other opens of the port fail
+SERIAL_OPT_VMIN_VTIME = 0x04     # Apply vmin / vtime
+SERIAL_OPT_LATENCY_TIMER = 0x08  # FTDI latency timer was written (LinkStats.applied)
+
+
+class SerialOptions(Structure):
+    """Options of OpenDeviceEx (libCFApiEx)"""
+    _fields_ = [
+        ("flags", c_uint),
+        ("vmin", c_ubyte),
+        ("vtime", c_ubyte),          # 0.1 s
+        ("latencyTimer", c_ubyte)    # FTDI latency timer in ms, 0 keeps adapter setting
+    ]
+
+
+class LinkStats(Structure):
+    """Link byte counters and throughput (libCFApiEx)"""
+    _fields_ = [
+        ("rxBytes", c_uint64),
+        ("txBytes", c_uint64),
+        ("elapsedMs", c_uint),
+        ("rxRate", c_uint),          # Bytes per second since the previous call
+        ("txRate", c_uint),
+        ("baudRate", c_uint),        # Rate the tty is really set to
+        ("applied", c_uint)          # SERIAL_OPT_* that took effect
+    ]
+
+
+class TagReadView(Structure):
+    """Read response lent out of the libCFApiEx receive slot (no copy)"""
+    _fields_ = [
+        ("frame", POINTER(c_ubyte)),
+        ("frameLen", c_ushort),
+        ("tagStatus", c_ubyte),
+        ("antenna", c_ubyte),
+        ("crcOff", c_ushort),
+        ("pcOff", c_ushort),
+        ("codeOff", c_ushort),
+        ("codeLen", c_ubyte),
+        ("dataOff", c_ushort),       # Read data, dataLen bytes
+        ("dataLen", c_ushort),
+        ("slot", c_int)
+    ]
+
+
+class TagRingStats(Structure):
+    """Counters of a libCFApiEx tag ring"""
+    _fields_ = [
+        ("pushed", c_uint64),       # Tags written by the reader thread
+        ("popped", c_uint64),       # Tags taken by the consumer
+        ("overflow", c_uint64),     # Tags dropped because the ring was full
+        ("truncated", c_uint64),    # Long EPCs cut to the inline slot
+        ("capacity", c_size_t),
+        ("used", c_size_t)
+    ]
+
+
+DEDUP_ANY_ANTENNA = 0x01   # One dedup entry per tag across all antennas
+DEDUP_NO_ARRIVE = 0x02     # Only report tags once they leave
+
+DEDUP_ARRIVE = 1           # First read of the tag in its window
+DEDUP_DEPART = 2           # Not read for window_ms
+DEDUP_EVICT = 3            # Dropped to make room (max_entries reached)
+DEDUP_FLUSH = 4            # Inventory ended with the tag still present
+
+
+class TagDedupConfig(Structure):
+    """Configuration of a libCFApiEx dedup cache"""
+    _fields_ = [
+        ("windowMs", c_uint),
+        ("maxEntries", c_uint),
+        ("flags", c_uint)
+    ]
+
+
+def _make_tag_sighting(tag_type):
+    """Build the TagSighting structure around the TagInfoCompact of libCFApiEx"""
+    class TagSighting(Structure):
+        """One deduplicated tag reported by the dedup cache (libCFApiEx)"""
+        _fields_ = [
+            ("event", c_int),           # DEDUP_*
+            ("tag", tag_type),          # Last read
+            ("code", POINTER(c_ubyte)), # Full EPC code
+            ("codeLen", c_ubyte),
+            ("antenna", c_ubyte),
+            ("peakRssi", c_short),      # 0.1 dBm
+            ("count", c_uint),          # Reads since the tag arrived
+            ("firstSeenMs", c_uint64),  # CLOCK_MONOTONIC ms
+            ("lastSeenMs", c_uint64)
+        ]
+    return TagSighting
+
+
+# void (*TagSightingCallback)(const TagSighting* sighting, void* userCtx)
+TagSightingCallback = CFUNCTYPE(None, c_void_p, c_void_p)
+
+
+JOURNAL_CODE_MAX = 40                      # EPC bytes a journal record keeps
+JOURNAL_TIME_MAX = 0xFFFFFFFFFFFFFFFF      # to_us of a query without an upper bound
+
+
+class TagJournalConfig(Structure):
+    """Configuration of a libCFApiEx tag event journal (0 selects the default)"""
+    _fields_ = [
+        ("segmentRecords", c_uint),
+        ("maxSegments", c_uint),
+        ("indexStride", c_uint)
+    ]
+
+
+class JournalRecord(Structure):
+    """One read event of a tag event journal (libCFApiEx)"""
+    _fields_ = [
+        ("timeUs", c_uint64),       # CLOCK_REALTIME us
+        ("source", c_uint),         # Reader id given to start_journal()
+        ("chain", c_uint),
+        ("rssi", c_short),          # 0.1 dBm
+        ("antenna", c_ubyte),
+        ("channel", c_ubyte),
+        ("codeLen", c_ubyte),       # Full EPC length, the first JOURNAL_CODE_MAX bytes are kept
+        ("pc", c_ubyte * 2),
+        ("reserved", c_ubyte),
+        ("code", c_ubyte * JOURNAL_CODE_MAX)
+    ]
+
+
+# int (*JournalRecordCallback)(const JournalRecord* record, void* userCtx)
+JournalRecordCallback = CFUNCTYPE(c_int, POINTER(JournalRecord), c_void_p)
+
+
+PRESENCE_ZONES = 16        # Zones of a presence engine
+PRESENCE_ANTENNAS = 16     # Antennas it tracks
+
+ZONE_ENTER = 1             # Tag got into the zone
+ZONE_EXIT = 2              # Tag left the zone (RSSI, timeout, eviction or end of inventory)
+ZONE_DIRECTION = 3         # Tag moved from from_zone into zone
+
+ZONE_DIR_IN = 1            # To a higher zone number (zones are numbered from the outside in)
+ZONE_DIR_OUT = 2           # To a lower zone number
+
+
+class TagPresenceConfig(Structure):
+    """Configuration of a libCFApiEx presence engine, RSSI in 0.1 dBm (0 selects the default)"""
+    _fields_ = [
+        ("zoneCount", c_uint),
+        ("zoneAntennas", c_ushort * PRESENCE_ZONES),  # Bit 0 = antenna 1
+        ("enterRssi", c_short * PRESENCE_ANTENNAS),
+        ("hysteresis", c_ushort),
+        ("smoothPercent", c_uint),
+        ("exitMs", c_uint),
+        ("directionMs", c_uint),
+        ("maxTags", c_uint)
+    ]
+
+
+class ZoneEvent(Structure):
+    """One zone change of a tag reported by the presence engine (libCFApiEx)"""
+    _fields_ = [
+        ("event", c_int),           # ZONE_*
+        ("zone", c_uint),
+        ("fromZone", c_uint),       # ZONE_DIRECTION
+        ("direction", c_int),       # ZONE_DIR_*
+        ("code", POINTER(c_ubyte)),
+        ("codeLen", c_ubyte),
+        ("antenna", c_ubyte),       # 0 for a timeout
+        ("rssi", c_short),          # Smoothed, 0.1 dBm
+        ("timeMs", c_uint64),       # CLOCK_MONOTONIC ms
+        ("enteredMs", c_uint64)     # ZONE_EXIT
+    ]
+
+
+# void (*ZoneEventCallback)(const ZoneEvent* event, void* userCtx)
+ZoneEventCallback = CFUNCTYPE(None, POINTER(ZoneEvent), c_void_p)
+
+
+MERGE_CODE_MAX = 64        # EPC bytes a cross-reader dedup entry keeps
+
+MERGE_ARRIVE = 1           # First read of the tag on any reader
+MERGE_HANDOFF = 2          # Another reader took the tag over
+MERGE_DEPART = 3           # No reader read the tag for depart_ms
+MERGE_EVICT = 4            # Dropped to make room (max_tags reached)
+MERGE_FLUSH = 5            # TagMerger.flush()
+
+
+class TagMergeConfig(Structure):
+    """Configuration of a libCFApiEx cross-reader dedup table (0 selects the default)"""
+    _fields_ = [
+        ("windowMs", c_uint),
+        ("departMs", c_uint),
+        ("hysteresis", c_ushort),   # 0.1 dB
+        ("maxTags", c_uint),
+        ("shards", c_uint),
+        ("ringSize", c_size_t)
+    ]
+
+
+class TagMergeEvent(Structure):
+    """One owner change of a tag reported by a TagMerger (libCFApiEx)"""
+    _fields_ = [
+        ("event", c_int),           # MERGE_*
+        ("hComm", c_int64),         # Owner after the event
+        ("fromHComm", c_int64),     # MERGE_HANDOFF: previous owner
+        ("rssi", c_short),          # Peak of the owner within the window, 0.1 dBm
+        ("fromRssi", c_short),
+        ("antenna", c_ubyte),
+        ("readers", c_ubyte),       # Readers that read the tag within the window
+        ("codeLen", c_ubyte),
+        ("code", c_ubyte * MERGE_CODE_MAX),
+        ("count", c_uint),          # Reads on all readers since MERGE_ARRIVE
+        ("firstMs", c_uint64),      # CLOCK_MONOTONIC ms
+        ("timeMs", c_uint64)
+    ]
+
+
+class TagMergeStats(Structure):
+    """Counters of a TagMerger"""
+    _fields_ = [
+        ("reads", c_uint64),
+        ("events", c_uint64),
+        ("handoffs", c_uint64),
+        ("overflow", c_uint64),     # Events dropped because nobody popped them
+        ("contended", c_uint64),    # Feeds that waited for the lock of their shard
+        ("tags", c_size_t),
+        ("queued", c_size_t)
+    ]
+
+
+TRIGGER_HOST = 0x00        # The host starts a bounded inventory on the trigger
+TRIGGER_GPIO = 0x01        # The reader's GPI starts its own inventory (trigger work mode)
+
+
+class TriggerConfig(Structure):
+    """Armed trigger read configuration of libCFApiEx (0 selects the default)"""
+    _fields_ = [
+        ("source", c_ubyte),        # TRIGGER_*
+        ("level", c_ubyte),         # TRIGGER_GPIO: 1 high level, 0 low level
+        ("triggerTime", c_ubyte),   # TRIGGER_GPIO: seconds of inventory per trigger
+        ("cycles", c_ubyte)         # TRIGGER_HOST: inventory rounds per start
+    ]
+
+
+class TriggerResult(Structure):
+    """Timing of the tag returned by an armed trigger read"""
+    _fields_ = [
+        ("triggerUs", c_uint64),    # CLOCK_MONOTONIC us, 0 for TRIGGER_GPIO
+        ("tagUs", c_uint64),
+        ("latencyUs", c_uint),      # Trigger to tag, 0 for TRIGGER_GPIO
+        ("rounds", c_uint),         # Inventories started until a tag came back
+        ("skipped", c_uint)         # Frames dropped (bad CRC, previous trigger, ...)
+    ]
+
+
+COMMISSION_EPC_MAX = 30            # Bytes of a new EPC
+COMMISSION_STEP_SINGULATE = 1      # CommissionResult.step: read the PC of the selected tag
+COMMISSION_STEP_WRITE = 2          # Write the EPC (and the PC if the length changes)
+COMMISSION_STEP_VERIFY = 3         # Read PC and EPC back through the new EPC
+COMMISSION_STEP_LOCK = 4           # LockTag of every area of lockAreas
+COMMISSION_STEP_DONE = 5
+COMMISSION_FIXED_DEPTH = 0x01      # CommissionConfig.flags: keep the op queue depth of the handle
+
+
+class CommissionJob(Structure):
+    """One tag for CFCommissionRun"""
+    _fields_ = [
+        ("maskBits", c_ubyte),      # Leading bits of the current EPC, 0 for the first tag answering
+        ("mask", c_ubyte * 32),
+        ("epcLen", c_ubyte),        # Even, 2..COMMISSION_EPC_MAX
+        ("epc", c_ubyte * COMMISSION_EPC_MAX),
+        ("accPwd", c_ubyte * 4),
+        ("lockAreas", c_ubyte),     # Bit (1 << LockArea) per area to lock
+        ("lockAction", c_ubyte),    # LockAction of every area
+        ("jobCtx", c_void_p)
+    ]
+
+
+class CommissionConfig(Structure):
+    """CFCommissionRun configuration (0 selects the default)"""
+    _fields_ = [
+        ("window", c_uint),         # Jobs in progress at once, 16
+        ("retries", c_uint),        # Retries per step, 3
+        ("retryDelayMs", c_ushort), # Pause after low power failures, 20
+        ("timeout", c_ushort),      # Milliseconds per response, DEF_WRITE_TIMEOUT
+        ("flags", c_uint)           # COMMISSION_FIXED_DEPTH
+    ]
+
+
+class CommissionResult(Structure):
+    """Outcome of one commissioning job, oldCode is only valid during the callback"""
+    _fields_ = [
+        ("index", c_size_t),
+        ("status", c_int),
+        ("step", c_ubyte),          # COMMISSION_STEP_DONE or the step that failed
+        ("antenna", c_ubyte),
+        ("oldPc", c_ubyte * 2),
+        ("oldCodeLen", c_ubyte),
+        ("oldCode", POINTER(c_ubyte)),
+        ("attempts", c_uint),
+        ("retries", c_uint),
+        ("elapsedUs", c_uint)
+    ]
+
+
+class CommissionStats(Structure):
+    """Totals of one CFCommissionRun"""
+    _fields_ = [
+        ("jobs", c_size_t),
+        ("commissioned", c_size_t),
+        ("failed", c_size_t),
+        ("ops", c_uint64),
+        ("retries", c_uint64),
+        ("lowPower", c_uint64),
+        ("noResp", c_uint64),
+        ("lost", c_uint64),         # Answers that never came
+        ("passes", c_uint),
+        ("depth", c_uint),          # Op queue depth the run ended with
+        ("elapsedMs", c_uint64),
+        ("perMinute", c_uint)
+    ]
+
+
+CommissionCallback = CFUNCTYPE(None, c_int64, POINTER(CommissionJob), POINTER(CommissionResult), c_void_p)
+
+
+DISCOVER_HID = 0x01        # OpenHidConnection readers
+DISCOVER_SERIAL = 0x02     # /dev/ttyUSB* and /dev/ttyACM* ports
+DISCOVER_NET = 0x04        # Hosts answering the UDP broadcast probe
+
+DISCOVER_VERIFY = 0x01     # Probe serial ports the cache already knows
+DISCOVER_ALL_PORTS = 0x02  # Also report serial ports that are no reader
+
+DISCOVER_CACHED = 0x01     # Result taken from the cache without a probe
+DISCOVER_READER = 0x02     # Answered GetInfo (or is a cached reader)
+DISCOVER_TIMEOUT = 0x04    # Probe still running at the deadline
+
+
+class DiscoverOptions(Structure):
+    """Settings of CFDiscoverAll (libCFApiEx)"""
+    _fields_ = [
+        ("kinds", c_uint),
+        ("flags", c_uint),
+        ("timeoutMs", c_uint),
+        ("baudRate", c_int),
+        ("vendorId", c_ushort),
+        ("productId", c_ushort),
+        ("cacheFile", c_char_p),
+        ("netUdpPort", c_ushort),
+        ("netTcpPort", c_ushort),
+        ("netProbe", c_char_p),
+        ("netProbeLen", c_ushort)
+    ]
+
+
+class DiscoverResult(Structure):
+    """One reader found by CFDiscoverAll (libCFApiEx)"""
+    _fields_ = [
+        ("kind", c_ubyte),
+        ("flags", c_ubyte),
+        ("vendorId", c_ushort),
+        ("productId", c_ushort),
+        ("index", c_ushort),
+        ("port", c_ushort),
+        ("status", c_int),
+        ("path", c_char * 128),
+        ("serial", c_char * 64),
+        ("sn", c_ubyte * 12)
+    ]
+
+
 class DeviceInfo(Structure):
     """Device information structure"""
     _fields_ = [
@@ -376,6 +799,25 @@ class Tag:
             sequence=tag_info.NO
         )
     
+    @classmethod
+    def from_compact(cls, tag: 'TagInfoCompact', arena: bytes = b'') -> 'Tag':
+        """Create Tag from a TagInfoCompact record and its overflow arena"""
+        if tag.arenaOff != TAGCOMPACT_NO_ARENA:
+            epc_bytes = arena[tag.arenaOff:tag.arenaOff + tag.codeLen]
+        else:
+            epc_bytes = bytes(tag.code[:tag.codeLen])
+        return cls(
+            epc=epc_bytes.hex().upper(),
+            epc_bytes=epc_bytes,
+            rssi=tag.rssi / 10.0,
+            antenna=tag.antenna,
+            channel=tag.channel,
+            crc=bytes(tag.crc).hex().upper(),
+            pc=bytes(tag.pc).hex().upper(),
+            length=tag.codeLen,
+            sequence=0
+        )
+    
     def to_dict(self) -> Dict[str, Any]:
         """Convert to dictionary"""
         return {
@@ -422,36 +864,36 @@ class TagError(CF591Error):
 # Library Loader
 # ============================================================================
 
-def _load_library():
-    """Load the libCFApi.so shared library"""
+def _find_library(name: str):
+    """Load a shared library by name from the system path or the API/Linux tree"""
     # First, try loading by name (works if in system library path)
     # This is the most reliable method when library is properly installed
     try:
-        return ctypes.CDLL('libCFApi.so')
+        return ctypes.CDLL(name)
     except OSError:
         pass
     
     # Then try explicit paths
     lib_paths = [
-        '/usr/local/lib/libCFApi.so',
-        '/usr/lib/libCFApi.so',
-        '/usr/lib/aarch64-linux-gnu/libCFApi.so',  # Debian/Ubuntu ARM64 path
-        '/usr/lib/arm-linux-gnueabihf/libCFApi.so',  # Debian/Ubuntu ARM path
+        f'/usr/local/lib/{name}',
+        f'/usr/lib/{name}',
+        f'/usr/lib/aarch64-linux-gnu/{name}',  # Debian/Ubuntu ARM64 path
+        f'/usr/lib/arm-linux-gnueabihf/{name}',  # Debian/Ubuntu ARM path
     ]
     
     # Add relative paths based on script location
     script_dir = os.path.dirname(os.path.abspath(__file__))
     lib_paths.extend([
-        os.path.join(script_dir, 'API/Linux/ARM64/libCFApi.so'),
-        os.path.join(script_dir, 'API/Linux/ARM/libCFApi.so'),
-        os.path.join(os.getcwd(), 'API/Linux/ARM64/libCFApi.so'),
-        os.path.join(os.getcwd(), 'API/Linux/ARM/libCFApi.so'),
-        './API/Linux/ARM64/libCFApi.so',
-        './API/Linux/ARM/libCFApi.so',
+        os.path.join(script_dir, f'API/Linux/ARM64/{name}'),
+        os.path.join(script_dir, f'API/Linux/ARM/{name}'),
+        os.path.join(os.getcwd(), f'API/Linux/ARM64/{name}'),
+        os.path.join(os.getcwd(), f'API/Linux/ARM/{name}'),
+        f'./API/Linux/ARM64/{name}',
+        f'./API/Linux/ARM/{name}',
     ])
     
     # Try find_library (may return None or partial path)
-    found_lib = ctypes.util.find_library('CFApi')
+    found_lib = ctypes.util.find_library(name[3:-3])
     if found_lib:
         lib_paths.append(found_lib)
     
@@ -465,10 +907,31 @@ def _load_library():
     
     # Final attempt: try with RTLD_GLOBAL flag (sometimes needed)
     try:
-        return ctypes.CDLL('libCFApi.so', mode=ctypes.RTLD_GLOBAL)
+        return ctypes.CDLL(name, mode=ctypes.RTLD_GLOBAL)
     except (OSError, AttributeError):
         pass
     
+    return None
+
+
+def _load_library():
+    """
+    Load the CFApi library
+    
+    Prefers libCFApiEx.so (host-side extensions, see README) which links
+    libCFApi.so and exports its symbols as well, so one handle serves both.
+    
+    Returns:
+        (library, has_extensions)
+    """
+    lib = _find_library('libCFApiEx.so')
+    if lib is not None:
+        return lib, True
+    
+    lib = _find_library('libCFApi.so')
+    if lib is not None:
+        return lib, False
+    
     raise OSError(
         "Could not find libCFApi.so. Please install it:\n"
         "  For Raspberry Pi 5 (ARM64):\n"
@@ -527,8 +990,10 @@ class CF591Reader:
             baud_rate: Baud rate (default: 115200)
             auto_connect: Whether to connect automatically on init
         """
-        self._lib = _load_library()
+        self._lib, self._has_ext = _load_library()
         self._setup_functions()
+        if self._has_ext:
+            self._setup_ext_functions()
         
         self.port = port
         self.baud_rate = baud_rate
@@ -536,6 +1001,20 @@ class CF591Reader:
         self._is_open = False
         self._is_inventory_running = False
         self._inventory_lock = threading.Lock()
+        self._batch_buf = None  # Reused TagInfoCompact array for get_tags()
+        self._arena_buf = None  # Overflow arena for codes longer than the compact slot
+        self._stream_cb = None  # Keeps the ctypes callback alive while streaming
+        self._ring_active = False  # Streaming into the InventoryStartRing ring
+        self._ring_buf = None   # Reused TagInfoCompact array for pop_ring()
+        self._tag_info = TagInfo()  # Reused by get_tag() without the native module
+        self._tag_resp = TagResp()  # Reused for the responses of read_tag() / write_tag()
+        self._dedup = None      # TagDedup of start_dedup(), destroyed by stop_streaming()
+        self._journal = None    # TagJournal of start_journal(), closed by stop_streaming()
+        self._presence = None   # TagPresence of start_presence(), destroyed by stop_streaming()
+        self._merge = None      # TagMerger of start_merged(), kept alive until stop_streaming()
+        self._trigger_armed = False  # arm_trigger() changed the reader, disarmed by close()
+        # The native module links libCFApiEx, it is only used together with it
+        self._native = _cf591 if self._has_ext else None
         
         if auto_connect:
             self.open()
@@ -711,14 +1190,162 @@ class CF591Reader:
         lib.SetPermissonPara.argtypes = [c_int64, PermissonPara]
         lib.SetPermissonPara.restype = c_int
     
+    def _setup_ext_functions(self):
+        """Setup C function signatures of the libCFApiEx host-side extensions"""
+        lib = self._lib
+        
+        lib.CloseDeviceEx.argtypes = [c_int64]
+        lib.CloseDeviceEx.restype = c_int
+        
+        # Batched inventory
+        lib.GetTagUiiBatch.argtypes = [c_int64, POINTER(TagInfo), c_size_t, POINTER(c_size_t), c_ushort]
+        lib.GetTagUiiBatch.restype = c_int
+        
+        # Compact tag records
+        lib.TagCompactCodeLen.argtypes = []
+        lib.TagCompactCodeLen.restype = c_int
+        self._tag_compact = _make_tag_info_compact(lib.TagCompactCodeLen())
+        
+        lib.GetTagUiiBatchCompact.argtypes = [
+            c_int64, POINTER(self._tag_compact), c_size_t, POINTER(c_size_t),
+            POINTER(TagCodeArena), c_ushort
+        ]
+        lib.GetTagUiiBatchCompact.restype = c_int
+        
+        # Streaming inventory
+        lib.InventoryStartStreaming.argtypes = [c_int64, TagStreamCallback, c_void_p, c_uint]
+        lib.InventoryStartStreaming.restype = c_int
+        
+        lib.InventoryStopStreaming.argtypes = [c_int64, c_ushort]
+        lib.InventoryStopStreaming.restype = c_int
+        
+        # Lock-free tag ring
+        lib.InventoryStartRing.argtypes = [c_int64, c_size_t, c_uint]
+        lib.InventoryStartRing.restype = c_int
+        
+        lib.TagRingPop.argtypes = [c_int64, POINTER(self._tag_compact), c_size_t, POINTER(c_size_t), c_ushort]
+        lib.TagRingPop.restype = c_int
+        
+        lib.TagRingGetStats.argtypes = [c_int64, POINTER(TagRingStats)]
+        lib.TagRingGetStats.restype = c_int
+        
+        # Serial link options
+        lib.OpenDeviceEx.argtypes = [POINTER(c_int64), c_char_p, c_int, POINTER(SerialOptions)]
+        lib.OpenDeviceEx.restype = c_int
+        
+        lib.GetLinkStats.argtypes = [c_int64, POINTER(LinkStats)]
+        lib.GetLinkStats.restype = c_int
+        
+        # Zero-copy read responses
+        lib.GetReadTagRespView.argtypes = [c_int64, POINTER(TagReadView), c_ushort]
+        lib.GetReadTagRespView.restype = c_int
+        
+        lib.ReleaseTagReadView.argtypes = [c_int64, POINTER(TagReadView)]
+        lib.ReleaseTagReadView.restype = c_int
+        
+        # Per-handle buffers up front, setters taking their block by pointer
+        lib.CFHandleReserve.argtypes = [c_int64, c_size_t, c_uint]
+        lib.CFHandleReserve.restype = c_int
+        
+        for name, param in (('SetDevicePara', DevicePara), ('SetAntPower', AntPower),
+                            ('SetGpioPara', GpioPara), ('SetGPIOWorkParam', GPIOWorkParam),
+                            ('SetNetInfo', NetInfo), ('SetwifiPara', WiFiPara),
+                            ('SetHeartbeat', Heartbeat), ('SetPermissonPara', PermissonPara)):
+            func = getattr(lib, name + '_Ptr')
+            func.argtypes = [c_int64, POINTER(param)]
+            func.restype = c_int
+        
+        # Tag dedup cache
+        self._tag_sighting = _make_tag_sighting(self._tag_compact)
+        
+        lib.TagDedupCreate.argtypes = [POINTER(TagDedupConfig)]
+        lib.TagDedupCreate.restype = c_void_p
+        
+        lib.TagDedupDestroy.argtypes = [c_void_p]
+        lib.TagDedupDestroy.restype = None
+        
+        lib.InventoryStartDedup.argtypes = [c_int64, c_void_p, TagSightingCallback, c_void_p, c_uint]
+        lib.InventoryStartDedup.restype = c_int
+        
+        # Tag event journal
+        lib.TagJournalOpen.argtypes = [c_char_p, POINTER(TagJournalConfig)]
+        lib.TagJournalOpen.restype = c_void_p
+        
+        lib.TagJournalClose.argtypes = [c_void_p]
+        lib.TagJournalClose.restype = None
+        
+        lib.InventoryStartJournal.argtypes = [c_int64, c_void_p, c_uint, c_void_p, c_void_p, c_uint]
+        lib.InventoryStartJournal.restype = c_int
+        
+        # Presence / zone engine
+        lib.TagPresenceConfigFromRssiPara.argtypes = [POINTER(TagPresenceConfig), POINTER(RssiPara)]
+        lib.TagPresenceConfigFromRssiPara.restype = c_int
+        
+        lib.TagPresenceCreate.argtypes = [POINTER(TagPresenceConfig)]
+        lib.TagPresenceCreate.restype = c_void_p
+        
+        lib.TagPresenceDestroy.argtypes = [c_void_p]
+        lib.TagPresenceDestroy.restype = None
+        
+        lib.InventoryStartPresence.argtypes = [c_int64, c_void_p, ZoneEventCallback, c_void_p, c_uint]
+        lib.InventoryStartPresence.restype = c_int
+        
+        # Cross-reader dedup (the table itself is managed by TagMerger)
+        lib.InventoryStartMerged.argtypes = [c_int64, c_void_p, c_uint]
+        lib.InventoryStartMerged.restype = c_int
+        
+        # Armed trigger-to-first-tag reads
+        lib.CFTriggerArm.argtypes = [c_int64, POINTER(TriggerConfig)]
+        lib.CFTriggerArm.restype = c_int
+        
+        lib.CFTriggerWaitTag.argtypes = [c_int64, c_int, POINTER(TagInfo), POINTER(TriggerResult), c_ushort]
+        lib.CFTriggerWaitTag.restype = c_int
+        
+        lib.CFTriggerDisarm.argtypes = [c_int64]
+        lib.CFTriggerDisarm.restype = c_int
+        
+        # Batched commissioning
+        lib.CFCommissionRun.argtypes = [c_int64, POINTER(CommissionJob), c_size_t, POINTER(CommissionConfig),
+                                        CommissionCallback, c_void_p, POINTER(CommissionStats)]
+        lib.CFCommissionRun.restype = c_int
+        
+        # Per-handle command sequencing
+        lib.InventoryContinueEx.argtypes = [c_int64, c_ubyte, c_ulong]
+        lib.InventoryContinueEx.restype = c_int
+        
+        lib.CFHandleLock.argtypes = [c_int64, c_uint]
+        lib.CFHandleLock.restype = c_int
+        
+        lib.CFHandleUnlock.argtypes = [c_int64]
+        lib.CFHandleUnlock.restype = c_int
+        
+        # Capture and replay of the byte stream
+        lib.CFCaptureStart.argtypes = [c_int64, c_char_p]
+        lib.CFCaptureStart.restype = c_int
+        
+        lib.CFCaptureStop.argtypes = [c_int64]
+        lib.CFCaptureStop.restype = c_int
+        
+        lib.OpenReplayDevice.argtypes = [POINTER(c_int64), c_char_p, c_double]
+        lib.OpenReplayDevice.restype = c_int
+    
     # ========================================================================
     # Connection Methods
     # ========================================================================
     
-    def open(self) -> bool:
+    def open(self, low_latency: bool = False, exclusive: bool = False,
+             latency_timer: int = 0) -> bool:
         """
         Open connection to the RFID reader via serial port
         
+        The options need libCFApiEx (OpenDeviceEx) and are ignored without it.
+        
+        Args:
+            low_latency: Low-latency mode of the USB-serial adapter
+                         (removes the 16 ms FTDI latency timer jitter)
+            exclusive: Lock the port against other processes (TIOCEXCL)
+            latency_timer: FTDI latency timer in ms (0 keeps the adapter setting)
+        
         Returns:
             True if connection successful
             
@@ -729,7 +1356,14 @@ class CF591Reader:
             return True
         
         port_bytes = self.port.encode('utf-8')
-        result = self._lib.OpenDevice(byref(self._handle), port_bytes, self.baud_rate)
+        flags = ((SERIAL_OPT_LOW_LATENCY if low_latency else 0) |
+                 (SERIAL_OPT_EXCLUSIVE if exclusive else 0))
+        if self._has_ext and (flags or latency_timer):
+            options = SerialOptions(flags, 0, 0, latency_timer)
+            result = self._lib.OpenDeviceEx(byref(self._handle), port_bytes, self.baud_rate,
+                                            byref(options))
+        else:
+            result = self._lib.OpenDevice(byref(self._handle), port_bytes, self.baud_rate)
         
         if result != StatusCode.OK:
             raise ConnectionError(
@@ -767,6 +1401,57 @@ class CF591Reader:
         self._is_open = True
         return True
     
+    def open_replay(self, path: str, speed: float = 1.0) -> bool:
+        """
+        Open a capture file of start_capture() as the reader (libCFApiEx)
+        
+        The recorded reader bytes are played back; where the host wrote in the
+        capture, playback waits for the commands of this session.
+        
+        Args:
+            path: Capture file
+            speed: 1.0 for the recorded timing, N for N times faster, 0 for no pauses
+            
+        Returns:
+            True if the replay device was opened
+        """
+        if self._is_open:
+            return True
+        if not self._has_ext:
+            raise ConnectionError("Replay devices require libCFApiEx")
+        
+        result = self._lib.OpenReplayDevice(byref(self._handle), path.encode('utf-8'), c_double(speed))
+        if result != StatusCode.OK:
+            raise ConnectionError(f"Failed to open capture {path}", result)
+        
+        self._is_open = True
+        return True
+    
+    def start_capture(self, path: str):
+        """
+        Record the raw byte stream of the connection to path (libCFApiEx)
+        
+        HID connections record the inventory labels only.
+        
+        Args:
+            path: Capture file to create, played back by open_replay()
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Capture requires libCFApiEx")
+        
+        result = self._lib.CFCaptureStart(self._handle, path.encode('utf-8'))
+        self._check_result(result, f"Failed to start capture to {path}")
+    
+    def stop_capture(self):
+        """End the capture of start_capture()"""
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Capture requires libCFApiEx")
+        
+        result = self._lib.CFCaptureStop(self._handle)
+        self._check_result(result, "Failed to stop capture")
+    
     def close(self):
         """Close connection to the RFID reader"""
         if not self._is_open:
@@ -779,7 +1464,27 @@ class CF591Reader:
             except:
                 pass
         
-        self._lib.CloseDevice(self._handle)
+        if self._has_ext:
+            if self._trigger_armed:
+                try:
+                    self.disarm_trigger()
+                except CommandError:
+                    pass
+            # Also stops a running stream and joins its reader thread
+            self._lib.CloseDeviceEx(self._handle)
+            self._stream_cb = None
+            self._merge = None
+            if self._dedup:
+                self._lib.TagDedupDestroy(self._dedup)
+                self._dedup = None
+            if self._journal:
+                self._lib.TagJournalClose(self._journal)
+                self._journal = None
+            if self._presence:
+                self._lib.TagPresenceDestroy(self._presence)
+                self._presence = None
+        else:
+            self._lib.CloseDevice(self._handle)
         self._handle = c_int64(-1)
         self._is_open = False
     
@@ -793,6 +1498,41 @@ class CF591Reader:
         if not self._is_open:
             raise ConnectionError("Reader is not open. Call open() first.")
     
+    def _set_param(self, name: str, param) -> int:
+        """Call setter name with param, by pointer when libCFApiEx is installed"""
+        if self._has_ext:
+            return getattr(self._lib, name + '_Ptr')(self._handle, byref(param))
+        return getattr(self._lib, name)(self._handle, param)
+    
+    @contextmanager
+    def command(self):
+        """
+        Run reader commands from another thread than the inventory one
+        
+        With libCFApiEx the link is taken for the block (CFHandleLock): inventory
+        calls of other threads wait between two polls, and a running inventory
+        is stopped for the block and continued after it, so no tag report comes
+        in between the responses. Without it the block runs as is.
+        
+        Example:
+            with reader.command():
+                reader.get_rf_power()
+        """
+        self._check_open()
+        if not self._has_ext:
+            yield
+            return
+        # a stream is stopped by the library itself, a plain inventory needs the flag
+        flags = HANDLE_PAUSE_INVENTORY if self._is_inventory_running and self._stream_cb is None \
+            and not self._ring_active else 0
+        result = self._lib.CFHandleLock(self._handle, c_uint(flags))
+        if (result & 0xFFFFFFFF) != StatusCode.OK:
+            raise CommandError("Failed to take the link", result)
+        try:
+            yield
+        finally:
+            self._lib.CFHandleUnlock(self._handle)
+    
     def _check_result(self, result: int, error_msg: str, 
                       ignore_codes: List[int] = None) -> int:
         """
@@ -921,7 +1661,7 @@ class CF591Reader:
         if 'buzzer_time' in kwargs:
             params.BUZZERTIME = kwargs['buzzer_time']
         
-        result = self._lib.SetDevicePara(self._handle, params)
+        result = self._set_param('SetDevicePara', params)
         if result != StatusCode.OK:
             raise CommandError("Failed to set device parameters", result)
     
@@ -990,7 +1730,7 @@ class CF591Reader:
         else:
             params.BUZZERTIME = 0
         
-        result = self._lib.SetDevicePara(self._handle, params)
+        result = self._set_param('SetDevicePara', params)
         if result != StatusCode.OK:
             raise CommandError("Failed to set buzzer settings", result)
     
@@ -1098,7 +1838,7 @@ class CF591Reader:
         for i, power in enumerate(power_values[:8]):
             ant_power.AntPower[i] = power
         
-        result = self._lib.SetAntPower(self._handle, ant_power)
+        result = self._set_param('SetAntPower', ant_power)
         
         if result != StatusCode.OK:
             raise CommandError("Failed to set antenna power", result)
@@ -1126,9 +1866,9 @@ class CF591Reader:
                     pass
                 self._is_inventory_running = False
             
-            result = self._lib.InventoryContinue(
-                self._handle, c_ubyte(inv_count), c_ulong(inv_param)
-            )
+            # the Ex call records the arguments, a paused inventory is continued with them
+            start = self._lib.InventoryContinueEx if self._has_ext else self._lib.InventoryContinue
+            result = start(self._handle, c_ubyte(inv_count), c_ulong(inv_param))
             
             # Convert signed error code to unsigned for comparison
             unsigned_result = result & 0xFFFFFFFF
@@ -1147,6 +1887,10 @@ class CF591Reader:
         """
         self._check_open()
         
+        if self._stream_cb is not None or self._ring_active:
+            self.stop_streaming(timeout)
+            return
+        
         with self._inventory_lock:
             if not self._is_inventory_running:
                 # Already stopped, nothing to do
@@ -1179,25 +1923,675 @@ class CF591Reader:
         """
         self._check_open()
         
-        tag_info = TagInfo()
-        result = self._lib.GetTagUii(self._handle, byref(tag_info), c_ushort(timeout))
+        if self._native:
+            result, fields = self._native.get_tag(self._handle.value, timeout)
+            tag = Tag(*fields) if fields else None
+        elif self._has_ext:
+            # a batch of one takes the turn on the link like every other libCFApiEx command
+            count = c_size_t(0)
+            result = self._lib.GetTagUiiBatch(self._handle, byref(self._tag_info), c_size_t(1),
+                                              byref(count), c_ushort(timeout))
+            tag = self._tag_info
+        else:
+            result = self._lib.GetTagUii(self._handle, byref(self._tag_info), c_ushort(timeout))
+            tag = self._tag_info
         
         # Convert signed error code to unsigned for comparison
         unsigned_result = result & 0xFFFFFFFF
         
         if unsigned_result == StatusCode.OK:
-            return Tag.from_tag_info(tag_info)
+            return tag if self._native else Tag.from_tag_info(tag)
         elif unsigned_result in (StatusCode.CMD_INVENTORY_STOP, StatusCode.CMD_COMM_TIMEOUT):
             return None
         else:
             raise CommandError("Failed to get tag", result)
     
+    def get_tags(self, max_count: int = 64, timeout: int = 1000) -> List[Tag]:
+        """
+        Get all tags already waiting in the inventory buffer in one call
+        
+        Blocks up to timeout only while no tag is buffered. Uses
+        GetTagUiiBatch when libCFApiEx is installed, otherwise falls back
+        to a single get_tag().
+        
+        Args:
+            max_count: Maximum number of tags to return
+            timeout: Timeout for the first tag in milliseconds
+            
+        Returns:
+            List of Tag objects (empty on timeout)
+        """
+        self._check_open()
+        
+        if not self._has_ext:
+            tag = self.get_tag(timeout=timeout)
+            return [tag] if tag else []
+        
+        if self._native:
+            return [Tag(*fields) for fields in self.get_tag_batch(max_count, timeout)]
+        
+        if self._batch_buf is None or len(self._batch_buf) < max_count:
+            self._batch_buf = (self._tag_compact * max_count)()
+            # room for at least one full 255-byte code, else a long EPC comes back as CMD_BUF_OVERFLOW
+            self._arena_buf = (c_ubyte * min(max(max_count * 32, 255), 0xFFFF))()
+        arena = TagCodeArena(cast(self._arena_buf, POINTER(c_ubyte)), len(self._arena_buf), 0)
+        count = c_size_t(0)
+        result = self._lib.GetTagUiiBatchCompact(
+            self._handle, self._batch_buf, c_size_t(max_count), byref(count),
+            byref(arena), c_ushort(timeout)
+        )
+        
+        # Convert signed error code to unsigned for comparison
+        unsigned_result = result & 0xFFFFFFFF
+        
+        if unsigned_result == StatusCode.OK:
+            overflow = bytes(self._arena_buf[:arena.used])
+            return [Tag.from_compact(self._batch_buf[i], overflow) for i in range(count.value)]
+        elif unsigned_result in (StatusCode.CMD_INVENTORY_STOP, StatusCode.CMD_COMM_TIMEOUT):
+            return []
+        else:
+            raise CommandError("Failed to get tags", result)
+    
+    def get_tag_batch(self, max_count: int = 64, timeout: int = 1000):
+        """
+        Get the tags waiting in the inventory buffer as one native TagBatch
+        
+        Requires the _cf591 module. The batch is a sequence of Tag field
+        tuples and exposes the TagInfoCompact records through the buffer
+        protocol, numpy.asarray(batch) gives a structured array without
+        building any Python object per tag (long EPCs: batch.arena).
+        
+        Args:
+            max_count: Maximum number of tags to return
+            timeout: Timeout for the first tag in milliseconds
+            
+        Returns:
+            _cf591.TagBatch (empty on timeout)
+        """
+        self._check_open()
+        if not self._native:
+            raise CommandError("Tag batches require the _cf591 module")
+        
+        result, batch = self._native.get_tags(self._handle.value, max_count, timeout)
+        
+        # Convert signed error code to unsigned for comparison
+        unsigned_result = result & 0xFFFFFFFF
+        
+        if unsigned_result in (StatusCode.OK, StatusCode.CMD_INVENTORY_STOP, StatusCode.CMD_COMM_TIMEOUT):
+            return batch
+        else:
+            raise CommandError("Failed to get tags", result)
+    
+    def start_streaming(self, callback: Callable[[List[Tag]], None], per_tag: bool = False,
+                        on_end: Optional[Callable[[int], None]] = None, flags: int = 0):
+        """
+        Start inventory with tags pushed from a library-owned reader thread
+        
+        Requires libCFApiEx. The callback runs on the reader thread as soon
+        as tags are decoded, there is no polling.
+        
+        Args:
+            callback: Called with a list of Tag objects (one per burst,
+                      or one tag per call with per_tag=True)
+            per_tag: Deliver each tag in its own callback
+            on_end: Called with the status code if the stream ends on its own
+                    (inventory finished, link lost)
+            flags: Extra STREAM_* flags
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Streaming inventory requires libCFApiEx")
+        
+        tag_type = self._tag_compact
+        
+        def _on_stream(handle, status, tags, count, arena, user_ctx):
+            try:
+                if (status & 0xFFFFFFFF) != StatusCode.OK:
+                    self._is_inventory_running = False
+                    if on_end:
+                        on_end(status & 0xFFFFFFFF)
+                    return
+                records = cast(tags, POINTER(tag_type * count)).contents
+                overflow = b''
+                if arena and arena.contents.used:
+                    overflow = ctypes.string_at(arena.contents.base, arena.contents.used)
+                callback([Tag.from_compact(records[i], overflow) for i in range(count)])
+            except Exception:
+                # Never let an exception unwind into the C reader thread
+                pass
+        
+        with self._inventory_lock:
+            if self._is_inventory_running:
+                raise CommandError("Inventory already running")
+            
+            self._stream_cb = TagStreamCallback(_on_stream)
+            result = self._lib.InventoryStartStreaming(
+                self._handle, self._stream_cb, None,
+                c_uint(flags | (STREAM_PER_TAG if per_tag else 0))
+            )
+            if (result & 0xFFFFFFFF) != StatusCode.OK:
+                self._stream_cb = None
+                raise CommandError("Failed to start streaming inventory", result)
+            
+            self._is_inventory_running = True
+    
+    def stop_streaming(self, timeout: int = 5000):
+        """
+        Stop streaming inventory and join the reader thread
+        
+        Args:
+            timeout: Timeout in milliseconds
+        """
+        self._check_open()
+        
+        with self._inventory_lock:
+            if self._stream_cb is None and not self._ring_active and not self._journal and not self._merge:
+                return
+            
+            result = self._lib.InventoryStopStreaming(self._handle, c_ushort(timeout))
+            self._stream_cb = None
+            self._ring_active = False
+            self._merge = None
+            if self._dedup:
+                # The reader thread is joined, nothing uses the cache any more
+                self._lib.TagDedupDestroy(self._dedup)
+                self._dedup = None
+            if self._journal:
+                self._lib.TagJournalClose(self._journal)
+                self._journal = None
+            if self._presence:
+                self._lib.TagPresenceDestroy(self._presence)
+                self._presence = None
+            self._is_inventory_running = False
+            
+            unsigned_result = result & 0xFFFFFFFF
+            if (unsigned_result != StatusCode.OK and
+                unsigned_result != StatusCode.CMD_COMM_TIMEOUT and
+                unsigned_result != StatusCode.CMD_INVENTORY_STOP):
+                raise CommandError("Failed to stop streaming inventory", result)
+    
+    def start_dedup(self, callback: Callable[[Dict[str, Any]], None], window_ms: int = 1000,
+                    max_entries: int = 4096, any_antenna: bool = False,
+                    arrive: bool = True, flags: int = 0):
+        """
+        Start streaming inventory through the native dedup cache
+        
+        Requires libCFApiEx. Instead of every repeat, each tag (per antenna
+        unless any_antenna) is reported when it arrives and once more when
+        it leaves, with its read count and peak RSSI. Stop with
+        stop_streaming().
+        
+        Args:
+            callback: Called on the reader thread with a dictionary with
+                      event (DEDUP_*), tag (last read, full EPC), count,
+                      peak_rssi, first_seen_ms, last_seen_ms
+            window_ms: A tag departs once it was not read for window_ms
+            max_entries: Tags tracked at once, the least recently read is
+                         evicted
+            any_antenna: One entry per tag across all antennas
+            arrive: Report DEDUP_ARRIVE events (False: departures only)
+            flags: Extra STREAM_* flags
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Tag dedup requires libCFApiEx")
+        
+        sighting_type = self._tag_sighting
+        
+        def _on_sighting(sighting, user_ctx):
+            try:
+                s = cast(sighting, POINTER(sighting_type)).contents
+                if s.event == DEDUP_FLUSH:
+                    self._is_inventory_running = False
+                code = ctypes.string_at(s.code, s.codeLen)
+                tag = Tag.from_compact(s.tag)
+                tag.epc, tag.epc_bytes, tag.length = code.hex().upper(), code, s.codeLen
+                callback({
+                    'event': s.event,
+                    'tag': tag,
+                    'count': s.count,
+                    'peak_rssi': s.peakRssi / 10.0,
+                    'first_seen_ms': s.firstSeenMs,
+                    'last_seen_ms': s.lastSeenMs
+                })
+            except Exception:
+                # Never let an exception unwind into the C reader thread
+                pass
+        
+        config = TagDedupConfig(window_ms, max_entries,
+                                (DEDUP_ANY_ANTENNA if any_antenna else 0) |
+                                (0 if arrive else DEDUP_NO_ARRIVE))
+        
+        with self._inventory_lock:
+            if self._is_inventory_running:
+                raise CommandError("Inventory already running")
+            
+            dedup = self._lib.TagDedupCreate(byref(config))
+            if not dedup:
+                raise CommandError("Invalid dedup configuration", StatusCode.CMD_PARAM_ERR)
+            
+            self._stream_cb = TagSightingCallback(_on_sighting)
+            result = self._lib.InventoryStartDedup(self._handle, dedup, self._stream_cb, None, c_uint(flags))
+            if (result & 0xFFFFFFFF) != StatusCode.OK:
+                self._stream_cb = None
+                self._lib.TagDedupDestroy(dedup)
+                raise CommandError("Failed to start dedup inventory", result)
+            
+            self._dedup = dedup
+            self._is_inventory_running = True
+    
+    def start_presence(self, callback: Callable[[Dict[str, Any]], None], zones: List[int],
+                       rssi_para: Optional[RssiPara] = None, enter_rssi: Optional[List[float]] = None,
+                       hysteresis: float = 0, exit_ms: int = 0, direction_ms: int = 0,
+                       smooth_percent: int = 0, max_tags: int = 0, flags: int = 0):
+        """
+        Start streaming inventory through the native presence / zone engine
+        
+        Requires libCFApiEx. The reader thread keeps a smoothed RSSI per tag
+        and antenna and reports zone changes instead of reads. Stop with
+        stop_streaming().
+        
+        Args:
+            callback: Called on the reader thread with a dictionary with
+                      event (ZONE_*), zone, from_zone, direction (ZONE_DIR_*),
+                      epc, antenna, rssi (dBm), time_ms, dwell_ms (ZONE_EXIT)
+            zones: Antenna mask of each zone (bit 0 = antenna 1), numbered from
+                   the outside in, e.g. [0x1, 0x2] for the two sides of a gate
+            rssi_para: RSSI filter calibration giving the thresholds
+                       (BasciRssi - AntDelta[i] dBm)
+            enter_rssi: Threshold per antenna in dBm, overrides rssi_para
+            hysteresis: dB below the threshold a tag must fall to leave (0: 3 dB)
+            exit_ms: Leave a zone when not read for this long (0: 1000)
+            direction_ms: Report a direction when the previous zone was left
+                          at most this long ago (0: 3000)
+            smooth_percent: Weight of a new read in the smoothed RSSI (0: 30)
+            max_tags: Tags tracked at once (0: 4096)
+            flags: Extra STREAM_* flags
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Presence engine requires libCFApiEx")
+        
+        config = TagPresenceConfig()
+        config.zoneCount = len(zones)
+        for z, mask in enumerate(zones[:PRESENCE_ZONES]):
+            config.zoneAntennas[z] = mask
+        if rssi_para is not None:
+            self._lib.TagPresenceConfigFromRssiPara(byref(config), byref(rssi_para))
+        for a, dbm in enumerate((enter_rssi or [])[:PRESENCE_ANTENNAS]):
+            config.enterRssi[a] = int(round(dbm * 10))
+        config.hysteresis = int(round(hysteresis * 10))
+        config.smoothPercent = smooth_percent
+        config.exitMs = exit_ms
+        config.directionMs = direction_ms
+        config.maxTags = max_tags
+        
+        def _on_event(event, user_ctx):
+            try:
+                e = event.contents
+                callback({
+                    'event': e.event,
+                    'zone': e.zone,
+                    'from_zone': e.fromZone,
+                    'direction': e.direction,
+                    'epc': ctypes.string_at(e.code, e.codeLen).hex().upper(),
+                    'antenna': e.antenna,
+                    'rssi': e.rssi / 10.0,
+                    'time_ms': e.timeMs,
+                    'dwell_ms': e.timeMs - e.enteredMs if e.event == ZONE_EXIT else 0
+                })
+            except Exception:
+                # Never let an exception unwind into the C reader thread
+                pass
+        
+        with self._inventory_lock:
+            if self._is_inventory_running:
+                raise CommandError("Inventory already running")
+            
+            presence = self._lib.TagPresenceCreate(byref(config))
+            if not presence:
+                raise CommandError("Invalid presence configuration", StatusCode.CMD_PARAM_ERR)
+            
+            self._stream_cb = ZoneEventCallback(_on_event)
+            result = self._lib.InventoryStartPresence(self._handle, presence, self._stream_cb, None, c_uint(flags))
+            if (result & 0xFFFFFFFF) != StatusCode.OK:
+                self._stream_cb = None
+                self._lib.TagPresenceDestroy(presence)
+                raise CommandError("Failed to start presence inventory", result)
+            
+            self._presence = presence
+            self._is_inventory_running = True
+    
+    def start_merged(self, merger: 'TagMerger', flags: int = 0):
+        """
+        Start streaming inventory into a cross-reader dedup table
+        
+        Requires libCFApiEx. Several readers stream into one TagMerger; the
+        reader with the strongest recent RSSI owns each tag and the merger
+        reports arrivals, handoffs and departures once for all of them.
+        Stop with stop_streaming() before closing the merger.
+        
+        Args:
+            merger: TagMerger shared by the readers
+            flags: Extra STREAM_* flags
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Cross-reader dedup requires libCFApiEx")
+        
+        with self._inventory_lock:
+            if self._is_inventory_running:
+                raise CommandError("Inventory already running")
+            
+            result = self._lib.InventoryStartMerged(self._handle, merger._merge, c_uint(flags))
+            if (result & 0xFFFFFFFF) != StatusCode.OK:
+                raise CommandError("Failed to start merged inventory", result)
+            
+            self._merge = merger
+            merger._readers[self._handle.value] = self
+            self._is_inventory_running = True
+    
+    def start_journal(self, directory: str, source: int = 0, segment_records: int = 0,
+                      max_segments: int = 0, flags: int = 0):
+        """
+        Start streaming inventory into a native tag event journal
+        
+        Requires libCFApiEx. Every read is appended by the reader thread as a
+        fixed-size record to memory-mapped segment files in directory, without
+        passing through Python. Read them back with query_journal(), also while
+        the journal is written. Stop with stop_streaming().
+        
+        Args:
+            directory: Journal directory, created if missing
+            source: Reader id stored in the records
+            segment_records: Records per segment file (0: 262144, 16 MiB)
+            max_segments: Segment files kept, the oldest is deleted (0: all)
+            flags: Extra STREAM_* flags
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Tag journal requires libCFApiEx")
+        
+        config = TagJournalConfig(segment_records, max_segments, 0)
+        
+        with self._inventory_lock:
+            if self._is_inventory_running:
+                raise CommandError("Inventory already running")
+            
+            journal = self._lib.TagJournalOpen(directory.encode('utf-8'), byref(config))
+            if not journal:
+                raise CommandError(f"Failed to open journal {directory}", StatusCode.CMD_PARAM_ERR)
+            
+            result = self._lib.InventoryStartJournal(self._handle, journal, c_uint(source), None, None, c_uint(flags))
+            if (result & 0xFFFFFFFF) != StatusCode.OK:
+                self._lib.TagJournalClose(journal)
+                raise CommandError("Failed to start journal inventory", result)
+            
+            self._journal = journal
+            self._is_inventory_running = True
+    
+    def arm_trigger(self, source: int = TRIGGER_HOST, level: int = 1, trigger_time: int = 0,
+                    cycles: int = 0):
+        """
+        Prime the reader for trigger reads taken with wait_trigger_tag()
+        
+        Requires libCFApiEx. Stops the inventory and discards what is queued
+        on the link. With TRIGGER_HOST each wait_trigger_tag() sends one
+        inventory of a few rounds that the reader ends by itself, so there is
+        no stop/start round trip per read; set the Q value to 0 for single tag
+        reads. TRIGGER_GPIO puts the reader in trigger work mode, its GPI then
+        starts the inventory; disarm_trigger() (or close()) restores the
+        previous work mode and GPIO parameters.
+        
+        Args:
+            source: TRIGGER_HOST or TRIGGER_GPIO
+            level: TRIGGER_GPIO: 1 for a high level, 0 for a low level trigger
+            trigger_time: TRIGGER_GPIO: seconds of inventory per trigger (0: 1)
+            cycles: TRIGGER_HOST: inventory rounds per trigger (0: 1)
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Trigger reads require libCFApiEx")
+        
+        config = TriggerConfig(source, level, trigger_time, cycles)
+        result = self._lib.CFTriggerArm(self._handle, byref(config))
+        if (result & 0xFFFFFFFF) != StatusCode.OK:
+            raise CommandError("Failed to arm trigger", result)
+        self._trigger_armed = True
+    
+    def wait_trigger_tag(self, timeout: int = 1000, trigger_fd: int = -1) -> Optional[Tuple[Tag, Dict[str, Any]]]:
+        """
+        Wait for the trigger and return the first tag that passes CRC
+        
+        Requires arm_trigger(). With TRIGGER_HOST the call itself is the
+        trigger, or trigger_fd becoming readable (a GPIO line, a socket ...;
+        it is not read). Tags still arriving for the previous trigger are
+        skipped.
+        
+        Args:
+            timeout: Milliseconds for the trigger and the tag together
+            trigger_fd: TRIGGER_HOST: descriptor to wait on, -1 for none
+            
+        Returns:
+            (Tag, timing) with latency_ms, rounds and skipped; None on timeout
+        """
+        self._check_open()
+        if not self._trigger_armed:
+            raise CommandError("Trigger is not armed", StatusCode.CMD_PARAM_ERR)
+        
+        timing = TriggerResult()
+        result = self._lib.CFTriggerWaitTag(self._handle, c_int(trigger_fd), byref(self._tag_info),
+                                            byref(timing), c_ushort(timeout))
+        unsigned_result = result & 0xFFFFFFFF
+        if unsigned_result == StatusCode.CMD_COMM_TIMEOUT:
+            return None
+        if unsigned_result != StatusCode.OK:
+            raise CommandError("Failed to wait for trigger tag", result)
+        return Tag.from_tag_info(self._tag_info), {
+            'latency_ms': timing.latencyUs / 1000.0 if timing.triggerUs else None,
+            'rounds': timing.rounds,
+            'skipped': timing.skipped,
+        }
+    
+    def disarm_trigger(self):
+        """Leave the armed state of arm_trigger(), restoring the reader parameters it changed"""
+        self._check_open()
+        if not self._trigger_armed:
+            return
+        self._trigger_armed = False
+        result = self._lib.CFTriggerDisarm(self._handle)
+        if (result & 0xFFFFFFFF) != StatusCode.OK:
+            raise CommandError("Failed to disarm trigger", result)
+    
+    def commission(self, jobs: List[Dict[str, Any]], window: int = 0, retries: int = 0,
+                   retry_delay_ms: int = 0, timeout: int = 0) -> Tuple[List[Dict[str, Any]], Dict[str, Any]]:
+        """
+        Write, verify and lock the EPCs of a batch of tags
+        
+        Requires libCFApiEx. Each job is one tag: its EPC is written (with a
+        new PC if the length changes), read back through the new EPC and the
+        areas in lock_areas are locked. The steps of up to window jobs are
+        pipelined on the link; a failure to answer, low power or a lost
+        response is retried. Unlike a loop of write_tag_epc() the tag is
+        selected per job, so the selectors must pick different tags.
+        
+        Args:
+            jobs: Dicts with 'epc' (bytes), 'select' (bytes of the current EPC,
+                  omitted for the first tag answering), 'select_bits'
+                  (default 8 * len(select)), 'password', 'lock_areas'
+                  (LockArea list) and 'lock_action' (LockAction)
+            window: Jobs in progress at once (0: 16)
+            retries: Retries per step (0: 3)
+            retry_delay_ms: Pause after low power failures (0: 20)
+            timeout: Milliseconds per response (0: DEF_WRITE_TIMEOUT)
+            
+        Returns:
+            (results, stats): one dict per job in completion order with
+            index, status, step, old_epc, attempts, retries and elapsed_ms
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Commissioning requires libCFApiEx")
+        
+        array = (CommissionJob * max(len(jobs), 1))()
+        for i, job in enumerate(jobs):
+            entry = array[i]
+            epc = bytes(job['epc'])
+            select = bytes(job.get('select', b''))
+            if len(epc) > COMMISSION_EPC_MAX or len(select) > 32:
+                raise CommandError(f"Commission job {i} is too long", StatusCode.CMD_PARAM_ERR)
+            entry.epcLen = len(epc)
+            entry.epc[:len(epc)] = list(epc)
+            entry.maskBits = job.get('select_bits', 8 * len(select))
+            entry.mask[:len(select)] = list(select)
+            entry.accPwd[:] = list(bytes(job.get('password') or bytes(4)))
+            entry.lockAreas = sum(1 << int(area) for area in job.get('lock_areas', ()))
+            entry.lockAction = int(job.get('lock_action', LockAction.LOCK))
+        
+        results = []
+        
+        def _on_job(handle, job, result, ctx):
+            r = result.contents
+            results.append({
+                'index': r.index,
+                'status': r.status & 0xFFFFFFFF,
+                'step': r.step,
+                'antenna': r.antenna,
+                'old_epc': bytes(r.oldCode[:r.oldCodeLen]).hex().upper(),
+                'attempts': r.attempts,
+                'retries': r.retries,
+                'elapsed_ms': r.elapsedUs / 1000.0,
+            })
+        
+        cb = CommissionCallback(_on_job)
+        config = CommissionConfig(window, retries, retry_delay_ms, timeout, 0)
+        stats = CommissionStats()
+        result = self._lib.CFCommissionRun(self._handle, array, len(jobs), byref(config), cb, None, byref(stats))
+        if (result & 0xFFFFFFFF) != StatusCode.OK:
+            raise CommandError("Commissioning ended on a link error", result)
+        return results, {name: getattr(stats, name) for name, _ in CommissionStats._fields_}
+    
+    def reserve(self, ring_size: int = 0, flags: int = RESERVE_VIEWS | RESERVE_RING):
+        """
+        Allocate the per-handle buffers of the library now instead of on first use
+        
+        Requires libCFApiEx. Afterwards get_tag(), get_tags(), read_tag() and
+        start_ring() + pop_ring() with the same size do no heap allocation
+        in the library. Call it before starting an inventory.
+        
+        Args:
+            ring_size: Tags of the start_ring() ring (0 for RING_DEFAULT_SIZE)
+            flags: RESERVE_* buffers to allocate
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Buffer reservation requires libCFApiEx")
+        
+        result = self._lib.CFHandleReserve(self._handle, c_size_t(ring_size), c_uint(flags))
+        if (result & 0xFFFFFFFF) != StatusCode.OK:
+            raise CommandError("Failed to reserve handle buffers", result)
+    
+    def start_ring(self, size: int = 0, flags: int = 0):
+        """
+        Start inventory streaming into a lock-free ring owned by the library
+        
+        Requires libCFApiEx. The reader thread only writes to the ring, read
+        it with pop_ring() from one thread and stop with stop_streaming().
+        Tags that arrive while the ring is full are counted in ring_stats().
+        
+        Args:
+            size: Number of tags the ring holds (0 for RING_DEFAULT_SIZE)
+            flags: Extra STREAM_* flags
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Tag ring requires libCFApiEx")
+        
+        with self._inventory_lock:
+            if self._is_inventory_running:
+                raise CommandError("Inventory already running")
+            
+            result = self._lib.InventoryStartRing(self._handle, c_size_t(size), c_uint(flags))
+            if (result & 0xFFFFFFFF) != StatusCode.OK:
+                raise CommandError("Failed to start ring inventory", result)
+            
+            self._ring_active = True
+            self._is_inventory_running = True
+    
+    def pop_ring(self, max_count: int = 64, timeout: int = 1000) -> List[Tag]:
+        """
+        Take the tags waiting in the ring started by start_ring()
+        
+        Args:
+            max_count: Maximum number of tags to return
+            timeout: Timeout while the ring is empty in milliseconds (0 to poll)
+            
+        Returns:
+            List of Tag objects (empty on timeout or once the inventory ended)
+        """
+        self._check_open()
+        
+        if self._native:
+            result, batch = self._native.ring_pop(self._handle.value, max_count, timeout)
+        else:
+            if self._ring_buf is None or len(self._ring_buf) < max_count:
+                self._ring_buf = (self._tag_compact * max_count)()
+            count = c_size_t(0)
+            result = self._lib.TagRingPop(
+                self._handle, self._ring_buf, c_size_t(max_count), byref(count), c_ushort(timeout)
+            )
+        
+        # Convert signed error code to unsigned for comparison
+        unsigned_result = result & 0xFFFFFFFF
+        
+        if unsigned_result == StatusCode.OK:
+            if self._native:
+                return [Tag(*fields) for fields in batch]
+            return [Tag.from_compact(self._ring_buf[i]) for i in range(count.value)]
+        elif unsigned_result in (StatusCode.CMD_INVENTORY_STOP, StatusCode.CMD_COMM_TIMEOUT):
+            return []
+        else:
+            raise CommandError("Failed to pop tags from ring", result)
+    
+    def ring_stats(self) -> Dict[str, int]:
+        """
+        Get the counters of the ring started by start_ring()
+        
+        Returns:
+            Dictionary with pushed, popped, overflow, truncated, capacity, used
+        """
+        self._check_open()
+        
+        stats = TagRingStats()
+        result = self._lib.TagRingGetStats(self._handle, byref(stats))
+        self._check_result(result, "Failed to get ring stats")
+        return {name: getattr(stats, name) for name, _ in TagRingStats._fields_}
+    
+    def get_link_stats(self) -> Dict[str, int]:
+        """
+        Get byte counters and the throughput the link achieved (libCFApiEx)
+        
+        Returns:
+            Dictionary with rxBytes, txBytes, elapsedMs, rxRate, txRate
+            (bytes/s since the previous call), baudRate, applied
+        """
+        self._check_open()
+        if not self._has_ext:
+            raise CommandError("Link statistics require libCFApiEx")
+        
+        stats = LinkStats()
+        result = self._lib.GetLinkStats(self._handle, byref(stats))
+        self._check_result(result, "Failed to get link stats")
+        return {name: getattr(stats, name) for name, _ in LinkStats._fields_}
+    
     def read_single_tag(self, timeout: int = 3000) -> Optional[Tag]:
         """
         Read a single tag and stop (trigger-based reading)
         
         This method starts inventory, reads until a tag is found or timeout,
         then stops the inventory. Perfect for trigger-based applications.
+        With libCFApiEx the tag is pushed by the streaming reader thread
+        instead of being polled.
         
         Args:
             timeout: Maximum time to wait for a tag in milliseconds
@@ -1207,6 +2601,9 @@ class CF591Reader:
         """
         self._check_open()
         
+        if self._has_ext:
+            return self._read_single_tag_streaming(timeout)
+        
         try:
             self.start_inventory()
             
@@ -1227,6 +2624,26 @@ class CF591Reader:
             except:
                 pass
     
+    def _read_single_tag_streaming(self, timeout: int) -> Optional[Tag]:
+        """read_single_tag() on top of the streaming reader thread"""
+        first: List[Tag] = []
+        done = threading.Event()
+        
+        def on_tags(tags: List[Tag]):
+            if not first:
+                first.append(tags[0])
+                done.set()
+        
+        try:
+            self.start_streaming(on_tags, per_tag=True, on_end=lambda status: done.set())
+            done.wait(timeout / 1000.0)
+            return first[0] if first else None
+        finally:
+            try:
+                self.stop_streaming()
+            except:
+                pass
+    
     def read_tags(self, max_tags: Optional[int] = None, timeout: int = 1000,
                   max_timeouts: int = 3) -> List[Tag]:
         """
@@ -1252,10 +2669,13 @@ class CF591Reader:
                 if max_tags and len(tags) >= max_tags:
                     break
                 
-                tag = self.get_tag(timeout=timeout)
+                batch = self.get_tags(
+                    max_count=(max_tags - len(tags)) if max_tags else 64,
+                    timeout=timeout
+                )
                 
-                if tag:
-                    tags.append(tag)
+                if batch:
+                    tags.extend(batch)
                     consecutive_timeouts = 0
                 else:
                     consecutive_timeouts += 1
@@ -1378,14 +2798,25 @@ class CF591Reader:
                 raise TagError("Failed to initiate read command", result)
             
             # Get response
-            resp = TagResp()
-            read_count = c_ubyte()
-            read_data = (c_ubyte * 256)()
-            
-            result = self._lib.GetReadTagResp(
-                self._handle, byref(resp), byref(read_count),
-                read_data, c_ushort(timeout)
-            )
+            if self._has_ext:
+                # Parsed in place in the receive slot, copied once into the result
+                view = TagReadView()
+                result = self._lib.GetReadTagRespView(self._handle, byref(view), c_ushort(timeout))
+                if (result & 0xFFFFFFFF) == StatusCode.OK:
+                    data = ctypes.string_at(
+                        ctypes.addressof(view.frame.contents) + view.dataOff, view.dataLen
+                    )
+                    self._lib.ReleaseTagReadView(self._handle, byref(view))
+                    return data
+            else:
+                resp = self._tag_resp
+                read_count = c_ubyte()
+                read_data = (c_ubyte * 256)()
+                
+                result = self._lib.GetReadTagResp(
+                    self._handle, byref(resp), byref(read_count),
+                    read_data, c_ushort(timeout)
+                )
             
             unsigned_result = result & 0xFFFFFFFF
             if unsigned_result != StatusCode.OK:
@@ -1485,7 +2916,7 @@ class CF591Reader:
                 raise TagError("Failed to initiate write command", result)
             
             # Get response
-            resp = TagResp()
+            resp = self._tag_resp
             result = self._lib.GetTagResp(
                 self._handle, c_ushort(0x0004), byref(resp), c_ushort(timeout)
             )
@@ -1824,6 +3255,8 @@ class CF591Reader:
         """
         Get current temperature and threshold
         
+        Safe to call while another thread runs the inventory.
+        
         Returns:
             Dictionary with 'current' and 'limit' temperatures
         """
@@ -1831,7 +3264,8 @@ class CF591Reader:
         
         current = c_ubyte()
         limit = c_ubyte()
-        result = self._lib.GetTemperature(self._handle, byref(current), byref(limit))
+        with self.command():
+            result = self._lib.GetTemperature(self._handle, byref(current), byref(limit))
         
         if result != StatusCode.OK:
             raise CommandError("Failed to get temperature", result)
@@ -1920,14 +3354,226 @@ class CF591Reader:
         return False
 
 
+class TagMerger:
+    """
+    Cross-reader dedup of readers covering overlapping zones (requires libCFApiEx)
+    
+    The readers stream into one native table (CF591Reader.start_merged()),
+    sharded so their reader threads rarely wait for each other. A tag is
+    owned by the reader with the strongest peak RSSI within window_ms; another
+    reader takes it over once it is stronger by hysteresis dB or the owner
+    stops reading it. pop() returns one event stream for all readers.
+    """
+    
+    def __init__(self, window_ms: int = 0, depart_ms: int = 0, hysteresis: float = 0,
+                 max_tags: int = 0, shards: int = 0, ring_size: int = 0):
+        """
+        Args (0 selects the library default):
+            window_ms: How long a reader's peak RSSI counts (500)
+            depart_ms: A tag no reader read this long departs (2000)
+            hysteresis: dB a reader must beat the owner by (3.0)
+            max_tags: Tags tracked at once (8192)
+            shards: Independently locked parts of the table (16)
+            ring_size: Events queued for pop() (RING_DEFAULT_SIZE)
+        """
+        lib, has_ext = _load_library()
+        if not has_ext:
+            raise CommandError("Cross-reader dedup requires libCFApiEx")
+        lib.TagMergeCreate.argtypes = [POINTER(TagMergeConfig)]
+        lib.TagMergeCreate.restype = c_void_p
+        lib.TagMergeDestroy.argtypes = [c_void_p]
+        lib.TagMergeDestroy.restype = None
+        lib.TagMergeFlush.argtypes = [c_void_p]
+        lib.TagMergeFlush.restype = c_int
+        lib.TagMergePop.argtypes = [c_void_p, POINTER(TagMergeEvent), c_size_t, POINTER(c_size_t), c_ushort]
+        lib.TagMergePop.restype = c_int
+        lib.TagMergeGetStats.argtypes = [c_void_p, POINTER(TagMergeStats)]
+        lib.TagMergeGetStats.restype = c_int
+        self._lib = lib
+        
+        config = TagMergeConfig()
+        config.windowMs = window_ms
+        config.departMs = depart_ms
+        config.hysteresis = int(round(hysteresis * 10))
+        config.maxTags = max_tags
+        config.shards = shards
+        config.ringSize = ring_size
+        self._merge = lib.TagMergeCreate(byref(config))
+        if not self._merge:
+            raise CommandError("Invalid merge configuration", StatusCode.CMD_PARAM_ERR)
+        self._buf = None  # Reused TagMergeEvent array for pop()
+        self._readers = {}  # Handle -> CF591Reader of start_merged()
+    
+    def pop(self, max_count: int = 64, timeout: int = 1000) -> List[Dict[str, Any]]:
+        """
+        Take the events of all readers, from one thread only
+        
+        Args:
+            max_count: Maximum number of events to return
+            timeout: Milliseconds to wait while no event is queued
+            
+        Returns:
+            List of dicts with event, reader / from_reader (CF591Reader), epc,
+            rssi (dBm), from_rssi, antenna, readers, count, first_ms and time_ms
+        """
+        if self._buf is None or len(self._buf) < max_count:
+            self._buf = (TagMergeEvent * max_count)()
+        count = c_size_t(0)
+        result = self._lib.TagMergePop(self._merge, self._buf, max_count, byref(count), c_ushort(timeout))
+        unsigned_result = result & 0xFFFFFFFF
+        if unsigned_result == StatusCode.CMD_COMM_TIMEOUT:
+            return []
+        if unsigned_result != StatusCode.OK:
+            raise CommandError("Failed to pop merged events", result)
+        
+        return [{
+            'event': e.event,
+            'reader': self._readers.get(e.hComm),
+            'from_reader': self._readers.get(e.fromHComm) if e.event == MERGE_HANDOFF else None,
+            'epc': bytes(e.code[:e.codeLen]).hex().upper(),
+            'rssi': e.rssi / 10.0,
+            'from_rssi': e.fromRssi / 10.0,
+            'antenna': e.antenna,
+            'readers': e.readers,
+            'count': e.count,
+            'first_ms': e.firstMs,
+            'time_ms': e.timeMs
+        } for e in self._buf[:count.value]]
+    
+    def flush(self):
+        """Report every tracked tag as MERGE_FLUSH (taken by the next pop()) and empty the table"""
+        self._lib.TagMergeFlush(self._merge)
+    
+    def stats(self) -> Dict[str, int]:
+        """Counters of the merger"""
+        stats = TagMergeStats()
+        self._lib.TagMergeGetStats(self._merge, byref(stats))
+        return {name: getattr(stats, name) for name, _ in TagMergeStats._fields_}
+    
+    def close(self):
+        """Free the table; stop every reader streaming into it first"""
+        if self._merge:
+            self._lib.TagMergeDestroy(self._merge)
+            self._merge = None
+
+
 # ============================================================================
 # High-Level Helper Functions
 # ============================================================================
 
+def discover_readers(kinds: int = DISCOVER_HID | DISCOVER_SERIAL, timeout: int = 800,
+                     cache_file: str = None, vendor_id: int = 0, product_id: int = 0,
+                     flags: int = 0) -> List[Dict[str, Any]]:
+    """
+    Find the readers of the host in parallel (CFDiscoverAll, requires libCFApiEx)
+    
+    Serial ports are probed all at once within timeout; ports whose USB
+    VID/PID/serial number and path cache_file already knows are reported
+    without opening them, which keeps the startup of a gateway short.
+    
+    Args:
+        kinds: DISCOVER_HID | DISCOVER_SERIAL (DISCOVER_NET needs the C API
+               for its broadcast payload)
+        timeout: Milliseconds for the whole discovery
+        cache_file: File keeping the port mappings across runs (None: process only)
+        vendor_id: USB vendor of serial ports to probe (0 = any)
+        product_id: USB product of serial ports to probe (0 = any)
+        flags: DISCOVER_VERIFY, DISCOVER_ALL_PORTS
+        
+    Returns:
+        List of dicts with kind, flags, path, index, vendor_id, product_id,
+        serial and sn (hex)
+    """
+    lib, has_ext = _load_library()
+    if not has_ext:
+        raise CommandError("Discovery requires libCFApiEx")
+    lib.CFDiscoverAll.argtypes = [POINTER(DiscoverOptions), POINTER(DiscoverResult), c_size_t, POINTER(c_size_t)]
+    lib.CFDiscoverAll.restype = c_int
+    
+    options = DiscoverOptions()
+    options.kinds = kinds
+    options.flags = flags
+    options.timeoutMs = timeout
+    options.vendorId = vendor_id
+    options.productId = product_id
+    options.cacheFile = cache_file.encode() if cache_file else None
+    results = (DiscoverResult * 64)()
+    count = c_size_t(0)
+    result = lib.CFDiscoverAll(byref(options), results, 64, byref(count))
+    if (result & 0xFFFFFFFF) not in (StatusCode.OK, StatusCode.CMD_BUF_OVERFLOW):
+        raise CommandError("Discovery failed", result)
+    
+    return [{
+        'kind': r.kind,
+        'flags': r.flags,
+        'path': r.path.decode(errors='replace'),
+        'index': r.index,
+        'vendor_id': r.vendorId,
+        'product_id': r.productId,
+        'serial': r.serial.decode(errors='replace'),
+        'sn': bytes(r.sn).hex().upper()
+    } for r in results[:count.value]]
+
+
+def query_journal(directory: str, from_us: int = 0, to_us: int = JOURNAL_TIME_MAX,
+                  epc: Optional[str] = None, limit: int = 0) -> List[Dict[str, Any]]:
+    """
+    Read events of a tag event journal of start_journal() (requires libCFApiEx)
+    
+    Args:
+        directory: Journal directory
+        from_us: First time (CLOCK_REALTIME microseconds, e.g. time.time_ns() // 1000)
+        to_us: Last time (JOURNAL_TIME_MAX: no upper bound)
+        epc: Hex EPC to look up through the EPC index (newest first), None for
+             all events of the range (oldest first)
+        limit: Stop after this many events (0: no limit)
+        
+    Returns:
+        List of dicts with time_us, source, epc, antenna, rssi (dBm), channel
+    """
+    lib, has_ext = _load_library()
+    if not has_ext:
+        raise CommandError("Tag journal requires libCFApiEx")
+    lib.TagJournalQueryRange.argtypes = [c_char_p, c_uint64, c_uint64, JournalRecordCallback, c_void_p]
+    lib.TagJournalQueryRange.restype = c_int
+    lib.TagJournalQueryCode.argtypes = [c_char_p, POINTER(c_ubyte), c_size_t, c_uint64, c_uint64, JournalRecordCallback, c_void_p]
+    lib.TagJournalQueryCode.restype = c_int
+    
+    events = []
+    
+    def _on_record(record, user_ctx):
+        r = record.contents
+        code = bytes(r.code[:min(r.codeLen, JOURNAL_CODE_MAX)])
+        events.append({
+            'time_us': r.timeUs,
+            'source': r.source,
+            'epc': code.hex().upper(),
+            'antenna': r.antenna,
+            'rssi': r.rssi / 10.0,
+            'channel': r.channel
+        })
+        # Any status other than OK ends the query
+        return 1 if limit and len(events) >= limit else StatusCode.OK
+    
+    cb = JournalRecordCallback(_on_record)
+    if epc is None:
+        result = lib.TagJournalQueryRange(directory.encode('utf-8'), from_us, to_us, cb, None)
+    else:
+        code = bytes.fromhex(epc)
+        buf = (c_ubyte * max(len(code), 1)).from_buffer_copy(code.ljust(1, b'\0'))
+        result = lib.TagJournalQueryCode(directory.encode('utf-8'), buf, len(code), from_us, to_us, cb, None)
+    if result not in (StatusCode.OK, 1):
+        raise CommandError(f"Failed to query journal {directory}", result)
+    return events
+
+
 def scan_for_readers(ports: List[str] = None) -> List[str]:
     """
     Scan for available RFID readers
     
+    With libCFApiEx and no explicit ports the serial ports are probed in
+    parallel (discover_readers()), otherwise one after another.
+    
     Args:
         ports: List of ports to check, or None for auto-detect
         
@@ -1937,6 +3583,10 @@ def scan_for_readers(ports: List[str] = None) -> List[str]:
     import glob
     
     if ports is None:
+        try:
+            return [r['path'] for r in discover_readers(DISCOVER_SERIAL)]
+        except (OSError, CommandError):
+            pass
         # Auto-detect serial ports
         ports = glob.glob('/dev/ttyUSB*') + glob.glob('/dev/ttyACM*')
     
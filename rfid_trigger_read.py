@@ -21,7 +21,7 @@ import sys
 import os
 import time
 from datetime import datetime
-from chafon_cf591 import CF591Reader, CF591Error
+from chafon_cf591 import CF591Reader, CF591Error, TRIGGER_HOST
 
 # ============================================================================
 # Configuration
@@ -174,6 +174,54 @@ def start_inventory_safe(reader, max_retries=5, initial_delay=0.2):
     return False
 
 
+def read_tag_armed(reader, read_start_time, read_start_datetime):
+    """
+    Read one tag through the armed trigger path of libCFApiEx.
+    
+    The reader was primed by arm_trigger(): this call is the trigger, it sends a
+    single inventory round that the reader ends by itself and returns the first
+    tag that passes CRC. No stop/start round trip and no buffer flush is needed.
+    """
+    enable_buzzer_safe(reader, max_retries=1, delay=0.05)
+    try:
+        got = reader.wait_trigger_tag(timeout=DEFAULT_TIMEOUT)
+    except CF591Error as e:
+        print(f"\n✗ Error reading tag: {e}")
+        print()
+        disable_buzzer_safe(reader)
+        return
+    
+    duration = (time.time() - read_start_time) * 1000
+    if got is None:
+        disable_buzzer_safe(reader)
+        print("\n✗ No tag detected within timeout")
+        print(f"Duration:   {duration:.2f} ms")
+        print()
+        return
+    
+    tag, timing = got
+    try:
+        reader.disable_buzzer()
+    except CF591Error:
+        pass
+    print("\n" + "=" * 60)
+    print("TAG DETECTED!")
+    print("=" * 60)
+    print(f"EPC:        {tag.epc}")
+    print(f"RSSI:       {tag.rssi:.1f} dBm")
+    print(f"Antenna:    {tag.antenna}")
+    print(f"Channel:    {tag.channel}")
+    print(f"Length:     {tag.length} bytes")
+    print("-" * 60)
+    print(f"Start Time:  {read_start_datetime.strftime('%Y-%m-%d %H:%M:%S.%f')[:-3]}")
+    print(f"Trigger to tag: {timing['latency_ms']:.2f} ms ({timing['rounds']} round(s))")
+    print(f"Duration:   {duration:.2f} ms")
+    print("=" * 60)
+    print()
+    print("✓ Tag read successfully")
+    print()
+
+
 # ============================================================================
 # Main Function
 # ============================================================================
@@ -350,33 +398,45 @@ def main():
         
         print()
         
-        # Initialize reader state - start inventory and keep it running
-        print("Initializing reader state...")
-        try:
-            reader.stop_inventory()
-            time.sleep(0.1)  # Give device time to settle
-        except:
-            pass
-        
-        # Start inventory and keep it running continuously (like sample code)
-        # Use retry logic to handle intermittent communication errors
-        print("Starting inventory...", end="", flush=True)
+        # With libCFApiEx, prime the armed trigger path: each read is one
+        # inventory round the reader ends itself, nothing runs in between
+        armed = False
         try:
-            start_inventory_safe(reader, max_retries=5, initial_delay=0.2)
-            print(" ✓")
-            time.sleep(0.1)  # Small delay for inventory to stabilize
+            reader.arm_trigger(TRIGGER_HOST)
+            armed = True
+            print("✓ Ready for reading (armed trigger, single round per read)")
+            print()
         except CF591Error as e:
-            print(f" ✗")
-            print(f"\n✗ Failed to start inventory after retries: {e}")
-            print("\nTroubleshooting:")
-            print("  1. Try unplugging and replugging the USB device")
-            print("  2. Check if another program is using the device")
-            print("  3. Restart the program")
-            print("  4. Check device permissions: sudo chmod 666 /dev/ttyUSB0")
-            sys.exit(1)
+            print(f"⚠ Armed trigger unavailable ({e}), using continuous inventory")
         
-        print("✓ Ready for reading (inventory running continuously)")
-        print()
+        if not armed:
+            # Initialize reader state - start inventory and keep it running
+            print("Initializing reader state...")
+            try:
+                reader.stop_inventory()
+                time.sleep(0.1)  # Give device time to settle
+            except:
+                pass
+            
+            # Start inventory and keep it running continuously (like sample code)
+            # Use retry logic to handle intermittent communication errors
+            print("Starting inventory...", end="", flush=True)
+            try:
+                start_inventory_safe(reader, max_retries=5, initial_delay=0.2)
+                print(" ✓")
+                time.sleep(0.1)  # Small delay for inventory to stabilize
+            except CF591Error as e:
+                print(f" ✗")
+                print(f"\n✗ Failed to start inventory after retries: {e}")
+                print("\nTroubleshooting:")
+                print("  1. Try unplugging and replugging the USB device")
+                print("  2. Check if another program is using the device")
+                print("  3. Restart the program")
+                print("  4. Check device permissions: sudo chmod 666 /dev/ttyUSB0")
+                sys.exit(1)
+            
+            print("✓ Ready for reading (inventory running continuously)")
+            print()
         
         # Main loop
         while True:
@@ -396,6 +456,14 @@ def main():
             read_start_datetime = datetime.now()
             print(f"\n[Timestamp: {read_start_datetime.strftime('%Y-%m-%d %H:%M:%S.%f')[:-3]}] Reading started")
             
+            if armed:
+                try:
+                    read_tag_armed(reader, read_start_time, read_start_datetime)
+                except KeyboardInterrupt:
+                    print("\n\nInterrupted by user")
+                    break
+                continue
+            
             # Clear any buffered tags quickly (inventory is already running)
             print("\n" + "-" * 60)
             print("Reading RFID tag...")